@@ -0,0 +1,205 @@
+#ifndef __AOT_H__
+#define __AOT_H__
+
+#include "memory.h"
+#include "utils.h"
+
+/*
+    Ahead - of - time translated code
+
+    stackvm - aot turns a guest image into C, one host function per basic
+    block, which is compiled and linked into the frontend. Blocks work on a
+    local copy of the AOTGuest, so the host compiler can keep the guest
+    registers in host registers, and access memory through the inlined page
+    table accessors. Writes to pages holding decoded code or a device take
+    the slow path through the memory module, so the runtime hears about
+    writes to translated code as it would from the interpreter.
+
+    A block only runs while the guest bytes it was translated from are
+    still in memory, which is checked the first time it is entered and
+    again after any write to it. Everything else, including the flag
+    register, halt and I/O instructions and jumps to addresses only known
+    at run time, runs through the CPU opcode table.
+*/
+
+// Guest register state struct, as translated code sees it
+typedef struct aot_guest_s {
+    unsigned short a, b, s, i;
+
+    // Zero, carry, sign and overflow flags, held as 0 or 1
+    unsigned char zf, cf, sf, vf;
+
+    // Halt and interrupt enable flags, in flags register bit order
+    unsigned char flags;
+
+    // Virtual clock in cycles
+    unsigned long long cycles;
+
+    // Number of instructions left in the batch
+    unsigned remaining;
+
+    // Set when translated code is written, so the running block stops after the write
+    unsigned char stale;
+
+    // Page table of the machine
+    const MemoryPageTable *pages;
+} AOTGuest;
+
+// Translated block struct
+typedef struct aot_block_s {
+    // Guest address and length in bytes of the instructions translated
+    unsigned short address;
+    unsigned char length;
+
+    // Number of instructions and their total cost in cycles
+    unsigned char count;
+    unsigned short cycles;
+
+    // Function running the block, leaving i at the next instruction
+    void (*function)(AOTGuest *guest);
+} AOTBlock;
+
+// Translated image struct, as written out by stackvm - aot
+typedef struct aot_image_s {
+    // Address the image was loaded at and its bytes
+    unsigned short address;
+    unsigned length;
+    const unsigned char *data;
+
+    // Blocks in address order
+    unsigned blockCount;
+    const AOTBlock *blocks;
+} AOTImage;
+
+// AOT context struct, holding the block map of one machine
+typedef struct aot_context_s AOTContext;
+
+// Function to create an AOT context, returning NULL on failure
+AOTContext *AOT_CreateContext(void);
+
+// Function to destroy an AOT context
+void AOT_DestroyContext(AOTContext *context);
+
+// Function to bind an AOT context to the calling thread, for the other AOT functions to act on
+void AOT_BindContext(AOTContext *context);
+
+// Function to run translated code from an image in place of the interpreter
+int AOT_Init(const AOTImage *image);
+
+// Function to go back to the interpreter
+void AOT_Quit(void);
+
+// Function to check if translated code is enabled
+int AOT_IsEnabled(void);
+
+// Function to execute up to count CPU instructions as translated code, stopping early on halt
+unsigned AOT_Run(unsigned count);
+
+/*
+    Helpers for translated code, matching the CPU opcode functions
+*/
+
+// Macro to leave a block after a write to translated code, giving back the instructions not run
+#define AOT_CHECK(guest, g, next, refund, refundCycles) \
+    if ((guest)->stale) { (g)->i = (next); (g)->remaining += (refund); (g)->cycles -= (refundCycles); *(guest) = *(g); return; }
+
+static inline unsigned char AOT_GetByte(AOTGuest *g, unsigned short address) {
+    return Memory_ReadByte(g->pages, address);
+}
+
+static inline void AOT_SetByte(AOTGuest *g, unsigned short address, unsigned char value) {
+    Memory_WriteByte(g->pages, address, value);
+}
+
+static inline unsigned short AOT_GetShort(AOTGuest *g, unsigned short address) {
+    return Memory_ReadShort(g->pages, address);
+}
+
+static inline void AOT_SetShort(AOTGuest *g, unsigned short address, unsigned short value) {
+    Memory_WriteShort(g->pages, address, value);
+}
+
+static inline void AOT_PushByte(AOTGuest *g, unsigned char value) {
+    AOT_SetByte(g, --g->s, value);
+}
+
+static inline unsigned char AOT_PopByte(AOTGuest *g) {
+    return AOT_GetByte(g, g->s++);
+}
+
+static inline void AOT_PushShort(AOTGuest *g, unsigned short value) {
+    AOT_PushByte(g, SHORT_HI(value));
+    AOT_PushByte(g, SHORT_LO(value));
+}
+
+static inline unsigned short AOT_PopShort(AOTGuest *g) {
+    unsigned char lo = AOT_PopByte(g);
+    unsigned char hi = AOT_PopByte(g);
+
+    return TO_SHORT(lo, hi);
+}
+
+// Helper function to set the flags from an 8 - bit result, with its carry out in bit 8
+static inline unsigned char AOT_ResultByte(AOTGuest *g, unsigned result) {
+    g->zf = !(result & 0xFF);
+    g->cf = (result >> 8) & 1;
+    g->sf = (result >> 7) & 1;
+    g->vf = 0;
+
+    return result;
+}
+
+// Helper function to set the flags from a 16 - bit result, with its carry out in bit 16
+static inline unsigned short AOT_ResultShort(AOTGuest *g, unsigned result) {
+    g->zf = !(result & 0xFFFF);
+    g->cf = (result >> 16) & 1;
+    g->sf = (result >> 15) & 1;
+    g->vf = 0;
+
+    return result;
+}
+
+static inline unsigned char AOT_ADB(AOTGuest *g, unsigned char a, unsigned char b) {
+    return AOT_ResultByte(g, a + b + g->cf);
+}
+
+static inline unsigned char AOT_RLB(AOTGuest *g, unsigned char a) {
+    return AOT_ResultByte(g, (a << 1) | g->cf);
+}
+
+static inline unsigned char AOT_RRB(AOTGuest *g, unsigned char a) {
+    unsigned char result = (a >> 1) | (g->cf << 7);
+
+    AOT_ResultByte(g, result);
+    g->cf = a & 1;
+
+    return result;
+}
+
+static inline unsigned short AOT_ADS(AOTGuest *g, unsigned short a, unsigned short b) {
+    return AOT_ResultShort(g, a + b + g->cf);
+}
+
+static inline unsigned short AOT_RLS(AOTGuest *g, unsigned short a) {
+    return AOT_ResultShort(g, (a << 1) | g->cf);
+}
+
+static inline unsigned short AOT_RRS(AOTGuest *g, unsigned short a) {
+    // The carry comes in at bit 7, as it does in the interpreter
+    unsigned short result = (a >> 1) | (g->cf << 7);
+
+    AOT_ResultShort(g, result);
+    g->cf = a & 1;
+
+    return result;
+}
+
+static inline void AOT_STS(AOTGuest *g) {
+    unsigned char top1 = AOT_GetByte(g, g->s);
+    unsigned char top2 = AOT_GetByte(g, g->s + 1);
+
+    AOT_SetByte(g, g->s, top2);
+    AOT_SetByte(g, g->s + 1, top1);
+}
+
+#endif
\ No newline at end of file
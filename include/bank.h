@@ -0,0 +1,90 @@
+#ifndef __BANK_H__
+#define __BANK_H__
+
+/*
+    Bank controller
+
+    Splits the 16 - bit address space into 4 KiB or 16 KiB windows and maps
+    each onto a bank of physical memory, up to 16 MiB of it. Banks are
+    numbered in units of the window size, and the first 64 KiB of physical
+    memory are the memory array, so at start and after a window size change
+    every window maps the bank of the same number and the machine sees the
+    memory it always had. Switching a bank repoints the page table entries
+    of the window, which copies nothing, and invalidates decoded code that
+    came from the old bank. Several windows may map the same bank.
+*/
+
+// Window size shifts
+#define BANK_WINDOW_SHIFT_4K 12
+#define BANK_WINDOW_SHIFT_16K 14
+
+// Maximum number of windows, at the smallest window size
+#define BANK_WINDOW_COUNT (1 << (16 - BANK_WINDOW_SHIFT_4K))
+
+// Physical memory size limits, in bytes
+#define BANK_MEMORY_MIN 0x10000
+#define BANK_MEMORY_MAX 0x1000000
+
+// Bank controller port enum
+typedef enum bank_port_e {
+    // Read or write the selected window
+    BANK_PORT_WINDOW = 0x40,
+
+    // Read or write the bank mapped in the selected window, writing the high byte switches the bank
+    BANK_PORT_BANK_LO,
+    BANK_PORT_BANK_HI,
+
+    // Read the window size shift, write 12 or 14 to switch to 4 KiB or 16 KiB windows, mapping every window to its own bank
+    BANK_PORT_SIZE,
+
+    // Read the number of banks at the current window size
+    BANK_PORT_COUNT_LO,
+    BANK_PORT_COUNT_HI,
+} BankPort;
+
+// Bank controller context struct, holding the physical memory and windows of one machine
+typedef struct bank_context_s BankContext;
+
+// Function to create a bank controller context, returning NULL on failure
+BankContext *Bank_CreateContext(void);
+
+// Function to destroy a bank controller context, freeing its physical memory
+void Bank_DestroyContext(BankContext *context);
+
+// Function to bind a bank controller context to the calling thread, for the other bank functions to act on
+void Bank_BindContext(BankContext *context);
+
+// Function to initialize the bank controller with size bytes of physical memory, a multiple of 16 KiB from 64 KiB to 16 MiB
+int Bank_Init(unsigned size);
+
+// Function to check if the bank controller is enabled
+int Bank_IsEnabled(void);
+
+// Function to get the size of the controller state, extended memory included, in bytes, 0 while disabled
+unsigned Bank_GetStateSize(void);
+
+// Function to save the controller state into a buffer of Bank_GetStateSize bytes
+void Bank_SaveState(unsigned char *buffer);
+
+// Function to check that a saved controller state has registers in range, returning 0 if Bank_LoadState would map banks outside physical memory
+int Bank_CheckState(const unsigned char *buffer);
+
+// Function to restore the controller state from a buffer of Bank_GetStateSize bytes that passed Bank_CheckState, mapping the windows onto their banks again
+void Bank_LoadState(const unsigned char *buffer);
+
+// Function to clear the dirty map of extended memory
+void Bank_ClearDirtyMap(void);
+
+// Function to get the size of a delta of the controller state, its registers, the dirty map of extended memory and each dirty page
+unsigned Bank_GetDeltaSize(void);
+
+// Function to save a delta of the controller state into a buffer of Bank_GetDeltaSize bytes
+void Bank_SaveDelta(unsigned char *buffer);
+
+// Function to get the number of bytes a delta of the controller state takes up by its dirty map, returning 0 if it doesn't fit in size bytes or its registers are out of range
+int Bank_CheckDelta(const unsigned char *buffer, unsigned size, unsigned *length);
+
+// Function to apply a delta of the controller state, returning the number of bytes it took up
+unsigned Bank_LoadDelta(const unsigned char *buffer);
+
+#endif
\ No newline at end of file
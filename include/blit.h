@@ -0,0 +1,38 @@
+#ifndef __BLIT_H__
+#define __BLIT_H__
+
+/*
+    Pixel conversion
+
+    Expands packed video memory into 32 - bit pixels at the resolution of
+    the guest, a row at a time, leaving scaling to whatever presents the
+    frame. Monochrome bytes hold 8 pixels, least significant bit first,
+    and 16 color bytes hold 2 pixels, low nibble first. Each conversion
+    has a scalar kernel and, on x86, SSE2, SSSE3 and AVX2 kernels, the
+    best one the host supports being picked at runtime.
+*/
+
+// Conversion kernel enum
+typedef enum blit_kernel_e {
+    BLIT_KERNEL_SCALAR = 0x00,
+    BLIT_KERNEL_SSE2,
+    BLIT_KERNEL_SSSE3,
+    BLIT_KERNEL_AVX2,
+} BlitKernel;
+
+// Function to pick the best conversion kernel the host supports
+void Blit_Init(void);
+
+// Function to pick a conversion kernel, returning 0 if the host doesn't support it
+int Blit_SetKernel(BlitKernel kernel);
+
+// Function to get the conversion kernel in use
+BlitKernel Blit_GetKernel(void);
+
+// Function to expand count monochrome bytes into count * 8 pixels, set bits in color and clear bits black
+void Blit_ExpandMono(unsigned *pixels, const unsigned char *bytes, unsigned count, unsigned color);
+
+// Function to expand count 16 color bytes into count * 2 pixels through a palette of 16 colors
+void Blit_Expand16(unsigned *pixels, const unsigned char *bytes, unsigned count, const unsigned *palette);
+
+#endif
\ No newline at end of file
@@ -1,10 +1,306 @@
 #ifndef __CPU_H__
 #define __CPU_H__
 
+// Profiler switch, selected at build time by defining CPU_PROFILE as 1
+#ifndef CPU_PROFILE
+#define CPU_PROFILE 0
+#endif
+
+// CPU opcode enum
+typedef enum cpu_opcode_e {
+    // Load instructions
+    CPU_OPCODE_LDAI = 0x00,
+    CPU_OPCODE_LDBI,
+    CPU_OPCODE_LDSI,
+    CPU_OPCODE_LDAD,
+    CPU_OPCODE_LDBD,
+    CPU_OPCODE_LDSD,
+    CPU_OPCODE_LDARA,
+    CPU_OPCODE_LDBRA,
+    CPU_OPCODE_LDSRA,
+    CPU_OPCODE_LDARB,
+    CPU_OPCODE_LDBRB,
+    CPU_OPCODE_LDSRB,
+    CPU_OPCODE_LDAXA,
+    CPU_OPCODE_LDBXA,
+    CPU_OPCODE_LDSXA,
+    CPU_OPCODE_LDAXB,
+    CPU_OPCODE_LDBXB,
+    CPU_OPCODE_LDSXB,
+    CPU_OPCODE_LDAYA,
+    CPU_OPCODE_LDBYA,
+    CPU_OPCODE_LDSYA,
+    CPU_OPCODE_LDAYB,
+    CPU_OPCODE_LDBYB,
+    CPU_OPCODE_LDSYB,
+
+    // Store instructions
+    CPU_OPCODE_STAD = 0x18,
+    CPU_OPCODE_STBD,
+    CPU_OPCODE_STSD,
+    CPU_OPCODE_STARA,
+    CPU_OPCODE_STBRA,
+    CPU_OPCODE_STSRA,
+    CPU_OPCODE_STARB,
+    CPU_OPCODE_STBRB,
+    CPU_OPCODE_STSRB,
+    CPU_OPCODE_STAXA,
+    CPU_OPCODE_STBXA,
+    CPU_OPCODE_STSXA,
+    CPU_OPCODE_STAXB,
+    CPU_OPCODE_STBXB,
+    CPU_OPCODE_STSXB,
+    CPU_OPCODE_STAYA,
+    CPU_OPCODE_STBYA,
+    CPU_OPCODE_STSYA,
+    CPU_OPCODE_STAYB,
+    CPU_OPCODE_STBYB,
+    CPU_OPCODE_STSYB,
+
+    // Move instructions
+    CPU_OPCODE_MVAB = 0x2D,
+    CPU_OPCODE_MVAS,
+    CPU_OPCODE_MVAI,
+    CPU_OPCODE_MVBA,
+    CPU_OPCODE_MVBS,
+    CPU_OPCODE_MVBI,
+    CPU_OPCODE_MVSA,
+    CPU_OPCODE_MVSB,
+    CPU_OPCODE_MVSI,
+    CPU_OPCODE_MVIA,
+    CPU_OPCODE_MVIB,
+    CPU_OPCODE_MVIS,
+
+    // Push instructions
+    CPU_OPCODE_PUBI = 0x39,
+    CPU_OPCODE_PUBD,
+    CPU_OPCODE_PUBRA,
+    CPU_OPCODE_PUBRB,
+    CPU_OPCODE_PUBXA,
+    CPU_OPCODE_PUBXB,
+    CPU_OPCODE_PUBYA,
+    CPU_OPCODE_PUBYB,
+    CPU_OPCODE_PUSI,
+    CPU_OPCODE_PUSD,
+    CPU_OPCODE_PUSRA,
+    CPU_OPCODE_PUSRB,
+    CPU_OPCODE_PUSXA,
+    CPU_OPCODE_PUSXB,
+    CPU_OPCODE_PUSYA,
+    CPU_OPCODE_PUSYB,
+    CPU_OPCODE_PUA,
+    CPU_OPCODE_PUB,
+    CPU_OPCODE_PUS,
+    CPU_OPCODE_PUI,
+    CPU_OPCODE_PUF,
+
+    // Pop instructions
+    CPU_OPCODE_POBD = 0x4E,
+    CPU_OPCODE_POBRA,
+    CPU_OPCODE_POBRB,
+    CPU_OPCODE_POBXA,
+    CPU_OPCODE_POBXB,
+    CPU_OPCODE_POBYA,
+    CPU_OPCODE_POBYB,
+    CPU_OPCODE_POSD,
+    CPU_OPCODE_POSRA,
+    CPU_OPCODE_POSRB,
+    CPU_OPCODE_POSXA,
+    CPU_OPCODE_POSXB,
+    CPU_OPCODE_POSYA,
+    CPU_OPCODE_POSYB,
+    CPU_OPCODE_POA,
+    CPU_OPCODE_POB,
+    CPU_OPCODE_POS,
+    CPU_OPCODE_POI,
+    CPU_OPCODE_POF,
+
+    // Stack instructions
+    CPU_OPCODE_DTS = 0x61,
+    CPU_OPCODE_STS,
+
+    // Indexing register instructions
+    CPU_OPCODE_IRA = 0x63,
+    CPU_OPCODE_IRB,
+    CPU_OPCODE_IRS,
+    CPU_OPCODE_DRA,
+    CPU_OPCODE_DRB,
+    CPU_OPCODE_DRS,
+
+    // 8 - bit ALU instructions
+    CPU_OPCODE_ADB = 0x69,
+    CPU_OPCODE_SUB,
+    CPU_OPCODE_ANB,
+    CPU_OPCODE_ORB,
+    CPU_OPCODE_XRB,
+    CPU_OPCODE_CPB,
+    CPU_OPCODE_IVB,
+    CPU_OPCODE_ICB,
+    CPU_OPCODE_DCB,
+    CPU_OPCODE_RLB,
+    CPU_OPCODE_RRB,
+    CPU_OPCODE_SLB,
+    CPU_OPCODE_SRB,
+    CPU_OPCODE_SAB,
+
+    // 16 - bit ALU instructions
+    CPU_OPCODE_ADS = 0x77,
+    CPU_OPCODE_SUS,
+    CPU_OPCODE_ANS,
+    CPU_OPCODE_ORS,
+    CPU_OPCODE_XRS,
+    CPU_OPCODE_CPS,
+    CPU_OPCODE_IVS,
+    CPU_OPCODE_ICS,
+    CPU_OPCODE_DCS,
+    CPU_OPCODE_RLS,
+    CPU_OPCODE_RRS,
+    CPU_OPCODE_SLS,
+    CPU_OPCODE_SRS,
+    CPU_OPCODE_SAS,
+
+    // Status flag instructions
+    CPU_OPCODE_SFZ = 0x85,
+    CPU_OPCODE_SFC,
+    CPU_OPCODE_SFS,
+    CPU_OPCODE_SFV,
+    CPU_OPCODE_CFZ,
+    CPU_OPCODE_CFC,
+    CPU_OPCODE_CFS,
+    CPU_OPCODE_CFV,
+    CPU_OPCODE_EI,
+    CPU_OPCODE_DI,
+    CPU_OPCODE_HT,
+
+    // Branching instructions
+    CPU_OPCODE_JM = 0x90,
+    CPU_OPCODE_CA,
+    CPU_OPCODE_RT,
+    CPU_OPCODE_SIA,
+    CPU_OPCODE_SIB,
+    CPU_OPCODE_SIC,
+    CPU_OPCODE_SID,
+    CPU_OPCODE_SIE,
+    CPU_OPCODE_SIF,
+    CPU_OPCODE_SIG,
+    CPU_OPCODE_SIH,
+
+    // Conditional branching instructions
+    CPU_OPCODE_JMZ = 0x9B,
+    CPU_OPCODE_JMC,
+    CPU_OPCODE_JMS,
+    CPU_OPCODE_JMV,
+    CPU_OPCODE_JMNZ,
+    CPU_OPCODE_JMNC,
+    CPU_OPCODE_JMNS,
+    CPU_OPCODE_JMNV,
+    CPU_OPCODE_CAZ,
+    CPU_OPCODE_CAC,
+    CPU_OPCODE_CAS,
+    CPU_OPCODE_CAV,
+    CPU_OPCODE_CANZ,
+    CPU_OPCODE_CANC,
+    CPU_OPCODE_CANS,
+    CPU_OPCODE_CANV,
+    CPU_OPCODE_RTZ,
+    CPU_OPCODE_RTC,
+    CPU_OPCODE_RTS,
+    CPU_OPCODE_RTV,
+    CPU_OPCODE_RTNZ,
+    CPU_OPCODE_RTNC,
+    CPU_OPCODE_RTNS,
+    CPU_OPCODE_RTNV,
+
+    // I/O port instructions
+    CPU_OPCODE_IPB = 0xB3,
+    CPU_OPCODE_OPB,
+    CPU_OPCODE_IPS,
+    CPU_OPCODE_OPS,
+
+    // Miscellaneous instructions
+    CPU_OPCODE_NO = 0xB7,
+} CPUOpcode;
+
+// CPU flag masks, in flags register bit order
+#define CPU_FLAG_Z 0x01
+#define CPU_FLAG_C 0x02
+#define CPU_FLAG_S 0x04
+#define CPU_FLAG_V 0x08
+#define CPU_FLAG_H 0x10
+#define CPU_FLAG_I 0x20
+
+// CPU register state struct
+typedef struct cpu_state_s {
+    unsigned short a, b, s, i;
+
+    // Flags register, see the CPU_FLAG masks
+    unsigned char f;
+
+    // Virtual clock, the total cost of the executed instructions in cycles
+    unsigned long long cycles;
+} CPUState;
+
+// CPU context struct, holding the registers and decoded code of one machine
+typedef struct cpu_context_s CPUContext;
+
+// Function to create a CPU context, returning NULL on failure
+CPUContext *CPU_CreateContext(void);
+
+// Function to destroy a CPU context
+void CPU_DestroyContext(CPUContext *context);
+
+// Function to bind a CPU context to the calling thread, for the other CPU functions to act on
+void CPU_BindContext(CPUContext *context);
+
 // Function to initialize the CPU
 int CPU_Init(void);
 
+// Function to get the cost of an opcode in virtual clock cycles
+unsigned CPU_GetCycleCost(unsigned char opcode);
+
+// Function to get the mnemonic of an opcode, NULL if it is undefined
+const char *CPU_GetName(unsigned char opcode);
+
+// Function to get the most cycles one instruction can take, an interrupt accepted before it included
+unsigned CPU_GetMaxCycleCost(void);
+
 // Function to execute the next CPU instruction
 void CPU_Execute(void);
 
+// Function to execute up to count CPU instructions, stopping early on halt or CPU_Stop
+unsigned CPU_Run(unsigned count);
+
+// Function to check if the CPU is halted
+int CPU_IsHalted(void);
+
+// Function to resume a halted CPU at the instruction after the halt
+void CPU_Wake(void);
+
+// Function to end the running CPU_Run after the current instruction, for a device that starts following the virtual clock
+void CPU_Stop(void);
+
+// Function to check if the running CPU_Run was ended by CPU_Stop
+int CPU_IsStopped(void);
+
+// Function to set or clear the interrupt request, driven by the interrupt controller
+void CPU_SetInterruptRequest(int request);
+
+// Function to check if the CPU would accept an interrupt before the next instruction
+int CPU_IsInterruptReady(void);
+
+// Function to get the CPU register state
+void CPU_GetState(CPUState *state);
+
+// Function to set the CPU register state
+void CPU_SetState(const CPUState *state);
+
+// Function to print how often each fused instruction was executed
+void CPU_PrintFusionReport(void);
+
+// Function to print the most executed opcodes and addresses, and the time spent in I/O handlers
+void CPU_PrintProfileReport(void);
+
+// Function to write every profiler count to a file, one comma separated record per line
+int CPU_WriteProfile(const char *path);
+
 #endif
\ No newline at end of file
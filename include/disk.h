@@ -27,6 +27,21 @@ typedef enum disk_operation_e {
     DISK_OPERATION_WRITE,
 } DiskOperation;
 
+// Size of a dirty sector map in bytes, one bit per sector
+#define DISK_DIRTY_MAP_SIZE 8
+
+// Disk context struct, holding the disk image and registers of one machine
+typedef struct disk_context_s DiskContext;
+
+// Function to create a disk context, returning NULL on failure
+DiskContext *Disk_CreateContext(void);
+
+// Function to destroy a disk context
+void Disk_DestroyContext(DiskContext *context);
+
+// Function to bind a disk context to the calling thread, for the other disk functions to act on
+void Disk_BindContext(DiskContext *context);
+
 // Function to initialize the disk
 int Disk_Init(void);
 
@@ -36,6 +51,42 @@ void Disk_Quit(void);
 // Function to load a disk image
 int Disk_LoadImage(const char *path);
 
+// Function to get the disk size in bytes
+unsigned Disk_GetSize(void);
+
+// Function to get a pointer to the disk data array
+const unsigned char *Disk_GetData(void);
+
+// Function to get the size of the disk state, image included, in bytes
+unsigned Disk_GetStateSize(void);
+
+// Function to save the disk state into a buffer of Disk_GetStateSize bytes
+void Disk_SaveState(unsigned char *buffer);
+
+// Function to restore the disk state from a buffer of Disk_GetStateSize bytes
+void Disk_LoadState(const unsigned char *buffer);
+
+// Function to get the dirty map of the image, DISK_DIRTY_MAP_SIZE bytes with a bit set for each sector written since it was cleared
+void Disk_GetDirtyMap(unsigned char *map);
+
+// Function to clear the dirty map of the image
+void Disk_ClearDirtyMap(void);
+
+// Function to get the size of a delta of the disk state, its dirty map, each dirty sector and the controller registers
+unsigned Disk_GetDeltaSize(void);
+
+// Function to save a delta of the disk state into a buffer of Disk_GetDeltaSize bytes
+void Disk_SaveDelta(unsigned char *buffer);
+
+// Function to get the number of bytes a delta of the disk state takes up by its dirty map, returning 0 if it doesn't fit in size bytes
+int Disk_CheckDelta(const unsigned char *buffer, unsigned size, unsigned *length);
+
+// Function to apply a delta of the disk state, returning the number of bytes it took up
+unsigned Disk_LoadDelta(const unsigned char *buffer);
+
+// Function to check if the disk is busy reading or writing
+int Disk_IsBusy(void);
+
 // Function to update the disk
 void Disk_Update(void);
 
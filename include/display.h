@@ -50,13 +50,31 @@ typedef enum display_mode_e {
     DISPLAY_MODE_PIXEL_320_200_16_COPY,
 } DisplayMode;
 
-// Function to initialize the display
+// Display context struct, holding the registers, framebuffer and window of one display
+typedef struct display_context_s DisplayContext;
+
+// Function to create a display context, returning NULL on failure
+DisplayContext *Display_CreateContext(void);
+
+// Function to destroy a display context, after Display_Quit
+void Display_DestroyContext(DisplayContext *context);
+
+// Function to bind a display context to the calling thread, for the other display functions to act on
+void Display_BindContext(DisplayContext *context);
+
+// Function to initialize the bound display, attaching its ports to the bound machine
 int Display_Init(void);
 
 // Function to draw the display
 void Display_Draw(void);
 
-// Function to quit the display
+// Function to draw the whole display next frame, for when the window lost its contents
+void Display_Invalidate(void);
+
+// Function to get the WINDOW_W x WINDOW_H framebuffer of a headless build, NULL when drawing to a window
+const unsigned *Display_GetFramebuffer(void);
+
+// Function to quit the bound display, closing its window
 void Display_Quit(void);
 
 #endif
\ No newline at end of file
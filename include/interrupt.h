@@ -0,0 +1,64 @@
+#ifndef __INTERRUPT_H__
+#define __INTERRUPT_H__
+
+/*
+    Interrupt controller
+
+    Eight interrupt lines, each delivered through the restart vector of
+    the same number, line 0 at 0x0000 through line 7 at 0x0038. A raised
+    line stays pending until the CPU accepts it or the guest acknowledges
+    it. When the interrupt flag is set, the CPU accepts the unmasked
+    pending line of highest priority between instructions, lower lines
+    winning ties. Accepting clears the pending bit and the interrupt flag,
+    then calls the vector like the SI instructions do. Handlers set the
+    flag again with EI before returning.
+*/
+
+// Number of interrupt lines
+#define INTERRUPT_LINE_COUNT 8
+
+// Interrupt line enum
+typedef enum interrupt_line_e {
+    INTERRUPT_LINE_DISK = 1,
+} InterruptLine;
+
+// Interrupt controller port enum
+typedef enum interrupt_port_e {
+    // Read the pending lines, write 1 bits to acknowledge lines
+    INTERRUPT_PORT_PENDING = 0x10,
+
+    // Read or write the masked lines, 1 bits mask a line
+    INTERRUPT_PORT_MASK,
+
+    // Write 1 bits to raise lines from software
+    INTERRUPT_PORT_RAISE,
+
+    // Write a line in bits 4 - 6 and its priority in bits 0 - 2, higher priorities first
+    INTERRUPT_PORT_PRIORITY,
+} InterruptPort;
+
+// Interrupt controller context struct, holding the lines of one machine
+typedef struct interrupt_context_s InterruptContext;
+
+// Function to create an interrupt controller context, returning NULL on failure
+InterruptContext *Interrupt_CreateContext(void);
+
+// Function to destroy an interrupt controller context
+void Interrupt_DestroyContext(InterruptContext *context);
+
+// Function to bind an interrupt controller context to the calling thread, for the other interrupt functions to act on
+void Interrupt_BindContext(InterruptContext *context);
+
+// Function to initialize the interrupt controller, after the I/O ports
+int Interrupt_Init(void);
+
+// Function to raise interrupt lines, one bit per line
+void Interrupt_Raise(unsigned char lines);
+
+// Function to accept the highest priority unmasked pending line, returning its number or -1 if none is pending
+int Interrupt_Acknowledge(void);
+
+// Function to pass the controller state on to the CPU interrupt request, after it was restored
+void Interrupt_Update(void);
+
+#endif
\ No newline at end of file
@@ -1,14 +1,86 @@
 #ifndef __IO_H__
 #define __IO_H__
 
+// Size of a port map in bytes, one bit per port
+#define IO_PORT_MAP_SIZE 32
+
+// Maximum number of device state blocks
+#define IO_STATE_COUNT 16
+
+// I/O trace mode enum
+typedef enum io_trace_e {
+    IO_TRACE_NONE = 0,
+    IO_TRACE_RECORD,
+    IO_TRACE_REPLAY,
+} IOTrace;
+
+// I/O context struct, holding the port functions of one machine
+typedef struct io_context_s IOContext;
+
+// Function to create an I/O context, returning NULL on failure
+IOContext *IO_CreateContext(void);
+
+// Function to destroy an I/O context
+void IO_DestroyContext(IOContext *context);
+
+// Function to bind an I/O context to the calling thread, for the other I/O functions to act on
+void IO_BindContext(IOContext *context);
+
 // Function to initialize I/O ports
 int IO_Init(void);
 
-// Function to register a read function for a port
-void IO_RegisterRead(unsigned char port, unsigned char (*funcptr)(void));
+// Function to register a read function for a port, called with user
+void IO_RegisterRead(unsigned char port, unsigned char (*funcptr)(void *user), void *user);
+
+// Function to register a write function for a port, called with user
+void IO_RegisterWrite(unsigned char port, void (*funcptr)(void *user, unsigned char value), void *user);
+
+// Function to mark a port as internal, belonging to a device whose whole state is part of the machine
+// Traces neither log nor stub out internal ports, a replay runs the device itself and it answers as it did in the recording
+// Registering a read or write function on the port clears the mark
+void IO_SetInternal(unsigned char port);
+
+// Function to register a block of device state, saved and restored with machine snapshots
+int IO_RegisterState(void *data, unsigned size);
+
+// Function to get the number of registered device state blocks
+unsigned IO_GetStateCount(void);
+
+// Function to get a registered device state block and its size
+void *IO_GetState(unsigned index, unsigned *size);
+
+// Function to get the maps of ports with a device bound for reading and writing
+void IO_GetPortMaps(unsigned char *readMap, unsigned char *writeMap);
+
+// Function to start logging port reads and device updates to a file
+int IO_StartRecording(const char *path);
+
+// Function to start feeding port reads and device updates from a log, instead of the devices
+int IO_StartReplay(const char *path);
+
+// Function to stop recording or replaying, closing the log
+void IO_StopTrace(void);
+
+// Function to get the trace mode, replays fall back to IO_TRACE_NONE when the log runs out or diverges
+IOTrace IO_GetTraceMode(void);
+
+// Function to log a device update at an instruction count while recording
+void IO_RecordUpdate(unsigned long long count);
+
+// Function to log a wake of the CPU by an input event at an instruction count while recording
+void IO_RecordWake(unsigned long long count);
+
+// Function to get the instruction count of the next device update or wake while replaying
+unsigned long long IO_GetNextUpdate(void);
+
+// Function to check if the next device update is a wake while replaying
+int IO_IsNextWake(void);
+
+// Function to move on to the next device update or wake while replaying
+void IO_ReplayUpdate(void);
 
-// Function to register a write function for a port
-void IO_RegisterWrite(unsigned char port, void (*funcptr)(unsigned char value));
+// Function to get the number of handler calls on a port and the time spent in them in nanoseconds, zero unless CPU_PROFILE is set
+void IO_GetProfile(unsigned char port, unsigned long long *calls, unsigned long long *time);
 
 // Function to read a port
 unsigned char IO_Read(unsigned char port);
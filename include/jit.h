@@ -0,0 +1,28 @@
+#ifndef __JIT_H__
+#define __JIT_H__
+
+// JIT context struct, holding the translation cache of one machine
+typedef struct jit_context_s JITContext;
+
+// Function to create a JIT context, returning NULL on failure
+JITContext *JIT_CreateContext(void);
+
+// Function to destroy a JIT context, freeing its code buffer
+void JIT_DestroyContext(JITContext *context);
+
+// Function to bind a JIT context to the calling thread, for the other JIT functions to act on
+void JIT_BindContext(JITContext *context);
+
+// Function to initialize the JIT compiler, failing on hosts it doesn't support
+int JIT_Init(void);
+
+// Function to quit the JIT compiler
+void JIT_Quit(void);
+
+// Function to check if the JIT compiler is enabled
+int JIT_IsEnabled(void);
+
+// Function to execute up to count CPU instructions as translated code, stopping early on halt
+unsigned JIT_Run(unsigned count);
+
+#endif
\ No newline at end of file
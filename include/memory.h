@@ -1,9 +1,137 @@
 #ifndef __MEMORY_H__
 #define __MEMORY_H__
 
+// Memory size constants
+#define MEMORY_SIZE 65536
+#define MEMORY_SIZE_MASK (MEMORY_SIZE - 1)
+
+// Memory page constants
+#define MEMORY_PAGE_SIZE 256
+#define MEMORY_PAGE_SIZE_MASK (MEMORY_PAGE_SIZE - 1)
+#define MEMORY_PAGE_SIZE_SHIFT 8
+
+#define MEMORY_PAGE_COUNT 256
+
+// Size of a dirty page map in bytes, one bit per page
+#define MEMORY_DIRTY_MAP_SIZE (MEMORY_PAGE_COUNT / 8)
+
+/*
+    Page table
+
+    Each 256 - byte page is backed by 256 bytes of host RAM, its own page
+    of the memory array unless the bank controller maps other memory in,
+    and may have a device mapped over it. Reads and writes have their own
+    host pointer per page, NULL where the access goes to a device, or for
+    writes, where the page holds decoded code that must be invalidated or
+    shares its RAM with another page. RAM accesses are then a table load,
+    a test and the access itself, inlined by the header accessors below.
+    Writes to code pages check the code map inline, and only device
+    accesses and writes to shared RAM leave the header.
+
+    RAM also has a dirty flag per page, set by the first write after it
+    was cleared. Pages with a clean flag send writes through the slow
+    path, which sets the flag and lets later writes take the fast path
+    again, so tracking costs one slow write per page and checkpoint.
+
+    Device pages only take data accesses. Instructions are always fetched
+    from the RAM behind a page, so every CPU dispatch method and
+    translated code run the same bytes.
+*/
+
+typedef struct memory_page_table_s {
+    // Host pointer to each page for reads, NULL where a device is mapped
+    unsigned char *read[MEMORY_PAGE_COUNT];
+
+    // Host pointer to each page for writes, NULL where a device is mapped, the page holds decoded code, shares its RAM or is clean
+    unsigned char *write[MEMORY_PAGE_COUNT];
+
+    // Host pointer to the RAM behind each page, for instruction fetches and writes to code pages
+    unsigned char *ram[MEMORY_PAGE_COUNT];
+
+    // Set for pages whose writes leave the header, with a device mapped in either direction, or RAM that is shared or clean
+    unsigned char slow[MEMORY_PAGE_COUNT];
+
+    // Code map, for writes to pages holding decoded code
+    const unsigned char *code;
+} MemoryPageTable;
+
+// Memory context struct, holding the memory and code map of one machine
+typedef struct memory_context_s MemoryContext;
+
+// Function to create a memory context, returning NULL on failure
+MemoryContext *Memory_CreateContext(void);
+
+// Function to destroy a memory context
+void Memory_DestroyContext(MemoryContext *context);
+
+// Function to bind a memory context to the calling thread, for the other memory functions to act on
+void Memory_BindContext(MemoryContext *context);
+
 // Function to initialize memory
 int Memory_Init(void);
 
+// Function to replace the whole memory array, invalidating decoded code on pages that change and marking them dirty
+void Memory_LoadData(const unsigned char *data);
+
+// Function to get the dirty map of the memory array, MEMORY_DIRTY_MAP_SIZE bytes with a bit set for each page written since it was cleared
+void Memory_GetDirtyMap(unsigned char *map);
+
+// Function to clear the dirty map of the memory array
+void Memory_ClearDirtyMap(void);
+
+// Function to refresh the page table after dirty flags passed to Memory_MapRAM were changed outside the memory module
+void Memory_UpdateDirty(void);
+
+// Function to get the size of a delta of the memory array, its dirty map followed by each dirty page
+unsigned Memory_GetDeltaSize(void);
+
+// Function to save a delta of the memory array into a buffer of Memory_GetDeltaSize bytes
+void Memory_SaveDelta(unsigned char *buffer);
+
+// Function to get the number of bytes a delta of the memory array takes up by its dirty map, returning 0 if it doesn't fit in size bytes
+int Memory_CheckDelta(const unsigned char *buffer, unsigned size, unsigned *length);
+
+// Function to apply a delta of the memory array, returning the number of bytes it took up
+unsigned Memory_LoadDelta(const unsigned char *buffer);
+
+// Function to get a pointer to the memory array
+unsigned char *Memory_GetData(void);
+
+// Function to get the page table, which stays at the same address for the life of the context
+const MemoryPageTable *Memory_GetPageTable(void);
+
+// Function to read a byte from a device page
+unsigned char Memory_ReadSlow(unsigned short address);
+
+// Function to write a byte to a device page, or to RAM under it where the device doesn't take writes
+// Writes to shared RAM report decoded code on the other pages sharing it straight away
+// Returns 1 if the write overwrote decoded code
+int Memory_WriteSlow(unsigned short address, unsigned char value);
+
+// Function to call the registered code write function
+void Memory_NotifyCodeWrite(unsigned short address);
+
+// Function to write a byte to the RAM behind a page, bypassing any device but still reporting writes to decoded code
+void Memory_SetRAMByte(unsigned short address, unsigned char value);
+
+// Function to back a page with 256 bytes of host memory and its dirty flag, NULL for its own page of the memory array
+// Memory in the memory array keeps its own dirty flags, so dirty is NULL for it
+// Set shared while other pages are backed by the same memory, so writes through either reach decoded code on both
+// Decoded code on the page is invalidated if its memory changes
+void Memory_MapRAM(unsigned char page, unsigned char *data, unsigned char *dirty, int shared);
+
+// Function to invalidate decoded code on a page whose RAM changed behind the memory module
+void Memory_InvalidatePage(unsigned char page);
+
+// Function to map a page to a device, either function may be NULL to leave that direction as RAM
+void Memory_MapDevice(unsigned char page, unsigned char (*read)(void *user, unsigned short address), void (*write)(void *user, unsigned short address, unsigned char value), void *user);
+
+// Function to map a page back to RAM
+void Memory_UnmapDevice(unsigned char page);
+
+// Function to check if a page is mapped to a device in either direction
+int Memory_HasDevice(unsigned char page);
+
 // Function to get a byte from memory
 unsigned char Memory_GetByte(unsigned short address);
 
@@ -16,4 +144,79 @@ unsigned short Memory_GetShort(unsigned short address);
 // Function to set a short in memory
 void Memory_SetShort(unsigned short address, unsigned short value);
 
+// Function to mark a range of bytes as holding decoded code
+void Memory_SetCode(unsigned short address, unsigned char length);
+
+// Function to unmark a page as holding decoded code
+void Memory_ClearCodePage(unsigned char page);
+
+// Function to get a pointer to the code map, one flag per byte
+const unsigned char *Memory_GetCodeMap(void);
+
+// Function to register the function called on writes to decoded code
+void Memory_RegisterCodeWrite(void (*funcptr)(unsigned short address));
+
+/*
+    Inline accessors, for the CPU and translated code
+*/
+
+// Instruction fetches, and accesses that must not reach a device, read the RAM behind the page
+static inline unsigned char Memory_FetchByte(const MemoryPageTable *pages, unsigned short address) {
+    return pages->ram[address >> MEMORY_PAGE_SIZE_SHIFT][address & MEMORY_PAGE_SIZE_MASK];
+}
+
+static inline unsigned char Memory_ReadByte(const MemoryPageTable *pages, unsigned short address) {
+    const unsigned char *page = pages->read[address >> MEMORY_PAGE_SIZE_SHIFT];
+
+    return page ? page[address & MEMORY_PAGE_SIZE_MASK] : Memory_ReadSlow(address);
+}
+
+// Helper function to write a byte, returning 1 if it overwrote decoded code
+// The caller reports code writes, either through Memory_NotifyCodeWrite or on its own
+static inline int Memory_StoreByte(const MemoryPageTable *pages, unsigned short address, unsigned char value) {
+    unsigned char *page = pages->write[address >> MEMORY_PAGE_SIZE_SHIFT];
+
+    if (page) {
+        page[address & MEMORY_PAGE_SIZE_MASK] = value;
+
+        return 0;
+    }
+
+    if (pages->slow[address >> MEMORY_PAGE_SIZE_SHIFT]) return Memory_WriteSlow(address, value);
+
+    pages->ram[address >> MEMORY_PAGE_SIZE_SHIFT][address & MEMORY_PAGE_SIZE_MASK] = value;
+
+    return pages->code[address];
+}
+
+static inline void Memory_WriteByte(const MemoryPageTable *pages, unsigned short address, unsigned char value) {
+    if (Memory_StoreByte(pages, address, value)) Memory_NotifyCodeWrite(address);
+}
+
+// Shorts within a page are read with one 16 - bit load, which the host compiler merges the two bytes into
+static inline unsigned short Memory_ReadShort(const MemoryPageTable *pages, unsigned short address) {
+    const unsigned char *page = pages->read[address >> MEMORY_PAGE_SIZE_SHIFT];
+    unsigned offset = address & MEMORY_PAGE_SIZE_MASK;
+
+    // Shorts crossing a page, including the wrap at 0xFFFF, take two byte reads
+    if (page && offset != MEMORY_PAGE_SIZE_MASK) return page[offset] | (page[offset + 1] << 8);
+
+    return Memory_ReadByte(pages, address) | (Memory_ReadByte(pages, address + 1) << 8);
+}
+
+static inline void Memory_WriteShort(const MemoryPageTable *pages, unsigned short address, unsigned short value) {
+    unsigned char *page = pages->write[address >> MEMORY_PAGE_SIZE_SHIFT];
+    unsigned offset = address & MEMORY_PAGE_SIZE_MASK;
+
+    if (page && offset != MEMORY_PAGE_SIZE_MASK) {
+        page[offset] = value & 0xFF;
+        page[offset + 1] = value >> 8;
+
+        return;
+    }
+
+    Memory_WriteByte(pages, address, value & 0xFF);
+    Memory_WriteByte(pages, address + 1, value >> 8);
+}
+
 #endif
\ No newline at end of file
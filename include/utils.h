@@ -10,4 +10,18 @@
 // Macro to combine two bytes into a short
 #define TO_SHORT(lo, hi) (((hi) << 8) | (lo))
 
+// Storage class of the per - thread bound machine context pointers
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// Keeps a function out of line, for slow paths that would crowd the registers of a hot caller
+#ifdef _MSC_VER
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
 #endif
\ No newline at end of file
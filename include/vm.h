@@ -0,0 +1,120 @@
+#ifndef __VM_H__
+#define __VM_H__
+
+#include "aot.h"
+#include "cpu.h"
+
+/*
+    Virtual machine API
+
+    A VM holds the complete state of one machine: CPU, memory, I/O ports,
+    disk, bank controller, JIT compiler and translated code. Any number of
+    machines can exist in one process. Every VM function binds its machine
+    to the calling thread first, so different threads may run different
+    machines at the same time, but a machine must only be used by one
+    thread at a time.
+*/
+
+// Virtual machine struct
+typedef struct vm_s VM;
+
+// Function to create a machine with its devices initialized, returning NULL on failure
+VM *VM_Create(void);
+
+// Function to destroy a machine
+void VM_Destroy(VM *vm);
+
+// Function to bind a machine to the calling thread, for the CPU, memory and I/O functions to act on
+void VM_Bind(VM *vm);
+
+// Function to run a machine through the JIT compiler, failing on hosts it doesn't support and in CPU_PROFILE builds
+int VM_EnableJIT(VM *vm);
+
+// Function to run a machine through code translated ahead of time by stackvm - aot, falling back to the interpreter elsewhere
+// Fails in CPU_PROFILE builds, which step every instruction through the interpreter
+int VM_EnableAOT(VM *vm, const AOTImage *image);
+
+// Function to add the bank controller with size bytes of physical memory, a multiple of 16 KiB from 64 KiB to 16 MiB
+int VM_EnableBanks(VM *vm, unsigned size);
+
+// Function to load a raw image file into memory at an address
+int VM_LoadImage(VM *vm, const char *path, unsigned short address);
+
+// Function to execute up to count instructions, stopping early on halt
+// Busy devices are updated right after the instruction that takes the virtual clock into each of their periods, so how runs are sliced doesn't change the result
+// A halted machine idles until its devices finish, advancing the virtual clock without executing anything
+unsigned VM_Run(VM *vm, unsigned count);
+
+// Function to check if a machine is halted with no device event pending, so only VM_Wake can resume it
+int VM_IsHalted(VM *vm);
+
+// Function to wake a halted machine, as an input event does
+// Wakes are logged while recording, and replays take theirs from the log instead
+void VM_Wake(VM *vm);
+
+// Function to get the register state of a machine
+void VM_GetState(VM *vm, CPUState *state);
+
+// Function to set the register state of a machine
+void VM_SetState(VM *vm, const CPUState *state);
+
+// Function to read bytes from memory, wrapping around at the end
+void VM_ReadMemory(VM *vm, unsigned short address, void *buffer, unsigned length);
+
+// Function to write bytes to memory, wrapping around at the end
+void VM_WriteMemory(VM *vm, unsigned short address, const void *buffer, unsigned length);
+
+// Function to get the disk size of a machine in bytes
+unsigned VM_GetDiskSize(VM *vm);
+
+// Function to read bytes from the disk, up to its end
+void VM_ReadDisk(VM *vm, unsigned address, void *buffer, unsigned length);
+
+// Function to hash the memory the CPU sees with 64 - bit FNV-1a, so runs can be compared without dumping it
+unsigned long long VM_HashMemory(VM *vm);
+
+// Function to hash the disk with 64 - bit FNV-1a
+unsigned long long VM_HashDisk(VM *vm);
+
+// Function to get a monotonic time in microseconds, for timing runs
+unsigned long long VM_GetTime(void);
+
+// Function to start recording every port read and device update to a log file
+int VM_StartRecording(VM *vm, const char *path);
+
+// Function to start replaying a log in place of the devices, which must start from the state the recording did
+int VM_StartReplay(VM *vm, const char *path);
+
+// Function to stop recording or replaying
+void VM_StopTrace(VM *vm);
+
+// Function to get the size of a machine snapshot in bytes
+unsigned VM_GetSnapshotSize(VM *vm);
+
+// Function to save the complete machine state into a buffer, returning the snapshot size or 0 if it doesn't fit
+unsigned VM_SaveSnapshot(VM *vm, void *buffer, unsigned size);
+
+// Function to restore the machine state from a snapshot, failing if it was taken with other devices attached
+int VM_LoadSnapshot(VM *vm, const void *buffer, unsigned size);
+
+// Function to get the size of a delta snapshot in bytes, which grows with the memory and disk written since the last checkpoint
+// Saving or loading any snapshot is a checkpoint
+unsigned VM_GetDeltaSnapshotSize(VM *vm);
+
+// Function to save what changed since the last checkpoint into a buffer, returning the delta snapshot size or 0 if it doesn't fit
+unsigned VM_SaveDeltaSnapshot(VM *vm, void *buffer, unsigned size);
+
+// Function to apply a delta snapshot to a machine restored to the checkpoint it was taken after, failing if it was taken with other devices attached
+int VM_LoadDeltaSnapshot(VM *vm, const void *buffer, unsigned size);
+
+// Function to attach a device to a port, either function may be NULL to leave that direction alone
+void VM_AttachDevice(VM *vm, unsigned char port, unsigned char (*read)(void *user), void (*write)(void *user, unsigned char value), void *user);
+
+// Function to map a 256 - byte page to a device, either function may be NULL to leave that direction as RAM
+// CPU data accesses to the page call the device, while instruction fetches and VM_ReadMemory / VM_WriteMemory see RAM
+void VM_MapDevice(VM *vm, unsigned char page, unsigned char (*read)(void *user, unsigned short address), void (*write)(void *user, unsigned short address, unsigned char value), void *user);
+
+// Function to map a page back to RAM
+void VM_UnmapDevice(VM *vm, unsigned char page);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "aot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "memory.h"
+#include "utils.h"
+
+// Block state enum
+typedef enum aot_block_state_e {
+    // Not yet compared with memory, or written since
+    AOT_BLOCK_UNCHECKED,
+
+    // Memory holds the bytes the block was translated from
+    AOT_BLOCK_VALID,
+
+    // Memory holds other bytes, so the interpreter runs them
+    AOT_BLOCK_INVALID,
+} AOTBlockState;
+
+// AOT context struct
+struct aot_context_s {
+    // Translated image, NULL while translated code is disabled
+    const AOTImage *image;
+
+    // Block index plus one for each guest address, 0 where no block starts
+    unsigned block[MEMORY_SIZE];
+
+    // State of each block, see AOTBlockState
+    unsigned char *state;
+
+    AOTGuest guest;
+};
+
+// AOT context bound to the calling thread
+static THREAD_LOCAL AOTContext *aot = NULL;
+
+// Function called on writes to the bytes of checked blocks
+static void AOT_CodeWrite(unsigned short address) {
+    if (!aot->image) return;
+
+    const AOTBlock *blocks = aot->image->blocks;
+
+    // Whole pages are checked again, since loading memory only reports the first code byte of each page changed
+    unsigned start = address & ~MEMORY_PAGE_SIZE_MASK;
+    unsigned end = start + MEMORY_PAGE_SIZE;
+
+    // Find the first block starting after the page, then walk back over the ones that may overlap it
+    unsigned lo = 0, hi = aot->image->blockCount;
+
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+
+        if (blocks[mid].address < end) lo = mid + 1;
+        else hi = mid;
+    }
+
+    while (lo-- > 0 && blocks[lo].address + 256 > start) {
+        if (blocks[lo].address + blocks[lo].length > start) aot->state[lo] = AOT_BLOCK_UNCHECKED;
+    }
+
+    // Stop the running block, it may be the one written
+    aot->guest.stale = 1;
+}
+
+// Function to get the block starting at an address, if memory still holds its bytes
+static const AOTBlock *AOT_Lookup(unsigned short address) {
+    unsigned index = aot->block[address];
+
+    if (!index--) return NULL;
+
+    const AOTBlock *block = &aot->image->blocks[index];
+
+    if (aot->state[index] == AOT_BLOCK_UNCHECKED) {
+        const unsigned char *data = aot->image->data + (block->address - aot->image->address);
+
+        aot->state[index] = AOT_BLOCK_VALID;
+
+        // Blocks are compared with the RAM the CPU would fetch them from, which may cross into another bank
+        for (unsigned i = 0; i < block->length; i++) {
+            if (Memory_FetchByte(aot->guest.pages, block->address + i) != data[i]) {
+                aot->state[index] = AOT_BLOCK_INVALID;
+                break;
+            }
+        }
+
+        // Writes to the block, whether it matched or not, check it again
+        Memory_SetCode(block->address, block->length);
+    }
+
+    return aot->state[index] == AOT_BLOCK_VALID ? block : NULL;
+}
+
+static void AOT_LoadState(void) {
+    CPUState state;
+
+    CPU_GetState(&state);
+
+    aot->guest.a = state.a;
+    aot->guest.b = state.b;
+    aot->guest.s = state.s;
+    aot->guest.i = state.i;
+
+    aot->guest.cycles = state.cycles;
+
+    aot->guest.zf = !!(state.f & CPU_FLAG_Z);
+    aot->guest.cf = !!(state.f & CPU_FLAG_C);
+    aot->guest.sf = !!(state.f & CPU_FLAG_S);
+    aot->guest.vf = !!(state.f & CPU_FLAG_V);
+
+    aot->guest.flags = state.f & ~(CPU_FLAG_Z | CPU_FLAG_C | CPU_FLAG_S | CPU_FLAG_V);
+}
+
+static void AOT_StoreState(void) {
+    CPUState state;
+
+    state.a = aot->guest.a;
+    state.b = aot->guest.b;
+    state.s = aot->guest.s;
+    state.i = aot->guest.i;
+
+    state.cycles = aot->guest.cycles;
+
+    state.f = aot->guest.flags;
+
+    if (aot->guest.zf) state.f |= CPU_FLAG_Z;
+    if (aot->guest.cf) state.f |= CPU_FLAG_C;
+    if (aot->guest.sf) state.f |= CPU_FLAG_S;
+    if (aot->guest.vf) state.f |= CPU_FLAG_V;
+
+    CPU_SetState(&state);
+}
+
+// Function to run one instruction through the opcode table, returning 0 if the CPU halted, would accept an interrupt or was stopped
+static int AOT_Interpret(void) {
+    AOT_StoreState();
+    CPU_Execute();
+    AOT_LoadState();
+
+    aot->guest.remaining--;
+
+    return !(aot->guest.flags & CPU_FLAG_H) && !CPU_IsInterruptReady() && !CPU_IsStopped();
+}
+
+AOTContext *AOT_CreateContext(void) {
+    AOTContext *context = calloc(1, sizeof(AOTContext));
+
+    if (!context) printf("Error: Failed to allocate AOT context\n");
+
+    return context;
+}
+
+void AOT_DestroyContext(AOTContext *context) {
+    if (!context) return;
+
+    if (aot == context) aot = NULL;
+
+    free(context->state);
+    free(context);
+}
+
+void AOT_BindContext(AOTContext *context) {
+    aot = context;
+}
+
+int AOT_Init(const AOTImage *image) {
+    if ((unsigned) image->address + image->length > MEMORY_SIZE) {
+        printf("Error: Translated image doesn't fit in memory\n");
+
+        return 0;
+    }
+
+    unsigned char *state = calloc(image->blockCount ? image->blockCount : 1, 1);
+
+    if (!state) {
+        printf("Error: Failed to allocate AOT block states\n");
+
+        return 0;
+    }
+
+    free(aot->state);
+
+    aot->image = image;
+    aot->state = state;
+
+    aot->guest.pages = Memory_GetPageTable();
+
+    memset(aot->block, 0, sizeof(aot->block));
+
+    for (unsigned i = 0; i < image->blockCount; i++)
+        aot->block[image->blocks[i].address] = i + 1;
+
+    // Only translated blocks are marked from now on
+    for (int page = 0; page < MEMORY_PAGE_COUNT; page++)
+        Memory_ClearCodePage(page);
+
+    Memory_RegisterCodeWrite(AOT_CodeWrite);
+
+    return 1;
+}
+
+void AOT_Quit(void) {
+    aot->image = NULL;
+}
+
+int AOT_IsEnabled(void) {
+    return aot && aot->image;
+}
+
+unsigned AOT_Run(unsigned count) {
+    AOT_LoadState();
+
+    if (aot->guest.flags & CPU_FLAG_H) return 0;
+
+    aot->guest.remaining = count;
+
+    // Only interpreted instructions can halt the CPU or let an interrupt through, and CPU_Run accepts it
+    int running = !CPU_IsInterruptReady();
+
+    while (running && aot->guest.remaining) {
+        const AOTBlock *block = AOT_Lookup(aot->guest.i);
+
+        if (!block) {
+            running = AOT_Interpret();
+            continue;
+        }
+
+        if (block->count > aot->guest.remaining) {
+            // Finish the batch one instruction at a time
+            while (aot->guest.remaining && AOT_Interpret());
+
+            break;
+        }
+
+        aot->guest.remaining -= block->count;
+        aot->guest.cycles += block->cycles;
+        aot->guest.stale = 0;
+
+        block->function(&aot->guest);
+    }
+
+    AOT_StoreState();
+
+    return count - aot->guest.remaining;
+}
\ No newline at end of file
@@ -0,0 +1,359 @@
+#include "bank.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "memory.h"
+#include "utils.h"
+
+// Bank controller registers struct, saved with machine snapshots ahead of extended memory
+typedef struct bank_registers_s {
+    // Bank mapped in each window
+    unsigned short bank[BANK_WINDOW_COUNT];
+
+    // Selected window
+    unsigned char window;
+
+    // Window size shift
+    unsigned char shift;
+
+    // Low byte of the bank number written to BANK_PORT_BANK_LO
+    unsigned char lo;
+} BankRegisters;
+
+// Bank controller context struct
+struct bank_context_s {
+    BankRegisters registers;
+
+    // Physical memory size in bytes, 0 while the controller is disabled
+    unsigned size;
+
+    // Physical memory past the memory array, NULL if there is none
+    unsigned char *extended;
+
+    // Dirty flag of each page of extended memory
+    unsigned char *dirty;
+};
+
+// Helper macro to get the number of pages of extended memory
+#define BANK_EXTENDED_PAGES ((bank->size - MEMORY_SIZE) >> MEMORY_PAGE_SIZE_SHIFT)
+
+// Bank controller context bound to the calling thread
+static THREAD_LOCAL BankContext *bank = NULL;
+
+// Helper function to get the number of windows at the current window size
+static unsigned Bank_GetWindowCount(void) {
+    return 1 << (16 - bank->registers.shift);
+}
+
+// Helper function to get the number of banks at the current window size
+static unsigned Bank_GetBankCount(void) {
+    return bank->size >> bank->registers.shift;
+}
+
+
+// Function to check that saved registers select a window size the controller supports and only map banks inside physical memory
+static int Bank_CheckRegisters(const unsigned char *buffer) {
+    BankRegisters registers;
+
+    memcpy(&registers, buffer, sizeof(BankRegisters));
+
+    if (registers.shift != BANK_WINDOW_SHIFT_4K && registers.shift != BANK_WINDOW_SHIFT_16K) return 0;
+
+    unsigned windows = 1 << (16 - registers.shift);
+
+    if (registers.window >= windows) return 0;
+
+    for (unsigned i = 0; i < windows; i++)
+        if (registers.bank[i] >= bank->size >> registers.shift) return 0;
+
+    return 1;
+}
+
+// Helper function to check if another window maps the same bank as a window
+static int Bank_IsShared(unsigned window) {
+    for (unsigned other = 0; other < Bank_GetWindowCount(); other++)
+        if (other != window && bank->registers.bank[other] == bank->registers.bank[window]) return 1;
+
+    return 0;
+}
+
+// Function to point the pages of a window at its bank
+static void Bank_MapWindow(unsigned window) {
+    unsigned pageShift = bank->registers.shift - MEMORY_PAGE_SIZE_SHIFT;
+    unsigned first = bank->registers.bank[window] << pageShift;
+    int shared = Bank_IsShared(window);
+
+    for (unsigned i = 0; i < 1u << pageShift; i++) {
+        unsigned page = first + i;
+
+        // Banks in the memory array are backed by the memory module itself
+        if (page < MEMORY_PAGE_COUNT) {
+            Memory_MapRAM((window << pageShift) + i, Memory_GetData() + (page << MEMORY_PAGE_SIZE_SHIFT), NULL, shared);
+            continue;
+        }
+
+        page -= MEMORY_PAGE_COUNT;
+
+        Memory_MapRAM((window << pageShift) + i, bank->extended + (page << MEMORY_PAGE_SIZE_SHIFT), &bank->dirty[page], shared);
+    }
+}
+
+// Function to replace a page of extended memory, invalidating decoded code wherever it is mapped if it changes
+static void Bank_LoadPage(unsigned page, const unsigned char *data) {
+    unsigned char *ram = bank->extended + (page << MEMORY_PAGE_SIZE_SHIFT);
+
+    if (!memcmp(ram, data, MEMORY_PAGE_SIZE)) return;
+
+    memcpy(ram, data, MEMORY_PAGE_SIZE);
+
+    bank->dirty[page] = 1;
+
+    // Find the windows mapping the bank holding the page
+    unsigned pageShift = bank->registers.shift - MEMORY_PAGE_SIZE_SHIFT;
+    unsigned physical = page + MEMORY_PAGE_COUNT;
+
+    for (unsigned i = 0; i < Bank_GetWindowCount(); i++) {
+        if (bank->registers.bank[i] != physical >> pageShift) continue;
+
+        Memory_InvalidatePage((i << pageShift) + (physical & ((1 << pageShift) - 1)));
+    }
+}
+
+// Function to switch the bank of a window
+static void Bank_Switch(unsigned window, unsigned short number) {
+    unsigned char shared[BANK_WINDOW_COUNT];
+
+    for (unsigned i = 0; i < Bank_GetWindowCount(); i++) shared[i] = Bank_IsShared(i);
+
+    bank->registers.bank[window] = number;
+
+    // Windows that start or stop sharing their bank with it are mapped again, so writes to them take the right path
+    for (unsigned i = 0; i < Bank_GetWindowCount(); i++)
+        if (i == window || shared[i] != Bank_IsShared(i)) Bank_MapWindow(i);
+}
+
+// Function to change the window size, mapping every window to the bank of the same number
+static void Bank_SetWindowShift(unsigned char shift) {
+    bank->registers.shift = shift;
+    bank->registers.window = 0;
+
+    for (unsigned i = 0; i < Bank_GetWindowCount(); i++) bank->registers.bank[i] = i;
+    for (unsigned i = 0; i < Bank_GetWindowCount(); i++) Bank_MapWindow(i);
+}
+
+// Bank controller port functions
+
+static unsigned char Bank_WindowPortRead(void *user) { return bank->registers.window; }
+static unsigned char Bank_BankLoPortRead(void *user) { return SHORT_LO(bank->registers.bank[bank->registers.window]); }
+static unsigned char Bank_BankHiPortRead(void *user) { return SHORT_HI(bank->registers.bank[bank->registers.window]); }
+static unsigned char Bank_SizePortRead(void *user) { return bank->registers.shift; }
+static unsigned char Bank_CountLoPortRead(void *user) { return SHORT_LO(Bank_GetBankCount()); }
+static unsigned char Bank_CountHiPortRead(void *user) { return SHORT_HI(Bank_GetBankCount()); }
+
+static void Bank_WindowPortWrite(void *user, unsigned char value) {
+    bank->registers.window = value & (Bank_GetWindowCount() - 1);
+}
+
+static void Bank_BankLoPortWrite(void *user, unsigned char value) {
+    bank->registers.lo = value;
+}
+
+static void Bank_BankHiPortWrite(void *user, unsigned char value) {
+    unsigned short number = TO_SHORT(bank->registers.lo, value);
+
+    // Banks past the end of physical memory are ignored
+    if (number < Bank_GetBankCount()) Bank_Switch(bank->registers.window, number);
+}
+
+static void Bank_SizePortWrite(void *user, unsigned char value) {
+    if (value == BANK_WINDOW_SHIFT_4K || value == BANK_WINDOW_SHIFT_16K) Bank_SetWindowShift(value);
+}
+
+BankContext *Bank_CreateContext(void) {
+    BankContext *context = calloc(1, sizeof(BankContext));
+
+    if (!context) printf("Error: Failed to allocate bank controller context\n");
+
+    return context;
+}
+
+void Bank_DestroyContext(BankContext *context) {
+    if (bank == context) bank = NULL;
+
+    if (context) {
+        free(context->extended);
+        free(context->dirty);
+    }
+
+    free(context);
+}
+
+void Bank_BindContext(BankContext *context) {
+    bank = context;
+}
+
+int Bank_Init(unsigned size) {
+    if (size < BANK_MEMORY_MIN || size > BANK_MEMORY_MAX || size & ((1 << BANK_WINDOW_SHIFT_16K) - 1)) {
+        printf("Error: Physical memory must be a multiple of 16 KiB from 64 KiB to 16 MiB\n");
+
+        return 0;
+    }
+
+    if (size > MEMORY_SIZE) {
+        bank->extended = calloc(size - MEMORY_SIZE, 1);
+        bank->dirty = malloc((size - MEMORY_SIZE) >> MEMORY_PAGE_SIZE_SHIFT);
+
+        if (!bank->extended || !bank->dirty) {
+            printf("Error: Failed to allocate physical memory\n");
+
+            return 0;
+        }
+    }
+
+    bank->size = size;
+
+    // Memory starts out dirty, as it was never checkpointed
+    if (bank->dirty) memset(bank->dirty, 1, BANK_EXTENDED_PAGES);
+
+    // Every window starts on its own bank, which the page table already maps
+    bank->registers.shift = BANK_WINDOW_SHIFT_16K;
+    bank->registers.window = 0;
+    bank->registers.lo = 0;
+
+    for (unsigned i = 0; i < BANK_WINDOW_COUNT; i++) bank->registers.bank[i] = i;
+
+    IO_RegisterRead(BANK_PORT_WINDOW, Bank_WindowPortRead, NULL);
+    IO_RegisterRead(BANK_PORT_BANK_LO, Bank_BankLoPortRead, NULL);
+    IO_RegisterRead(BANK_PORT_BANK_HI, Bank_BankHiPortRead, NULL);
+    IO_RegisterRead(BANK_PORT_SIZE, Bank_SizePortRead, NULL);
+    IO_RegisterRead(BANK_PORT_COUNT_LO, Bank_CountLoPortRead, NULL);
+    IO_RegisterRead(BANK_PORT_COUNT_HI, Bank_CountHiPortRead, NULL);
+
+    IO_RegisterWrite(BANK_PORT_WINDOW, Bank_WindowPortWrite, NULL);
+    IO_RegisterWrite(BANK_PORT_BANK_LO, Bank_BankLoPortWrite, NULL);
+    IO_RegisterWrite(BANK_PORT_BANK_HI, Bank_BankHiPortWrite, NULL);
+    IO_RegisterWrite(BANK_PORT_SIZE, Bank_SizePortWrite, NULL);
+
+    // Mark the controller ports internal
+    for (int port = BANK_PORT_WINDOW; port <= BANK_PORT_COUNT_HI; port++) IO_SetInternal(port);
+
+    return 1;
+}
+
+int Bank_IsEnabled(void) {
+    return bank && bank->size;
+}
+
+unsigned Bank_GetStateSize(void) {
+    if (!Bank_IsEnabled()) return 0;
+
+    return sizeof(BankRegisters) + bank->size - MEMORY_SIZE;
+}
+
+void Bank_SaveState(unsigned char *buffer) {
+    if (!Bank_IsEnabled()) return;
+
+    memcpy(buffer, &bank->registers, sizeof(BankRegisters));
+    memcpy(buffer + sizeof(BankRegisters), bank->extended, bank->size - MEMORY_SIZE);
+}
+
+int Bank_CheckState(const unsigned char *buffer) {
+    if (!Bank_IsEnabled()) return 1;
+
+    return Bank_CheckRegisters(buffer);
+}
+
+void Bank_LoadState(const unsigned char *buffer) {
+    if (!Bank_IsEnabled()) return;
+
+    memcpy(&bank->registers, buffer, sizeof(BankRegisters));
+    buffer += sizeof(BankRegisters);
+
+    // Windows are mapped before the pages are compared, so changed pages invalidate decoded code where they are now mapped
+    for (unsigned i = 0; i < Bank_GetWindowCount(); i++) Bank_MapWindow(i);
+
+    for (unsigned page = 0; page < BANK_EXTENDED_PAGES; page++)
+        Bank_LoadPage(page, buffer + (page << MEMORY_PAGE_SIZE_SHIFT));
+
+    Memory_UpdateDirty();
+}
+
+void Bank_ClearDirtyMap(void) {
+    if (!Bank_IsEnabled()) return;
+
+    memset(bank->dirty, 0, BANK_EXTENDED_PAGES);
+
+    Memory_UpdateDirty();
+}
+
+unsigned Bank_GetDeltaSize(void) {
+    if (!Bank_IsEnabled()) return 0;
+
+    unsigned size = sizeof(BankRegisters) + (BANK_EXTENDED_PAGES + 7) / 8;
+
+    for (unsigned page = 0; page < BANK_EXTENDED_PAGES; page++)
+        if (bank->dirty[page]) size += MEMORY_PAGE_SIZE;
+
+    return size;
+}
+
+void Bank_SaveDelta(unsigned char *buffer) {
+    if (!Bank_IsEnabled()) return;
+
+    unsigned char *map = buffer + sizeof(BankRegisters);
+    unsigned char *data = map + (BANK_EXTENDED_PAGES + 7) / 8;
+
+    memcpy(buffer, &bank->registers, sizeof(BankRegisters));
+    memset(map, 0, (BANK_EXTENDED_PAGES + 7) / 8);
+
+    for (unsigned page = 0; page < BANK_EXTENDED_PAGES; page++) {
+        if (!bank->dirty[page]) continue;
+
+        map[page >> 3] |= 1 << (page & 7);
+
+        memcpy(data, bank->extended + (page << MEMORY_PAGE_SIZE_SHIFT), MEMORY_PAGE_SIZE);
+        data += MEMORY_PAGE_SIZE;
+    }
+}
+
+int Bank_CheckDelta(const unsigned char *buffer, unsigned size, unsigned *length) {
+    *length = 0;
+
+    if (!Bank_IsEnabled()) return 1;
+
+    const unsigned char *map = buffer + sizeof(BankRegisters);
+
+    *length = sizeof(BankRegisters) + (BANK_EXTENDED_PAGES + 7) / 8;
+
+    if (size < *length || !Bank_CheckRegisters(buffer)) return 0;
+
+    for (unsigned page = 0; page < BANK_EXTENDED_PAGES; page++)
+        if (map[page >> 3] & (1 << (page & 7))) *length += MEMORY_PAGE_SIZE;
+
+    return *length <= size;
+}
+
+unsigned Bank_LoadDelta(const unsigned char *buffer) {
+    if (!Bank_IsEnabled()) return 0;
+
+    const unsigned char *map = buffer + sizeof(BankRegisters);
+    const unsigned char *data = map + (BANK_EXTENDED_PAGES + 7) / 8;
+
+    memcpy(&bank->registers, buffer, sizeof(BankRegisters));
+
+    for (unsigned i = 0; i < Bank_GetWindowCount(); i++) Bank_MapWindow(i);
+
+    for (unsigned page = 0; page < BANK_EXTENDED_PAGES; page++) {
+        if (!(map[page >> 3] & (1 << (page & 7)))) continue;
+
+        Bank_LoadPage(page, data);
+        data += MEMORY_PAGE_SIZE;
+    }
+
+    Memory_UpdateDirty();
+
+    return data - buffer;
+}
\ No newline at end of file
@@ -0,0 +1,416 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "vm.h"
+
+/*
+    Batch runner
+
+    Runs a set of images, each as an independent machine, on a pool of
+    worker threads and prints one JSON line per image. Jobs are dealt out
+    round - robin to one queue per worker; a worker takes jobs from the back
+    of its own queue and, once that is empty, steals from the front of the
+    others, so long running images don't leave the rest of the pool idle.
+*/
+
+// Number of instructions executed between budget, halt and timeout checks
+#define BATCH_SLICE_SIZE 10000
+
+// Default instruction budget per job
+#define BATCH_DEFAULT_BUDGET 100000000
+
+// Batch job status enum
+typedef enum batch_status_e {
+    BATCH_STATUS_HALT = 0,
+    BATCH_STATUS_BUDGET,
+    BATCH_STATUS_TIMEOUT,
+    BATCH_STATUS_ERROR,
+} BatchStatus;
+
+// Batch job status names, indexed by BatchStatus
+static const char *BATCH_STATUS_NAMES[] = { "halt", "budget", "timeout", "error" };
+
+// Batch worker queue struct, a deque of job indices
+typedef struct batch_queue_s {
+    pthread_mutex_t lock;
+    unsigned *jobs;
+    unsigned head, tail;
+} BatchQueue;
+
+// Instruction budget per job
+static unsigned long long BUDGET = BATCH_DEFAULT_BUDGET;
+
+// Wall - clock timeout per job in milliseconds, 0 for none
+static unsigned long TIMEOUT = 0;
+
+// Address images are loaded at
+static unsigned short LOAD_ADDRESS = 0;
+
+// Run the machines through the JIT compiler flag
+static int USE_JIT = 0;
+
+// Image paths, indexed by job
+static char **JOBS = NULL;
+static unsigned JOB_COUNT = 0;
+static unsigned JOB_CAPACITY = 0;
+
+// Worker queues, one per thread
+static BatchQueue *QUEUES = NULL;
+static unsigned WORKER_COUNT = 0;
+
+// Lock keeping result lines whole
+static pthread_mutex_t OUTPUT_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+// Function to get the number of processor cores
+static unsigned Batch_GetCoreCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+
+    return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? count : 1;
+#endif
+}
+
+// Function to add an image path to the job list
+static int Batch_AddJob(const char *path) {
+    if (JOB_COUNT == JOB_CAPACITY) {
+        unsigned capacity = JOB_CAPACITY ? JOB_CAPACITY * 2 : 64;
+        char **jobs = realloc(JOBS, capacity * sizeof(char *));
+
+        if (!jobs) {
+            printf("Error: Failed to allocate job list\n");
+
+            return 0;
+        }
+
+        JOBS = jobs;
+        JOB_CAPACITY = capacity;
+    }
+
+    JOBS[JOB_COUNT] = malloc(strlen(path) + 1);
+
+    if (!JOBS[JOB_COUNT]) {
+        printf("Error: Failed to allocate job list\n");
+
+        return 0;
+    }
+
+    strcpy(JOBS[JOB_COUNT++], path);
+
+    return 1;
+}
+
+// Function to compare two image paths for sorting
+static int Batch_ComparePaths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Function to add every regular file in a directory as a job, in name order
+static int Batch_ScanDirectory(const char *path) {
+    DIR *dir = opendir(path);
+
+    if (!dir) {
+        printf("Error: Failed to open directory %s\n", path);
+
+        return 0;
+    }
+
+    unsigned first = JOB_COUNT;
+    struct dirent *entry;
+    char file[4096];
+    struct stat info;
+
+    while ((entry = readdir(dir))) {
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+
+        if (stat(file, &info) || !S_ISREG(info.st_mode)) continue;
+
+        if (!Batch_AddJob(file)) {
+            closedir(dir);
+
+            return 0;
+        }
+    }
+
+    closedir(dir);
+
+    qsort(JOBS + first, JOB_COUNT - first, sizeof(char *), Batch_ComparePaths);
+
+    return 1;
+}
+
+// Function to add every image listed in a manifest as a job, one path per line
+static int Batch_ReadManifest(const char *path) {
+    FILE *file = fopen(path, "r");
+
+    if (!file) {
+        printf("Error: Failed to open manifest %s\n", path);
+
+        return 0;
+    }
+
+    char line[4096];
+
+    while (fgets(line, sizeof(line), file)) {
+        // Strip the line ending and skip blank lines
+        line[strcspn(line, "\r\n")] = 0;
+
+        if (!line[0]) continue;
+
+        if (!Batch_AddJob(line)) {
+            fclose(file);
+
+            return 0;
+        }
+    }
+
+    fclose(file);
+
+    return 1;
+}
+
+// Function to print a string as a JSON string literal
+static void Batch_PrintString(const char *string) {
+    putchar('"');
+
+    for (; *string; string++) {
+        unsigned char c = *string;
+
+        if (c == '"' || c == '\\') printf("\\%c", c);
+        else if (c < 0x20) printf("\\u%04x", c);
+        else putchar(c);
+    }
+
+    putchar('"');
+}
+
+// Function to run one job and print its result line
+static void Batch_RunJob(unsigned job) {
+    BatchStatus status = BATCH_STATUS_ERROR;
+    unsigned long long executed = 0;
+    unsigned long long start = VM_GetTime();
+    unsigned long long end = start;
+    unsigned long long memoryHash = 0, diskHash = 0;
+    CPUState state = { 0 };
+
+    VM *vm = VM_Create();
+
+    if (vm && USE_JIT) VM_EnableJIT(vm);
+
+    if (vm && VM_LoadImage(vm, JOBS[job], LOAD_ADDRESS)) {
+        unsigned long long deadline = start + (unsigned long long)TIMEOUT * 1000;
+
+        // Run in slices until the machine halts or runs out of instructions or time
+        for (;;) {
+            if (VM_IsHalted(vm)) {
+                status = BATCH_STATUS_HALT;
+                break;
+            }
+
+            if (executed >= BUDGET) {
+                status = BATCH_STATUS_BUDGET;
+                break;
+            }
+
+            if (TIMEOUT && VM_GetTime() >= deadline) {
+                status = BATCH_STATUS_TIMEOUT;
+                break;
+            }
+
+            unsigned long long slice = BUDGET - executed;
+
+            executed += VM_Run(vm, slice < BATCH_SLICE_SIZE ? slice : BATCH_SLICE_SIZE);
+        }
+
+        end = VM_GetTime();
+
+        VM_GetState(vm, &state);
+
+        memoryHash = VM_HashMemory(vm);
+        diskHash = VM_HashDisk(vm);
+    }
+
+    VM_Destroy(vm);
+
+    pthread_mutex_lock(&OUTPUT_LOCK);
+
+    printf("{\"job\":%u,\"image\":", job);
+    Batch_PrintString(JOBS[job]);
+    printf(",\"status\":\"%s\"", BATCH_STATUS_NAMES[status]);
+
+    if (status != BATCH_STATUS_ERROR) {
+        printf(",\"instructions\":%llu,\"cycles\":%llu,\"runtime_us\":%llu", executed, state.cycles, end - start);
+        printf(",\"a\":%u,\"b\":%u,\"s\":%u,\"i\":%u,\"f\":%u", state.a, state.b, state.s, state.i, state.f);
+        printf(",\"memory_hash\":\"%016llx\",\"disk_hash\":\"%016llx\"", memoryHash, diskHash);
+    }
+
+    printf("}\n");
+    fflush(stdout);
+
+    pthread_mutex_unlock(&OUTPUT_LOCK);
+}
+
+// Function to take the next job, from the back of the own queue or the front of another, returning 0 when none are left
+static int Batch_TakeJob(unsigned worker, unsigned *job) {
+    BatchQueue *queue = &QUEUES[worker];
+
+    pthread_mutex_lock(&queue->lock);
+
+    if (queue->head != queue->tail) {
+        *job = queue->jobs[--queue->tail];
+        pthread_mutex_unlock(&queue->lock);
+
+        return 1;
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+
+    // Jobs are never added once the workers start, so one empty pass means done
+    for (unsigned i = 1; i < WORKER_COUNT; i++) {
+        queue = &QUEUES[(worker + i) % WORKER_COUNT];
+
+        pthread_mutex_lock(&queue->lock);
+
+        if (queue->head != queue->tail) {
+            *job = queue->jobs[queue->head++];
+            pthread_mutex_unlock(&queue->lock);
+
+            return 1;
+        }
+
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    return 0;
+}
+
+// Function run by each worker thread
+static void *Batch_Worker(void *argument) {
+    unsigned worker = (unsigned)(size_t)argument;
+    unsigned job;
+
+    while (Batch_TakeJob(worker, &job))
+        Batch_RunJob(job);
+
+    return NULL;
+}
+
+// Function to print the command line usage
+static void Batch_PrintUsage(const char *name) {
+    printf("Usage: %s [-n instructions] [-t timeout_ms] [-w workers] [-a load_address] [-j] directory|manifest\n", name);
+}
+
+int main(int argc, char **argv) {
+    const char *input = NULL;
+
+    WORKER_COUNT = Batch_GetCoreCount();
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            BUDGET = strtoull(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            TIMEOUT = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-w") && i + 1 < argc) {
+            WORKER_COUNT = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            LOAD_ADDRESS = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-j")) {
+            USE_JIT = 1;
+        } else if (argv[i][0] != '-' && !input) {
+            input = argv[i];
+        } else {
+            Batch_PrintUsage(argv[0]);
+
+            return 1;
+        }
+    }
+
+    if (!input || !WORKER_COUNT) {
+        Batch_PrintUsage(argv[0]);
+
+        return 1;
+    }
+
+    // Collect the jobs from a directory or a manifest file
+    struct stat info;
+
+    if (stat(input, &info)) {
+        printf("Error: Failed to open %s\n", input);
+
+        return 1;
+    }
+
+    if (!(S_ISDIR(info.st_mode) ? Batch_ScanDirectory(input) : Batch_ReadManifest(input))) return 1;
+
+    if (WORKER_COUNT > JOB_COUNT) WORKER_COUNT = JOB_COUNT ? JOB_COUNT : 1;
+
+    // Deal the jobs out round - robin, so every worker starts with a share
+    QUEUES = calloc(WORKER_COUNT, sizeof(BatchQueue));
+    pthread_t *threads = calloc(WORKER_COUNT, sizeof(pthread_t));
+
+    if (!QUEUES || !threads) {
+        printf("Error: Failed to allocate workers\n");
+
+        return 1;
+    }
+
+    for (unsigned i = 0; i < WORKER_COUNT; i++) {
+        QUEUES[i].jobs = malloc((JOB_COUNT / WORKER_COUNT + 1) * sizeof(unsigned));
+
+        if (!QUEUES[i].jobs) {
+            printf("Error: Failed to allocate workers\n");
+
+            return 1;
+        }
+
+        pthread_mutex_init(&QUEUES[i].lock, NULL);
+    }
+
+    // Jobs are pushed in reverse, so each worker's own back - end pops run in list order
+    for (unsigned job = JOB_COUNT; job-- > 0;) {
+        BatchQueue *queue = &QUEUES[job % WORKER_COUNT];
+
+        queue->jobs[queue->tail++] = job;
+    }
+
+    for (unsigned i = 0; i < WORKER_COUNT; i++) {
+        if (pthread_create(&threads[i], NULL, Batch_Worker, (void *)(size_t)i)) {
+            printf("Error: Failed to start worker thread\n");
+
+            return 1;
+        }
+    }
+
+    for (unsigned i = 0; i < WORKER_COUNT; i++)
+        pthread_join(threads[i], NULL);
+
+    for (unsigned i = 0; i < WORKER_COUNT; i++) {
+        pthread_mutex_destroy(&QUEUES[i].lock);
+        free(QUEUES[i].jobs);
+    }
+
+    for (unsigned i = 0; i < JOB_COUNT; i++)
+        free(JOBS[i]);
+
+    free(threads);
+    free(QUEUES);
+    free(JOBS);
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "blit.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BLIT_X86 1
+#include <immintrin.h>
+#else
+#define BLIT_X86 0
+#endif
+
+// Scalar kernels, for any host and for the bytes past the last whole vector
+
+static void Blit_ExpandMonoScalar(unsigned *pixels, const unsigned char *bytes, unsigned count, unsigned color) {
+    for (unsigned i = 0; i < count; i++) {
+        unsigned char byte = bytes[i];
+
+        for (int j = 0; j < 8; j++) *pixels++ = color & -((byte >> j) & 1);
+    }
+}
+
+static void Blit_Expand16Scalar(unsigned *pixels, const unsigned char *bytes, unsigned count, const unsigned *palette) {
+    for (unsigned i = 0; i < count; i++) {
+        *pixels++ = palette[bytes[i] & 15];
+        *pixels++ = palette[bytes[i] >> 4];
+    }
+}
+
+#if BLIT_X86
+// SSE2 kernel, each byte broadcast and tested against the bits of 4 pixels at a time
+__attribute__((target("sse2")))
+static void Blit_ExpandMonoSSE2(unsigned *pixels, const unsigned char *bytes, unsigned count, unsigned color) {
+    const __m128i bits[2] = {
+        _mm_setr_epi32(0x01, 0x02, 0x04, 0x08),
+        _mm_setr_epi32(0x10, 0x20, 0x40, 0x80),
+    };
+
+    __m128i colors = _mm_set1_epi32(color);
+
+    for (unsigned i = 0; i < count; i++) {
+        __m128i byte = _mm_set1_epi32(bytes[i]);
+
+        for (int j = 0; j < 2; j++) {
+            __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(byte, bits[j]), bits[j]);
+
+            _mm_storeu_si128((__m128i *)pixels, _mm_and_si128(mask, colors));
+            pixels += 4;
+        }
+    }
+}
+
+// SSSE3 kernel, looking each byte of the palette colors up from its own 16 - byte plane, 8 bytes at a time
+__attribute__((target("ssse3")))
+static void Blit_Expand16SSSE3(unsigned *pixels, const unsigned char *bytes, unsigned count, const unsigned *palette) {
+    unsigned char planes[4][16];
+
+    for (int i = 0; i < 16; i++)
+        for (int j = 0; j < 4; j++) planes[j][i] = palette[i] >> (j << 3);
+
+    __m128i plane[4];
+
+    for (int j = 0; j < 4; j++) plane[j] = _mm_loadu_si128((const __m128i *)planes[j]);
+
+    __m128i nibble = _mm_set1_epi8(15);
+
+    unsigned i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i packed = _mm_loadl_epi64((const __m128i *)(bytes + i));
+
+        // 16 color indices in pixel order
+        __m128i indices = _mm_unpacklo_epi8(_mm_and_si128(packed, nibble), _mm_and_si128(_mm_srli_epi16(packed, 4), nibble));
+
+        __m128i b0 = _mm_shuffle_epi8(plane[0], indices);
+        __m128i b1 = _mm_shuffle_epi8(plane[1], indices);
+        __m128i b2 = _mm_shuffle_epi8(plane[2], indices);
+        __m128i b3 = _mm_shuffle_epi8(plane[3], indices);
+
+        // Interleave the planes back into 32 - bit colors
+        __m128i lo01 = _mm_unpacklo_epi8(b0, b1), hi01 = _mm_unpackhi_epi8(b0, b1);
+        __m128i lo23 = _mm_unpacklo_epi8(b2, b3), hi23 = _mm_unpackhi_epi8(b2, b3);
+
+        _mm_storeu_si128((__m128i *)pixels + 0, _mm_unpacklo_epi16(lo01, lo23));
+        _mm_storeu_si128((__m128i *)pixels + 1, _mm_unpackhi_epi16(lo01, lo23));
+        _mm_storeu_si128((__m128i *)pixels + 2, _mm_unpacklo_epi16(hi01, hi23));
+        _mm_storeu_si128((__m128i *)pixels + 3, _mm_unpackhi_epi16(hi01, hi23));
+
+        pixels += 16;
+    }
+
+    Blit_Expand16Scalar(pixels, bytes + i, count - i, palette);
+}
+
+// AVX2 kernels, 8 pixels a store
+
+__attribute__((target("avx2")))
+static void Blit_ExpandMonoAVX2(unsigned *pixels, const unsigned char *bytes, unsigned count, unsigned color) {
+    __m256i bits = _mm256_setr_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+    __m256i colors = _mm256_set1_epi32(color);
+
+    for (unsigned i = 0; i < count; i++) {
+        __m256i byte = _mm256_set1_epi32(bytes[i]);
+        __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(byte, bits), bits);
+
+        _mm256_storeu_si256((__m256i *)pixels, _mm256_and_si256(mask, colors));
+        pixels += 8;
+    }
+}
+
+// Looks the palette up a half at a time with a dword permute, 4 bytes at a time
+__attribute__((target("avx2")))
+static void Blit_Expand16AVX2(unsigned *pixels, const unsigned char *bytes, unsigned count, const unsigned *palette) {
+    __m256i lower = _mm256_loadu_si256((const __m256i *)palette);
+    __m256i upper = _mm256_loadu_si256((const __m256i *)(palette + 8));
+
+    __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    __m256i nibble = _mm256_set1_epi32(15);
+    __m256i seven = _mm256_set1_epi32(7);
+
+    unsigned i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256i packed = _mm256_set1_epi32(bytes[i] | (bytes[i + 1] << 8) | (bytes[i + 2] << 16) | ((unsigned)bytes[i + 3] << 24));
+        __m256i indices = _mm256_and_si256(_mm256_srlv_epi32(packed, shifts), nibble);
+
+        __m256i colors = _mm256_blendv_epi8(
+            _mm256_permutevar8x32_epi32(lower, indices),
+            _mm256_permutevar8x32_epi32(upper, indices),
+            _mm256_cmpgt_epi32(indices, seven)
+        );
+
+        _mm256_storeu_si256((__m256i *)pixels, colors);
+        pixels += 8;
+    }
+
+    Blit_Expand16Scalar(pixels, bytes + i, count - i, palette);
+}
+#endif
+
+// Conversion kernel functions arrays
+static void (*Blit_ExpandMonoFunction[])(unsigned *, const unsigned char *, unsigned, unsigned) = {
+    Blit_ExpandMonoScalar,
+#if BLIT_X86
+    Blit_ExpandMonoSSE2,
+    Blit_ExpandMonoSSE2,
+    Blit_ExpandMonoAVX2,
+#endif
+};
+
+static void (*Blit_Expand16Function[])(unsigned *, const unsigned char *, unsigned, const unsigned *) = {
+    Blit_Expand16Scalar,
+#if BLIT_X86
+    // SSE2 has no byte shuffle to look the palette up with
+    Blit_Expand16Scalar,
+    Blit_Expand16SSSE3,
+    Blit_Expand16AVX2,
+#endif
+};
+
+// Conversion kernel in use
+static BlitKernel KERNEL = BLIT_KERNEL_SCALAR;
+
+// Function to check if the host supports a kernel
+static int Blit_IsSupported(BlitKernel kernel) {
+#if BLIT_X86
+    switch (kernel) {
+        case BLIT_KERNEL_SCALAR: return 1;
+        case BLIT_KERNEL_SSE2: return __builtin_cpu_supports("sse2");
+        case BLIT_KERNEL_SSSE3: return __builtin_cpu_supports("ssse3");
+        case BLIT_KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+        default: return 0;
+    }
+#else
+    return kernel == BLIT_KERNEL_SCALAR;
+#endif
+}
+
+void Blit_Init(void) {
+    for (int kernel = BLIT_KERNEL_AVX2; kernel >= BLIT_KERNEL_SCALAR; kernel--)
+        if (Blit_SetKernel(kernel)) return;
+}
+
+int Blit_SetKernel(BlitKernel kernel) {
+    if (!Blit_IsSupported(kernel)) return 0;
+
+    KERNEL = kernel;
+
+    return 1;
+}
+
+BlitKernel Blit_GetKernel(void) {
+    return KERNEL;
+}
+
+void Blit_ExpandMono(unsigned *pixels, const unsigned char *bytes, unsigned count, unsigned color) {
+    Blit_ExpandMonoFunction[KERNEL](pixels, bytes, count, color);
+}
+
+void Blit_Expand16(unsigned *pixels, const unsigned char *bytes, unsigned count, const unsigned *palette) {
+    Blit_Expand16Function[KERNEL](pixels, bytes, count, palette);
+}
\ No newline at end of file
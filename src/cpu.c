@@ -1,12 +1,76 @@
 #include "cpu.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aot.h"
 #include "memory.h"
 #include "io.h"
+#include "interrupt.h"
+#include "jit.h"
 #include "utils.h"
 
-// The CPU struct
+// CPU dispatch methods, selected at build time by defining CPU_DISPATCH
+#define CPU_DISPATCH_TABLE 0
+#define CPU_DISPATCH_SWITCH 1
+#define CPU_DISPATCH_THREADED 2
+
+// Default to threaded code where computed goto is available
+#ifndef CPU_DISPATCH
+#ifdef __GNUC__
+#define CPU_DISPATCH CPU_DISPATCH_THREADED
+#else
+#define CPU_DISPATCH CPU_DISPATCH_SWITCH
+#endif
+#endif
+
+/*
+    Lazy status flags
+
+    ALU operations only record their result, shifted up so its sign is in
+    bit 15, with the carry out in bit 16. The overflow flag is bit 17, which
+    every ALU operation clears. The zero flag is read from its own copy of
+    the result so that it can be set independently of the sign. Flags are
+    worked out from these only when a branch, PUF or a state read needs them.
+*/
+
+typedef struct {
+    unsigned result;
+    unsigned zero;
+} CPUFlags;
+
+#define CPU_FLAGS_BIT_S 15
+#define CPU_FLAGS_BIT_C 16
+#define CPU_FLAGS_BIT_V 17
+
+// Helper macro to align an 8 - bit result, with its carry out in bit 8
+#define CPU_FLAGS_BYTE(result) ((unsigned) (result) << 8)
+
+static inline unsigned char CPU_Flags_Z(const CPUFlags *f) { return !(f->zero & 0xFFFF); }
+static inline unsigned char CPU_Flags_C(const CPUFlags *f) { return (f->result >> CPU_FLAGS_BIT_C) & 1; }
+static inline unsigned char CPU_Flags_S(const CPUFlags *f) { return (f->result >> CPU_FLAGS_BIT_S) & 1; }
+static inline unsigned char CPU_Flags_V(const CPUFlags *f) { return (f->result >> CPU_FLAGS_BIT_V) & 1; }
+
+// Helper function to set a single flag bit of the result
+static inline void CPU_Flags_SetBit(CPUFlags *f, int bit, unsigned char value) {
+    f->result = (f->result & ~(1u << bit)) | ((unsigned) value << bit);
+}
+
+static inline void CPU_Flags_SetZ(CPUFlags *f, unsigned char value) { f->zero = !value; }
+static inline void CPU_Flags_SetC(CPUFlags *f, unsigned char value) { CPU_Flags_SetBit(f, CPU_FLAGS_BIT_C, value); }
+static inline void CPU_Flags_SetS(CPUFlags *f, unsigned char value) { CPU_Flags_SetBit(f, CPU_FLAGS_BIT_S, value); }
+static inline void CPU_Flags_SetV(CPUFlags *f, unsigned char value) { CPU_Flags_SetBit(f, CPU_FLAGS_BIT_V, value); }
 
-static struct {
+// Helper function to record an aligned ALU result in place of the flags
+static inline void CPU_Flags_Result(CPUFlags *f, unsigned result) {
+    f->result = result;
+    f->zero = result;
+}
+
+// The CPU context struct, holding the state of one machine
+
+struct cpu_context_s {
     // 16 - bit CPU registers
     union {
         struct {
@@ -30,11 +94,71 @@ static struct {
 
         unsigned char value;
     } f;
-} cpu;
 
-// Helper function to fetch a byte
+    // Zero, carry, sign and overflow flags, which the bits in f only mirror on state reads
+    CPUFlags flags;
+
+    // Virtual clock in cycles
+    unsigned long long cycles;
+
+    // Set while the interrupt controller has an unmasked line pending
+    unsigned char interrupt;
+
+    // Set by a device to end the running batch after the current instruction
+    unsigned char stop;
+
+    // Page table of the machine, bound in CPU_Init
+    const MemoryPageTable *pages;
+
+    // Decoded instruction cache, one entry per address
+    struct cpu_decoded_s *decoded;
+
+    // Number of times each fused instruction was executed
+    unsigned long long *fusedHits;
+
+    // Profiler counts, only allocated when CPU_PROFILE is set
+    struct cpu_profile_s *profile;
+};
+
+// CPU context bound to the calling thread
+static THREAD_LOCAL CPUContext *cpu = NULL;
+
+// Macro to check if the CPU would accept an interrupt before the next instruction
+#define CPU_INTERRUPT_READY() (cpu->interrupt && cpu->f.i)
+
+// Macro to check if the running batch has to end before the next instruction
+#define CPU_BATCH_DONE() (CPU_INTERRUPT_READY() || cpu->stop)
+
+// Helper functions to access memory through the page table, with the RAM case inlined
+static inline unsigned char CPU_GetByte(unsigned short address) { return Memory_ReadByte(cpu->pages, address); }
+static inline void CPU_SetByte(unsigned short address, unsigned char value) { Memory_WriteByte(cpu->pages, address, value); }
+static inline unsigned short CPU_GetShort(unsigned short address) { return Memory_ReadShort(cpu->pages, address); }
+static inline void CPU_SetShort(unsigned short address, unsigned short value) { Memory_WriteShort(cpu->pages, address, value); }
+
+// Helper function to get the flags register, working out the lazy flags
+static unsigned char CPU_Util_GetFlags(void) {
+    cpu->f.z = CPU_Flags_Z(&cpu->flags);
+    cpu->f.c = CPU_Flags_C(&cpu->flags);
+    cpu->f.s = CPU_Flags_S(&cpu->flags);
+    cpu->f.v = CPU_Flags_V(&cpu->flags);
+
+    return cpu->f.value;
+}
+
+// Helper function to set the flags register
+static void CPU_Util_SetFlags(unsigned char value) {
+    cpu->f.value = value;
+
+    CPU_Flags_Result(&cpu->flags, 0);
+    CPU_Flags_SetZ(&cpu->flags, cpu->f.z);
+    CPU_Flags_SetC(&cpu->flags, cpu->f.c);
+    CPU_Flags_SetS(&cpu->flags, cpu->f.s);
+    CPU_Flags_SetV(&cpu->flags, cpu->f.v);
+}
+
+// Helper function to fetch a byte, always from RAM
 static unsigned char CPU_FetchByte(void) {
-    return Memory_GetByte(cpu.i.value++);
+    return Memory_FetchByte(cpu->pages, cpu->i.value++);
 }
 
 // Helper function to fetch a short
@@ -47,12 +171,12 @@ static unsigned short CPU_FetchShort(void) {
 
 // Helper function to push a byte onto the stack
 static void CPU_PushByte(unsigned char value) {
-    Memory_SetByte(--cpu.s.value, value);
+    CPU_SetByte(--cpu->s.value, value);
 }
 
 // Helper function to pop a byte from the stack
 static unsigned char CPU_PopByte(void) {
-    return Memory_GetByte(cpu.s.value++);
+    return CPU_GetByte(cpu->s.value++);
 }
 
 // Helper function to push a short onto the stack
@@ -73,32 +197,28 @@ static unsigned short CPU_PopShort(void) {
 #define CPU_ADDRESS_D CPU_FetchShort()
 
 // Helper macros to get the effective address for addressing mode "R"
-#define CPU_ADDRESS_RA cpu.a.value
-#define CPU_ADDRESS_RB cpu.b.value
+#define CPU_ADDRESS_RA cpu->a.value
+#define CPU_ADDRESS_RB cpu->b.value
 
 // Helper macros to get the effective address for addressing mode "X"
-#define CPU_ADDRESS_XA (cpu.a.value + CPU_FetchShort())
-#define CPU_ADDRESS_XB (cpu.b.value + CPU_FetchShort())
+#define CPU_ADDRESS_XA (cpu->a.value + CPU_FetchShort())
+#define CPU_ADDRESS_XB (cpu->b.value + CPU_FetchShort())
 
 // Helper macros to get the effective address for addressing mode "Y"
-#define CPU_ADDRESS_YA Memory_GetShort(cpu.a.value + CPU_FetchShort())
-#define CPU_ADDRESS_YB Memory_GetShort(cpu.b.value + CPU_FetchShort())
+#define CPU_ADDRESS_YA CPU_GetShort(cpu->a.value + CPU_FetchShort())
+#define CPU_ADDRESS_YB CPU_GetShort(cpu->b.value + CPU_FetchShort())
 
 /*
     8 - bit ALU helper functions
 */
 
 static unsigned char CPU_ADB(unsigned char a, unsigned char b) {
-    unsigned short result = a + b + cpu.f.c;
-    unsigned char resultByte = result;
+    unsigned short result = a + b + CPU_Flags_C(&cpu->flags);
 
-    // Update status flags
-    cpu.f.z = !resultByte;
-    cpu.f.c = result > 0xFF;
-    cpu.f.s = resultByte >> 7;
-    cpu.f.v = 0;
+    // Defer the status flags until they are read
+    CPU_Flags_Result(&cpu->flags, CPU_FLAGS_BYTE(result));
 
-    return resultByte;
+    return result;
 }
 
 static unsigned char CPU_SUB(unsigned char a, unsigned char b) {
@@ -108,11 +228,7 @@ static unsigned char CPU_SUB(unsigned char a, unsigned char b) {
 static unsigned char CPU_ANB(unsigned char a, unsigned char b) {
     unsigned char resultByte = a & b;
 
-    // Update status flags
-    cpu.f.z = !resultByte;
-    cpu.f.c = 0;
-    cpu.f.s = resultByte >> 7;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, CPU_FLAGS_BYTE(resultByte));
 
     return resultByte;
 }
@@ -120,11 +236,7 @@ static unsigned char CPU_ANB(unsigned char a, unsigned char b) {
 static unsigned char CPU_ORB(unsigned char a, unsigned char b) {
     unsigned char resultByte = a | b;
 
-    // Update status flags
-    cpu.f.z = !resultByte;
-    cpu.f.c = 0;
-    cpu.f.s = resultByte >> 7;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, CPU_FLAGS_BYTE(resultByte));
 
     return resultByte;
 }
@@ -132,11 +244,7 @@ static unsigned char CPU_ORB(unsigned char a, unsigned char b) {
 static unsigned char CPU_XRB(unsigned char a, unsigned char b) {
     unsigned char resultByte = a ^ b;
 
-    // Update status flags
-    cpu.f.z = !resultByte;
-    cpu.f.c = 0;
-    cpu.f.s = resultByte >> 7;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, CPU_FLAGS_BYTE(resultByte));
 
     return resultByte;
 }
@@ -144,35 +252,24 @@ static unsigned char CPU_XRB(unsigned char a, unsigned char b) {
 static unsigned char CPU_IVB(unsigned char a) {
     unsigned char resultByte = ~a;
 
-    // Update status flags
-    cpu.f.z = !resultByte;
-    cpu.f.c = 0;
-    cpu.f.s = resultByte >> 7;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, CPU_FLAGS_BYTE(resultByte));
 
     return resultByte;
 }
 
 static unsigned char CPU_RLB(unsigned char a) {
-    unsigned char resultByte = (a << 1) | cpu.f.c;
+    // Bit 7 shifts out into bit 8, which becomes the carry
+    unsigned short result = (a << 1) | CPU_Flags_C(&cpu->flags);
 
-    // Update status flags
-    cpu.f.z = !resultByte;
-    cpu.f.c = a >> 7;
-    cpu.f.s = resultByte >> 7;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, CPU_FLAGS_BYTE(result));
 
-    return resultByte;
+    return result;
 }
 
 static unsigned char CPU_RRB(unsigned char a) {
-    unsigned char resultByte = (a >> 1) | (cpu.f.c << 7);
+    unsigned char resultByte = (a >> 1) | (CPU_Flags_C(&cpu->flags) << 7);
 
-    // Update status flags
-    cpu.f.z = !resultByte;
-    cpu.f.c = a & 1;
-    cpu.f.s = resultByte >> 7;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, CPU_FLAGS_BYTE(resultByte) | ((a & 1) << CPU_FLAGS_BIT_C));
 
     return resultByte;
 }
@@ -182,16 +279,11 @@ static unsigned char CPU_RRB(unsigned char a) {
 */
 
 static unsigned short CPU_ADS(unsigned short a, unsigned short b) {
-    unsigned result = a + b + cpu.f.c;
-    unsigned short resultShort = result;
+    unsigned result = a + b + CPU_Flags_C(&cpu->flags);
 
-    // Update status flags
-    cpu.f.z = !resultShort;
-    cpu.f.c = result > 0xFFFF;
-    cpu.f.s = resultShort >> 15;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, result);
 
-    return resultShort;
+    return result;
 }
 
 static unsigned short CPU_SUS(unsigned short a, unsigned short b) {
@@ -201,11 +293,7 @@ static unsigned short CPU_SUS(unsigned short a, unsigned short b) {
 static unsigned short CPU_ANS(unsigned short a, unsigned short b) {
     unsigned short resultShort = a & b;
 
-    // Update status flags
-    cpu.f.z = !resultShort;
-    cpu.f.c = 0;
-    cpu.f.s = resultShort >> 15;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, resultShort);
 
     return resultShort;
 }
@@ -213,11 +301,7 @@ static unsigned short CPU_ANS(unsigned short a, unsigned short b) {
 static unsigned short CPU_ORS(unsigned short a, unsigned short b) {
     unsigned short resultShort = a | b;
 
-    // Update status flags
-    cpu.f.z = !resultShort;
-    cpu.f.c = 0;
-    cpu.f.s = resultShort >> 15;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, resultShort);
 
     return resultShort;
 }
@@ -225,11 +309,7 @@ static unsigned short CPU_ORS(unsigned short a, unsigned short b) {
 static unsigned short CPU_XRS(unsigned short a, unsigned short b) {
     unsigned short resultShort = a ^ b;
 
-    // Update status flags
-    cpu.f.z = !resultShort;
-    cpu.f.c = 0;
-    cpu.f.s = resultShort >> 15;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, resultShort);
 
     return resultShort;
 }
@@ -237,35 +317,24 @@ static unsigned short CPU_XRS(unsigned short a, unsigned short b) {
 static unsigned short CPU_IVS(unsigned short a) {
     unsigned short resultShort = ~a;
 
-    // Update status flags
-    cpu.f.z = !resultShort;
-    cpu.f.c = 0;
-    cpu.f.s = resultShort >> 15;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, resultShort);
 
     return resultShort;
 }
 
 static unsigned short CPU_RLS(unsigned short a) {
-    unsigned short resultShort = (a << 1) | cpu.f.c;
+    // Bit 15 shifts out into bit 16, which becomes the carry
+    unsigned result = (a << 1) | CPU_Flags_C(&cpu->flags);
 
-    // Update status flags
-    cpu.f.z = !resultShort;
-    cpu.f.c = a >> 15;
-    cpu.f.s = resultShort >> 15;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, result);
 
-    return resultShort;
+    return result;
 }
 
 static unsigned short CPU_RRS(unsigned short a) {
-    unsigned short resultShort = (a >> 1) | (cpu.f.c << 7);
+    unsigned short resultShort = (a >> 1) | (CPU_Flags_C(&cpu->flags) << 7);
 
-    // Update status flags
-    cpu.f.z = !resultShort;
-    cpu.f.c = a & 1;
-    cpu.f.s = resultShort >> 15;
-    cpu.f.v = 0;
+    CPU_Flags_Result(&cpu->flags, resultShort | ((a & 1) << CPU_FLAGS_BIT_C));
 
     return resultShort;
 }
@@ -274,169 +343,169 @@ static unsigned short CPU_RRS(unsigned short a) {
     Load instructions
 */
 
-static void CPU_Opcode_LDAI(void) { cpu.a.value = CPU_FetchShort(); }
-static void CPU_Opcode_LDBI(void) { cpu.b.value = CPU_FetchShort(); }
-static void CPU_Opcode_LDSI(void) { cpu.s.value = CPU_FetchShort(); }
+static void CPU_Opcode_LDAI(void) { cpu->a.value = CPU_FetchShort(); }
+static void CPU_Opcode_LDBI(void) { cpu->b.value = CPU_FetchShort(); }
+static void CPU_Opcode_LDSI(void) { cpu->s.value = CPU_FetchShort(); }
 
-static void CPU_Opcode_LDAD(void) { cpu.a.value = Memory_GetShort(CPU_ADDRESS_D); }
-static void CPU_Opcode_LDBD(void) { cpu.b.value = Memory_GetShort(CPU_ADDRESS_D); }
-static void CPU_Opcode_LDSD(void) { cpu.s.value = Memory_GetShort(CPU_ADDRESS_D); }
+static void CPU_Opcode_LDAD(void) { cpu->a.value = CPU_GetShort(CPU_ADDRESS_D); }
+static void CPU_Opcode_LDBD(void) { cpu->b.value = CPU_GetShort(CPU_ADDRESS_D); }
+static void CPU_Opcode_LDSD(void) { cpu->s.value = CPU_GetShort(CPU_ADDRESS_D); }
 
-static void CPU_Opcode_LDARA(void) { cpu.a.value = Memory_GetShort(CPU_ADDRESS_RA); }
-static void CPU_Opcode_LDBRA(void) { cpu.b.value = Memory_GetShort(CPU_ADDRESS_RA); }
-static void CPU_Opcode_LDSRA(void) { cpu.s.value = Memory_GetShort(CPU_ADDRESS_RA); }
+static void CPU_Opcode_LDARA(void) { cpu->a.value = CPU_GetShort(CPU_ADDRESS_RA); }
+static void CPU_Opcode_LDBRA(void) { cpu->b.value = CPU_GetShort(CPU_ADDRESS_RA); }
+static void CPU_Opcode_LDSRA(void) { cpu->s.value = CPU_GetShort(CPU_ADDRESS_RA); }
 
-static void CPU_Opcode_LDARB(void) { cpu.a.value = Memory_GetShort(CPU_ADDRESS_RB); }
-static void CPU_Opcode_LDBRB(void) { cpu.b.value = Memory_GetShort(CPU_ADDRESS_RB); }
-static void CPU_Opcode_LDSRB(void) { cpu.s.value = Memory_GetShort(CPU_ADDRESS_RB); }
+static void CPU_Opcode_LDARB(void) { cpu->a.value = CPU_GetShort(CPU_ADDRESS_RB); }
+static void CPU_Opcode_LDBRB(void) { cpu->b.value = CPU_GetShort(CPU_ADDRESS_RB); }
+static void CPU_Opcode_LDSRB(void) { cpu->s.value = CPU_GetShort(CPU_ADDRESS_RB); }
 
-static void CPU_Opcode_LDAXA(void) { cpu.a.value = Memory_GetShort(CPU_ADDRESS_XA); }
-static void CPU_Opcode_LDBXA(void) { cpu.b.value = Memory_GetShort(CPU_ADDRESS_XA); }
-static void CPU_Opcode_LDSXA(void) { cpu.s.value = Memory_GetShort(CPU_ADDRESS_XA); }
+static void CPU_Opcode_LDAXA(void) { cpu->a.value = CPU_GetShort(CPU_ADDRESS_XA); }
+static void CPU_Opcode_LDBXA(void) { cpu->b.value = CPU_GetShort(CPU_ADDRESS_XA); }
+static void CPU_Opcode_LDSXA(void) { cpu->s.value = CPU_GetShort(CPU_ADDRESS_XA); }
 
-static void CPU_Opcode_LDAXB(void) { cpu.a.value = Memory_GetShort(CPU_ADDRESS_XB); }
-static void CPU_Opcode_LDBXB(void) { cpu.b.value = Memory_GetShort(CPU_ADDRESS_XB); }
-static void CPU_Opcode_LDSXB(void) { cpu.s.value = Memory_GetShort(CPU_ADDRESS_XB); }
+static void CPU_Opcode_LDAXB(void) { cpu->a.value = CPU_GetShort(CPU_ADDRESS_XB); }
+static void CPU_Opcode_LDBXB(void) { cpu->b.value = CPU_GetShort(CPU_ADDRESS_XB); }
+static void CPU_Opcode_LDSXB(void) { cpu->s.value = CPU_GetShort(CPU_ADDRESS_XB); }
 
-static void CPU_Opcode_LDAYA(void) { cpu.a.value = Memory_GetShort(CPU_ADDRESS_YA); }
-static void CPU_Opcode_LDBYA(void) { cpu.b.value = Memory_GetShort(CPU_ADDRESS_YA); }
-static void CPU_Opcode_LDSYA(void) { cpu.s.value = Memory_GetShort(CPU_ADDRESS_YA); }
+static void CPU_Opcode_LDAYA(void) { cpu->a.value = CPU_GetShort(CPU_ADDRESS_YA); }
+static void CPU_Opcode_LDBYA(void) { cpu->b.value = CPU_GetShort(CPU_ADDRESS_YA); }
+static void CPU_Opcode_LDSYA(void) { cpu->s.value = CPU_GetShort(CPU_ADDRESS_YA); }
 
-static void CPU_Opcode_LDAYB(void) { cpu.a.value = Memory_GetShort(CPU_ADDRESS_YB); }
-static void CPU_Opcode_LDBYB(void) { cpu.b.value = Memory_GetShort(CPU_ADDRESS_YB); }
-static void CPU_Opcode_LDSYB(void) { cpu.s.value = Memory_GetShort(CPU_ADDRESS_YB); }
+static void CPU_Opcode_LDAYB(void) { cpu->a.value = CPU_GetShort(CPU_ADDRESS_YB); }
+static void CPU_Opcode_LDBYB(void) { cpu->b.value = CPU_GetShort(CPU_ADDRESS_YB); }
+static void CPU_Opcode_LDSYB(void) { cpu->s.value = CPU_GetShort(CPU_ADDRESS_YB); }
 
 /*
     Store instructions
 */
 
-static void CPU_Opcode_STAD(void) { Memory_SetShort(CPU_FetchShort(), cpu.a.value); }
-static void CPU_Opcode_STBD(void) { Memory_SetShort(CPU_FetchShort(), cpu.b.value); }
-static void CPU_Opcode_STSD(void) { Memory_SetShort(CPU_FetchShort(), cpu.s.value); }
+static void CPU_Opcode_STAD(void) { CPU_SetShort(CPU_FetchShort(), cpu->a.value); }
+static void CPU_Opcode_STBD(void) { CPU_SetShort(CPU_FetchShort(), cpu->b.value); }
+static void CPU_Opcode_STSD(void) { CPU_SetShort(CPU_FetchShort(), cpu->s.value); }
 
-static void CPU_Opcode_STARA(void) { Memory_SetShort(CPU_ADDRESS_RA, cpu.a.value); }
-static void CPU_Opcode_STBRA(void) { Memory_SetShort(CPU_ADDRESS_RA, cpu.b.value); }
-static void CPU_Opcode_STSRA(void) { Memory_SetShort(CPU_ADDRESS_RA, cpu.s.value); }
+static void CPU_Opcode_STARA(void) { CPU_SetShort(CPU_ADDRESS_RA, cpu->a.value); }
+static void CPU_Opcode_STBRA(void) { CPU_SetShort(CPU_ADDRESS_RA, cpu->b.value); }
+static void CPU_Opcode_STSRA(void) { CPU_SetShort(CPU_ADDRESS_RA, cpu->s.value); }
 
-static void CPU_Opcode_STARB(void) { Memory_SetShort(CPU_ADDRESS_RB, cpu.a.value); }
-static void CPU_Opcode_STBRB(void) { Memory_SetShort(CPU_ADDRESS_RB, cpu.b.value); }
-static void CPU_Opcode_STSRB(void) { Memory_SetShort(CPU_ADDRESS_RB, cpu.s.value); }
+static void CPU_Opcode_STARB(void) { CPU_SetShort(CPU_ADDRESS_RB, cpu->a.value); }
+static void CPU_Opcode_STBRB(void) { CPU_SetShort(CPU_ADDRESS_RB, cpu->b.value); }
+static void CPU_Opcode_STSRB(void) { CPU_SetShort(CPU_ADDRESS_RB, cpu->s.value); }
 
-static void CPU_Opcode_STAXA(void) { Memory_SetShort(CPU_ADDRESS_XA, cpu.a.value); }
-static void CPU_Opcode_STBXA(void) { Memory_SetShort(CPU_ADDRESS_XA, cpu.b.value); }
-static void CPU_Opcode_STSXA(void) { Memory_SetShort(CPU_ADDRESS_XA, cpu.s.value); }
+static void CPU_Opcode_STAXA(void) { CPU_SetShort(CPU_ADDRESS_XA, cpu->a.value); }
+static void CPU_Opcode_STBXA(void) { CPU_SetShort(CPU_ADDRESS_XA, cpu->b.value); }
+static void CPU_Opcode_STSXA(void) { CPU_SetShort(CPU_ADDRESS_XA, cpu->s.value); }
 
-static void CPU_Opcode_STAXB(void) { Memory_SetShort(CPU_ADDRESS_XB, cpu.a.value); }
-static void CPU_Opcode_STBXB(void) { Memory_SetShort(CPU_ADDRESS_XB, cpu.b.value); }
-static void CPU_Opcode_STSXB(void) { Memory_SetShort(CPU_ADDRESS_XB, cpu.s.value); }
+static void CPU_Opcode_STAXB(void) { CPU_SetShort(CPU_ADDRESS_XB, cpu->a.value); }
+static void CPU_Opcode_STBXB(void) { CPU_SetShort(CPU_ADDRESS_XB, cpu->b.value); }
+static void CPU_Opcode_STSXB(void) { CPU_SetShort(CPU_ADDRESS_XB, cpu->s.value); }
 
-static void CPU_Opcode_STAYA(void) { Memory_SetShort(CPU_ADDRESS_YA, cpu.a.value); }
-static void CPU_Opcode_STBYA(void) { Memory_SetShort(CPU_ADDRESS_YA, cpu.b.value); }
-static void CPU_Opcode_STSYA(void) { Memory_SetShort(CPU_ADDRESS_YA, cpu.s.value); }
+static void CPU_Opcode_STAYA(void) { CPU_SetShort(CPU_ADDRESS_YA, cpu->a.value); }
+static void CPU_Opcode_STBYA(void) { CPU_SetShort(CPU_ADDRESS_YA, cpu->b.value); }
+static void CPU_Opcode_STSYA(void) { CPU_SetShort(CPU_ADDRESS_YA, cpu->s.value); }
 
-static void CPU_Opcode_STAYB(void) { Memory_SetShort(CPU_ADDRESS_YB, cpu.a.value); }
-static void CPU_Opcode_STBYB(void) { Memory_SetShort(CPU_ADDRESS_YB, cpu.b.value); }
-static void CPU_Opcode_STSYB(void) { Memory_SetShort(CPU_ADDRESS_YB, cpu.s.value); }
+static void CPU_Opcode_STAYB(void) { CPU_SetShort(CPU_ADDRESS_YB, cpu->a.value); }
+static void CPU_Opcode_STBYB(void) { CPU_SetShort(CPU_ADDRESS_YB, cpu->b.value); }
+static void CPU_Opcode_STSYB(void) { CPU_SetShort(CPU_ADDRESS_YB, cpu->s.value); }
 
 /*
     Move instructions
 */
 
-static void CPU_Opcode_MVAB(void) { cpu.a.value = cpu.b.value; }
-static void CPU_Opcode_MVAS(void) { cpu.a.value = cpu.s.value; }
-static void CPU_Opcode_MVAI(void) { cpu.a.value = cpu.i.value; }
+static void CPU_Opcode_MVAB(void) { cpu->a.value = cpu->b.value; }
+static void CPU_Opcode_MVAS(void) { cpu->a.value = cpu->s.value; }
+static void CPU_Opcode_MVAI(void) { cpu->a.value = cpu->i.value; }
 
-static void CPU_Opcode_MVBA(void) { cpu.b.value = cpu.a.value; }
-static void CPU_Opcode_MVBS(void) { cpu.b.value = cpu.s.value; }
-static void CPU_Opcode_MVBI(void) { cpu.b.value = cpu.i.value; }
+static void CPU_Opcode_MVBA(void) { cpu->b.value = cpu->a.value; }
+static void CPU_Opcode_MVBS(void) { cpu->b.value = cpu->s.value; }
+static void CPU_Opcode_MVBI(void) { cpu->b.value = cpu->i.value; }
 
-static void CPU_Opcode_MVSA(void) { cpu.s.value = cpu.a.value; }
-static void CPU_Opcode_MVSB(void) { cpu.s.value = cpu.b.value; }
-static void CPU_Opcode_MVSI(void) { cpu.s.value = cpu.i.value; }
+static void CPU_Opcode_MVSA(void) { cpu->s.value = cpu->a.value; }
+static void CPU_Opcode_MVSB(void) { cpu->s.value = cpu->b.value; }
+static void CPU_Opcode_MVSI(void) { cpu->s.value = cpu->i.value; }
 
-static void CPU_Opcode_MVIA(void) { cpu.i.value = cpu.a.value; }
-static void CPU_Opcode_MVIB(void) { cpu.i.value = cpu.b.value; }
-static void CPU_Opcode_MVIS(void) { cpu.i.value = cpu.s.value; }
+static void CPU_Opcode_MVIA(void) { cpu->i.value = cpu->a.value; }
+static void CPU_Opcode_MVIB(void) { cpu->i.value = cpu->b.value; }
+static void CPU_Opcode_MVIS(void) { cpu->i.value = cpu->s.value; }
 
 /*
     Push instructions
 */
 
 static void CPU_Opcode_PUBI(void) { CPU_PushByte(CPU_FetchByte()); }
-static void CPU_Opcode_PUBD(void) { CPU_PushByte(Memory_GetByte(CPU_ADDRESS_D)); }
-static void CPU_Opcode_PUBRA(void) { CPU_PushByte(Memory_GetByte(CPU_ADDRESS_RA)); }
-static void CPU_Opcode_PUBRB(void) { CPU_PushByte(Memory_GetByte(CPU_ADDRESS_RB)); }
-static void CPU_Opcode_PUBXA(void) { CPU_PushByte(Memory_GetByte(CPU_ADDRESS_XA)); }
-static void CPU_Opcode_PUBXB(void) { CPU_PushByte(Memory_GetByte(CPU_ADDRESS_XB)); }
-static void CPU_Opcode_PUBYA(void) { CPU_PushByte(Memory_GetByte(CPU_ADDRESS_YA)); }
-static void CPU_Opcode_PUBYB(void) { CPU_PushByte(Memory_GetByte(CPU_ADDRESS_YB)); }
+static void CPU_Opcode_PUBD(void) { CPU_PushByte(CPU_GetByte(CPU_ADDRESS_D)); }
+static void CPU_Opcode_PUBRA(void) { CPU_PushByte(CPU_GetByte(CPU_ADDRESS_RA)); }
+static void CPU_Opcode_PUBRB(void) { CPU_PushByte(CPU_GetByte(CPU_ADDRESS_RB)); }
+static void CPU_Opcode_PUBXA(void) { CPU_PushByte(CPU_GetByte(CPU_ADDRESS_XA)); }
+static void CPU_Opcode_PUBXB(void) { CPU_PushByte(CPU_GetByte(CPU_ADDRESS_XB)); }
+static void CPU_Opcode_PUBYA(void) { CPU_PushByte(CPU_GetByte(CPU_ADDRESS_YA)); }
+static void CPU_Opcode_PUBYB(void) { CPU_PushByte(CPU_GetByte(CPU_ADDRESS_YB)); }
 
 static void CPU_Opcode_PUSI(void) { CPU_PushShort(CPU_FetchShort()); }
-static void CPU_Opcode_PUSD(void) { CPU_PushShort(Memory_GetShort(CPU_ADDRESS_D)); }
-static void CPU_Opcode_PUSRA(void) { CPU_PushShort(Memory_GetShort(CPU_ADDRESS_RA)); }
-static void CPU_Opcode_PUSRB(void) { CPU_PushShort(Memory_GetShort(CPU_ADDRESS_RB)); }
-static void CPU_Opcode_PUSXA(void) { CPU_PushShort(Memory_GetShort(CPU_ADDRESS_XA)); }
-static void CPU_Opcode_PUSXB(void) { CPU_PushShort(Memory_GetShort(CPU_ADDRESS_XB)); }
-static void CPU_Opcode_PUSYA(void) { CPU_PushShort(Memory_GetShort(CPU_ADDRESS_YA)); }
-static void CPU_Opcode_PUSYB(void) { CPU_PushShort(Memory_GetShort(CPU_ADDRESS_YB)); }
-
-static void CPU_Opcode_PUA(void) { CPU_PushShort(cpu.a.value); }
-static void CPU_Opcode_PUB(void) { CPU_PushShort(cpu.b.value); }
-static void CPU_Opcode_PUS(void) { CPU_PushShort(cpu.s.value); }
-static void CPU_Opcode_PUI(void) { CPU_PushShort(cpu.i.value); }
-static void CPU_Opcode_PUF(void) { CPU_PushByte(cpu.f.value); }
+static void CPU_Opcode_PUSD(void) { CPU_PushShort(CPU_GetShort(CPU_ADDRESS_D)); }
+static void CPU_Opcode_PUSRA(void) { CPU_PushShort(CPU_GetShort(CPU_ADDRESS_RA)); }
+static void CPU_Opcode_PUSRB(void) { CPU_PushShort(CPU_GetShort(CPU_ADDRESS_RB)); }
+static void CPU_Opcode_PUSXA(void) { CPU_PushShort(CPU_GetShort(CPU_ADDRESS_XA)); }
+static void CPU_Opcode_PUSXB(void) { CPU_PushShort(CPU_GetShort(CPU_ADDRESS_XB)); }
+static void CPU_Opcode_PUSYA(void) { CPU_PushShort(CPU_GetShort(CPU_ADDRESS_YA)); }
+static void CPU_Opcode_PUSYB(void) { CPU_PushShort(CPU_GetShort(CPU_ADDRESS_YB)); }
+
+static void CPU_Opcode_PUA(void) { CPU_PushShort(cpu->a.value); }
+static void CPU_Opcode_PUB(void) { CPU_PushShort(cpu->b.value); }
+static void CPU_Opcode_PUS(void) { CPU_PushShort(cpu->s.value); }
+static void CPU_Opcode_PUI(void) { CPU_PushShort(cpu->i.value); }
+static void CPU_Opcode_PUF(void) { CPU_PushByte(CPU_Util_GetFlags()); }
 
 /*
     Pop instructions
 */
 
-static void CPU_Opcode_POBD(void) { Memory_SetByte(CPU_ADDRESS_D, CPU_PopByte()); }
-static void CPU_Opcode_POBRA(void) { Memory_SetByte(CPU_ADDRESS_RA, CPU_PopByte()); }
-static void CPU_Opcode_POBRB(void) { Memory_SetByte(CPU_ADDRESS_RB, CPU_PopByte()); }
-static void CPU_Opcode_POBXA(void) { Memory_SetByte(CPU_ADDRESS_XA, CPU_PopByte()); }
-static void CPU_Opcode_POBXB(void) { Memory_SetByte(CPU_ADDRESS_XB, CPU_PopByte()); }
-static void CPU_Opcode_POBYA(void) { Memory_SetByte(CPU_ADDRESS_YA, CPU_PopByte()); }
-static void CPU_Opcode_POBYB(void) { Memory_SetByte(CPU_ADDRESS_YB, CPU_PopByte()); }
-
-static void CPU_Opcode_POSD(void) { Memory_SetShort(CPU_ADDRESS_D, CPU_PopShort()); }
-static void CPU_Opcode_POSRA(void) { Memory_SetShort(CPU_ADDRESS_RA, CPU_PopShort()); }
-static void CPU_Opcode_POSRB(void) { Memory_SetShort(CPU_ADDRESS_RB, CPU_PopShort()); }
-static void CPU_Opcode_POSXA(void) { Memory_SetShort(CPU_ADDRESS_XA, CPU_PopShort()); }
-static void CPU_Opcode_POSXB(void) { Memory_SetShort(CPU_ADDRESS_XB, CPU_PopShort()); }
-static void CPU_Opcode_POSYA(void) { Memory_SetShort(CPU_ADDRESS_YA, CPU_PopShort()); }
-static void CPU_Opcode_POSYB(void) { Memory_SetShort(CPU_ADDRESS_YB, CPU_PopShort()); }
-
-static void CPU_Opcode_POA(void) { cpu.a.value = CPU_PopShort(); }
-static void CPU_Opcode_POB(void) { cpu.b.value = CPU_PopShort(); }
-static void CPU_Opcode_POS(void) { cpu.s.value = CPU_PopShort(); }
-static void CPU_Opcode_POI(void) { cpu.i.value = CPU_PopShort(); }
-static void CPU_Opcode_POF(void) { cpu.f.value = CPU_PopByte(); }
+static void CPU_Opcode_POBD(void) { CPU_SetByte(CPU_ADDRESS_D, CPU_PopByte()); }
+static void CPU_Opcode_POBRA(void) { CPU_SetByte(CPU_ADDRESS_RA, CPU_PopByte()); }
+static void CPU_Opcode_POBRB(void) { CPU_SetByte(CPU_ADDRESS_RB, CPU_PopByte()); }
+static void CPU_Opcode_POBXA(void) { CPU_SetByte(CPU_ADDRESS_XA, CPU_PopByte()); }
+static void CPU_Opcode_POBXB(void) { CPU_SetByte(CPU_ADDRESS_XB, CPU_PopByte()); }
+static void CPU_Opcode_POBYA(void) { CPU_SetByte(CPU_ADDRESS_YA, CPU_PopByte()); }
+static void CPU_Opcode_POBYB(void) { CPU_SetByte(CPU_ADDRESS_YB, CPU_PopByte()); }
+
+static void CPU_Opcode_POSD(void) { CPU_SetShort(CPU_ADDRESS_D, CPU_PopShort()); }
+static void CPU_Opcode_POSRA(void) { CPU_SetShort(CPU_ADDRESS_RA, CPU_PopShort()); }
+static void CPU_Opcode_POSRB(void) { CPU_SetShort(CPU_ADDRESS_RB, CPU_PopShort()); }
+static void CPU_Opcode_POSXA(void) { CPU_SetShort(CPU_ADDRESS_XA, CPU_PopShort()); }
+static void CPU_Opcode_POSXB(void) { CPU_SetShort(CPU_ADDRESS_XB, CPU_PopShort()); }
+static void CPU_Opcode_POSYA(void) { CPU_SetShort(CPU_ADDRESS_YA, CPU_PopShort()); }
+static void CPU_Opcode_POSYB(void) { CPU_SetShort(CPU_ADDRESS_YB, CPU_PopShort()); }
+
+static void CPU_Opcode_POA(void) { cpu->a.value = CPU_PopShort(); }
+static void CPU_Opcode_POB(void) { cpu->b.value = CPU_PopShort(); }
+static void CPU_Opcode_POS(void) { cpu->s.value = CPU_PopShort(); }
+static void CPU_Opcode_POI(void) { cpu->i.value = CPU_PopShort(); }
+static void CPU_Opcode_POF(void) { CPU_Util_SetFlags(CPU_PopByte()); }
 
 /*
     Stack instructions
 */
 
-static void CPU_Opcode_DTS(void) { CPU_PushByte(Memory_GetByte(cpu.s.value)); }
+static void CPU_Opcode_DTS(void) { CPU_PushByte(CPU_GetByte(cpu->s.value)); }
 
 static void CPU_Opcode_STS(void) {
-    unsigned char top1 = Memory_GetByte(cpu.s.value);
-    unsigned char top2 = Memory_GetByte(cpu.s.value + 1);
+    unsigned char top1 = CPU_GetByte(cpu->s.value);
+    unsigned char top2 = CPU_GetByte(cpu->s.value + 1);
 
-    Memory_SetByte(cpu.s.value, top2);
-    Memory_SetByte(cpu.s.value + 1, top1);
+    CPU_SetByte(cpu->s.value, top2);
+    CPU_SetByte(cpu->s.value + 1, top1);
 }
 
 /*
     Indexing register instructions
 */
 
-static void CPU_Opcode_IRA(void) { cpu.a.value++; }
-static void CPU_Opcode_IRB(void) { cpu.b.value++; }
-static void CPU_Opcode_IRS(void) { cpu.s.value++; }
+static void CPU_Opcode_IRA(void) { cpu->a.value++; }
+static void CPU_Opcode_IRB(void) { cpu->b.value++; }
+static void CPU_Opcode_IRS(void) { cpu->s.value++; }
 
-static void CPU_Opcode_DRA(void) { cpu.a.value--; }
-static void CPU_Opcode_DRB(void) { cpu.b.value--; }
-static void CPU_Opcode_DRS(void) { cpu.s.value--; }
+static void CPU_Opcode_DRA(void) { cpu->a.value--; }
+static void CPU_Opcode_DRB(void) { cpu->b.value--; }
+static void CPU_Opcode_DRS(void) { cpu->s.value--; }
 
 /*
     8 - bit ALU instructions
@@ -481,7 +550,7 @@ static void CPU_Opcode_CPB(void) {
     unsigned char a = CPU_PopByte();
     unsigned char b = CPU_PopByte();
 
-    cpu.f.c = 1;
+    CPU_Flags_SetC(&cpu->flags, 1);
 
     CPU_SUB(a, b);
 }
@@ -495,7 +564,7 @@ static void CPU_Opcode_IVB(void) {
 static void CPU_Opcode_ICB(void) {
     unsigned char a = CPU_PopByte();
 
-    cpu.f.c = 0;
+    CPU_Flags_SetC(&cpu->flags, 0);
 
     CPU_PushByte(CPU_ADB(a, 1));
 }
@@ -503,7 +572,7 @@ static void CPU_Opcode_ICB(void) {
 static void CPU_Opcode_DCB(void) {
     unsigned char a = CPU_PopByte();
 
-    cpu.f.c = 1;
+    CPU_Flags_SetC(&cpu->flags, 1);
 
     CPU_PushByte(CPU_SUB(a, 1));
 }
@@ -523,7 +592,7 @@ static void CPU_Opcode_RRB(void) {
 static void CPU_Opcode_SLB(void) {
     unsigned char a = CPU_PopByte();
 
-    cpu.f.c = 0;
+    CPU_Flags_SetC(&cpu->flags, 0);
 
     CPU_PushByte(CPU_RLB(a));
 }
@@ -531,7 +600,7 @@ static void CPU_Opcode_SLB(void) {
 static void CPU_Opcode_SRB(void) {
     unsigned char a = CPU_PopByte();
 
-    cpu.f.c = 0;
+    CPU_Flags_SetC(&cpu->flags, 0);
 
     CPU_PushByte(CPU_RRB(a));
 }
@@ -539,7 +608,7 @@ static void CPU_Opcode_SRB(void) {
 static void CPU_Opcode_SAB(void) {
     unsigned char a = CPU_PopByte();
 
-    cpu.f.c = 1;
+    CPU_Flags_SetC(&cpu->flags, 1);
 
     CPU_PushByte(CPU_RRB(a));
 }
@@ -587,7 +656,7 @@ static void CPU_Opcode_CPS(void) {
     unsigned short a = CPU_PopShort();
     unsigned short b = CPU_PopShort();
 
-    cpu.f.c = 1;
+    CPU_Flags_SetC(&cpu->flags, 1);
 
     CPU_SUS(a, b);
 }
@@ -601,7 +670,7 @@ static void CPU_Opcode_IVS(void) {
 static void CPU_Opcode_ICS(void) {
     unsigned short a = CPU_PopShort();
 
-    cpu.f.c = 0;
+    CPU_Flags_SetC(&cpu->flags, 0);
 
     CPU_PushShort(CPU_ADS(a, 1));
 }
@@ -609,7 +678,7 @@ static void CPU_Opcode_ICS(void) {
 static void CPU_Opcode_DCS(void) {
     unsigned short a = CPU_PopShort();
 
-    cpu.f.c = 1;
+    CPU_Flags_SetC(&cpu->flags, 1);
 
     CPU_PushShort(CPU_SUS(a, 1));
 }
@@ -629,7 +698,7 @@ static void CPU_Opcode_RRS(void) {
 static void CPU_Opcode_SLS(void) {
     unsigned short a = CPU_PopShort();
 
-    cpu.f.c = 0;
+    CPU_Flags_SetC(&cpu->flags, 0);
 
     CPU_PushShort(CPU_RLS(a));
 }
@@ -637,7 +706,7 @@ static void CPU_Opcode_SLS(void) {
 static void CPU_Opcode_SRS(void) {
     unsigned short a = CPU_PopShort();
 
-    cpu.f.c = 0;
+    CPU_Flags_SetC(&cpu->flags, 0);
 
     CPU_PushShort(CPU_RRS(a));
 }
@@ -645,7 +714,7 @@ static void CPU_Opcode_SRS(void) {
 static void CPU_Opcode_SAS(void) {
     unsigned short a = CPU_PopShort();
 
-    cpu.f.c = 1;
+    CPU_Flags_SetC(&cpu->flags, 1);
 
     CPU_PushShort(CPU_RRS(a));
 }
@@ -654,20 +723,20 @@ static void CPU_Opcode_SAS(void) {
     Status flag instructions
 */
 
-static void CPU_Opcode_SFZ(void) { cpu.f.z = 1; }
-static void CPU_Opcode_SFC(void) { cpu.f.c = 1; }
-static void CPU_Opcode_SFS(void) { cpu.f.s = 1; }
-static void CPU_Opcode_SFV(void) { cpu.f.v = 1; }
+static void CPU_Opcode_SFZ(void) { CPU_Flags_SetZ(&cpu->flags, 1); }
+static void CPU_Opcode_SFC(void) { CPU_Flags_SetC(&cpu->flags, 1); }
+static void CPU_Opcode_SFS(void) { CPU_Flags_SetS(&cpu->flags, 1); }
+static void CPU_Opcode_SFV(void) { CPU_Flags_SetV(&cpu->flags, 1); }
 
-static void CPU_Opcode_CFZ(void) { cpu.f.z = 0; }
-static void CPU_Opcode_CFC(void) { cpu.f.c = 0; }
-static void CPU_Opcode_CFS(void) { cpu.f.s = 0; }
-static void CPU_Opcode_CFV(void) { cpu.f.v = 0; }
+static void CPU_Opcode_CFZ(void) { CPU_Flags_SetZ(&cpu->flags, 0); }
+static void CPU_Opcode_CFC(void) { CPU_Flags_SetC(&cpu->flags, 0); }
+static void CPU_Opcode_CFS(void) { CPU_Flags_SetS(&cpu->flags, 0); }
+static void CPU_Opcode_CFV(void) { CPU_Flags_SetV(&cpu->flags, 0); }
 
-static void CPU_Opcode_EI(void) { cpu.f.i = 1; }
-static void CPU_Opcode_DI(void) { cpu.f.i = 0; }
+static void CPU_Opcode_EI(void) { cpu->f.i = 1; }
+static void CPU_Opcode_DI(void) { cpu->f.i = 0; }
 
-static void CPU_Opcode_HT(void) { cpu.f.h = 1; }
+static void CPU_Opcode_HT(void) { cpu->f.h = 1; }
 
 /*
     Branching instructions
@@ -675,15 +744,15 @@ static void CPU_Opcode_HT(void) { cpu.f.h = 1; }
 
 // Helper function for calling an address
 static void CPU_Util_CA(unsigned short address) {
-    CPU_PushShort(cpu.i.value);
-    cpu.i.value = address;
+    CPU_PushShort(cpu->i.value);
+    cpu->i.value = address;
 }
 
 // Helper function to do a conditional jump
 static void CPU_Util_CondJM(unsigned char condition) {
     unsigned short address = CPU_FetchShort();
 
-    if (condition) cpu.i.value = address;
+    if (condition) cpu->i.value = address;
 }
 
 // Helper function to do a conditional call
@@ -691,20 +760,20 @@ static void CPU_Util_CondCA(unsigned char condition) {
     unsigned short address = CPU_FetchShort();
 
     if (condition) {
-        CPU_PushShort(cpu.i.value);
+        CPU_PushShort(cpu->i.value);
 
-        cpu.i.value = address;
+        cpu->i.value = address;
     }
 }
 
-static void CPU_Opcode_JM(void) { cpu.i.value = CPU_FetchShort(); }
+static void CPU_Opcode_JM(void) { cpu->i.value = CPU_FetchShort(); }
 
 static void CPU_Opcode_CA(void) {
     unsigned short address = CPU_FetchShort();
     CPU_Util_CA(address);
 }
 
-static void CPU_Opcode_RT(void) { cpu.i.value = CPU_PopShort(); }
+static void CPU_Opcode_RT(void) { cpu->i.value = CPU_PopShort(); }
 
 static void CPU_Opcode_SIA(void) { CPU_Util_CA(0x0000); }
 static void CPU_Opcode_SIB(void) { CPU_Util_CA(0x0008); }
@@ -719,35 +788,35 @@ static void CPU_Opcode_SIH(void) { CPU_Util_CA(0x0038); }
     Conditional branching instructions
 */
 
-static void CPU_Opcode_JMZ(void) { CPU_Util_CondJM(cpu.f.z); }
-static void CPU_Opcode_JMC(void) { CPU_Util_CondJM(cpu.f.c); }
-static void CPU_Opcode_JMS(void) { CPU_Util_CondJM(cpu.f.s); }
-static void CPU_Opcode_JMV(void) { CPU_Util_CondJM(cpu.f.v); }
+static void CPU_Opcode_JMZ(void) { CPU_Util_CondJM(CPU_Flags_Z(&cpu->flags)); }
+static void CPU_Opcode_JMC(void) { CPU_Util_CondJM(CPU_Flags_C(&cpu->flags)); }
+static void CPU_Opcode_JMS(void) { CPU_Util_CondJM(CPU_Flags_S(&cpu->flags)); }
+static void CPU_Opcode_JMV(void) { CPU_Util_CondJM(CPU_Flags_V(&cpu->flags)); }
 
-static void CPU_Opcode_JMNZ(void) { CPU_Util_CondJM(!cpu.f.z); }
-static void CPU_Opcode_JMNC(void) { CPU_Util_CondJM(!cpu.f.c); }
-static void CPU_Opcode_JMNS(void) { CPU_Util_CondJM(!cpu.f.s); }
-static void CPU_Opcode_JMNV(void) { CPU_Util_CondJM(!cpu.f.v); }
+static void CPU_Opcode_JMNZ(void) { CPU_Util_CondJM(!CPU_Flags_Z(&cpu->flags)); }
+static void CPU_Opcode_JMNC(void) { CPU_Util_CondJM(!CPU_Flags_C(&cpu->flags)); }
+static void CPU_Opcode_JMNS(void) { CPU_Util_CondJM(!CPU_Flags_S(&cpu->flags)); }
+static void CPU_Opcode_JMNV(void) { CPU_Util_CondJM(!CPU_Flags_V(&cpu->flags)); }
 
-static void CPU_Opcode_CAZ(void) { CPU_Util_CondCA(cpu.f.z); }
-static void CPU_Opcode_CAC(void) { CPU_Util_CondCA(cpu.f.c); }
-static void CPU_Opcode_CAS(void) { CPU_Util_CondCA(cpu.f.s); }
-static void CPU_Opcode_CAV(void) { CPU_Util_CondCA(cpu.f.v); }
+static void CPU_Opcode_CAZ(void) { CPU_Util_CondCA(CPU_Flags_Z(&cpu->flags)); }
+static void CPU_Opcode_CAC(void) { CPU_Util_CondCA(CPU_Flags_C(&cpu->flags)); }
+static void CPU_Opcode_CAS(void) { CPU_Util_CondCA(CPU_Flags_S(&cpu->flags)); }
+static void CPU_Opcode_CAV(void) { CPU_Util_CondCA(CPU_Flags_V(&cpu->flags)); }
 
-static void CPU_Opcode_CANZ(void) { CPU_Util_CondCA(!cpu.f.z); }
-static void CPU_Opcode_CANC(void) { CPU_Util_CondCA(!cpu.f.c); }
-static void CPU_Opcode_CANS(void) { CPU_Util_CondCA(!cpu.f.s); }
-static void CPU_Opcode_CANV(void) { CPU_Util_CondCA(!cpu.f.v); }
+static void CPU_Opcode_CANZ(void) { CPU_Util_CondCA(!CPU_Flags_Z(&cpu->flags)); }
+static void CPU_Opcode_CANC(void) { CPU_Util_CondCA(!CPU_Flags_C(&cpu->flags)); }
+static void CPU_Opcode_CANS(void) { CPU_Util_CondCA(!CPU_Flags_S(&cpu->flags)); }
+static void CPU_Opcode_CANV(void) { CPU_Util_CondCA(!CPU_Flags_V(&cpu->flags)); }
 
-static void CPU_Opcode_RTZ(void) { if (cpu.f.z) cpu.i.value = CPU_PopShort(); }
-static void CPU_Opcode_RTC(void) { if (cpu.f.c) cpu.i.value = CPU_PopShort(); }
-static void CPU_Opcode_RTS(void) { if (cpu.f.s) cpu.i.value = CPU_PopShort(); }
-static void CPU_Opcode_RTV(void) { if (cpu.f.v) cpu.i.value = CPU_PopShort(); }
+static void CPU_Opcode_RTZ(void) { if (CPU_Flags_Z(&cpu->flags)) cpu->i.value = CPU_PopShort(); }
+static void CPU_Opcode_RTC(void) { if (CPU_Flags_C(&cpu->flags)) cpu->i.value = CPU_PopShort(); }
+static void CPU_Opcode_RTS(void) { if (CPU_Flags_S(&cpu->flags)) cpu->i.value = CPU_PopShort(); }
+static void CPU_Opcode_RTV(void) { if (CPU_Flags_V(&cpu->flags)) cpu->i.value = CPU_PopShort(); }
 
-static void CPU_Opcode_RTNZ(void) { if (!cpu.f.z) cpu.i.value = CPU_PopShort(); }
-static void CPU_Opcode_RTNC(void) { if (!cpu.f.c) cpu.i.value = CPU_PopShort(); }
-static void CPU_Opcode_RTNS(void) { if (!cpu.f.s) cpu.i.value = CPU_PopShort(); }
-static void CPU_Opcode_RTNV(void) { if (!cpu.f.v) cpu.i.value = CPU_PopShort(); }
+static void CPU_Opcode_RTNZ(void) { if (!CPU_Flags_Z(&cpu->flags)) cpu->i.value = CPU_PopShort(); }
+static void CPU_Opcode_RTNC(void) { if (!CPU_Flags_C(&cpu->flags)) cpu->i.value = CPU_PopShort(); }
+static void CPU_Opcode_RTNS(void) { if (!CPU_Flags_S(&cpu->flags)) cpu->i.value = CPU_PopShort(); }
+static void CPU_Opcode_RTNV(void) { if (!CPU_Flags_V(&cpu->flags)) cpu->i.value = CPU_PopShort(); }
 
 /*
     I/O port instructions
@@ -776,6 +845,79 @@ static void CPU_Opcode_OPS(void) {
 
 static void CPU_Opcode_NO(void) { return; }
 
+// Opcode mnemonic array, in opcode order, NULL for undefined opcodes
+static const char *CPU_OPCODE_NAME[256] = {
+    "LDAI", "LDBI", "LDSI", "LDAD", "LDBD", "LDSD", "LDARA", "LDBRA",
+    "LDSRA", "LDARB", "LDBRB", "LDSRB", "LDAXA", "LDBXA", "LDSXA", "LDAXB",
+    "LDBXB", "LDSXB", "LDAYA", "LDBYA", "LDSYA", "LDAYB", "LDBYB", "LDSYB",
+    "STAD", "STBD", "STSD", "STARA", "STBRA", "STSRA", "STARB", "STBRB",
+    "STSRB", "STAXA", "STBXA", "STSXA", "STAXB", "STBXB", "STSXB", "STAYA",
+    "STBYA", "STSYA", "STAYB", "STBYB", "STSYB", "MVAB", "MVAS", "MVAI",
+    "MVBA", "MVBS", "MVBI", "MVSA", "MVSB", "MVSI", "MVIA", "MVIB",
+    "MVIS", "PUBI", "PUBD", "PUBRA", "PUBRB", "PUBXA", "PUBXB", "PUBYA",
+    "PUBYB", "PUSI", "PUSD", "PUSRA", "PUSRB", "PUSXA", "PUSXB", "PUSYA",
+    "PUSYB", "PUA", "PUB", "PUS", "PUI", "PUF", "POBD", "POBRA",
+    "POBRB", "POBXA", "POBXB", "POBYA", "POBYB", "POSD", "POSRA", "POSRB",
+    "POSXA", "POSXB", "POSYA", "POSYB", "POA", "POB", "POS", "POI",
+    "POF", "DTS", "STS", "IRA", "IRB", "IRS", "DRA", "DRB",
+    "DRS", "ADB", "SUB", "ANB", "ORB", "XRB", "CPB", "IVB",
+    "ICB", "DCB", "RLB", "RRB", "SLB", "SRB", "SAB", "ADS",
+    "SUS", "ANS", "ORS", "XRS", "CPS", "IVS", "ICS", "DCS",
+    "RLS", "RRS", "SLS", "SRS", "SAS", "SFZ", "SFC", "SFS",
+    "SFV", "CFZ", "CFC", "CFS", "CFV", "EI", "DI", "HT",
+    "JM", "CA", "RT", "SIA", "SIB", "SIC", "SID", "SIE",
+    "SIF", "SIG", "SIH", "JMZ", "JMC", "JMS", "JMV", "JMNZ",
+    "JMNC", "JMNS", "JMNV", "CAZ", "CAC", "CAS", "CAV", "CANZ",
+    "CANC", "CANS", "CANV", "RTZ", "RTC", "RTS", "RTV", "RTNZ",
+    "RTNC", "RTNS", "RTNV", "IPB", "OPB", "IPS", "OPS", "NO",
+};
+
+/*
+    Virtual clock
+
+    Every instruction costs one cycle per byte fetched and per byte of
+    memory or stack accessed, one more for an ALU operation or an indexed
+    address, and two more for the pointer read of indirect addressing.
+    Port accesses cost one cycle per byte. Branches cost the same whether
+    they are taken or not, so the clock only depends on the instructions.
+*/
+
+// Instruction cycle cost array, in opcode order
+static const unsigned char CPU_OPCODE_CYCLES[256] = {
+    3, 3, 3, 5, 5, 5, 3, 3, // 0x00
+    3, 3, 3, 3, 6, 6, 6, 6, // 0x08
+    6, 6, 8, 8, 8, 8, 8, 8, // 0x10
+    5, 5, 5, 3, 3, 3, 3, 3, // 0x18
+    3, 6, 6, 6, 6, 6, 6, 8, // 0x20
+    8, 8, 8, 8, 8, 1, 1, 1, // 0x28
+    1, 1, 1, 1, 1, 1, 1, 1, // 0x30
+    1, 3, 5, 3, 3, 6, 6, 8, // 0x38
+    8, 5, 7, 5, 5, 8, 8, 10, // 0x40
+    10, 3, 3, 3, 3, 2, 5, 3, // 0x48
+    3, 6, 6, 8, 8, 7, 5, 5, // 0x50
+    8, 8, 10, 10, 3, 3, 3, 3, // 0x58
+    2, 3, 5, 2, 2, 2, 2, 2, // 0x60
+    2, 5, 5, 5, 5, 5, 4, 4, // 0x68
+    4, 4, 4, 4, 4, 4, 4, 8, // 0x70
+    8, 8, 8, 8, 6, 6, 6, 6, // 0x78
+    6, 6, 6, 6, 6, 1, 1, 1, // 0x80
+    1, 1, 1, 1, 1, 1, 1, 1, // 0x88
+    3, 5, 3, 3, 3, 3, 3, 3, // 0x90
+    3, 3, 3, 3, 3, 3, 3, 3, // 0x98
+    3, 3, 3, 5, 5, 5, 5, 5, // 0xA0
+    5, 5, 5, 3, 3, 3, 3, 3, // 0xA8
+    3, 3, 3, 4, 4, 6, 6, 1, // 0xB0
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xB8
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xC0
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xC8
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xD0
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xD8
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xE0
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xE8
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xF0
+    1, 1, 1, 1, 1, 1, 1, 1 // 0xF8
+};
+
 /*
     CPU opcode function pointer array
 */
@@ -1039,17 +1181,1836 @@ static void (*CPU_Opcode[256])(void) = {
     CPU_Opcode_NO
 };
 
+#if CPU_DISPATCH != CPU_DISPATCH_TABLE
+
+/*
+    Fast interpreter core
+
+    Runs a batch of instructions with the registers and the status flags held
+    in host locals, reading and writing the memory array directly. Selected
+    at build time through CPU_DISPATCH, and equivalent to the opcode table.
+
+    Instructions are executed from a decoded instruction cache keyed by the
+    instruction address, so operands are only fetched once. Decoded bytes are
+    marked in the memory code map, and a write to any of them invalidates the
+    decoded instructions of the whole page.
+
+    Common instruction sequences are fused at decode time into a single
+    decoded instruction, executed by one handler with the same flag and stack
+    memory side effects as its parts.
+*/
+
+// Maximum decoded instruction length in bytes, including fused sequences
+#define CPU_DECODE_MAX_LENGTH 6
+
+// Fused instruction enum, numbered after the opcodes
+typedef enum cpu_fused_e {
+    CPU_FUSED_FIRST = 0x100,
+
+    // PUSI imm; ADS
+    CPU_FUSED_PUSI_ADS = CPU_FUSED_FIRST,
+
+    // PUBI imm; CPB; JMZ addr and JMNZ addr
+    CPU_FUSED_PUBI_CPB_JMZ,
+    CPU_FUSED_PUBI_CPB_JMNZ,
+
+    // PUA; PUB; ADS; POA
+    CPU_FUSED_PUA_PUB_ADS_POA,
+
+    // IPB port; ANB; JMZ addr and JMNZ addr
+    CPU_FUSED_IPB_ANB_JMZ,
+    CPU_FUSED_IPB_ANB_JMNZ,
+
+    CPU_FUSED_END
+} CPUFused;
+
+#define CPU_FUSED_COUNT (CPU_FUSED_END - CPU_FUSED_FIRST)
+
+// Fused instruction name array, in fused instruction order
+static const char *CPU_FUSED_NAME[CPU_FUSED_COUNT] = {
+    "PUSI; ADS",
+    "PUBI; CPB; JMZ",
+    "PUBI; CPB; JMNZ",
+    "PUA; PUB; ADS; POA",
+    "IPB; ANB; JMZ",
+    "IPB; ANB; JMNZ"
+};
+
+// Decoded instruction struct
+typedef struct cpu_decoded_s {
+#if CPU_DISPATCH == CPU_DISPATCH_THREADED
+    // Handler label address, NULL if the entry is not decoded, so dispatch tests what it loads anyway
+    const void *handler;
+#endif
+
+    // Immediate, address, displacement or port operand
+    unsigned short operand;
+
+    // Branch address of fused instructions ending in a jump
+    unsigned short target;
+
+    // Opcode or fused instruction
+    unsigned short opcode;
+
+    // Instruction length, 0 if the entry is not decoded
+    unsigned char length;
+
+    // Cycle cost of the instruction, or of the first part of a fused instruction
+    unsigned char cycles;
+} CPUDecoded;
+
+// Function to invalidate the decoded instructions overlapping a page
+static void CPU_InvalidatePage(unsigned char page) {
+    unsigned short start = page << MEMORY_PAGE_SIZE_SHIFT;
+
+    Memory_ClearCodePage(page);
+
+    memset(&cpu->decoded[start], 0, MEMORY_PAGE_SIZE * sizeof(CPUDecoded));
+
+    // Instructions near the end of the previous page can extend into this one
+    start -= CPU_DECODE_MAX_LENGTH - 1;
+
+    memset(&cpu->decoded[start], 0, (CPU_DECODE_MAX_LENGTH - 1) * sizeof(CPUDecoded));
+}
+
+// Function called on writes to decoded code
+static void CPU_CodeWrite(unsigned short address) {
+    CPU_InvalidatePage(address >> MEMORY_PAGE_SIZE_SHIFT);
+}
+
+// Profile builds step every instruction through the opcode table, so the fast core is left out of them
+#if CPU_DISPATCH != CPU_DISPATCH_TABLE && !CPU_PROFILE
+
+// Instruction length array, in opcode order
+static const unsigned char CPU_OPCODE_LENGTH[256] = {
+    3, 3, 3, 3, 3, 3, 1, 1, // 0x00
+    1, 1, 1, 1, 3, 3, 3, 3, // 0x08
+    3, 3, 3, 3, 3, 3, 3, 3, // 0x10
+    3, 3, 3, 1, 1, 1, 1, 1, // 0x18
+    1, 3, 3, 3, 3, 3, 3, 3, // 0x20
+    3, 3, 3, 3, 3, 1, 1, 1, // 0x28
+    1, 1, 1, 1, 1, 1, 1, 1, // 0x30
+    1, 2, 3, 1, 1, 3, 3, 3, // 0x38
+    3, 3, 3, 1, 1, 3, 3, 3, // 0x40
+    3, 1, 1, 1, 1, 1, 3, 1, // 0x48
+    1, 3, 3, 3, 3, 3, 1, 1, // 0x50
+    3, 3, 3, 3, 1, 1, 1, 1, // 0x58
+    1, 1, 1, 1, 1, 1, 1, 1, // 0x60
+    1, 1, 1, 1, 1, 1, 1, 1, // 0x68
+    1, 1, 1, 1, 1, 1, 1, 1, // 0x70
+    1, 1, 1, 1, 1, 1, 1, 1, // 0x78
+    1, 1, 1, 1, 1, 1, 1, 1, // 0x80
+    1, 1, 1, 1, 1, 1, 1, 1, // 0x88
+    3, 3, 1, 1, 1, 1, 1, 1, // 0x90
+    1, 1, 1, 3, 3, 3, 3, 3, // 0x98
+    3, 3, 3, 3, 3, 3, 3, 3, // 0xA0
+    3, 3, 3, 1, 1, 1, 1, 1, // 0xA8
+    1, 1, 1, 2, 2, 2, 2, 1, // 0xB0
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xB8
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xC0
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xC8
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xD0
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xD8
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xE0
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xE8
+    1, 1, 1, 1, 1, 1, 1, 1, // 0xF0
+    1, 1, 1, 1, 1, 1, 1, 1 // 0xF8
+};
+
+// Function to decode the instruction at an address
+static void CPU_Decode(const MemoryPageTable *pages, unsigned short address) {
+    CPUDecoded *decoded = &cpu->decoded[address];
+
+    unsigned char opcode = Memory_FetchByte(pages, address);
+    unsigned char length = CPU_OPCODE_LENGTH[opcode];
+
+    unsigned char lo = Memory_FetchByte(pages, address + 1);
+    unsigned char hi = Memory_FetchByte(pages, address + 2);
+
+    decoded->opcode = opcode;
+    decoded->length = length;
+    decoded->operand = length == 3 ? TO_SHORT(lo, hi) : lo;
+    decoded->target = 0;
+    decoded->cycles = CPU_OPCODE_CYCLES[opcode];
+
+#define CPU_DECODE_BYTE(offset) Memory_FetchByte(pages, address + (offset))
+
+    // Fuse common instruction sequences starting at this address
+    switch (opcode) {
+        case CPU_OPCODE_PUSI:
+            if (CPU_DECODE_BYTE(3) == CPU_OPCODE_ADS) {
+                decoded->opcode = CPU_FUSED_PUSI_ADS;
+                length = 4;
+            }
+
+            break;
+
+        case CPU_OPCODE_PUBI:
+            if (CPU_DECODE_BYTE(2) != CPU_OPCODE_CPB) break;
+
+            if (CPU_DECODE_BYTE(3) == CPU_OPCODE_JMZ)
+                decoded->opcode = CPU_FUSED_PUBI_CPB_JMZ;
+            else if (CPU_DECODE_BYTE(3) == CPU_OPCODE_JMNZ)
+                decoded->opcode = CPU_FUSED_PUBI_CPB_JMNZ;
+            else
+                break;
+
+            decoded->target = TO_SHORT(CPU_DECODE_BYTE(4), CPU_DECODE_BYTE(5));
+            length = 6;
+
+            break;
+
+        case CPU_OPCODE_PUA:
+            if (CPU_DECODE_BYTE(1) == CPU_OPCODE_PUB &&
+                CPU_DECODE_BYTE(2) == CPU_OPCODE_ADS &&
+                CPU_DECODE_BYTE(3) == CPU_OPCODE_POA) {
+                decoded->opcode = CPU_FUSED_PUA_PUB_ADS_POA;
+                length = 4;
+            }
+
+            break;
+
+        case CPU_OPCODE_IPB:
+            if (CPU_DECODE_BYTE(2) != CPU_OPCODE_ANB) break;
+
+            if (CPU_DECODE_BYTE(3) == CPU_OPCODE_JMZ)
+                decoded->opcode = CPU_FUSED_IPB_ANB_JMZ;
+            else if (CPU_DECODE_BYTE(3) == CPU_OPCODE_JMNZ)
+                decoded->opcode = CPU_FUSED_IPB_ANB_JMNZ;
+            else
+                break;
+
+            decoded->target = TO_SHORT(CPU_DECODE_BYTE(4), CPU_DECODE_BYTE(5));
+            length = 6;
+
+            break;
+    }
+
+#undef CPU_DECODE_BYTE
+
+    // Fused instructions cover every byte of their parts
+    decoded->length = length;
+
+    Memory_SetCode(address, length);
+}
+
+// Stack page number standing for no page cached, never equal to a page number
+#define CORE_STACK_NONE MEMORY_PAGE_COUNT
+
+/*
+    Slow paths of the fast core, kept out of line so the dispatch loop keeps
+    its locals in registers
+*/
+
+// Function to read a byte off the page table
+static NOINLINE unsigned char CPU_Core_ReadByteSlow(const MemoryPageTable *pages, unsigned short address) {
+    return Memory_ReadByte(pages, address);
+}
+
+// Function to read a short off the page table, the low byte first
+static NOINLINE unsigned short CPU_Core_ReadShortSlow(const MemoryPageTable *pages, unsigned short address) {
+    unsigned char lo = Memory_ReadByte(pages, address);
+
+    return lo | (Memory_ReadByte(pages, address + 1) << 8);
+}
+
+// Function to write a byte off the page table, returning 1 if it overwrote decoded code
+static NOINLINE int CPU_Core_StoreByteSlow(const MemoryPageTable *pages, unsigned short address, unsigned char value) {
+    return Memory_StoreByte(pages, address, value);
+}
+
+// Function to get the host memory of a page of the stack, or NULL unless it is RAM both ways
+static NOINLINE unsigned char *CPU_Core_LoadStack(const MemoryPageTable *pages, unsigned page) {
+    unsigned char *data = pages->write[page];
+
+    return data == pages->read[page] ? data : NULL;
+}
+
+// Helper function to read a short from host memory
+static inline unsigned short CPU_Core_LoadShort(const unsigned char *data) {
+    return data[0] | (data[1] << 8);
+}
+
+// Helper function to read a byte, dropping the cached stack page on device reads, which may remap pages
+static inline unsigned char CPU_Core_GetByte(const MemoryPageTable *pages, unsigned short address, unsigned *stackPage) {
+    const unsigned char *page = pages->read[address >> MEMORY_PAGE_SIZE_SHIFT];
+
+    if (page) return page[address & MEMORY_PAGE_SIZE_MASK];
+
+    *stackPage = CORE_STACK_NONE;
+
+    return CPU_Core_ReadByteSlow(pages, address);
+}
+
+// Helper function to read a short, dropping the cached stack page unless it is within a RAM page
+static inline unsigned short CPU_Core_GetShort(const MemoryPageTable *pages, unsigned short address, unsigned *stackPage) {
+    const unsigned char *page = pages->read[address >> MEMORY_PAGE_SIZE_SHIFT];
+    unsigned offset = address & MEMORY_PAGE_SIZE_MASK;
+
+    if (page && offset != MEMORY_PAGE_SIZE_MASK) return CPU_Core_LoadShort(page + offset);
+
+    *stackPage = CORE_STACK_NONE;
+
+    return CPU_Core_ReadShortSlow(pages, address);
+}
+
+/*
+    Fast core 8 - bit ALU helper functions
+*/
+
+static inline unsigned char CPU_Core_ADB(CPUFlags *f, unsigned char a, unsigned char b) {
+    unsigned short result = a + b + CPU_Flags_C(f);
+
+    CPU_Flags_Result(f, CPU_FLAGS_BYTE(result));
+
+    return result;
+}
+
+static inline unsigned char CPU_Core_SUB(CPUFlags *f, unsigned char a, unsigned char b) {
+    return CPU_Core_ADB(f, a, ~b);
+}
+
+static inline unsigned char CPU_Core_Logic8(CPUFlags *f, unsigned char resultByte) {
+    CPU_Flags_Result(f, CPU_FLAGS_BYTE(resultByte));
+
+    return resultByte;
+}
+
+static inline unsigned char CPU_Core_RLB(CPUFlags *f, unsigned char a) {
+    unsigned short result = (a << 1) | CPU_Flags_C(f);
+
+    CPU_Flags_Result(f, CPU_FLAGS_BYTE(result));
+
+    return result;
+}
+
+static inline unsigned char CPU_Core_RRB(CPUFlags *f, unsigned char a) {
+    unsigned char resultByte = (a >> 1) | (CPU_Flags_C(f) << 7);
+
+    CPU_Flags_Result(f, CPU_FLAGS_BYTE(resultByte) | ((a & 1) << CPU_FLAGS_BIT_C));
+
+    return resultByte;
+}
+
+/*
+    Fast core 16 - bit ALU helper functions
+*/
+
+static inline unsigned short CPU_Core_ADS(CPUFlags *f, unsigned short a, unsigned short b) {
+    unsigned result = a + b + CPU_Flags_C(f);
+
+    CPU_Flags_Result(f, result);
+
+    return result;
+}
+
+static inline unsigned short CPU_Core_SUS(CPUFlags *f, unsigned short a, unsigned short b) {
+    return CPU_Core_ADS(f, a, ~b);
+}
+
+static inline unsigned short CPU_Core_Logic16(CPUFlags *f, unsigned short resultShort) {
+    CPU_Flags_Result(f, resultShort);
+
+    return resultShort;
+}
+
+static inline unsigned short CPU_Core_RLS(CPUFlags *f, unsigned short a) {
+    unsigned result = (a << 1) | CPU_Flags_C(f);
+
+    CPU_Flags_Result(f, result);
+
+    return result;
+}
+
+static inline unsigned short CPU_Core_RRS(CPUFlags *f, unsigned short a) {
+    // Matches CPU_RRS, which rotates the carry into bit 7
+    unsigned short resultShort = (a >> 1) | (CPU_Flags_C(f) << 7);
+
+    CPU_Flags_Result(f, resultShort | ((a & 1) << CPU_FLAGS_BIT_C));
+
+    return resultShort;
+}
+
+/*
+    Fast core memory access macros
+*/
+
+// Operands come from the decoded instruction, advancing past them by a constant
+#define CORE_FETCH_BYTE() (i += 1, (unsigned char) operand)
+#define CORE_FETCH_SHORT() (i += 2, operand)
+
+#define CORE_GET_BYTE(address) CPU_Core_GetByte(pages, (address), &stackPage)
+#define CORE_GET_SHORT(address) CPU_Core_GetShort(pages, (address), &stackPage)
+
+// Pauses end the batch after the current instruction, resuming it at CPU_Core_Done unless an interrupt is ready
+#define CORE_PAUSE() do {                               \
+        if (!paused) {                                  \
+            paused = 1;                                 \
+            pausedRemaining = remaining;                \
+            remaining = 0;                              \
+        }                                               \
+    } while (0)
+
+// Writes to decoded code pause the batch, so the next dispatch sees the write
+#define CORE_CODE_WRITE(address) do {                   \
+        if (!codeWrite) {                               \
+            codeWrite = 1;                              \
+            codeWriteAddress = (address);               \
+            CORE_PAUSE();                               \
+        }                                               \
+    } while (0)
+
+// Writes leaving the page table may reach a device, which may remap pages, so they drop the cached stack page, or
+// raise an interrupt, so they pause the batch for it to be taken after the instruction
+#define CORE_SET_BYTE(address, value) do {                                              \
+        unsigned short setAddress = (address);                                          \
+        unsigned char setByte = (value);                                                \
+        unsigned char *setPage = pages->write[SHORT_HI(setAddress)];                    \
+                                                                                        \
+        if (setPage) {                                                                  \
+            setPage[SHORT_LO(setAddress)] = setByte;                                    \
+        } else {                                                                        \
+            stackPage = CORE_STACK_NONE;                                                \
+                                                                                        \
+            if (CPU_Core_StoreByteSlow(pages, setAddress, setByte))                     \
+                CORE_CODE_WRITE(setAddress);                                            \
+                                                                                        \
+            if (CPU_BATCH_DONE()) CORE_PAUSE();                                         \
+        }                                                                               \
+    } while (0)
+
+#define CORE_SET_SHORT(address, value) do {                                             \
+        unsigned short setShortAddress = (address);                                     \
+        unsigned short setValue = (value);                                              \
+        unsigned char *setShortPage = pages->write[SHORT_HI(setShortAddress)];          \
+        unsigned setOffset = SHORT_LO(setShortAddress);                                 \
+                                                                                        \
+        if (setShortPage && setOffset != MEMORY_PAGE_SIZE_MASK) {                       \
+            CORE_STORE_SHORT(setShortPage + setOffset, setValue);                       \
+        } else {                                                                        \
+            CORE_SET_BYTE(setShortAddress, SHORT_LO(setValue));                         \
+            CORE_SET_BYTE(setShortAddress + 1, SHORT_HI(setValue));                     \
+        }                                                                               \
+    } while (0)
+
+// Two byte stores through one pointer, which the host compiler merges into a 16 - bit store
+#define CORE_STORE_SHORT(data, value) do {          \
+        unsigned char *storeData = (data);          \
+                                                    \
+        storeData[0] = SHORT_LO(value);             \
+        storeData[1] = SHORT_HI(value);             \
+    } while (0)
+
+/*
+    The page s points into is cached in stack and stackPage while it is RAM
+    both ways, so pushes and pops skip the page table. A miss looks the page
+    up again, leaving CORE_STACK_NONE when it has to go through the page
+    table. Entries only go from RAM to something else when code is decoded,
+    a port or device is accessed, or decoded code is invalidated, so every
+    one of those drops the cached page.
+*/
+
+// Helper macro to cache the page of the stack if it is RAM both ways, evaluating to 1 if so
+#define CORE_STACK_LOAD(page) (                                                                         \
+        stackPage = (stack = CPU_Core_LoadStack(pages, (page))) ? (unsigned) (page) : CORE_STACK_NONE,  \
+        stackPage != CORE_STACK_NONE)
+
+// Helper macros to check if a byte or a short at address is on the cached stack page, caching its page on a miss
+#define CORE_STACK_BYTE(address) (SHORT_HI(address) == stackPage || CORE_STACK_LOAD(SHORT_HI(address)))
+#define CORE_STACK_SHORT(address) (SHORT_LO(address) != MEMORY_PAGE_SIZE_MASK && CORE_STACK_BYTE(address))
+
+#define CORE_PUSH_BYTE(value) do {                  \
+        unsigned char pushByte = (value);           \
+                                                    \
+        s--;                                        \
+                                                    \
+        if (CORE_STACK_BYTE(s))                     \
+            stack[SHORT_LO(s)] = pushByte;          \
+        else                                        \
+            CORE_SET_BYTE(s, pushByte);             \
+    } while (0)
+
+#define CORE_POP_BYTE() (CORE_STACK_BYTE(s) ? stack[SHORT_LO(s++)] : (s++, CORE_GET_BYTE(s - 1)))
+
+#define CORE_PUSH_SHORT(value) do {                             \
+        unsigned short pushValue = (value);                     \
+                                                                \
+        s -= 2;                                                 \
+                                                                \
+        if (CORE_STACK_SHORT(s))                                \
+            CORE_STORE_SHORT(stack + SHORT_LO(s), pushValue);   \
+        else                                                    \
+            CORE_SET_SHORT(s, pushValue);                       \
+    } while (0)
+
+#define CORE_POP_SHORT() (s += 2, CORE_STACK_SHORT(s - 2) ? CPU_Core_LoadShort(stack + SHORT_LO(s - 2)) : CORE_GET_SHORT(s - 2))
+
+// Port accesses may remap pages through the bank controller or a device
+#define CORE_IO_READ(port) (stackPage = CORE_STACK_NONE, IO_Read(port))
+
+#define CORE_IO_WRITE(port, value) do {             \
+        unsigned char ioValue = (value);            \
+                                                    \
+        IO_Write((port), ioValue);                  \
+        stackPage = CORE_STACK_NONE;                \
+    } while (0)
+
+// Fast core addressing mode macros
+#define CORE_ADDRESS_D CORE_FETCH_SHORT()
+
+#define CORE_ADDRESS_RA a
+#define CORE_ADDRESS_RB b
+
+#define CORE_ADDRESS_XA (a + CORE_FETCH_SHORT())
+#define CORE_ADDRESS_XB (b + CORE_FETCH_SHORT())
+
+#define CORE_ADDRESS_YA CORE_GET_SHORT(a + CORE_FETCH_SHORT())
+#define CORE_ADDRESS_YB CORE_GET_SHORT(b + CORE_FETCH_SHORT())
+
+// Fast core decode macro, advancing the instruction pointer past the opcode
+#if CPU_DISPATCH == CPU_DISPATCH_THREADED
+
+#define CORE_DECODE() do {                                          \
+        decoded = &cache[i];                                        \
+                                                                    \
+        if (!decoded->handler) {                                    \
+            CPU_Decode(pages, i);                                   \
+            decoded->handler = CPU_CORE_LABEL[decoded->opcode];     \
+            stackPage = CORE_STACK_NONE;                            \
+        }                                                           \
+                                                                    \
+        operand = decoded->operand;                                 \
+        cycles += decoded->cycles;                                  \
+        i++;                                                        \
+    } while (0)
+
+#else
+
+#define CORE_DECODE() do {                                          \
+        decoded = &cache[i];                                        \
+                                                                    \
+        if (!decoded->length) {                                     \
+            CPU_Decode(pages, i);                                   \
+            stackPage = CORE_STACK_NONE;                            \
+        }                                                           \
+                                                                    \
+        operand = decoded->operand;                                 \
+        cycles += decoded->cycles;                                  \
+        i++;                                                        \
+    } while (0)
+
+#endif
+
+// Fast core dispatch macros
+#if CPU_DISPATCH == CPU_DISPATCH_THREADED
+
+#define CORE_CASE(name) CPU_Core_##name:
+#define CORE_FUSED_CASE(name) CPU_Core_##name:
+#define CORE_DEFAULT CPU_Core_NO:
+
+#define CORE_NEXT() do {                    \
+        if (!remaining) goto CPU_Core_Done; \
+                                            \
+        remaining--;                        \
+        CORE_DECODE();                      \
+        goto *decoded->handler;             \
+    } while (0)
+
+#else
+
+#define CORE_CASE(name) case CPU_OPCODE_##name:
+#define CORE_FUSED_CASE(name) case CPU_FUSED_##name:
+#define CORE_DEFAULT default:
+
+#define CORE_NEXT() continue
+
+#endif
+
+// Label for the single instruction a fused instruction falls back to
+#define CORE_SINGLE(name) CPU_Core_Single_##name:
+
+// Cycle cost of an opcode
+#define CORE_CYCLES(name) CPU_OPCODE_CYCLES[CPU_OPCODE_##name]
+
+// Fused instructions run as their first part alone when the budget can't fit them all, or the stack from low to high
+// isn't RAM both ways, as their parts use the values they pushed instead of reading them back
+#define CORE_FUSED_ENTER(name, single, parts, partCycles, low, high) do {                   \
+        if (remaining < (parts) - 1 || !CORE_STACK_BYTE((unsigned short) (low)) ||          \
+            !CORE_STACK_BYTE((unsigned short) (high))) goto CPU_Core_Single_##single;       \
+                                                                        \
+        remaining -= (parts) - 1;                                       \
+        cycles += (partCycles);                                         \
+        fusedHits[CPU_FUSED_##name - CPU_FUSED_FIRST]++;                \
+    } while (0)
+
+// Fused instructions stop after a port read that raised an interrupt or mapped a device over the value it pushed, giving back the rest
+#define CORE_FUSED_PORT(left, leftCycles) do {                 \
+        if (CPU_BATCH_DONE() || !CORE_STACK_BYTE(s)) {          \
+            remaining += (left);                                \
+            cycles -= (leftCycles);                             \
+            goto CPU_Core_Done;                                 \
+        }                                                       \
+    } while (0)
+
+// Fused instructions stop after a part that paused the batch, giving back the rest
+#define CORE_FUSED_SPLIT(left, leftCycles) do {     \
+        if (paused) {                               \
+            pausedRemaining += (left);              \
+            cycles -= (leftCycles);                 \
+            goto CPU_Core_Done;                     \
+        }                                           \
+    } while (0)
+
+// Function to run the fast core for up to count instructions
+static unsigned CPU_Core_Run(unsigned count) {
+    const MemoryPageTable *pages = Memory_GetPageTable();
+
+    CPUDecoded *cache = cpu->decoded;
+    unsigned long long *fusedHits = cpu->fusedHits;
+
+    CPUDecoded *decoded;
+    unsigned short operand;
+
+    // Load the CPU state into locals
+    unsigned short a = cpu->a.value;
+    unsigned short b = cpu->b.value;
+    unsigned short s = cpu->s.value;
+    unsigned short i = cpu->i.value;
+
+    CPUFlags f = cpu->flags;
+
+    unsigned long long cycles = cpu->cycles;
+
+    unsigned remaining = count;
+
+    // Cached stack page, see CORE_STACK_LOAD
+    unsigned char *stack = NULL;
+    unsigned stackPage = CORE_STACK_NONE;
+
+    // Pending pause, and the write to decoded code behind it if any
+    unsigned char paused = 0;
+    unsigned pausedRemaining = 0;
+
+    unsigned char codeWrite = 0;
+    unsigned short codeWriteAddress = 0;
+
+    unsigned short address;
+    unsigned char port;
+    unsigned char byteA, byteB;
+    unsigned short shortA, shortB;
+
+#if CPU_DISPATCH == CPU_DISPATCH_THREADED
+    // Label array for the threaded dispatch, in opcode order
+    static const void *CPU_CORE_LABEL[256 + CPU_FUSED_COUNT] = {
+        &&CPU_Core_LDAI,
+        &&CPU_Core_LDBI,
+        &&CPU_Core_LDSI,
+        &&CPU_Core_LDAD,
+        &&CPU_Core_LDBD,
+        &&CPU_Core_LDSD,
+        &&CPU_Core_LDARA,
+        &&CPU_Core_LDBRA,
+        &&CPU_Core_LDSRA,
+        &&CPU_Core_LDARB,
+        &&CPU_Core_LDBRB,
+        &&CPU_Core_LDSRB,
+        &&CPU_Core_LDAXA,
+        &&CPU_Core_LDBXA,
+        &&CPU_Core_LDSXA,
+        &&CPU_Core_LDAXB,
+        &&CPU_Core_LDBXB,
+        &&CPU_Core_LDSXB,
+        &&CPU_Core_LDAYA,
+        &&CPU_Core_LDBYA,
+        &&CPU_Core_LDSYA,
+        &&CPU_Core_LDAYB,
+        &&CPU_Core_LDBYB,
+        &&CPU_Core_LDSYB,
+        &&CPU_Core_STAD,
+        &&CPU_Core_STBD,
+        &&CPU_Core_STSD,
+        &&CPU_Core_STARA,
+        &&CPU_Core_STBRA,
+        &&CPU_Core_STSRA,
+        &&CPU_Core_STARB,
+        &&CPU_Core_STBRB,
+        &&CPU_Core_STSRB,
+        &&CPU_Core_STAXA,
+        &&CPU_Core_STBXA,
+        &&CPU_Core_STSXA,
+        &&CPU_Core_STAXB,
+        &&CPU_Core_STBXB,
+        &&CPU_Core_STSXB,
+        &&CPU_Core_STAYA,
+        &&CPU_Core_STBYA,
+        &&CPU_Core_STSYA,
+        &&CPU_Core_STAYB,
+        &&CPU_Core_STBYB,
+        &&CPU_Core_STSYB,
+        &&CPU_Core_MVAB,
+        &&CPU_Core_MVAS,
+        &&CPU_Core_MVAI,
+        &&CPU_Core_MVBA,
+        &&CPU_Core_MVBS,
+        &&CPU_Core_MVBI,
+        &&CPU_Core_MVSA,
+        &&CPU_Core_MVSB,
+        &&CPU_Core_MVSI,
+        &&CPU_Core_MVIA,
+        &&CPU_Core_MVIB,
+        &&CPU_Core_MVIS,
+        &&CPU_Core_PUBI,
+        &&CPU_Core_PUBD,
+        &&CPU_Core_PUBRA,
+        &&CPU_Core_PUBRB,
+        &&CPU_Core_PUBXA,
+        &&CPU_Core_PUBXB,
+        &&CPU_Core_PUBYA,
+        &&CPU_Core_PUBYB,
+        &&CPU_Core_PUSI,
+        &&CPU_Core_PUSD,
+        &&CPU_Core_PUSRA,
+        &&CPU_Core_PUSRB,
+        &&CPU_Core_PUSXA,
+        &&CPU_Core_PUSXB,
+        &&CPU_Core_PUSYA,
+        &&CPU_Core_PUSYB,
+        &&CPU_Core_PUA,
+        &&CPU_Core_PUB,
+        &&CPU_Core_PUS,
+        &&CPU_Core_PUI,
+        &&CPU_Core_PUF,
+        &&CPU_Core_POBD,
+        &&CPU_Core_POBRA,
+        &&CPU_Core_POBRB,
+        &&CPU_Core_POBXA,
+        &&CPU_Core_POBXB,
+        &&CPU_Core_POBYA,
+        &&CPU_Core_POBYB,
+        &&CPU_Core_POSD,
+        &&CPU_Core_POSRA,
+        &&CPU_Core_POSRB,
+        &&CPU_Core_POSXA,
+        &&CPU_Core_POSXB,
+        &&CPU_Core_POSYA,
+        &&CPU_Core_POSYB,
+        &&CPU_Core_POA,
+        &&CPU_Core_POB,
+        &&CPU_Core_POS,
+        &&CPU_Core_POI,
+        &&CPU_Core_POF,
+        &&CPU_Core_DTS,
+        &&CPU_Core_STS,
+        &&CPU_Core_IRA,
+        &&CPU_Core_IRB,
+        &&CPU_Core_IRS,
+        &&CPU_Core_DRA,
+        &&CPU_Core_DRB,
+        &&CPU_Core_DRS,
+        &&CPU_Core_ADB,
+        &&CPU_Core_SUB,
+        &&CPU_Core_ANB,
+        &&CPU_Core_ORB,
+        &&CPU_Core_XRB,
+        &&CPU_Core_CPB,
+        &&CPU_Core_IVB,
+        &&CPU_Core_ICB,
+        &&CPU_Core_DCB,
+        &&CPU_Core_RLB,
+        &&CPU_Core_RRB,
+        &&CPU_Core_SLB,
+        &&CPU_Core_SRB,
+        &&CPU_Core_SAB,
+        &&CPU_Core_ADS,
+        &&CPU_Core_SUS,
+        &&CPU_Core_ANS,
+        &&CPU_Core_ORS,
+        &&CPU_Core_XRS,
+        &&CPU_Core_CPS,
+        &&CPU_Core_IVS,
+        &&CPU_Core_ICS,
+        &&CPU_Core_DCS,
+        &&CPU_Core_RLS,
+        &&CPU_Core_RRS,
+        &&CPU_Core_SLS,
+        &&CPU_Core_SRS,
+        &&CPU_Core_SAS,
+        &&CPU_Core_SFZ,
+        &&CPU_Core_SFC,
+        &&CPU_Core_SFS,
+        &&CPU_Core_SFV,
+        &&CPU_Core_CFZ,
+        &&CPU_Core_CFC,
+        &&CPU_Core_CFS,
+        &&CPU_Core_CFV,
+        &&CPU_Core_EI,
+        &&CPU_Core_DI,
+        &&CPU_Core_HT,
+        &&CPU_Core_JM,
+        &&CPU_Core_CA,
+        &&CPU_Core_RT,
+        &&CPU_Core_SIA,
+        &&CPU_Core_SIB,
+        &&CPU_Core_SIC,
+        &&CPU_Core_SID,
+        &&CPU_Core_SIE,
+        &&CPU_Core_SIF,
+        &&CPU_Core_SIG,
+        &&CPU_Core_SIH,
+        &&CPU_Core_JMZ,
+        &&CPU_Core_JMC,
+        &&CPU_Core_JMS,
+        &&CPU_Core_JMV,
+        &&CPU_Core_JMNZ,
+        &&CPU_Core_JMNC,
+        &&CPU_Core_JMNS,
+        &&CPU_Core_JMNV,
+        &&CPU_Core_CAZ,
+        &&CPU_Core_CAC,
+        &&CPU_Core_CAS,
+        &&CPU_Core_CAV,
+        &&CPU_Core_CANZ,
+        &&CPU_Core_CANC,
+        &&CPU_Core_CANS,
+        &&CPU_Core_CANV,
+        &&CPU_Core_RTZ,
+        &&CPU_Core_RTC,
+        &&CPU_Core_RTS,
+        &&CPU_Core_RTV,
+        &&CPU_Core_RTNZ,
+        &&CPU_Core_RTNC,
+        &&CPU_Core_RTNS,
+        &&CPU_Core_RTNV,
+        &&CPU_Core_IPB,
+        &&CPU_Core_OPB,
+        &&CPU_Core_IPS,
+        &&CPU_Core_OPS,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+        &&CPU_Core_NO,
+
+        // Fused instructions
+        &&CPU_Core_PUSI_ADS,
+        &&CPU_Core_PUBI_CPB_JMZ,
+        &&CPU_Core_PUBI_CPB_JMNZ,
+        &&CPU_Core_PUA_PUB_ADS_POA,
+        &&CPU_Core_IPB_ANB_JMZ,
+        &&CPU_Core_IPB_ANB_JMNZ
+    };
+
+    CORE_NEXT();
+#else
+    for (;;) {
+CPU_Core_Dispatch:
+        if (!remaining) goto CPU_Core_Done;
+
+        remaining--;
+
+        CORE_DECODE();
+
+        switch (decoded->opcode) {
+#endif
+
+    // Load instructions
+    CORE_CASE(LDAI) a = CORE_FETCH_SHORT(); CORE_NEXT();
+    CORE_CASE(LDBI) b = CORE_FETCH_SHORT(); CORE_NEXT();
+    CORE_CASE(LDSI) s = CORE_FETCH_SHORT(); CORE_NEXT();
+
+    CORE_CASE(LDAD) a = CORE_GET_SHORT(CORE_ADDRESS_D); CORE_NEXT();
+    CORE_CASE(LDBD) b = CORE_GET_SHORT(CORE_ADDRESS_D); CORE_NEXT();
+    CORE_CASE(LDSD) s = CORE_GET_SHORT(CORE_ADDRESS_D); CORE_NEXT();
+
+    CORE_CASE(LDARA) a = CORE_GET_SHORT(CORE_ADDRESS_RA); CORE_NEXT();
+    CORE_CASE(LDBRA) b = CORE_GET_SHORT(CORE_ADDRESS_RA); CORE_NEXT();
+    CORE_CASE(LDSRA) s = CORE_GET_SHORT(CORE_ADDRESS_RA); CORE_NEXT();
+
+    CORE_CASE(LDARB) a = CORE_GET_SHORT(CORE_ADDRESS_RB); CORE_NEXT();
+    CORE_CASE(LDBRB) b = CORE_GET_SHORT(CORE_ADDRESS_RB); CORE_NEXT();
+    CORE_CASE(LDSRB) s = CORE_GET_SHORT(CORE_ADDRESS_RB); CORE_NEXT();
+
+    CORE_CASE(LDAXA) a = CORE_GET_SHORT(CORE_ADDRESS_XA); CORE_NEXT();
+    CORE_CASE(LDBXA) b = CORE_GET_SHORT(CORE_ADDRESS_XA); CORE_NEXT();
+    CORE_CASE(LDSXA) s = CORE_GET_SHORT(CORE_ADDRESS_XA); CORE_NEXT();
+
+    CORE_CASE(LDAXB) a = CORE_GET_SHORT(CORE_ADDRESS_XB); CORE_NEXT();
+    CORE_CASE(LDBXB) b = CORE_GET_SHORT(CORE_ADDRESS_XB); CORE_NEXT();
+    CORE_CASE(LDSXB) s = CORE_GET_SHORT(CORE_ADDRESS_XB); CORE_NEXT();
+
+    CORE_CASE(LDAYA) a = CORE_GET_SHORT(CORE_ADDRESS_YA); CORE_NEXT();
+    CORE_CASE(LDBYA) b = CORE_GET_SHORT(CORE_ADDRESS_YA); CORE_NEXT();
+    CORE_CASE(LDSYA) s = CORE_GET_SHORT(CORE_ADDRESS_YA); CORE_NEXT();
+
+    CORE_CASE(LDAYB) a = CORE_GET_SHORT(CORE_ADDRESS_YB); CORE_NEXT();
+    CORE_CASE(LDBYB) b = CORE_GET_SHORT(CORE_ADDRESS_YB); CORE_NEXT();
+    CORE_CASE(LDSYB) s = CORE_GET_SHORT(CORE_ADDRESS_YB); CORE_NEXT();
+
+    // Store instructions
+    CORE_CASE(STAD) CORE_SET_SHORT(CORE_ADDRESS_D, a); CORE_NEXT();
+    CORE_CASE(STBD) CORE_SET_SHORT(CORE_ADDRESS_D, b); CORE_NEXT();
+    CORE_CASE(STSD) CORE_SET_SHORT(CORE_ADDRESS_D, s); CORE_NEXT();
+
+    CORE_CASE(STARA) CORE_SET_SHORT(CORE_ADDRESS_RA, a); CORE_NEXT();
+    CORE_CASE(STBRA) CORE_SET_SHORT(CORE_ADDRESS_RA, b); CORE_NEXT();
+    CORE_CASE(STSRA) CORE_SET_SHORT(CORE_ADDRESS_RA, s); CORE_NEXT();
+
+    CORE_CASE(STARB) CORE_SET_SHORT(CORE_ADDRESS_RB, a); CORE_NEXT();
+    CORE_CASE(STBRB) CORE_SET_SHORT(CORE_ADDRESS_RB, b); CORE_NEXT();
+    CORE_CASE(STSRB) CORE_SET_SHORT(CORE_ADDRESS_RB, s); CORE_NEXT();
+
+    CORE_CASE(STAXA) CORE_SET_SHORT(CORE_ADDRESS_XA, a); CORE_NEXT();
+    CORE_CASE(STBXA) CORE_SET_SHORT(CORE_ADDRESS_XA, b); CORE_NEXT();
+    CORE_CASE(STSXA) CORE_SET_SHORT(CORE_ADDRESS_XA, s); CORE_NEXT();
+
+    CORE_CASE(STAXB) CORE_SET_SHORT(CORE_ADDRESS_XB, a); CORE_NEXT();
+    CORE_CASE(STBXB) CORE_SET_SHORT(CORE_ADDRESS_XB, b); CORE_NEXT();
+    CORE_CASE(STSXB) CORE_SET_SHORT(CORE_ADDRESS_XB, s); CORE_NEXT();
+
+    CORE_CASE(STAYA) CORE_SET_SHORT(CORE_ADDRESS_YA, a); CORE_NEXT();
+    CORE_CASE(STBYA) CORE_SET_SHORT(CORE_ADDRESS_YA, b); CORE_NEXT();
+    CORE_CASE(STSYA) CORE_SET_SHORT(CORE_ADDRESS_YA, s); CORE_NEXT();
+
+    CORE_CASE(STAYB) CORE_SET_SHORT(CORE_ADDRESS_YB, a); CORE_NEXT();
+    CORE_CASE(STBYB) CORE_SET_SHORT(CORE_ADDRESS_YB, b); CORE_NEXT();
+    CORE_CASE(STSYB) CORE_SET_SHORT(CORE_ADDRESS_YB, s); CORE_NEXT();
+
+    // Move instructions
+    CORE_CASE(MVAB) a = b; CORE_NEXT();
+    CORE_CASE(MVAS) a = s; CORE_NEXT();
+    CORE_CASE(MVAI) a = i; CORE_NEXT();
+
+    CORE_CASE(MVBA) b = a; CORE_NEXT();
+    CORE_CASE(MVBS) b = s; CORE_NEXT();
+    CORE_CASE(MVBI) b = i; CORE_NEXT();
+
+    CORE_CASE(MVSA) s = a; CORE_NEXT();
+    CORE_CASE(MVSB) s = b; CORE_NEXT();
+    CORE_CASE(MVSI) s = i; CORE_NEXT();
+
+    CORE_CASE(MVIA) i = a; CORE_NEXT();
+    CORE_CASE(MVIB) i = b; CORE_NEXT();
+    CORE_CASE(MVIS) i = s; CORE_NEXT();
+
+    // Push instructions
+    CORE_CASE(PUBI) CORE_SINGLE(PUBI) byteA = CORE_FETCH_BYTE(); CORE_PUSH_BYTE(byteA); CORE_NEXT();
+    CORE_CASE(PUBD) byteA = CORE_GET_BYTE(CORE_ADDRESS_D); CORE_PUSH_BYTE(byteA); CORE_NEXT();
+    CORE_CASE(PUBRA) byteA = CORE_GET_BYTE(CORE_ADDRESS_RA); CORE_PUSH_BYTE(byteA); CORE_NEXT();
+    CORE_CASE(PUBRB) byteA = CORE_GET_BYTE(CORE_ADDRESS_RB); CORE_PUSH_BYTE(byteA); CORE_NEXT();
+    CORE_CASE(PUBXA) byteA = CORE_GET_BYTE(CORE_ADDRESS_XA); CORE_PUSH_BYTE(byteA); CORE_NEXT();
+    CORE_CASE(PUBXB) byteA = CORE_GET_BYTE(CORE_ADDRESS_XB); CORE_PUSH_BYTE(byteA); CORE_NEXT();
+    CORE_CASE(PUBYA) byteA = CORE_GET_BYTE(CORE_ADDRESS_YA); CORE_PUSH_BYTE(byteA); CORE_NEXT();
+    CORE_CASE(PUBYB) byteA = CORE_GET_BYTE(CORE_ADDRESS_YB); CORE_PUSH_BYTE(byteA); CORE_NEXT();
+
+    CORE_CASE(PUSI) CORE_SINGLE(PUSI) CORE_PUSH_SHORT(CORE_FETCH_SHORT()); CORE_NEXT();
+    CORE_CASE(PUSD) CORE_PUSH_SHORT(CORE_GET_SHORT(CORE_ADDRESS_D)); CORE_NEXT();
+    CORE_CASE(PUSRA) CORE_PUSH_SHORT(CORE_GET_SHORT(CORE_ADDRESS_RA)); CORE_NEXT();
+    CORE_CASE(PUSRB) CORE_PUSH_SHORT(CORE_GET_SHORT(CORE_ADDRESS_RB)); CORE_NEXT();
+    CORE_CASE(PUSXA) CORE_PUSH_SHORT(CORE_GET_SHORT(CORE_ADDRESS_XA)); CORE_NEXT();
+    CORE_CASE(PUSXB) CORE_PUSH_SHORT(CORE_GET_SHORT(CORE_ADDRESS_XB)); CORE_NEXT();
+    CORE_CASE(PUSYA) CORE_PUSH_SHORT(CORE_GET_SHORT(CORE_ADDRESS_YA)); CORE_NEXT();
+    CORE_CASE(PUSYB) CORE_PUSH_SHORT(CORE_GET_SHORT(CORE_ADDRESS_YB)); CORE_NEXT();
+
+    CORE_CASE(PUA) CORE_SINGLE(PUA) CORE_PUSH_SHORT(a); CORE_NEXT();
+    CORE_CASE(PUB) CORE_PUSH_SHORT(b); CORE_NEXT();
+    CORE_CASE(PUS) CORE_PUSH_SHORT(s); CORE_NEXT();
+    CORE_CASE(PUI) CORE_PUSH_SHORT(i); CORE_NEXT();
+
+    CORE_CASE(PUF)
+        cpu->flags = f;
+
+        CORE_PUSH_BYTE(CPU_Util_GetFlags());
+        CORE_NEXT();
+
+    // Pop instructions
+    CORE_CASE(POBD) address = CORE_ADDRESS_D; CORE_SET_BYTE(address, CORE_POP_BYTE()); CORE_NEXT();
+    CORE_CASE(POBRA) address = CORE_ADDRESS_RA; CORE_SET_BYTE(address, CORE_POP_BYTE()); CORE_NEXT();
+    CORE_CASE(POBRB) address = CORE_ADDRESS_RB; CORE_SET_BYTE(address, CORE_POP_BYTE()); CORE_NEXT();
+    CORE_CASE(POBXA) address = CORE_ADDRESS_XA; CORE_SET_BYTE(address, CORE_POP_BYTE()); CORE_NEXT();
+    CORE_CASE(POBXB) address = CORE_ADDRESS_XB; CORE_SET_BYTE(address, CORE_POP_BYTE()); CORE_NEXT();
+    CORE_CASE(POBYA) address = CORE_ADDRESS_YA; CORE_SET_BYTE(address, CORE_POP_BYTE()); CORE_NEXT();
+    CORE_CASE(POBYB) address = CORE_ADDRESS_YB; CORE_SET_BYTE(address, CORE_POP_BYTE()); CORE_NEXT();
+
+    CORE_CASE(POSD) address = CORE_ADDRESS_D; CORE_SET_SHORT(address, CORE_POP_SHORT()); CORE_NEXT();
+    CORE_CASE(POSRA) address = CORE_ADDRESS_RA; CORE_SET_SHORT(address, CORE_POP_SHORT()); CORE_NEXT();
+    CORE_CASE(POSRB) address = CORE_ADDRESS_RB; CORE_SET_SHORT(address, CORE_POP_SHORT()); CORE_NEXT();
+    CORE_CASE(POSXA) address = CORE_ADDRESS_XA; CORE_SET_SHORT(address, CORE_POP_SHORT()); CORE_NEXT();
+    CORE_CASE(POSXB) address = CORE_ADDRESS_XB; CORE_SET_SHORT(address, CORE_POP_SHORT()); CORE_NEXT();
+    CORE_CASE(POSYA) address = CORE_ADDRESS_YA; CORE_SET_SHORT(address, CORE_POP_SHORT()); CORE_NEXT();
+    CORE_CASE(POSYB) address = CORE_ADDRESS_YB; CORE_SET_SHORT(address, CORE_POP_SHORT()); CORE_NEXT();
+
+    CORE_CASE(POA) a = CORE_POP_SHORT(); CORE_NEXT();
+    CORE_CASE(POB) b = CORE_POP_SHORT(); CORE_NEXT();
+    CORE_CASE(POS) s = CORE_POP_SHORT(); CORE_NEXT();
+    CORE_CASE(POI) i = CORE_POP_SHORT(); CORE_NEXT();
+
+    CORE_CASE(POF)
+        CPU_Util_SetFlags(CORE_POP_BYTE());
+
+        f = cpu->flags;
+
+        // Popping the flags may set the halt flag or enable interrupts
+        if (cpu->f.h || CPU_INTERRUPT_READY()) goto CPU_Core_Done;
+
+        CORE_NEXT();
+
+    // Stack instructions
+    CORE_CASE(DTS) byteA = CORE_GET_BYTE(s); CORE_PUSH_BYTE(byteA); CORE_NEXT();
+
+    CORE_CASE(STS)
+        byteA = CORE_GET_BYTE(s);
+        byteB = CORE_GET_BYTE(s + 1);
+
+        CORE_SET_BYTE(s, byteB);
+        CORE_SET_BYTE(s + 1, byteA);
+
+        CORE_NEXT();
+
+    // Indexing register instructions
+    CORE_CASE(IRA) a++; CORE_NEXT();
+    CORE_CASE(IRB) b++; CORE_NEXT();
+    CORE_CASE(IRS) s++; CORE_NEXT();
+
+    CORE_CASE(DRA) a--; CORE_NEXT();
+    CORE_CASE(DRB) b--; CORE_NEXT();
+    CORE_CASE(DRS) s--; CORE_NEXT();
+
+    // 8 - bit ALU instructions
+    CORE_CASE(ADB)
+        byteA = CORE_POP_BYTE();
+        byteB = CORE_POP_BYTE();
+
+        CORE_PUSH_BYTE(CPU_Core_ADB(&f, byteA, byteB));
+        CORE_NEXT();
+
+    CORE_CASE(SUB)
+        byteA = CORE_POP_BYTE();
+        byteB = CORE_POP_BYTE();
+
+        CORE_PUSH_BYTE(CPU_Core_SUB(&f, byteA, byteB));
+        CORE_NEXT();
+
+    CORE_CASE(ANB)
+        byteA = CORE_POP_BYTE();
+        byteB = CORE_POP_BYTE();
+
+        CORE_PUSH_BYTE(CPU_Core_Logic8(&f, byteA & byteB));
+        CORE_NEXT();
+
+    CORE_CASE(ORB)
+        byteA = CORE_POP_BYTE();
+        byteB = CORE_POP_BYTE();
+
+        CORE_PUSH_BYTE(CPU_Core_Logic8(&f, byteA | byteB));
+        CORE_NEXT();
+
+    CORE_CASE(XRB)
+        byteA = CORE_POP_BYTE();
+        byteB = CORE_POP_BYTE();
+
+        CORE_PUSH_BYTE(CPU_Core_Logic8(&f, byteA ^ byteB));
+        CORE_NEXT();
+
+    CORE_CASE(CPB)
+        byteA = CORE_POP_BYTE();
+        byteB = CORE_POP_BYTE();
+
+        CPU_Flags_SetC(&f, 1);
+
+        CPU_Core_SUB(&f, byteA, byteB);
+        CORE_NEXT();
+
+    CORE_CASE(IVB) byteA = CORE_POP_BYTE(); CORE_PUSH_BYTE(CPU_Core_Logic8(&f, ~byteA)); CORE_NEXT();
+
+    CORE_CASE(ICB) byteA = CORE_POP_BYTE(); CPU_Flags_SetC(&f, 0); CORE_PUSH_BYTE(CPU_Core_ADB(&f, byteA, 1)); CORE_NEXT();
+    CORE_CASE(DCB) byteA = CORE_POP_BYTE(); CPU_Flags_SetC(&f, 1); CORE_PUSH_BYTE(CPU_Core_SUB(&f, byteA, 1)); CORE_NEXT();
+
+    CORE_CASE(RLB) byteA = CORE_POP_BYTE(); CORE_PUSH_BYTE(CPU_Core_RLB(&f, byteA)); CORE_NEXT();
+    CORE_CASE(RRB) byteA = CORE_POP_BYTE(); CORE_PUSH_BYTE(CPU_Core_RRB(&f, byteA)); CORE_NEXT();
+
+    CORE_CASE(SLB) byteA = CORE_POP_BYTE(); CPU_Flags_SetC(&f, 0); CORE_PUSH_BYTE(CPU_Core_RLB(&f, byteA)); CORE_NEXT();
+    CORE_CASE(SRB) byteA = CORE_POP_BYTE(); CPU_Flags_SetC(&f, 0); CORE_PUSH_BYTE(CPU_Core_RRB(&f, byteA)); CORE_NEXT();
+    CORE_CASE(SAB) byteA = CORE_POP_BYTE(); CPU_Flags_SetC(&f, 1); CORE_PUSH_BYTE(CPU_Core_RRB(&f, byteA)); CORE_NEXT();
+
+    // 16 - bit ALU instructions
+    CORE_CASE(ADS)
+        shortA = CORE_POP_SHORT();
+        shortB = CORE_POP_SHORT();
+
+        CORE_PUSH_SHORT(CPU_Core_ADS(&f, shortA, shortB));
+        CORE_NEXT();
+
+    CORE_CASE(SUS)
+        shortA = CORE_POP_SHORT();
+        shortB = CORE_POP_SHORT();
+
+        CORE_PUSH_SHORT(CPU_Core_SUS(&f, shortA, shortB));
+        CORE_NEXT();
+
+    CORE_CASE(ANS)
+        shortA = CORE_POP_SHORT();
+        shortB = CORE_POP_SHORT();
+
+        CORE_PUSH_SHORT(CPU_Core_Logic16(&f, shortA & shortB));
+        CORE_NEXT();
+
+    CORE_CASE(ORS)
+        shortA = CORE_POP_SHORT();
+        shortB = CORE_POP_SHORT();
+
+        CORE_PUSH_SHORT(CPU_Core_Logic16(&f, shortA | shortB));
+        CORE_NEXT();
+
+    CORE_CASE(XRS)
+        shortA = CORE_POP_SHORT();
+        shortB = CORE_POP_SHORT();
+
+        CORE_PUSH_SHORT(CPU_Core_Logic16(&f, shortA ^ shortB));
+        CORE_NEXT();
+
+    CORE_CASE(CPS)
+        shortA = CORE_POP_SHORT();
+        shortB = CORE_POP_SHORT();
+
+        CPU_Flags_SetC(&f, 1);
+
+        CPU_Core_SUS(&f, shortA, shortB);
+        CORE_NEXT();
+
+    CORE_CASE(IVS) shortA = CORE_POP_SHORT(); CORE_PUSH_SHORT(CPU_Core_Logic16(&f, ~shortA)); CORE_NEXT();
+
+    CORE_CASE(ICS) shortA = CORE_POP_SHORT(); CPU_Flags_SetC(&f, 0); CORE_PUSH_SHORT(CPU_Core_ADS(&f, shortA, 1)); CORE_NEXT();
+    CORE_CASE(DCS) shortA = CORE_POP_SHORT(); CPU_Flags_SetC(&f, 1); CORE_PUSH_SHORT(CPU_Core_SUS(&f, shortA, 1)); CORE_NEXT();
+
+    CORE_CASE(RLS) shortA = CORE_POP_SHORT(); CORE_PUSH_SHORT(CPU_Core_RLS(&f, shortA)); CORE_NEXT();
+    CORE_CASE(RRS) shortA = CORE_POP_SHORT(); CORE_PUSH_SHORT(CPU_Core_RRS(&f, shortA)); CORE_NEXT();
+
+    CORE_CASE(SLS) shortA = CORE_POP_SHORT(); CPU_Flags_SetC(&f, 0); CORE_PUSH_SHORT(CPU_Core_RLS(&f, shortA)); CORE_NEXT();
+    CORE_CASE(SRS) shortA = CORE_POP_SHORT(); CPU_Flags_SetC(&f, 0); CORE_PUSH_SHORT(CPU_Core_RRS(&f, shortA)); CORE_NEXT();
+    CORE_CASE(SAS) shortA = CORE_POP_SHORT(); CPU_Flags_SetC(&f, 1); CORE_PUSH_SHORT(CPU_Core_RRS(&f, shortA)); CORE_NEXT();
+
+    // Status flag instructions
+    CORE_CASE(SFZ) CPU_Flags_SetZ(&f, 1); CORE_NEXT();
+    CORE_CASE(SFC) CPU_Flags_SetC(&f, 1); CORE_NEXT();
+    CORE_CASE(SFS) CPU_Flags_SetS(&f, 1); CORE_NEXT();
+    CORE_CASE(SFV) CPU_Flags_SetV(&f, 1); CORE_NEXT();
+
+    CORE_CASE(CFZ) CPU_Flags_SetZ(&f, 0); CORE_NEXT();
+    CORE_CASE(CFC) CPU_Flags_SetC(&f, 0); CORE_NEXT();
+    CORE_CASE(CFS) CPU_Flags_SetS(&f, 0); CORE_NEXT();
+    CORE_CASE(CFV) CPU_Flags_SetV(&f, 0); CORE_NEXT();
+
+    // Enabling interrupts may let a pending one through, which is accepted outside the core
+    CORE_CASE(EI) cpu->f.i = 1; if (cpu->interrupt) goto CPU_Core_Done; CORE_NEXT();
+    CORE_CASE(DI) cpu->f.i = 0; CORE_NEXT();
+
+    CORE_CASE(HT) cpu->f.h = 1; goto CPU_Core_Done;
+
+    // Branching instructions
+    CORE_CASE(JM) i = CORE_FETCH_SHORT(); CORE_NEXT();
+
+    CORE_CASE(CA)
+        address = CORE_FETCH_SHORT();
+
+        CORE_PUSH_SHORT(i);
+        i = address;
+
+        CORE_NEXT();
+
+    CORE_CASE(RT) i = CORE_POP_SHORT(); CORE_NEXT();
+
+    CORE_CASE(SIA) CORE_PUSH_SHORT(i); i = 0x0000; CORE_NEXT();
+    CORE_CASE(SIB) CORE_PUSH_SHORT(i); i = 0x0008; CORE_NEXT();
+    CORE_CASE(SIC) CORE_PUSH_SHORT(i); i = 0x0010; CORE_NEXT();
+    CORE_CASE(SID) CORE_PUSH_SHORT(i); i = 0x0018; CORE_NEXT();
+    CORE_CASE(SIE) CORE_PUSH_SHORT(i); i = 0x0020; CORE_NEXT();
+    CORE_CASE(SIF) CORE_PUSH_SHORT(i); i = 0x0028; CORE_NEXT();
+    CORE_CASE(SIG) CORE_PUSH_SHORT(i); i = 0x0030; CORE_NEXT();
+    CORE_CASE(SIH) CORE_PUSH_SHORT(i); i = 0x0038; CORE_NEXT();
+
+    // Conditional branching instructions
+#define CORE_COND_JM(condition) do {        \
+        address = CORE_FETCH_SHORT();       \
+                                            \
+        if (condition) i = address;         \
+    } while (0)
+
+#define CORE_COND_CA(condition) do {        \
+        address = CORE_FETCH_SHORT();       \
+                                            \
+        if (condition) {                    \
+            CORE_PUSH_SHORT(i);             \
+            i = address;                    \
+        }                                   \
+    } while (0)
+
+    CORE_CASE(JMZ) CORE_COND_JM(CPU_Flags_Z(&f)); CORE_NEXT();
+    CORE_CASE(JMC) CORE_COND_JM(CPU_Flags_C(&f)); CORE_NEXT();
+    CORE_CASE(JMS) CORE_COND_JM(CPU_Flags_S(&f)); CORE_NEXT();
+    CORE_CASE(JMV) CORE_COND_JM(CPU_Flags_V(&f)); CORE_NEXT();
+
+    CORE_CASE(JMNZ) CORE_COND_JM(!CPU_Flags_Z(&f)); CORE_NEXT();
+    CORE_CASE(JMNC) CORE_COND_JM(!CPU_Flags_C(&f)); CORE_NEXT();
+    CORE_CASE(JMNS) CORE_COND_JM(!CPU_Flags_S(&f)); CORE_NEXT();
+    CORE_CASE(JMNV) CORE_COND_JM(!CPU_Flags_V(&f)); CORE_NEXT();
+
+    CORE_CASE(CAZ) CORE_COND_CA(CPU_Flags_Z(&f)); CORE_NEXT();
+    CORE_CASE(CAC) CORE_COND_CA(CPU_Flags_C(&f)); CORE_NEXT();
+    CORE_CASE(CAS) CORE_COND_CA(CPU_Flags_S(&f)); CORE_NEXT();
+    CORE_CASE(CAV) CORE_COND_CA(CPU_Flags_V(&f)); CORE_NEXT();
+
+    CORE_CASE(CANZ) CORE_COND_CA(!CPU_Flags_Z(&f)); CORE_NEXT();
+    CORE_CASE(CANC) CORE_COND_CA(!CPU_Flags_C(&f)); CORE_NEXT();
+    CORE_CASE(CANS) CORE_COND_CA(!CPU_Flags_S(&f)); CORE_NEXT();
+    CORE_CASE(CANV) CORE_COND_CA(!CPU_Flags_V(&f)); CORE_NEXT();
+
+    CORE_CASE(RTZ) if (CPU_Flags_Z(&f)) i = CORE_POP_SHORT(); CORE_NEXT();
+    CORE_CASE(RTC) if (CPU_Flags_C(&f)) i = CORE_POP_SHORT(); CORE_NEXT();
+    CORE_CASE(RTS) if (CPU_Flags_S(&f)) i = CORE_POP_SHORT(); CORE_NEXT();
+    CORE_CASE(RTV) if (CPU_Flags_V(&f)) i = CORE_POP_SHORT(); CORE_NEXT();
+
+    CORE_CASE(RTNZ) if (!CPU_Flags_Z(&f)) i = CORE_POP_SHORT(); CORE_NEXT();
+    CORE_CASE(RTNC) if (!CPU_Flags_C(&f)) i = CORE_POP_SHORT(); CORE_NEXT();
+    CORE_CASE(RTNS) if (!CPU_Flags_S(&f)) i = CORE_POP_SHORT(); CORE_NEXT();
+    CORE_CASE(RTNV) if (!CPU_Flags_V(&f)) i = CORE_POP_SHORT(); CORE_NEXT();
+
+#undef CORE_COND_JM
+#undef CORE_COND_CA
+
+    // I/O port instructions, port reads may raise an interrupt
+    CORE_CASE(IPB) CORE_SINGLE(IPB)
+        port = CORE_FETCH_BYTE();
+
+        CORE_PUSH_BYTE(CORE_IO_READ(port));
+
+        if (CPU_BATCH_DONE()) goto CPU_Core_Done;
+
+        CORE_NEXT();
+
+    // Port writes may raise or unmask an interrupt, or start a device that stops the batch
+    CORE_CASE(OPB)
+        port = CORE_FETCH_BYTE();
+
+        CORE_IO_WRITE(port, CORE_POP_BYTE());
+
+        if (CPU_BATCH_DONE()) goto CPU_Core_Done;
+
+        CORE_NEXT();
+
+    CORE_CASE(IPS)
+        port = CORE_FETCH_BYTE();
+
+        CORE_PUSH_BYTE(CORE_IO_READ(port + 1));
+        CORE_PUSH_BYTE(CORE_IO_READ(port));
+
+        if (CPU_BATCH_DONE()) goto CPU_Core_Done;
+
+        CORE_NEXT();
+
+    CORE_CASE(OPS)
+        port = CORE_FETCH_BYTE();
+
+        CORE_IO_WRITE(port, CORE_POP_BYTE());
+        CORE_IO_WRITE(port + 1, CORE_POP_BYTE());
+
+        if (CPU_BATCH_DONE()) goto CPU_Core_Done;
+
+        CORE_NEXT();
+
+    // Miscellaneous instructions
+    CORE_DEFAULT CORE_NEXT();
+
+    // Fused instructions, run only with the stack on RAM both ways and split after each part that may write to it
+    CORE_FUSED_CASE(PUSI_ADS)
+        CORE_FUSED_ENTER(PUSI_ADS, PUSI, 2, CORE_CYCLES(ADS), s - 2, s + 1);
+
+        shortA = CORE_FETCH_SHORT();
+        CORE_PUSH_SHORT(shortA);
+        CORE_FUSED_SPLIT(1, CORE_CYCLES(ADS));
+
+        i += 1;
+        shortB = CORE_GET_SHORT(s + 2);
+        s += 2;
+
+        CORE_SET_SHORT(s, CPU_Core_ADS(&f, shortA, shortB));
+        CORE_NEXT();
+
+#define CORE_FUSED_PUBI_CPB(condition) do {             \
+        address = decoded->target;                      \
+                                                        \
+        byteA = CORE_FETCH_BYTE();                      \
+        CORE_PUSH_BYTE(byteA);                          \
+        CORE_FUSED_SPLIT(2, CORE_CYCLES(CPB) + CORE_CYCLES(JMZ)); \
+                                                        \
+        i += 1;                                         \
+        byteB = CORE_GET_BYTE(s + 1);                   \
+        s += 2;                                         \
+                                                        \
+        CPU_Flags_SetC(&f, 1);                          \
+        CPU_Core_SUB(&f, byteA, byteB);                 \
+                                                        \
+        i += 3;                                         \
+                                                        \
+        if (condition) i = address;                     \
+    } while (0)
+
+    CORE_FUSED_CASE(PUBI_CPB_JMZ)
+        CORE_FUSED_ENTER(PUBI_CPB_JMZ, PUBI, 3, CORE_CYCLES(CPB) + CORE_CYCLES(JMZ), s - 1, s);
+        CORE_FUSED_PUBI_CPB(CPU_Flags_Z(&f));
+        CORE_NEXT();
+
+    CORE_FUSED_CASE(PUBI_CPB_JMNZ)
+        CORE_FUSED_ENTER(PUBI_CPB_JMNZ, PUBI, 3, CORE_CYCLES(CPB) + CORE_CYCLES(JMNZ), s - 1, s);
+        CORE_FUSED_PUBI_CPB(!CPU_Flags_Z(&f));
+        CORE_NEXT();
+
+    CORE_FUSED_CASE(PUA_PUB_ADS_POA)
+        CORE_FUSED_ENTER(PUA_PUB_ADS_POA, PUA, 4, CORE_CYCLES(PUB) + CORE_CYCLES(ADS) + CORE_CYCLES(POA), s - 4, s - 1);
+
+        CORE_PUSH_SHORT(a);
+        CORE_FUSED_SPLIT(3, CORE_CYCLES(PUB) + CORE_CYCLES(ADS) + CORE_CYCLES(POA));
+
+        i += 1;
+        CORE_PUSH_SHORT(b);
+        CORE_FUSED_SPLIT(2, CORE_CYCLES(ADS) + CORE_CYCLES(POA));
+
+        i += 1;
+        shortA = CPU_Core_ADS(&f, b, a);
+        s += 2;
+        CORE_SET_SHORT(s, shortA);
+        CORE_FUSED_SPLIT(1, CORE_CYCLES(POA));
+
+        i += 1;
+        a = shortA;
+        s += 2;
+
+        CORE_NEXT();
+
+#define CORE_FUSED_IPB_ANB(condition) do {              \
+        address = decoded->target;                      \
+                                                        \
+        port = CORE_FETCH_BYTE();                       \
+        byteA = CORE_IO_READ(port);                     \
+        CORE_PUSH_BYTE(byteA);                          \
+        CORE_FUSED_SPLIT(2, CORE_CYCLES(ANB) + CORE_CYCLES(JMZ)); \
+        CORE_FUSED_PORT(2, CORE_CYCLES(ANB) + CORE_CYCLES(JMZ)); \
+                                                        \
+        i += 1;                                         \
+        byteB = CORE_GET_BYTE(s + 1);                   \
+        s += 1;                                         \
+                                                        \
+        CORE_SET_BYTE(s, CPU_Core_Logic8(&f, byteA & byteB)); \
+        CORE_FUSED_SPLIT(1, CORE_CYCLES(JMZ));          \
+                                                        \
+        i += 3;                                         \
+                                                        \
+        if (condition) i = address;                     \
+    } while (0)
+
+    CORE_FUSED_CASE(IPB_ANB_JMZ)
+        CORE_FUSED_ENTER(IPB_ANB_JMZ, IPB, 3, CORE_CYCLES(ANB) + CORE_CYCLES(JMZ), s - 1, s);
+        CORE_FUSED_IPB_ANB(CPU_Flags_Z(&f));
+        CORE_NEXT();
+
+    CORE_FUSED_CASE(IPB_ANB_JMNZ)
+        CORE_FUSED_ENTER(IPB_ANB_JMNZ, IPB, 3, CORE_CYCLES(ANB) + CORE_CYCLES(JMNZ), s - 1, s);
+        CORE_FUSED_IPB_ANB(!CPU_Flags_Z(&f));
+        CORE_NEXT();
+
+#undef CORE_FUSED_PUBI_CPB
+#undef CORE_FUSED_IPB_ANB
+
+#if CPU_DISPATCH != CPU_DISPATCH_THREADED
+        }
+    }
+#endif
+
+CPU_Core_Done:
+    // Invalidate decoded instructions overwritten by the last instruction and carry on, unless an interrupt is ready
+    if (paused) {
+        if (codeWrite) {
+            CPU_CodeWrite(codeWriteAddress);
+            CPU_CodeWrite(codeWriteAddress + 1);
+
+            codeWrite = 0;
+        }
+
+        paused = 0;
+        stackPage = CORE_STACK_NONE;
+        remaining = pausedRemaining;
+
+        if (!CPU_BATCH_DONE()) {
+#if CPU_DISPATCH == CPU_DISPATCH_THREADED
+            CORE_NEXT();
+#else
+            goto CPU_Core_Dispatch;
+#endif
+        }
+    }
+
+    // Store the locals back into the CPU state
+    cpu->a.value = a;
+    cpu->b.value = b;
+    cpu->s.value = s;
+    cpu->i.value = i;
+
+    cpu->flags = f;
+
+    cpu->cycles = cycles;
+
+    return count - remaining;
+}
+
+#undef CORE_FETCH_BYTE
+#undef CORE_FETCH_SHORT
+#undef CORE_GET_BYTE
+#undef CORE_GET_SHORT
+#undef CORE_SET_BYTE
+#undef CORE_SET_SHORT
+#undef CORE_CODE_WRITE
+#undef CORE_PAUSE
+#undef CORE_PUSH_BYTE
+#undef CORE_POP_BYTE
+#undef CORE_PUSH_SHORT
+#undef CORE_POP_SHORT
+#undef CORE_CASE
+#undef CORE_FUSED_CASE
+#undef CORE_SINGLE
+#undef CORE_FUSED_ENTER
+#undef CORE_FUSED_SPLIT
+#undef CORE_FUSED_PORT
+#undef CORE_DEFAULT
+#undef CORE_NEXT
+#undef CORE_DECODE
+
+#endif
+
+#endif
+
+
+/*
+    Profiler
+
+    Built in with CPU_PROFILE set, when CPU_Run steps every instruction
+    through CPU_Execute so each one is seen, in place of the fast core or
+    translated code. The I/O module times the port handlers.
+*/
+
+#if CPU_PROFILE
+// CPU profile struct
+typedef struct cpu_profile_s {
+    // Number of times each opcode was executed
+    unsigned long long opcodeHits[256];
+
+    // Number of instructions executed at each address
+    unsigned long long addressHits[MEMORY_SIZE];
+} CPUProfile;
+
+// Number of opcodes and addresses shown in the profile report
+#define CPU_PROFILE_REPORT_COUNT 20
+
+// Counts the indices being sorted refer to
+static THREAD_LOCAL const unsigned long long *CPU_PROFILE_SORT_COUNTS = NULL;
+
+// Function to compare two indices by descending count
+static int CPU_Profile_Compare(const void *a, const void *b) {
+    unsigned long long countA = CPU_PROFILE_SORT_COUNTS[*(const unsigned *)a];
+    unsigned long long countB = CPU_PROFILE_SORT_COUNTS[*(const unsigned *)b];
+
+    return (countA < countB) - (countA > countB);
+}
+
+// Function to sort the indices of counts by descending count, returning how many are non - zero
+static unsigned CPU_Profile_Sort(const unsigned long long *counts, unsigned *indices, unsigned length) {
+    unsigned used = 0;
+
+    for (unsigned i = 0; i < length; i++)
+        if (counts[i]) indices[used++] = i;
+
+    CPU_PROFILE_SORT_COUNTS = counts;
+    qsort(indices, used, sizeof(unsigned), CPU_Profile_Compare);
+
+    return used;
+}
+#endif
+
+CPUContext *CPU_CreateContext(void) {
+    CPUContext *context = calloc(1, sizeof(CPUContext));
+
+    if (!context) {
+        printf("Error: Failed to allocate CPU context\n");
+
+        return NULL;
+    }
+
+#if CPU_DISPATCH != CPU_DISPATCH_TABLE
+    // The decoded instruction cache is only used by the fast core
+    context->decoded = calloc(MEMORY_SIZE, sizeof(CPUDecoded));
+    context->fusedHits = calloc(CPU_FUSED_COUNT, sizeof(unsigned long long));
+
+    if (!context->decoded || !context->fusedHits) {
+        printf("Error: Failed to allocate CPU decoded instruction cache\n");
+
+        CPU_DestroyContext(context);
+
+        return NULL;
+    }
+#endif
+
+#if CPU_PROFILE
+    context->profile = calloc(1, sizeof(CPUProfile));
+
+    if (!context->profile) {
+        printf("Error: Failed to allocate CPU profile\n");
+
+        CPU_DestroyContext(context);
+
+        return NULL;
+    }
+#endif
+
+    return context;
+}
+
+void CPU_DestroyContext(CPUContext *context) {
+    if (!context) return;
+
+    if (cpu == context) cpu = NULL;
+
+    free(context->decoded);
+    free(context->fusedHits);
+    free(context->profile);
+    free(context);
+}
+
+void CPU_BindContext(CPUContext *context) {
+    cpu = context;
+}
+
 int CPU_Init(void) {
     // Reset registers
-    cpu.a.value = 0;
-    cpu.b.value = 0;
-    cpu.s.value = 0;
-    cpu.i.value = 0;
-    cpu.f.value = 0;
+    cpu->a.value = 0;
+    cpu->b.value = 0;
+    cpu->s.value = 0;
+    cpu->i.value = 0;
+    CPU_Util_SetFlags(0);
+
+    cpu->cycles = 0;
+    cpu->interrupt = 0;
+    cpu->stop = 0;
+
+    cpu->pages = Memory_GetPageTable();
+
+#if CPU_DISPATCH != CPU_DISPATCH_TABLE
+    // Clear the decoded instruction cache
+    memset(cpu->decoded, 0, MEMORY_SIZE * sizeof(CPUDecoded));
+
+    Memory_RegisterCodeWrite(CPU_CodeWrite);
+#endif
 
     return 1;
 }
 
+unsigned CPU_GetCycleCost(unsigned char opcode) {
+    return CPU_OPCODE_CYCLES[opcode];
+}
+
+const char *CPU_GetName(unsigned char opcode) {
+    return CPU_OPCODE_NAME[opcode];
+}
+
+unsigned CPU_GetMaxCycleCost(void) {
+    unsigned cost = 0;
+
+    for (int i = 0; i < 256; i++)
+        if (CPU_OPCODE_CYCLES[i] > cost) cost = CPU_OPCODE_CYCLES[i];
+
+    // Accepting an interrupt costs as much as the SI instruction on top of the next one
+    return cost + CPU_OPCODE_CYCLES[CPU_OPCODE_SIA];
+}
+
 void CPU_Execute(void) {
-    CPU_Opcode[CPU_FetchByte()]();
+#if CPU_PROFILE
+    cpu->profile->addressHits[cpu->i.value]++;
+#endif
+
+    unsigned char opcode = CPU_FetchByte();
+
+#if CPU_PROFILE
+    cpu->profile->opcodeHits[opcode]++;
+#endif
+
+    cpu->cycles += CPU_OPCODE_CYCLES[opcode];
+
+    CPU_Opcode[opcode]();
+}
+
+// Function to accept the next interrupt, waking the CPU and calling the vector of its line
+static void CPU_Interrupt(void) {
+    int line = Interrupt_Acknowledge();
+
+    if (line < 0) return;
+
+    cpu->f.h = 0;
+    cpu->f.i = 0;
+
+    cpu->cycles += CPU_OPCODE_CYCLES[CPU_OPCODE_SIA];
+
+    CPU_Util_CA(line << 3);
+}
+
+// Function to execute up to count CPU instructions, stopping early on halt, once an interrupt would be accepted or when a device stops the batch
+static unsigned CPU_RunBatch(unsigned count) {
+#if !CPU_PROFILE
+    // Translated code takes over when an image is translated ahead of time or the JIT compiler is enabled
+    if (AOT_IsEnabled()) return AOT_Run(count);
+    if (JIT_IsEnabled()) return JIT_Run(count);
+#endif
+
+#if CPU_DISPATCH != CPU_DISPATCH_TABLE && !CPU_PROFILE
+    if (cpu->f.h) return 0;
+
+    return CPU_Core_Run(count);
+#else
+    unsigned executed = 0;
+
+    // Execute instructions until the budget is used up, the CPU halts, an interrupt is let through or a device stops the batch
+    while (executed < count && !cpu->f.h && !CPU_BATCH_DONE()) {
+        CPU_Execute();
+
+        executed++;
+    }
+
+    return executed;
+#endif
+}
+
+unsigned CPU_Run(unsigned count) {
+    unsigned executed = 0;
+
+    cpu->stop = 0;
+
+    // Interrupts are accepted between batches, the batch ending early when an instruction lets one through
+    do {
+        if (CPU_INTERRUPT_READY()) CPU_Interrupt();
+
+        executed += CPU_RunBatch(count - executed);
+    } while (executed < count && CPU_INTERRUPT_READY() && !cpu->stop);
+
+    return executed;
+}
+
+int CPU_IsHalted(void) {
+    return cpu->f.h;
+}
+
+void CPU_Wake(void) {
+    cpu->f.h = 0;
+}
+
+void CPU_Stop(void) {
+    cpu->stop = 1;
+}
+
+int CPU_IsStopped(void) {
+    return cpu->stop;
+}
+
+void CPU_SetInterruptRequest(int request) {
+    cpu->interrupt = !!request;
+}
+
+int CPU_IsInterruptReady(void) {
+    return CPU_INTERRUPT_READY();
+}
+
+void CPU_GetState(CPUState *state) {
+    state->a = cpu->a.value;
+    state->b = cpu->b.value;
+    state->s = cpu->s.value;
+    state->i = cpu->i.value;
+    state->f = CPU_Util_GetFlags();
+    state->cycles = cpu->cycles;
+}
+
+void CPU_SetState(const CPUState *state) {
+    cpu->a.value = state->a;
+    cpu->b.value = state->b;
+    cpu->s.value = state->s;
+    cpu->i.value = state->i;
+    CPU_Util_SetFlags(state->f);
+    cpu->cycles = state->cycles;
+}
+
+void CPU_PrintFusionReport(void) {
+#if CPU_DISPATCH != CPU_DISPATCH_TABLE
+    printf("Fused instructions:\n");
+
+    for (int i = 0; i < CPU_FUSED_COUNT; i++)
+        printf("    %-20s %llu\n", CPU_FUSED_NAME[i], cpu->fusedHits[i]);
+#else
+    printf("Fused instructions: not used by the opcode table dispatch\n");
+#endif
+}
+
+void CPU_PrintProfileReport(void) {
+#if CPU_PROFILE
+    // Sorted indices of the opcodes, then of the addresses, kept off the stack and out of shared state
+    unsigned *indices = malloc(MEMORY_SIZE * sizeof(unsigned));
+    unsigned long long total = 0;
+
+    if (!indices) {
+        printf("Error: Failed to allocate profile report\n");
+
+        return;
+    }
+
+    for (int i = 0; i < 256; i++)
+        total += cpu->profile->opcodeHits[i];
+
+    if (!total) total = 1;
+
+    unsigned used = CPU_Profile_Sort(cpu->profile->opcodeHits, indices, 256);
+
+    printf("Most executed opcodes:\n");
+
+    for (unsigned i = 0; i < used && i < CPU_PROFILE_REPORT_COUNT; i++) {
+        unsigned opcode = indices[i];
+        const char *name = CPU_OPCODE_NAME[opcode] ? CPU_OPCODE_NAME[opcode] : "??";
+        unsigned long long hits = cpu->profile->opcodeHits[opcode];
+
+        printf("    %02X %-6s %16llu %6.2f%%\n", opcode, name, hits, hits * 100.0 / total);
+    }
+
+    used = CPU_Profile_Sort(cpu->profile->addressHits, indices, MEMORY_SIZE);
+
+    printf("Most executed addresses:\n");
+
+    for (unsigned i = 0; i < used && i < CPU_PROFILE_REPORT_COUNT; i++) {
+        unsigned address = indices[i];
+        unsigned long long hits = cpu->profile->addressHits[address];
+
+        printf("    %04X %16llu %6.2f%%\n", address, hits, hits * 100.0 / total);
+    }
+
+    printf("I/O handlers:\n");
+
+    for (int port = 0; port < 256; port++) {
+        unsigned long long calls, time;
+
+        IO_GetProfile(port, &calls, &time);
+
+        if (calls) printf("    port %02X %12llu calls %12llu us\n", port, calls, time / 1000);
+    }
+
+    free(indices);
+#else
+    printf("Profile: not built in, build with CPU_PROFILE=1\n");
+#endif
+}
+
+int CPU_WriteProfile(const char *path) {
+#if CPU_PROFILE
+    FILE *file = fopen(path, "w");
+
+    if (!file) {
+        printf("Error: Failed to open %s\n", path);
+
+        return 0;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        if (cpu->profile->opcodeHits[i])
+            fprintf(file, "opcode,%d,%s,%llu\n", i, CPU_OPCODE_NAME[i] ? CPU_OPCODE_NAME[i] : "??", cpu->profile->opcodeHits[i]);
+    }
+
+    for (int i = 0; i < MEMORY_SIZE; i++) {
+        if (cpu->profile->addressHits[i])
+            fprintf(file, "address,%d,%llu\n", i, cpu->profile->addressHits[i]);
+    }
+
+    for (int port = 0; port < 256; port++) {
+        unsigned long long calls, time;
+
+        IO_GetProfile(port, &calls, &time);
+
+        if (calls) fprintf(file, "port,%d,%llu,%llu\n", port, calls, time);
+    }
+
+    fclose(file);
+
+    return 1;
+#else
+    printf("Error: Profile not built in, build with CPU_PROFILE=1\n");
+
+    return 0;
+#endif
 }
\ No newline at end of file
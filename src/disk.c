@@ -1,6 +1,15 @@
 #include "disk.h"
 
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "interrupt.h"
+#include "io.h"
 #include "memory.h"
+#include "utils.h"
 
 /*
     Disk size constants
@@ -26,17 +35,19 @@
 #define DISK_SECTOR_SIZE_MASK (DISK_SECTOR_SIZE - 1)
 #define DISK_SECTOR_SIZE_SHIFT 8
 
+#define DISK_SECTOR_COUNT (DISK_SIZE >> DISK_SECTOR_SIZE_SHIFT)
+
 // Macro to get byte from disk
-#define DISK_GETBYTE(addr) DISK[((addr) & DISK_SIZE_MASK)]
+#define DISK_GETBYTE(addr) disk->image[((addr) & DISK_SIZE_MASK)]
 
 // Macro to set byte in disk
-#define DISK_SETBYTE(addr, byte) DISK[((addr) & DISK_SIZE_MASK)] = (byte)
+#define DISK_SETBYTE(addr, byte) disk->image[((addr) & DISK_SIZE_MASK)] = (byte)
 
-// Disk data array
-static unsigned char DISK[DISK_SIZE];
+// Disk context struct
+struct disk_context_s {
+    // Disk data array
+    unsigned char image[DISK_SIZE];
 
-// Disk struct
-static struct {
     // Memory address buffer and data ports
     union {
         struct {
@@ -66,45 +77,68 @@ static struct {
 
     // Number of bytes to read / write
     unsigned byteCount;
-} disk;
+
+    // Dirty flag of each sector, set when written since the last clear, and not part of the state
+    unsigned char dirty[DISK_SECTOR_COUNT];
+};
+
+// Size of the disk state, everything in the context up to the dirty flags
+#define DISK_STATE_SIZE offsetof(DiskContext, dirty)
+
+// Offset and size of the controller registers in the disk state, everything after the image
+#define DISK_REGISTERS_OFFSET offsetof(DiskContext, memoryAddress)
+#define DISK_REGISTERS_SIZE (DISK_STATE_SIZE - DISK_REGISTERS_OFFSET)
+
+// Disk context bound to the calling thread
+static THREAD_LOCAL DiskContext *disk = NULL;
 
 // Disk command port write function
-static void Disk_CommandPortWrite(unsigned char value) {
+static void Disk_CommandPortWrite(void *user, unsigned char value) {
     switch (value) {
         case DISK_COMMAND_ENABLE_INTERRUPTS:
-            disk.status.intEnable = 1;
+            disk->status.intEnable = 1;
             break;
 
         case DISK_COMMAND_DISABLE_INTERRUPTS:
-            disk.status.intEnable = 0;
+            disk->status.intEnable = 0;
             break;
 
         case DISK_COMMAND_GET_DISK_NUMBER:
-            disk.data.lo = 0;
-            disk.data.hi = 0;
+            disk->data.lo = 0;
+            disk->data.hi = 0;
 
             break;
 
         case DISK_COMMAND_SET_START_SECTOR:
-            disk.diskAddress = disk.data.lo << DISK_SECTOR_SIZE_SHIFT;
+            disk->diskAddress = disk->data.lo << DISK_SECTOR_SIZE_SHIFT;
             break;
 
         case DISK_COMMAND_SET_MEMORY_ADDRESS:
-            disk.memoryAddress.value = disk.data.value;
+            disk->memoryAddress.value = disk->data.value;
             break;
 
         case DISK_COMMAND_SET_SECTOR_COUNT:
-            disk.sectorCount = disk.data.lo;
+            disk->sectorCount = disk->data.lo;
             break;
 
         case DISK_COMMAND_READ_SECTORS:
-            disk.status.operation = DISK_OPERATION_READ;
-            disk.byteCount = disk.sectorCount << DISK_SECTOR_SIZE_SHIFT;
+            disk->status.operation = DISK_OPERATION_READ;
+            disk->byteCount = disk->sectorCount << DISK_SECTOR_SIZE_SHIFT;
+            disk->status.ready = !disk->byteCount;
+
+            // The transfer follows the virtual clock from here, so the machine has to update it as the clock passes each device period
+            if (disk->byteCount) CPU_Stop();
+
             break;
 
         case DISK_COMMAND_WRITE_SECTORS:
-            disk.status.operation = DISK_OPERATION_WRITE;
-            disk.byteCount = disk.sectorCount << DISK_SECTOR_SIZE_SHIFT;
+            disk->status.operation = DISK_OPERATION_WRITE;
+            disk->byteCount = disk->sectorCount << DISK_SECTOR_SIZE_SHIFT;
+            disk->status.ready = !disk->byteCount;
+
+            // The transfer follows the virtual clock from here, so the machine has to update it as the clock passes each device period
+            if (disk->byteCount) CPU_Stop();
+
             break;
 
         default:
@@ -114,31 +148,29 @@ static void Disk_CommandPortWrite(unsigned char value) {
 
 // Disk data port functions
 
-static unsigned char Disk_DataLoPortRead(void) { return disk.data.lo; }
-static unsigned char Disk_DataHiPortRead(void) { return disk.data.hi; }
+static unsigned char Disk_DataLoPortRead(void *user) { return disk->data.lo; }
+static unsigned char Disk_DataHiPortRead(void *user) { return disk->data.hi; }
 
-static void Disk_DataLoPortWrite(unsigned char value) { disk.data.lo = value; }
-static void Disk_DataHiPortWrite(unsigned char value) { disk.data.hi = value; }
+static void Disk_DataLoPortWrite(void *user, unsigned char value) { disk->data.lo = value; }
+static void Disk_DataHiPortWrite(void *user, unsigned char value) { disk->data.hi = value; }
 
 // Disk status port read function
-static unsigned char Disk_StatusPortRead(void) { return disk.status.value; }
+static unsigned char Disk_StatusPortRead(void *user) { return disk->status.value; }
 
 // Function to read bytes from disk to memory
 static void Disk_ReadByte(void) {
-    disk.status.ready = !disk.byteCount;
+    Memory_SetByte(disk->memoryAddress.value++, DISK_GETBYTE(disk->diskAddress++));
 
-    Memory_SetByte(disk.memoryAddress.value++, DISK_GETBYTE(disk.diskAddress++));
-
-    disk.byteCount--;
+    disk->byteCount--;
 }
 
 // Function to write sectors from memory to disk
 static void Disk_WriteByte(void) {
-    disk.status.ready = !disk.byteCount;
+    disk->dirty[(disk->diskAddress & DISK_SIZE_MASK) >> DISK_SECTOR_SIZE_SHIFT] = 1;
 
-    DISK_SETBYTE(disk.diskAddress++, Memory_GetByte(disk.memoryAddress.value++));
+    DISK_SETBYTE(disk->diskAddress++, Memory_GetByte(disk->memoryAddress.value++));
 
-    disk.byteCount--;
+    disk->byteCount--;
 }
 
 // Disk operation function pointer array
@@ -147,11 +179,48 @@ static void (*Disk_Operation[2])(void) = {
     Disk_WriteByte
 };
 
+DiskContext *Disk_CreateContext(void) {
+    DiskContext *context = calloc(1, sizeof(DiskContext));
+
+    if (!context) {
+        printf("Error: Failed to allocate disk context\n");
+
+        return NULL;
+    }
+
+    // The image starts out dirty, as it was never checkpointed
+    memset(context->dirty, 1, DISK_SECTOR_COUNT);
+
+    return context;
+}
+
+void Disk_DestroyContext(DiskContext *context) {
+    if (disk == context) disk = NULL;
+
+    free(context);
+}
+
+void Disk_BindContext(DiskContext *context) {
+    disk = context;
+}
+
 int Disk_Init(void) {
     // Disable interrupts and ready the disk
-    disk.status.intEnable = 0;
-    disk.status.ready = 1;
-    
+    disk->status.intEnable = 0;
+    disk->status.ready = 1;
+
+    IO_RegisterWrite(DISK_PORT_COMMAND, Disk_CommandPortWrite, NULL);
+
+    IO_RegisterRead(DISK_PORT_DATA_LO, Disk_DataLoPortRead, NULL);
+    IO_RegisterRead(DISK_PORT_DATA_HI, Disk_DataHiPortRead, NULL);
+    IO_RegisterRead(DISK_PORT_STATUS, Disk_StatusPortRead, NULL);
+
+    IO_RegisterWrite(DISK_PORT_DATA_LO, Disk_DataLoPortWrite, NULL);
+    IO_RegisterWrite(DISK_PORT_DATA_HI, Disk_DataHiPortWrite, NULL);
+
+    // Mark the disk ports internal, the image being part of the machine
+    for (int port = DISK_PORT_COMMAND; port <= DISK_PORT_STATUS; port++) IO_SetInternal(port);
+
     return 1;
 }
 
@@ -163,10 +232,118 @@ int Disk_LoadImage(const char *path) {
     return 1;
 }
 
+unsigned Disk_GetSize(void) {
+    return DISK_SIZE;
+}
+
+const unsigned char *Disk_GetData(void) {
+    return disk->image;
+}
+
+unsigned Disk_GetStateSize(void) {
+    return DISK_STATE_SIZE;
+}
+
+// The context holds no pointers, so the state is the context itself, transfers in flight included
+void Disk_SaveState(unsigned char *buffer) {
+    memcpy(buffer, disk, DISK_STATE_SIZE);
+}
+
+// Function to replace a sector of the image, marking it dirty if it changes
+static void Disk_LoadSector(unsigned sector, const unsigned char *data) {
+    unsigned char *image = &disk->image[sector << DISK_SECTOR_SIZE_SHIFT];
+
+    if (!memcmp(image, data, DISK_SECTOR_SIZE)) return;
+
+    memcpy(image, data, DISK_SECTOR_SIZE);
+
+    disk->dirty[sector] = 1;
+}
+
+void Disk_LoadState(const unsigned char *buffer) {
+    for (unsigned sector = 0; sector < DISK_SECTOR_COUNT; sector++)
+        Disk_LoadSector(sector, buffer + (sector << DISK_SECTOR_SIZE_SHIFT));
+
+    memcpy((unsigned char *) disk + DISK_REGISTERS_OFFSET, buffer + DISK_REGISTERS_OFFSET, DISK_REGISTERS_SIZE);
+}
+
+void Disk_GetDirtyMap(unsigned char *map) {
+    memset(map, 0, DISK_DIRTY_MAP_SIZE);
+
+    for (unsigned sector = 0; sector < DISK_SECTOR_COUNT; sector++)
+        if (disk->dirty[sector]) map[sector >> 3] |= 1 << (sector & 7);
+}
+
+void Disk_ClearDirtyMap(void) {
+    memset(disk->dirty, 0, DISK_SECTOR_COUNT);
+}
+
+unsigned Disk_GetDeltaSize(void) {
+    unsigned size = DISK_DIRTY_MAP_SIZE + DISK_REGISTERS_SIZE;
+
+    for (unsigned sector = 0; sector < DISK_SECTOR_COUNT; sector++)
+        if (disk->dirty[sector]) size += DISK_SECTOR_SIZE;
+
+    return size;
+}
+
+void Disk_SaveDelta(unsigned char *buffer) {
+    Disk_GetDirtyMap(buffer);
+    buffer += DISK_DIRTY_MAP_SIZE;
+
+    for (unsigned sector = 0; sector < DISK_SECTOR_COUNT; sector++) {
+        if (!disk->dirty[sector]) continue;
+
+        memcpy(buffer, &disk->image[sector << DISK_SECTOR_SIZE_SHIFT], DISK_SECTOR_SIZE);
+        buffer += DISK_SECTOR_SIZE;
+    }
+
+    memcpy(buffer, (unsigned char *) disk + DISK_REGISTERS_OFFSET, DISK_REGISTERS_SIZE);
+}
+
+int Disk_CheckDelta(const unsigned char *buffer, unsigned size, unsigned *length) {
+    *length = DISK_DIRTY_MAP_SIZE + DISK_REGISTERS_SIZE;
+
+    if (size < *length) return 0;
+
+    for (unsigned sector = 0; sector < DISK_SECTOR_COUNT; sector++)
+        if (buffer[sector >> 3] & (1 << (sector & 7))) *length += DISK_SECTOR_SIZE;
+
+    return *length <= size;
+}
+
+unsigned Disk_LoadDelta(const unsigned char *buffer) {
+    const unsigned char *map = buffer;
+    const unsigned char *data = buffer + DISK_DIRTY_MAP_SIZE;
+
+    for (unsigned sector = 0; sector < DISK_SECTOR_COUNT; sector++) {
+        if (!(map[sector >> 3] & (1 << (sector & 7)))) continue;
+
+        Disk_LoadSector(sector, data);
+        data += DISK_SECTOR_SIZE;
+    }
+
+    memcpy((unsigned char *) disk + DISK_REGISTERS_OFFSET, data, DISK_REGISTERS_SIZE);
+    data += DISK_REGISTERS_SIZE;
+
+    return data - buffer;
+}
+
+int Disk_IsBusy(void) {
+    return !disk->status.ready;
+}
+
 void Disk_Update(void) {
     // Return if the disk is not busy (reading or writing)
-    if (disk.status.ready) return;
+    if (disk->status.ready) return;
 
     // Perform the current disk operation
-    Disk_Operation[disk.status.operation]();
+    Disk_Operation[disk->status.operation]();
+
+    if (disk->byteCount) return;
+
+    // The transfer is done, raise its completion interrupt if enabled
+    disk->status.ready = 1;
+
+    if (disk->status.intEnable) Interrupt_Raise(1 << INTERRUPT_LINE_DISK);
 }
\ No newline at end of file
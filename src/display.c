@@ -1,22 +1,50 @@
 #include "display.h"
 
-#include <SDL3/SDL.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef DISPLAY_HEADLESS
+#include <SDL3/SDL.h>
+#endif
 
+#include "blit.h"
 #include "io.h"
 #include "font.h"
 #include "memory.h"
+#include "utils.h"
+
+#ifdef DISPLAY_HEADLESS
+// Minimum and clamp macros, standing in for the SDL ones
+#define SDL_min(x, y) ((x) < (y) ? (x) : (y))
+#define SDL_clamp(x, a, b) ((x) < (a) ? (a) : (x) > (b) ? (b) : (x))
 
-// The window
-static SDL_Window *WINDOW = NULL;
+// Rectangle struct, standing in for the SDL one
+typedef struct {
+    int x, y, w, h;
+} SDL_Rect;
+#endif
 
-// The window surface
-static SDL_Surface *SURFACE = NULL;
+// Row length of the guest framebuffer in pixels
+#define DISPLAY_PITCH WINDOW_W
 
 // Display mode macros
 #define DISPLAY_MODE_COUNT 8
 #define DISPLAY_MODE_COUNT_MASK 7
 
+// Pixel mode row sizes, in bytes of video memory
+#define DISPLAY_PIXEL_ROW_SIZE_MONO 40
+#define DISPLAY_PIXEL_ROW_SIZE_16 160
+
+// Text mode size limits, in rows and in bytes of video memory
+#define DISPLAY_TEXT_ROWS_MAX 50
+#define DISPLAY_TEXT_ROW_SIZE_MAX 160
+#define DISPLAY_TEXT_MEMORY_MAX 8000
+
+// Glyph cache size in tiles and hash table size, a power of 2
+#define DISPLAY_GLYPH_COUNT 1024
+#define DISPLAY_GLYPH_HASH_SIZE 2048
+
 // Display memory size array
 static unsigned short DISPLAY_MEMORY_SIZE[DISPLAY_MODE_COUNT] = {
     1000,   // 40 x 25, monochrome
@@ -74,8 +102,8 @@ static unsigned DISPLAY_PALETTE[16] = {
     0x00FFFFFF,
 };
 
-// Display struct
-static struct {
+// Display registers struct, saved with machine snapshots
+typedef struct display_registers_s {
     // Starting address of video memory
     unsigned short base;
 
@@ -103,118 +131,162 @@ static struct {
 
         unsigned value;
     } data, cursorIndex;
-} display;
-
-// Function to set a pixel on the display
-static void Display_SetPixel(unsigned x, unsigned y, unsigned pixel) {
-    x = SDL_min(x, WINDOW_W - 1);
-    y = SDL_min(y, WINDOW_H - 1);
+} DisplayRegisters;
 
-    unsigned *pixels = (unsigned*) SURFACE->pixels + y * SURFACE->w + x;
+// Text mode struct, holding the video memory the framebuffer shows in text mode
+typedef struct display_text_s {
+    // Video memory of the cells as last drawn
+    unsigned char cells[DISPLAY_TEXT_MEMORY_MAX];
 
-    *pixels = pixel;
-}
-
-// Function to set a double - sized pixel on the display
-static void Display_SetPixelDouble(unsigned x, unsigned y, unsigned pixel) {
-    x = SDL_min(x, WINDOW_HW - 1) << 1;
-    y = SDL_min(y, WINDOW_HH - 1) << 1;
-
-    unsigned *pixels = (unsigned*) SURFACE->pixels + y * SURFACE->w + x;
+    // Mode and base the cells were drawn with
+    DisplayMode mode;
+    unsigned short base;
 
-    for (int i = 0; i < 2; i++) {
-        for (int j = 0; j < 2; j++) {
-            *(pixels + j) = pixel;
-        }
+    // Set while the framebuffer shows the cells, clear to draw every cell next frame
+    int valid;
+} DisplayText;
+
+// Glyph tile struct, a character pre - rendered in two colors
+typedef struct display_glyph_s {
+    // Colors the tile was rendered with, background first, so a palette change misses the cache
+    unsigned colors[2];
+
+    // Character index
+    unsigned char c;
+
+    // Next tile in the same hash bucket and the tiles used just before and after it, -1 for none
+    short next, older, newer;
+
+    // Pixels, FONT_CHAR_SIZE rows of as many pixels
+    unsigned pixels[FONT_CHAR_SIZE * FONT_CHAR_SIZE];
+} DisplayGlyph;
+
+// Glyph cache struct, evicting the least recently used tile when full
+typedef struct display_glyph_cache_s {
+    DisplayGlyph tiles[DISPLAY_GLYPH_COUNT];
+
+    // First tile of each hash bucket, -1 for none
+    short buckets[DISPLAY_GLYPH_HASH_SIZE];
+
+    // Most and least recently used tiles, -1 for none
+    short newest, oldest;
+
+    // Number of tiles in use
+    unsigned count;
+} DisplayGlyphCache;
+
+// Display context struct
+struct display_context_s {
+    DisplayRegisters registers;
+    DisplayText text;
+    DisplayGlyphCache glyphs;
+
+    // Rectangles of the guest framebuffer drawn this frame and their count, at most one per row of text
+    SDL_Rect damage[DISPLAY_TEXT_ROWS_MAX];
+    int damageCount;
+
+    // The guest framebuffer, drawn at the resolution of the display mode
+    unsigned framebuffer[WINDOW_W * WINDOW_H];
+#ifdef DISPLAY_HEADLESS
+    // The window - sized framebuffer the guest framebuffer is scaled into instead of a window
+    unsigned scaled[WINDOW_W * WINDOW_H];
+#else
+    // The window and its renderer
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+
+    // Streaming texture the guest framebuffer is uploaded into, scaled to the window by the renderer
+    SDL_Texture *texture;
+#endif
+};
 
-        pixels += SURFACE->w;
-    }
-}
+// Display context bound to the calling thread
+static THREAD_LOCAL DisplayContext *display = NULL;
 
 // Command port write function
-static void Display_CommandPortWrite(unsigned char byte) {
+static void Display_CommandPortWrite(void *user, unsigned char byte) {
     switch (byte) {
         case DISPLAY_COMMAND_GET_MEMORY_SIZE:
-            display.data.value = DISPLAY_MEMORY_SIZE[display.mode];
+            display->registers.data.value = DISPLAY_MEMORY_SIZE[display->registers.mode];
             break;
 
         case DISPLAY_COMMAND_GET_WIDTH:
-            display.data.value = DISPLAY_WIDTH[display.mode];
+            display->registers.data.value = DISPLAY_WIDTH[display->registers.mode];
             break;
 
         case DISPLAY_COMMAND_GET_HEIGHT:
-            display.data.value = DISPLAY_HEIGHT[display.mode];
+            display->registers.data.value = DISPLAY_HEIGHT[display->registers.mode];
             break;
 
 
         case DISPLAY_COMMAND_GET_MODE:
-            display.data.lo = display.mode;
-            display.data.hi = display.mode;
+            display->registers.data.lo = display->registers.mode;
+            display->registers.data.hi = display->registers.mode;
 
             break;
 
         case DISPLAY_COMMAND_GET_CURSOR_INDEX:
-            display.data.value = display.cursorIndex.value;
+            display->registers.data.value = display->registers.cursorIndex.value;
             break;
 
         case DISPLAY_COMMAND_GET_CURSOR_X:
-            display.data.lo = display.cursorX;
-            display.data.hi = display.cursorX;
+            display->registers.data.lo = display->registers.cursorX;
+            display->registers.data.hi = display->registers.cursorX;
 
             break;
 
         case DISPLAY_COMMAND_GET_CURSOR_Y:
-            display.data.lo = display.cursorY;
-            display.data.hi = display.cursorY;
+            display->registers.data.lo = display->registers.cursorY;
+            display->registers.data.hi = display->registers.cursorY;
 
             break;
 
         case DISPLAY_COMMAND_GET_CURSOR_TYPE:
-            display.data.lo = display.cursorType.value;
-            display.data.hi = display.cursorType.value;
+            display->registers.data.lo = display->registers.cursorType.value;
+            display->registers.data.hi = display->registers.cursorType.value;
 
             break;
 
 
         case DISPLAY_COMMAND_SET_MODE:
-            display.mode = display.data.lo & DISPLAY_MODE_COUNT_MASK;
+            display->registers.mode = display->registers.data.lo & DISPLAY_MODE_COUNT_MASK;
             break;
 
         case DISPLAY_COMMAND_SET_CURSOR_INDEX:
             // Set cursor x
-            display.cursorX = display.data.value % DISPLAY_WIDTH[display.mode];
+            display->registers.cursorX = display->registers.data.value % DISPLAY_WIDTH[display->registers.mode];
 
             // Set cursor y
-            display.cursorY = display.data.value / DISPLAY_WIDTH[display.mode];
-            display.cursorY %= DISPLAY_HEIGHT[display.mode];
+            display->registers.cursorY = display->registers.data.value / DISPLAY_WIDTH[display->registers.mode];
+            display->registers.cursorY %= DISPLAY_HEIGHT[display->registers.mode];
 
             // Set index
-            display.cursorIndex.value = display.cursorY * DISPLAY_WIDTH[display.mode] + display.cursorX;
+            display->registers.cursorIndex.value = display->registers.cursorY * DISPLAY_WIDTH[display->registers.mode] + display->registers.cursorX;
 
             break;
 
         case DISPLAY_COMMAND_SET_CURSOR_X:
-            display.cursorX = display.data.lo % DISPLAY_WIDTH[display.mode];
-            display.cursorIndex.value = display.cursorY * DISPLAY_WIDTH[display.mode] + display.cursorX;
+            display->registers.cursorX = display->registers.data.lo % DISPLAY_WIDTH[display->registers.mode];
+            display->registers.cursorIndex.value = display->registers.cursorY * DISPLAY_WIDTH[display->registers.mode] + display->registers.cursorX;
 
             break;
 
         case DISPLAY_COMMAND_SET_CURSOR_Y:
-            display.cursorY = display.data.lo % DISPLAY_HEIGHT[display.mode];
-            display.cursorIndex.value = display.cursorY * DISPLAY_WIDTH[display.mode] + display.cursorX;
+            display->registers.cursorY = display->registers.data.lo % DISPLAY_HEIGHT[display->registers.mode];
+            display->registers.cursorIndex.value = display->registers.cursorY * DISPLAY_WIDTH[display->registers.mode] + display->registers.cursorX;
 
             break;
         
         case DISPLAY_COMMAND_SET_CURSOR_POS:
-            display.cursorX = display.data.lo % DISPLAY_WIDTH[display.mode];
-            display.cursorY = display.data.hi % DISPLAY_HEIGHT[display.mode];
+            display->registers.cursorX = display->registers.data.lo % DISPLAY_WIDTH[display->registers.mode];
+            display->registers.cursorY = display->registers.data.hi % DISPLAY_HEIGHT[display->registers.mode];
 
-            display.cursorIndex.value = display.cursorY * DISPLAY_WIDTH[display.mode] + display.cursorX;
+            display->registers.cursorIndex.value = display->registers.cursorY * DISPLAY_WIDTH[display->registers.mode] + display->registers.cursorX;
 
             break;
 
         case DISPLAY_COMMAND_SET_CURSOR_TYPE:
-            display.cursorType.value = display.data.lo;
+            display->registers.cursorType.value = display->registers.data.lo;
             break;
 
         default:
@@ -223,172 +295,234 @@ static void Display_CommandPortWrite(unsigned char byte) {
 }
 
 // Data port functions
-static unsigned char Display_DataLoRead(void) { return display.data.lo; }
-static unsigned char Display_DataHiRead(void) { return display.data.hi; }
+static unsigned char Display_DataLoRead(void *user) { return display->registers.data.lo; }
+static unsigned char Display_DataHiRead(void *user) { return display->registers.data.hi; }
 
-static void Display_DataLoWrite(unsigned char byte) { display.data.lo = byte; }
-static void Display_DataHiWrite(unsigned char byte) { display.data.hi = byte; }
+static void Display_DataLoWrite(void *user, unsigned char byte) { display->registers.data.lo = byte; }
+static void Display_DataHiWrite(void *user, unsigned char byte) { display->registers.data.hi = byte; }
 
-// Function to draw a character
-static void Display_DrawChar(unsigned x, unsigned y, unsigned char c, unsigned char color) {
-    c = SDL_clamp(c - ' ', 0, FONT_CHAR_COUNT - 1);
+// Function to get the hash bucket of a glyph
+static unsigned Display_HashGlyph(unsigned char c, const unsigned *colors) {
+    unsigned hash = c * 0x9E3779B1u;
 
-    unsigned long long charData = FONT_DATA[c];
+    hash ^= colors[0] * 0x85EBCA77u;
+    hash ^= colors[1] * 0xC2B2AE3Du;
 
-    unsigned colors[2] = {
-        DISPLAY_PALETTE[color >> 4],
-        DISPLAY_PALETTE[color & 0x0F],
-    };
+    return (hash ^ hash >> 16) & (DISPLAY_GLYPH_HASH_SIZE - 1);
+}
 
-    for (unsigned char i = 0; i < 8; i++)
-        for (unsigned char j = 0; j < 8; j++) {
-            Display_SetPixel(x + j, y + i, colors[charData & 1]);
+// Function to take a tile out of the recently used list
+static void Display_UnlinkGlyph(short index) {
+    DisplayGlyph *glyph = &display->glyphs.tiles[index];
 
-            charData >>= 1;
-        }
+    if (glyph->older >= 0) display->glyphs.tiles[glyph->older].newer = glyph->newer;
+    else display->glyphs.oldest = glyph->newer;
+
+    if (glyph->newer >= 0) display->glyphs.tiles[glyph->newer].older = glyph->older;
+    else display->glyphs.newest = glyph->older;
 }
 
-// Function to draw a character (double size)
-static void Display_DrawCharDouble(unsigned x, unsigned y, unsigned char c, unsigned char color) {
-    c = SDL_clamp(c - ' ', 0, FONT_CHAR_COUNT - 1);
+// Function to put a tile at the most recently used end of the list
+static void Display_TouchGlyph(short index) {
+    DisplayGlyph *glyph = &display->glyphs.tiles[index];
+
+    glyph->older = display->glyphs.newest;
+    glyph->newer = -1;
+
+    if (display->glyphs.newest >= 0) display->glyphs.tiles[display->glyphs.newest].newer = index;
+    else display->glyphs.oldest = index;
+
+    display->glyphs.newest = index;
+}
+
+// Function to evict the least recently used tile, returning it
+static short Display_EvictGlyph(void) {
+    short index = display->glyphs.oldest;
+    DisplayGlyph *glyph = &display->glyphs.tiles[index];
 
-    unsigned long long charData = FONT_DATA[c];
+    short *link = &display->glyphs.buckets[Display_HashGlyph(glyph->c, glyph->colors)];
+
+    while (*link != index) link = &display->glyphs.tiles[*link].next;
+
+    *link = glyph->next;
+
+    Display_UnlinkGlyph(index);
+
+    return index;
+}
+
+// Function to render a character into a tile
+static void Display_RenderGlyph(DisplayGlyph *glyph) {
+    unsigned long long charData = FONT_DATA[glyph->c];
+
+    for (unsigned i = 0; i < FONT_CHAR_SIZE * FONT_CHAR_SIZE; i++) {
+        glyph->pixels[i] = glyph->colors[charData & 1];
+
+        charData >>= 1;
+    }
+}
+
+// Function to get the tile of a character in a color, rendering it on a miss
+static const unsigned *Display_GetGlyph(unsigned char c, unsigned char color) {
+    c = SDL_clamp(c - ' ', 0, FONT_CHAR_COUNT - 1);
 
     unsigned colors[2] = {
         DISPLAY_PALETTE[color >> 4],
         DISPLAY_PALETTE[color & 0x0F],
     };
 
-    for (unsigned char i = 0; i < 8; i++)
-        for (unsigned char j = 0; j < 8; j++) {
-            Display_SetPixelDouble(x + j, y + i, colors[charData & 1]);
+    unsigned bucket = Display_HashGlyph(c, colors);
 
-            charData >>= 1;
+    for (short index = display->glyphs.buckets[bucket]; index >= 0; index = display->glyphs.tiles[index].next) {
+        DisplayGlyph *glyph = &display->glyphs.tiles[index];
+
+        if (glyph->c != c || glyph->colors[0] != colors[0] || glyph->colors[1] != colors[1]) continue;
+
+        if (display->glyphs.newest != index) {
+            Display_UnlinkGlyph(index);
+            Display_TouchGlyph(index);
         }
-}
 
-// Function to draw display in text mode, normal sized, monochrome
-static void Display_DrawTextMono(void) {
-    unsigned short address = display.base;
+        return glyph->pixels;
+    }
 
-    unsigned drawX, drawY = 0;
+    short index = display->glyphs.count < DISPLAY_GLYPH_COUNT ? (short)display->glyphs.count++ : Display_EvictGlyph();
+    DisplayGlyph *glyph = &display->glyphs.tiles[index];
 
-    for (int i = 0; i < DISPLAY_HEIGHT[display.mode]; i++) {
-        drawX = 0;
+    glyph->colors[0] = colors[0];
+    glyph->colors[1] = colors[1];
+    glyph->c = c;
 
-        for (int j = 0; j < DISPLAY_WIDTH[display.mode]; j++) {
-            Display_DrawChar(drawX, drawY, Memory_GetByte(address++), 0x08);
+    Display_RenderGlyph(glyph);
 
-            drawX += FONT_CHAR_SIZE;
-        }
+    glyph->next = display->glyphs.buckets[bucket];
+    display->glyphs.buckets[bucket] = index;
 
-        drawY += FONT_CHAR_SIZE;
-    }
+    Display_TouchGlyph(index);
+
+    return glyph->pixels;
 }
 
-// Function to draw display in text mode, double sized, monochrome
-static void Display_DrawTextDoubleMono(void) {
-    unsigned short address = display.base;
+// Function to draw a character, copying its tile a row at a time
+static void Display_DrawChar(unsigned x, unsigned y, unsigned char c, unsigned char color) {
+    const unsigned *tile = Display_GetGlyph(c, color);
+    unsigned *pixels = display->framebuffer + y * DISPLAY_PITCH + x;
 
-    unsigned drawX, drawY = 0;
+    for (unsigned i = 0; i < FONT_CHAR_SIZE; i++) {
+        memcpy(pixels, tile, FONT_CHAR_SIZE * sizeof(unsigned));
 
-    for (int i = 0; i < DISPLAY_HEIGHT[display.mode]; i++) {
-        drawX = 0;
+        pixels += DISPLAY_PITCH;
+        tile += FONT_CHAR_SIZE;
+    }
+}
 
-        for (int j = 0; j < DISPLAY_WIDTH[display.mode]; j++) {
-            Display_DrawCharDouble(drawX, drawY, Memory_GetByte(address++), 0x08);
+// Function to read video memory, whole runs of a page at a time where the page is RAM
+static void Display_ReadVideo(unsigned char *buffer, unsigned short address, unsigned size) {
+    const MemoryPageTable *pages = Memory_GetPageTable();
 
-            drawX += FONT_CHAR_SIZE;
-        }
+    while (size) {
+        const unsigned char *page = pages->read[address >> MEMORY_PAGE_SIZE_SHIFT];
+        unsigned run = SDL_min(size, MEMORY_PAGE_SIZE - (address & MEMORY_PAGE_SIZE_MASK));
 
-        drawY += FONT_CHAR_SIZE;
+        if (page) memcpy(buffer, page + (address & MEMORY_PAGE_SIZE_MASK), run);
+        else for (unsigned i = 0; i < run; i++) buffer[i] = Memory_ReadSlow(address + i);
+
+        buffer += run;
+        address += run;
+        size -= run;
     }
 }
 
-// Function to draw display in text mode, normal sized, 16 colors
-static void Display_DrawText16(void) {
-    unsigned short address = display.base;
+// Function to draw the cells of text mode that changed since the last frame
+// Each cell is cellSize bytes, a character and for 16 colors an attribute
+static void Display_DrawText(unsigned cellSize) {
+    unsigned width = DISPLAY_WIDTH[display->registers.mode];
+    unsigned rowSize = width * cellSize;
+
+    unsigned short address = display->registers.base;
+
+    // Cells drawn with another mode or base show nothing worth keeping
+    if (display->text.mode != display->registers.mode || display->text.base != display->registers.base) display->text.valid = 0;
 
-    unsigned drawX, drawY = 0;
+    for (unsigned i = 0; i < DISPLAY_HEIGHT[display->registers.mode]; i++) {
+        unsigned char row[DISPLAY_TEXT_ROW_SIZE_MAX];
+        unsigned char *shadow = display->text.cells + i * rowSize;
 
-    for (int i = 0; i < DISPLAY_HEIGHT[display.mode]; i++) {
-        drawX = 0;
+        Display_ReadVideo(row, address, rowSize);
+        address += rowSize;
 
-        for (int j = 0; j < DISPLAY_WIDTH[display.mode]; j++) {
-            unsigned char c = Memory_GetByte(address++);
-            unsigned char color = Memory_GetByte(address++);
+        // Most rows of most frames are untouched, so whole rows are compared first
+        if (display->text.valid && !memcmp(row, shadow, rowSize)) continue;
 
-            Display_DrawChar(drawX, drawY, c, color);
+        unsigned first = width, last = 0;
 
-            drawX += FONT_CHAR_SIZE;
+        for (unsigned j = 0; j < width; j++) {
+            const unsigned char *cell = row + j * cellSize;
+
+            if (display->text.valid && !memcmp(cell, shadow + j * cellSize, cellSize)) continue;
+
+            Display_DrawChar(j * FONT_CHAR_SIZE, i * FONT_CHAR_SIZE, cell[0], cellSize > 1 ? cell[1] : 0x08);
+
+            first = SDL_min(first, j);
+            last = j;
         }
 
-        drawY += FONT_CHAR_SIZE;
+        memcpy(shadow, row, rowSize);
+
+        // One rectangle covers the changed cells of the row
+        display->damage[display->damageCount++] = (SDL_Rect){ first * FONT_CHAR_SIZE, i * FONT_CHAR_SIZE, (last - first + 1) * FONT_CHAR_SIZE, FONT_CHAR_SIZE };
     }
+
+    display->text.mode = display->registers.mode;
+    display->text.base = display->registers.base;
+    display->text.valid = 1;
 }
 
-// Function to draw display in text mode, double sized, 16 colors
-static void Display_DrawTextDouble16(void) {
-    unsigned short address = display.base;
+// Function to draw display in text mode, monochrome
+static void Display_DrawTextMono(void) {
+    Display_DrawText(1);
+}
 
-    unsigned drawX, drawY = 0;
+// Function to draw display in text mode, 16 colors
+static void Display_DrawText16(void) {
+    Display_DrawText(2);
+}
 
-    for (int i = 0; i < DISPLAY_HEIGHT[display.mode]; i++) {
-        drawX = 0;
+// Function to draw display in pixel mode, a row of video memory of rowSize bytes at a time, expanded by convert
+static void Display_DrawPixel(void (*convert)(unsigned *, const unsigned char *, unsigned), unsigned rowSize) {
+    unsigned char row[DISPLAY_PIXEL_ROW_SIZE_16];
+    unsigned short address = display->registers.base;
 
-        for (int j = 0; j < DISPLAY_WIDTH[display.mode]; j++) {
-            unsigned char c = Memory_GetByte(address++);
-            unsigned char color = Memory_GetByte(address++);
+    unsigned *pixels = display->framebuffer;
 
-            Display_DrawCharDouble(drawX, drawY, c, color);
+    for (int i = 0; i < DISPLAY_HEIGHT[display->registers.mode]; i++) {
+        Display_ReadVideo(row, address, rowSize);
+        address += rowSize;
 
-            drawX += FONT_CHAR_SIZE;
-        }
+        convert(pixels, row, rowSize);
 
-        drawY += FONT_CHAR_SIZE;
+        pixels += DISPLAY_PITCH;
     }
 }
 
+// Pixel mode row conversion functions
+static void Display_ConvertMono(unsigned *pixels, const unsigned char *bytes, unsigned count) { Blit_ExpandMono(pixels, bytes, count, 0xABCDEF); }
+static void Display_Convert16(unsigned *pixels, const unsigned char *bytes, unsigned count) { Blit_Expand16(pixels, bytes, count, DISPLAY_PALETTE); }
+
 // Function to draw display in pixel mode, monochrome
 static void Display_DrawPixelMono(void) {
-    unsigned char pixel;
-    unsigned char shift;
-    unsigned pixelIndex = 0;
-    unsigned address;
-
-    for (int i = 0; i < DISPLAY_HEIGHT[display.mode]; i++) {
-        for (int j = 0; j < DISPLAY_WIDTH[display.mode]; j++) {
-            address = (pixelIndex >> FONT_CHAR_SIZE_SHIFT) + display.base;
-            shift = pixelIndex++ & FONT_CHAR_SIZE_MASK;
-            pixel = (Memory_GetByte(address) >> shift) & 1;
-
-            Display_SetPixelDouble(j, i, 0xABCDEF & -pixel);
-        }
-    }
+    Display_DrawPixel(Display_ConvertMono, DISPLAY_PIXEL_ROW_SIZE_MONO);
 }
 
 // Function to draw display in pixel mode, 16 colors
 static void Display_DrawPixel16(void) {
-    unsigned char pixel;
-    unsigned char shift;
-    unsigned pixelIndex = 0;
-    unsigned address;
-
-    for (int i = 0; i < DISPLAY_HEIGHT[display.mode]; i++) {
-        for (int j = 0; j < DISPLAY_WIDTH[display.mode]; j++) {
-            address = (pixelIndex >> 1) + display.base;
-            shift = 4 & -(pixelIndex++ & 1);
-            pixel = (Memory_GetByte(address) >> shift) & 15;
-
-            Display_SetPixelDouble(j, i, DISPLAY_PALETTE[pixel]);
-        }
-    }
+    Display_DrawPixel(Display_Convert16, DISPLAY_PIXEL_ROW_SIZE_16);
 }
 
 // Display drawing functions array
 static void (*Display_DrawFunction[DISPLAY_MODE_COUNT])(void) = {
-    Display_DrawTextDoubleMono,
-    Display_DrawTextDouble16,
+    Display_DrawTextMono,
+    Display_DrawText16,
     Display_DrawTextMono,
     Display_DrawText16,
     Display_DrawPixelMono,
@@ -397,47 +531,177 @@ static void (*Display_DrawFunction[DISPLAY_MODE_COUNT])(void) = {
     Display_DrawPixel16,
 };
 
-int Display_Init(void) {
-    WINDOW = SDL_CreateWindow(
-        "Stinky Stacky Virtual Machine",
-        WINDOW_W, WINDOW_H,
-        0
-    );
+// Function to get the resolution of the guest framebuffer in the current mode
+static void Display_GetResolution(unsigned *width, unsigned *height) {
+    *width = DISPLAY_WIDTH[display->registers.mode];
+    *height = DISPLAY_HEIGHT[display->registers.mode];
+
+    // Text modes are measured in cells
+    if (display->registers.mode < DISPLAY_MODE_PIXEL_320_200_2) {
+        *width *= FONT_CHAR_SIZE;
+        *height *= FONT_CHAR_SIZE;
+    }
+}
+
+DisplayContext *Display_CreateContext(void) {
+    DisplayContext *context = calloc(1, sizeof(DisplayContext));
+
+    if (!context) printf("Error: Failed to allocate display context\n");
+
+    return context;
+}
+
+void Display_DestroyContext(DisplayContext *context) {
+    if (display == context) display = NULL;
+
+    free(context);
+}
 
-    if (WINDOW == NULL) {
+void Display_BindContext(DisplayContext *context) {
+    display = context;
+}
+
+int Display_Init(void) {
+#ifndef DISPLAY_HEADLESS
+    if (!SDL_CreateWindowAndRenderer("Stinky Stacky Virtual Machine", WINDOW_W, WINDOW_H, SDL_WINDOW_RESIZABLE, &display->window, &display->renderer)) {
         printf("Error creating window: %s\n", SDL_GetError());
 
         return 0;
     }
 
-    SURFACE = SDL_GetWindowSurface(WINDOW);
-    
+    // The renderer scales frames to the window, keeping their aspect ratio with bars
+    SDL_SetRenderLogicalPresentation(display->renderer, WINDOW_W, WINDOW_H, SDL_LOGICAL_PRESENTATION_LETTERBOX);
+
+    // Large enough for the largest mode, smaller modes use its top left corner
+    display->texture = SDL_CreateTexture(display->renderer, SDL_PIXELFORMAT_XRGB8888, SDL_TEXTUREACCESS_STREAMING, WINDOW_W, WINDOW_H);
+
+    if (display->texture == NULL) {
+        printf("Error creating texture: %s\n", SDL_GetError());
+
+        return 0;
+    }
+
+    SDL_SetTextureScaleMode(display->texture, SDL_SCALEMODE_NEAREST);
+#endif
+    // Pick the pixel conversion kernels for the host
+    Blit_Init();
+
+    // Start with an empty glyph cache
+    memset(display->glyphs.buckets, 0xFF, sizeof(display->glyphs.buckets));
+
+    display->glyphs.newest = display->glyphs.oldest = -1;
+    display->glyphs.count = 0;
+
     // Register IO commands
-    IO_RegisterWrite(DISPLAY_PORT_COMMAND, Display_CommandPortWrite);
+    IO_RegisterWrite(DISPLAY_PORT_COMMAND, Display_CommandPortWrite, NULL);
+
+    IO_RegisterRead(DISPLAY_PORT_DATA_LO, Display_DataLoRead, NULL);
+    IO_RegisterRead(DISPLAY_PORT_DATA_HI, Display_DataHiRead, NULL);
 
-    IO_RegisterRead(DISPLAY_PORT_DATA_LO, Display_DataLoRead);
-    IO_RegisterRead(DISPLAY_PORT_DATA_HI, Display_DataHiRead);
+    IO_RegisterWrite(DISPLAY_PORT_DATA_LO, Display_DataLoWrite, NULL);
+    IO_RegisterWrite(DISPLAY_PORT_DATA_HI, Display_DataHiWrite, NULL);
 
-    IO_RegisterWrite(DISPLAY_PORT_DATA_LO, Display_DataLoWrite);
-    IO_RegisterWrite(DISPLAY_PORT_DATA_HI, Display_DataHiWrite);
+    // The display only reads guest memory, so replays run it instead of stubbing out mode and cursor changes
+    for (int port = DISPLAY_PORT_COMMAND; port <= DISPLAY_PORT_DATA_HI; port++) IO_SetInternal(port);
+
+    // Save the display registers with machine snapshots
+    if (!IO_RegisterState(&display->registers, sizeof(DisplayRegisters))) return 0;
 
     // Set initial display mode to 40 x 20 monochrome text mode
-    display.mode = DISPLAY_MODE_TEXT_40_30_2;
+    display->registers.mode = DISPLAY_MODE_TEXT_40_30_2;
 
     return 1;
 }
 
+// Function to draw the display in the current mode, filling the damage rectangles with what changed
+static void Display_DrawMode(void) {
+    display->damageCount = 0;
+
+    Display_DrawFunction[display->registers.mode]();
+
+    // Pixel modes draw the whole frame and leave nothing of text mode on it
+    if (display->registers.mode >= DISPLAY_MODE_PIXEL_320_200_2) {
+        display->damage[display->damageCount++] = (SDL_Rect){ 0, 0, DISPLAY_WIDTH[display->registers.mode], DISPLAY_HEIGHT[display->registers.mode] };
+
+        display->text.valid = 0;
+    }
+}
+
+#ifdef DISPLAY_HEADLESS
+// Function to scale what changed in the guest framebuffer up into the window - sized one
+static void Display_Scale(void) {
+    unsigned width, height;
+
+    Display_GetResolution(&width, &height);
+
+    unsigned scaleX = WINDOW_W / width;
+    unsigned scaleY = WINDOW_H / height;
+
+    for (int i = 0; i < display->damageCount; i++) {
+        SDL_Rect *rect = &display->damage[i];
+
+        for (int y = rect->y; y < rect->y + rect->h; y++) {
+            const unsigned *source = display->framebuffer + y * DISPLAY_PITCH;
+            unsigned *pixels = display->scaled + y * scaleY * WINDOW_W;
+
+            for (int x = rect->x; x < rect->x + rect->w; x++)
+                for (unsigned j = 0; j < scaleX; j++) pixels[x * scaleX + j] = source[x];
+
+            for (unsigned j = 1; j < scaleY; j++)
+                memcpy(pixels + j * WINDOW_W + rect->x * scaleX, pixels + rect->x * scaleX, rect->w * scaleX * sizeof(unsigned));
+        }
+    }
+}
+#endif
+
 void Display_Draw(void) {
-    SDL_LockSurface(SURFACE);
+    Display_DrawMode();
+
+#ifdef DISPLAY_HEADLESS
+    Display_Scale();
+#else
+    // A static screen presents nothing, the window keeps showing the last frame
+    if (!display->damageCount) return;
 
-    Display_DrawFunction[display.mode]();
+    // Only what changed is uploaded, at the resolution of the guest
+    for (int i = 0; i < display->damageCount; i++) {
+        SDL_Rect *rect = &display->damage[i];
 
-    SDL_UnlockSurface(SURFACE);
-    SDL_UpdateWindowSurface(WINDOW);
+        SDL_UpdateTexture(display->texture, rect, display->framebuffer + rect->y * DISPLAY_PITCH + rect->x, DISPLAY_PITCH * sizeof(unsigned));
+    }
+
+    unsigned width, height;
+
+    Display_GetResolution(&width, &height);
+
+    SDL_FRect source = { 0, 0, width, height };
+
+    SDL_RenderClear(display->renderer);
+    SDL_RenderTexture(display->renderer, display->texture, &source, NULL);
+    SDL_RenderPresent(display->renderer);
+#endif
+}
+
+void Display_Invalidate(void) {
+    display->text.valid = 0;
+}
 
-    SDL_Delay(16);
+const unsigned *Display_GetFramebuffer(void) {
+#ifdef DISPLAY_HEADLESS
+    return display->scaled;
+#else
+    return NULL;
+#endif
 }
 
 void Display_Quit(void) {
-    SDL_DestroyWindow(WINDOW);
+#ifndef DISPLAY_HEADLESS
+    SDL_DestroyTexture(display->texture);
+    SDL_DestroyRenderer(display->renderer);
+    SDL_DestroyWindow(display->window);
+
+    display->texture = NULL;
+    display->renderer = NULL;
+    display->window = NULL;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include <ctype.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "vm.h"
+
+/*
+    Fork server
+
+    Boots a machine once, up to a marker, then serves jobs from the booted
+    state. Every job runs in a fork()ed child, which shares the machine's
+    memory, disk and translated code with the server copy - on - write, so
+    the per - job setup cost is one fork. POSIX only.
+
+    The marker is either a write to a control port (-m) or reaching an
+    address (-p). The boot is single - stepped so the machine stops exactly
+    on the marker.
+
+    Requests are read one per line, from stdin or from each connection to
+    a Unix socket (-s):
+
+        <instructions> [<address>=<hex bytes> ...]
+
+    The child writes the bytes into memory, runs until halt or until the
+    instructions are used up, and answers with one JSON line. A request
+    with a malformed count or patch is answered with {"status":"error"}
+    without running.
+*/
+
+// Number of instructions executed between budget and halt checks
+#define FORKSERVER_SLICE_SIZE 10000
+
+// Maximum length of a request line
+#define FORKSERVER_LINE_SIZE 65536
+
+// Marker port, -1 for none
+static int MARKER_PORT = -1;
+
+// Marker address, -1 for none
+static long MARKER_ADDRESS = -1;
+
+// Maximum number of instructions to boot for
+static unsigned long long BOOT_BUDGET = 1000000000;
+
+// Address the image is loaded at
+static unsigned short LOAD_ADDRESS = 0;
+
+// Run the CPU through the JIT compiler flag
+static int USE_JIT = 0;
+
+// Set once the guest writes to the marker port
+static int MARKER_HIT = 0;
+
+// The booted machine
+static VM *MACHINE = NULL;
+
+// Marker port write function
+static void ForkServer_MarkerWrite(void *user, unsigned char value) {
+    MARKER_HIT = 1;
+}
+
+// Function to boot the machine up to the marker, returning 0 if it halts or runs out of instructions first
+static int ForkServer_Boot(void) {
+    CPUState state;
+
+    for (unsigned long long executed = 0; executed < BOOT_BUDGET; executed++) {
+        if (MARKER_ADDRESS >= 0) {
+            VM_GetState(MACHINE, &state);
+
+            if (state.i == MARKER_ADDRESS) return 1;
+        }
+
+        if (!VM_Run(MACHINE, 1)) break;
+
+        if (MARKER_HIT) return 1;
+    }
+
+    printf("Error: Machine did not reach the marker\n");
+
+    return 0;
+}
+
+// Function to write the bytes of one <address>=<hex bytes> patch into memory, returning 0 if it is malformed
+static int ForkServer_ApplyPatch(const char *patch) {
+    char *end;
+    unsigned long address = strtoul(patch, &end, 0);
+
+    // The address needs digits of its own, and a whole number of bytes has to follow it
+    if (end == patch || !isxdigit((unsigned char)patch[0]) || address >= MEMORY_SIZE || *end++ != '=') return 0;
+
+    size_t length = strlen(end);
+
+    if (length % 2) return 0;
+
+    for (size_t i = 0; i < length; i++) {
+        if (!isxdigit((unsigned char)end[i])) return 0;
+    }
+
+    // Only write once the whole patch is known to be good
+    while (*end) {
+        char hex[3] = { end[0], end[1], 0 };
+        unsigned char value = strtoul(hex, NULL, 16);
+
+        VM_WriteMemory(MACHINE, address++ & MEMORY_SIZE_MASK, &value, 1);
+        end += 2;
+    }
+
+    return 1;
+}
+
+// Function to run one job in a child process and write its result line to a file descriptor
+static void ForkServer_RunJob(char *request, int output) {
+    char result[512];
+    unsigned long long start = VM_GetTime();
+    unsigned long long executed = 0;
+    char *token = strtok(request, " \t");
+    char *end = NULL;
+
+    // A line of only blanks has no instruction count to parse
+    unsigned long long budget = token ? strtoull(token, &end, 0) : 0;
+
+    if (!token || *end) {
+        snprintf(result, sizeof(result), "{\"status\":\"error\"}\n");
+        write(output, result, strlen(result));
+
+        return;
+    }
+
+    // Patch memory with the request's variant
+    while ((token = strtok(NULL, " \t"))) {
+        if (!ForkServer_ApplyPatch(token)) {
+            snprintf(result, sizeof(result), "{\"status\":\"error\"}\n");
+            write(output, result, strlen(result));
+
+            return;
+        }
+    }
+
+    while (!VM_IsHalted(MACHINE) && executed < budget) {
+        unsigned long long slice = budget - executed;
+
+        executed += VM_Run(MACHINE, slice < FORKSERVER_SLICE_SIZE ? slice : FORKSERVER_SLICE_SIZE);
+    }
+
+    unsigned long long stop = VM_GetTime();
+
+    CPUState state;
+
+    VM_GetState(MACHINE, &state);
+
+    snprintf(result, sizeof(result),
+        "{\"status\":\"%s\",\"instructions\":%llu,\"runtime_us\":%llu,"
+        "\"a\":%u,\"b\":%u,\"s\":%u,\"i\":%u,\"f\":%u,"
+        "\"memory_hash\":\"%016llx\",\"disk_hash\":\"%016llx\"}\n",
+        VM_IsHalted(MACHINE) ? "halt" : "budget", executed, stop - start,
+        state.a, state.b, state.s, state.i, state.f,
+        VM_HashMemory(MACHINE), VM_HashDisk(MACHINE));
+
+    write(output, result, strlen(result));
+}
+
+// Function to serve requests read from one file descriptor, answering on another
+static void ForkServer_Serve(int input, int output) {
+    static char line[FORKSERVER_LINE_SIZE];
+    FILE *file = fdopen(input, "r");
+
+    if (!file) return;
+
+    while (fgets(line, sizeof(line), file)) {
+        // Strip the line ending and skip blank lines
+        line[strcspn(line, "\r\n")] = 0;
+
+        if (!line[0]) continue;
+
+        pid_t child = fork();
+
+        if (child < 0) {
+            printf("Error: Failed to fork job\n");
+            break;
+        }
+
+        // The child runs the job on its copy - on - write view of the booted machine
+        if (!child) {
+            ForkServer_RunJob(line, output);
+            _exit(0);
+        }
+
+        int status;
+
+        waitpid(child, &status, 0);
+
+        // Answer for jobs that crashed, so the client never waits on a missing line
+        if (!WIFEXITED(status)) {
+            static const char crashed[] = "{\"status\":\"crash\"}\n";
+
+            write(output, crashed, sizeof(crashed) - 1);
+        }
+    }
+
+    fclose(file);
+}
+
+// Function to serve each connection to a Unix socket in its own process
+static int ForkServer_Listen(const char *path) {
+    struct sockaddr_un address = { 0 };
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (server < 0 || strlen(path) >= sizeof(address.sun_path)) {
+        printf("Error: Failed to create socket %s\n", path);
+
+        return 0;
+    }
+
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+
+    if (bind(server, (struct sockaddr *)&address, sizeof(address)) || listen(server, 16)) {
+        printf("Error: Failed to listen on %s\n", path);
+        close(server);
+
+        return 0;
+    }
+
+    // Connection processes are never waited on
+    signal(SIGCHLD, SIG_IGN);
+
+    printf("Listening on %s\n", path);
+    fflush(stdout);
+
+    for (;;) {
+        int connection = accept(server, NULL, NULL);
+
+        if (connection < 0) continue;
+
+        pid_t child = fork();
+
+        if (!child) {
+            close(server);
+
+            // Jobs are waited on by the connection process
+            signal(SIGCHLD, SIG_DFL);
+
+            ForkServer_Serve(connection, connection);
+            _exit(0);
+        }
+
+        close(connection);
+    }
+
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    const char *imagePath = NULL;
+    const char *socketPath = NULL;
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            MARKER_PORT = strtoul(argv[++i], NULL, 0) & 0xFF;
+        } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            MARKER_ADDRESS = strtoul(argv[++i], NULL, 0) & 0xFFFF;
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            BOOT_BUDGET = strtoull(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            LOAD_ADDRESS = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (!strcmp(argv[i], "-j")) {
+            USE_JIT = 1;
+        } else if (argv[i][0] != '-' && !imagePath) {
+            imagePath = argv[i];
+        } else {
+            imagePath = NULL;
+            break;
+        }
+    }
+
+    if (!imagePath || (MARKER_PORT < 0 && MARKER_ADDRESS < 0)) {
+        printf("Usage: %s (-m marker_port | -p marker_address) [-n boot_instructions] [-a load_address] [-s socket] [-j] image\n", argv[0]);
+
+        return 1;
+    }
+
+    MACHINE = VM_Create();
+    if (!MACHINE) return 1;
+
+    if (USE_JIT && !VM_EnableJIT(MACHINE)) printf("Falling back to the interpreter\n");
+
+    if (MARKER_PORT >= 0) VM_AttachDevice(MACHINE, MARKER_PORT, NULL, ForkServer_MarkerWrite, NULL);
+
+    if (!VM_LoadImage(MACHINE, imagePath, LOAD_ADDRESS) || !ForkServer_Boot()) return 1;
+
+    // Flush before forking so buffered output isn't repeated by the children
+    fflush(stdout);
+
+    int result = 1;
+
+    if (socketPath) result = ForkServer_Listen(socketPath);
+    else ForkServer_Serve(STDIN_FILENO, STDOUT_FILENO);
+
+    VM_Destroy(MACHINE);
+
+    return !result;
+}
\ No newline at end of file
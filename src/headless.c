@@ -0,0 +1,214 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "display.h"
+#include "vm.h"
+
+#ifdef HEADLESS_AOT
+// Image translated by stackvm - aot, linked in by the stackvm-headless-aot target
+extern const AOTImage AOT_IMAGE;
+#endif
+
+/*
+    Headless frontend
+
+    Runs a machine without SDL, for build and test servers. The display
+    device keeps its full port protocol, but only draws into its in - memory
+    framebuffer when a frame is asked for with -o, written out as a PPM.
+    Build with DISPLAY_HEADLESS defined, and with HEADLESS_AOT defined and
+    the output of stackvm - aot linked in to run translated code with -t.
+*/
+
+// Default number of instructions run per VM_Run call
+#define HEADLESS_BATCH_SIZE 10000
+
+// Number of instructions run per VM_Run call, which must not change the result
+static unsigned BATCH_SIZE = HEADLESS_BATCH_SIZE;
+
+// Number of instructions to execute, 0 to run until halted
+static unsigned long long INSTRUCTION_COUNT = 0;
+
+// Address the image is loaded at
+static unsigned short LOAD_ADDRESS = 0;
+
+// Physical memory in KiB for the bank controller, 0 to run without it
+static unsigned MEMORY_KIB = 0;
+
+// Run the CPU through the JIT compiler flag
+static int USE_JIT = 0;
+
+// Run the CPU through the translated image flag
+static int USE_AOT = 0;
+
+// Image to load, NULL to start with empty memory
+static const char *IMAGE_PATH = NULL;
+
+// File to write the final frame to, NULL to never draw
+static const char *FRAME_PATH = NULL;
+
+// I/O log to record to or replay from, NULL for neither
+static const char *RECORD_PATH = NULL;
+static const char *REPLAY_PATH = NULL;
+
+// File to write the profile to, NULL for none
+static const char *PROFILE_PATH = NULL;
+
+// Set by signals to stop the run, or to write the profile and carry on
+static volatile sig_atomic_t STOP_REQUESTED = 0;
+static volatile sig_atomic_t PROFILE_REQUESTED = 0;
+
+// Signal handler function
+static void Headless_Signal(int number) {
+    if (number == SIGINT) STOP_REQUESTED = 1;
+    else PROFILE_REQUESTED = 1;
+}
+
+// Function to write the display framebuffer as a binary PPM
+static int Headless_WriteFrame(const char *path) {
+    FILE *file = fopen(path, "wb");
+
+    if (!file) {
+        printf("Error: Failed to open %s\n", path);
+
+        return 0;
+    }
+
+    Display_Draw();
+
+    const unsigned *pixels = Display_GetFramebuffer();
+
+    fprintf(file, "P6\n%d %d\n255\n", WINDOW_W, WINDOW_H);
+
+    for (unsigned i = 0; i < WINDOW_W * WINDOW_H; i++) {
+        fputc(pixels[i] >> 16, file);
+        fputc(pixels[i] >> 8, file);
+        fputc(pixels[i], file);
+    }
+
+    fclose(file);
+
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            INSTRUCTION_COUNT = strtoull(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            BATCH_SIZE = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            LOAD_ADDRESS = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            FRAME_PATH = argv[++i];
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            RECORD_PATH = argv[++i];
+        } else if (!strcmp(argv[i], "-R") && i + 1 < argc) {
+            REPLAY_PATH = argv[++i];
+        } else if (!strcmp(argv[i], "-P") && i + 1 < argc) {
+            PROFILE_PATH = argv[++i];
+        } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            MEMORY_KIB = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-j")) {
+            USE_JIT = 1;
+        } else if (!strcmp(argv[i], "-t")) {
+            USE_AOT = 1;
+        } else if (argv[i][0] != '-' && !IMAGE_PATH) {
+            IMAGE_PATH = argv[i];
+        } else {
+            printf("Usage: %s [-n instructions] [-s batch_size] [-a load_address] [-o frame.ppm] [-r record.log | -R replay.log] [-P profile.csv] [-m memory_kib] [-j | -t] [image]\n", argv[0]);
+
+            return 1;
+        }
+    }
+
+    // Create the machine, which initializes the CPU, memory, I/O module and disk
+    VM *machine = VM_Create();
+    if (!machine) return 1;
+
+    // Add the bank controller
+    if (MEMORY_KIB && !VM_EnableBanks(machine, MEMORY_KIB * 1024)) return 1;
+
+    // Initialize the JIT compiler, falling back to the interpreter if it fails
+    if (USE_JIT && !VM_EnableJIT(machine)) printf("Falling back to the interpreter\n");
+
+    // Run the translated image, falling back to the interpreter if it isn't linked in
+    if (USE_AOT) {
+#ifdef HEADLESS_AOT
+        if (!VM_EnableAOT(machine, &AOT_IMAGE)) printf("Falling back to the interpreter\n");
+#else
+        printf("Error: Built without a translated image, falling back to the interpreter\n");
+#endif
+    }
+
+    // Initialize the display, which attaches its ports to the bound machine
+    DisplayContext *display = Display_CreateContext();
+    if (!display) return 1;
+
+    Display_BindContext(display);
+    if (!Display_Init()) return 1;
+
+    if (IMAGE_PATH && !VM_LoadImage(machine, IMAGE_PATH, LOAD_ADDRESS)) return 1;
+
+    if (RECORD_PATH && !VM_StartRecording(machine, RECORD_PATH)) return 1;
+    if (REPLAY_PATH && !VM_StartReplay(machine, REPLAY_PATH)) return 1;
+
+    // Stop on Ctrl - C, and write the profile on SIGUSR1 where there is one
+    signal(SIGINT, Headless_Signal);
+#ifdef SIGUSR1
+    signal(SIGUSR1, Headless_Signal);
+#endif
+
+    // Run the CPU in batches, the machine updating its devices as the virtual clock passes
+    unsigned long long executed = 0;
+
+    while (!VM_IsHalted(machine) && !STOP_REQUESTED) {
+        if (PROFILE_REQUESTED && PROFILE_PATH) {
+            VM_Bind(machine);
+            CPU_WriteProfile(PROFILE_PATH);
+        }
+
+        PROFILE_REQUESTED = 0;
+
+        unsigned batch = BATCH_SIZE ? BATCH_SIZE : HEADLESS_BATCH_SIZE;
+
+        if (INSTRUCTION_COUNT) {
+            if (executed >= INSTRUCTION_COUNT) break;
+
+            if (INSTRUCTION_COUNT - executed < batch) batch = INSTRUCTION_COUNT - executed;
+        }
+
+        executed += VM_Run(machine, batch);
+    }
+
+    CPUState state;
+
+    VM_GetState(machine, &state);
+
+    printf("Executed %llu instructions in %llu cycles, %s\n", executed, state.cycles, VM_IsHalted(machine) ? "halted" : "stopped");
+    printf("A=%04X B=%04X S=%04X I=%04X F=%02X\n", state.a, state.b, state.s, state.i, state.f);
+    printf("Memory hash %016llX\n", VM_HashMemory(machine));
+
+    // Draw from the machine that was run, the display reads its memory
+    int result = 1;
+
+    if (PROFILE_PATH) {
+        VM_Bind(machine);
+        CPU_PrintProfileReport();
+        result = CPU_WriteProfile(PROFILE_PATH);
+    }
+
+    if (FRAME_PATH) {
+        VM_Bind(machine);
+        result &= Headless_WriteFrame(FRAME_PATH);
+    }
+
+    VM_Destroy(machine);
+    Display_Quit();
+    Display_DestroyContext(display);
+
+    return !result;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "interrupt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+#include "io.h"
+#include "utils.h"
+
+// Interrupt controller context struct
+struct interrupt_context_s {
+    // Pending and masked lines, one bit per line
+    unsigned char pending;
+    unsigned char mask;
+
+    // Priority of each line
+    unsigned char priority[INTERRUPT_LINE_COUNT];
+};
+
+// Interrupt controller context bound to the calling thread
+static THREAD_LOCAL InterruptContext *interrupt = NULL;
+
+// Function to request an interrupt from the CPU while any unmasked line is pending
+static void Interrupt_Request(void) {
+    CPU_SetInterruptRequest(interrupt->pending & ~interrupt->mask);
+}
+
+// Interrupt controller port functions
+
+static unsigned char Interrupt_PendingPortRead(void *user) { return interrupt->pending; }
+static unsigned char Interrupt_MaskPortRead(void *user) { return interrupt->mask; }
+
+static void Interrupt_PendingPortWrite(void *user, unsigned char value) {
+    interrupt->pending &= ~value;
+    Interrupt_Request();
+}
+
+static void Interrupt_MaskPortWrite(void *user, unsigned char value) {
+    interrupt->mask = value;
+    Interrupt_Request();
+}
+
+static void Interrupt_RaisePortWrite(void *user, unsigned char value) {
+    Interrupt_Raise(value);
+}
+
+static void Interrupt_PriorityPortWrite(void *user, unsigned char value) {
+    interrupt->priority[(value >> 4) & (INTERRUPT_LINE_COUNT - 1)] = value & 7;
+}
+
+InterruptContext *Interrupt_CreateContext(void) {
+    InterruptContext *context = calloc(1, sizeof(InterruptContext));
+
+    if (!context) printf("Error: Failed to allocate interrupt controller context\n");
+
+    return context;
+}
+
+void Interrupt_DestroyContext(InterruptContext *context) {
+    if (interrupt == context) interrupt = NULL;
+
+    free(context);
+}
+
+void Interrupt_BindContext(InterruptContext *context) {
+    interrupt = context;
+}
+
+int Interrupt_Init(void) {
+    // Nothing pending or masked, and every line at the same priority
+    for (int i = 0; i < INTERRUPT_LINE_COUNT; i++) interrupt->priority[i] = 0;
+
+    interrupt->pending = 0;
+    interrupt->mask = 0;
+
+    Interrupt_Request();
+
+    IO_RegisterRead(INTERRUPT_PORT_PENDING, Interrupt_PendingPortRead, NULL);
+    IO_RegisterRead(INTERRUPT_PORT_MASK, Interrupt_MaskPortRead, NULL);
+
+    IO_RegisterWrite(INTERRUPT_PORT_PENDING, Interrupt_PendingPortWrite, NULL);
+    IO_RegisterWrite(INTERRUPT_PORT_MASK, Interrupt_MaskPortWrite, NULL);
+    IO_RegisterWrite(INTERRUPT_PORT_RAISE, Interrupt_RaisePortWrite, NULL);
+    IO_RegisterWrite(INTERRUPT_PORT_PRIORITY, Interrupt_PriorityPortWrite, NULL);
+
+    // Mark the controller ports internal
+    for (int port = INTERRUPT_PORT_PENDING; port <= INTERRUPT_PORT_PRIORITY; port++) IO_SetInternal(port);
+
+    return IO_RegisterState(interrupt, sizeof(InterruptContext));
+}
+
+void Interrupt_Raise(unsigned char lines) {
+    interrupt->pending |= lines;
+    Interrupt_Request();
+}
+
+int Interrupt_Acknowledge(void) {
+    unsigned char ready = interrupt->pending & ~interrupt->mask;
+    int line = -1;
+
+    for (int i = 0; i < INTERRUPT_LINE_COUNT; i++) {
+        if (!(ready & (1 << i))) continue;
+
+        if (line < 0 || interrupt->priority[i] > interrupt->priority[line]) line = i;
+    }
+
+    if (line < 0) return -1;
+
+    interrupt->pending &= ~(1 << line);
+    Interrupt_Request();
+
+    return line;
+}
+
+void Interrupt_Update(void) {
+    Interrupt_Request();
+}
\ No newline at end of file
@@ -1,38 +1,431 @@
 #include "io.h"
 
-// Read function pointers array
-static unsigned char (*IO_READ_FUNPTR[256])(void) = { 0 };
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-// Write function pointers array
-static void (*IO_WRITE_FUNPTR[256])(unsigned char value) = { 0 };
+#include "cpu.h"
+#include "utils.h"
 
 // Default read function
-static unsigned char IO_READ_DEFAULT(void) { return 0; }
+static unsigned char IO_READ_DEFAULT(void *user) { return 0; }
 
 // Default write function
-static void IO_WRITE_DEFAULT(unsigned char value) { return; }
+static void IO_WRITE_DEFAULT(void *user, unsigned char value) { return; }
+
+/*
+    I/O trace format
+
+    header      IO_TRACE_MAGIC and IO_TRACE_VERSION, one byte each
+    records     IO_TRACE_TAG_READ, port, value
+                IO_TRACE_TAG_UPDATE, instructions since the last update as LEB128
+                IO_TRACE_TAG_WAKE, instructions since the last update as LEB128
+
+    Port reads are logged in the order they happen, which a replay of the
+    same code repeats. Device updates happen between CPU runs, so they are
+    logged at their exact instruction count, and a replay makes them happen
+    there however the run is sliced. Wakes from input are device events
+    too, logged and replayed like updates, while a replay ignores the input
+    of its own frontend. Ports of devices whose whole state is
+    part of the machine are neither logged nor stubbed out, as a replay
+    runs them the same way.
+*/
+
+#define IO_TRACE_MAGIC "SVMR"
+#define IO_TRACE_MAGIC_SIZE 4
+#define IO_TRACE_VERSION 2
+
+// Trace record tags
+#define IO_TRACE_TAG_READ 0x00
+#define IO_TRACE_TAG_UPDATE 0x01
+#define IO_TRACE_TAG_WAKE 0x02
+
+// I/O context struct
+struct io_context_s {
+    // Read function pointers array
+    unsigned char (*read[256])(void *user);
+
+    // Write function pointers array
+    void (*write[256])(void *user, unsigned char value);
+
+    // Device data passed to the read and write functions
+    void *readUser[256];
+    void *writeUser[256];
+
+    // Map of ports internal to the machine, which traces leave alone
+    unsigned char internal[IO_PORT_MAP_SIZE];
+
+    // Device state blocks saved with machine snapshots
+    void *state[IO_STATE_COUNT];
+    unsigned stateSize[IO_STATE_COUNT];
+    unsigned stateCount;
+
+    // Trace mode and the log being recorded or replayed
+    IOTrace trace;
+    FILE *traceFile;
+    unsigned char *replay;
+    unsigned replaySize, replayPosition;
+
+    // Position of the next device update record while replaying
+    unsigned updatePosition;
+
+    // Instruction count of the last and, while replaying, the next device update
+    unsigned long long lastUpdate, nextUpdate;
+
+    // Set while replaying when the next device update is a wake
+    unsigned char nextWake;
+#if CPU_PROFILE
+    // Number of handler calls on each port and the nanoseconds spent in them
+    unsigned long long profileCalls[256];
+    unsigned long long profileTime[256];
+#endif
+};
+
+// I/O context bound to the calling thread
+static THREAD_LOCAL IOContext *io = NULL;
+
+// Macro to check if a port is internal to the machine
+#define IO_IS_INTERNAL(port) (io->internal[(port) >> 3] & (1 << ((port) & 7)))
+
+IOContext *IO_CreateContext(void) {
+    IOContext *context = calloc(1, sizeof(IOContext));
+
+    if (!context) printf("Error: Failed to allocate I/O context\n");
+
+    return context;
+}
+
+void IO_DestroyContext(IOContext *context) {
+    if (!context) return;
+
+    if (context->traceFile) fclose(context->traceFile);
+
+    free(context->replay);
+
+    if (io == context) io = NULL;
+
+    free(context);
+}
+
+void IO_BindContext(IOContext *context) {
+    io = context;
+}
 
 int IO_Init(void) {
     for (int i = 0; i < 256; i++) {
-        IO_READ_FUNPTR[i] = IO_READ_DEFAULT;
-        IO_WRITE_FUNPTR[i] = IO_WRITE_DEFAULT;
+        IO_RegisterRead(i, IO_READ_DEFAULT, NULL);
+        IO_RegisterWrite(i, IO_WRITE_DEFAULT, NULL);
+    }
+
+    memset(io->internal, 0, IO_PORT_MAP_SIZE);
+
+    io->stateCount = 0;
+
+    return 1;
+}
+
+void IO_RegisterRead(unsigned char port, unsigned char (*funcptr)(void *user), void *user) {
+    io->read[port] = funcptr;
+    io->readUser[port] = user;
+    io->internal[port >> 3] &= ~(1 << (port & 7));
+}
+
+void IO_RegisterWrite(unsigned char port, void (*funcptr)(void *user, unsigned char value), void *user) {
+    io->write[port] = funcptr;
+    io->writeUser[port] = user;
+    io->internal[port >> 3] &= ~(1 << (port & 7));
+}
+
+void IO_SetInternal(unsigned char port) {
+    io->internal[port >> 3] |= 1 << (port & 7);
+}
+
+int IO_RegisterState(void *data, unsigned size) {
+    if (io->stateCount == IO_STATE_COUNT) {
+        printf("Error: Too many device state blocks\n");
+
+        return 0;
+    }
+
+    io->state[io->stateCount] = data;
+    io->stateSize[io->stateCount] = size;
+    io->stateCount++;
+
+    return 1;
+}
+
+unsigned IO_GetStateCount(void) {
+    return io->stateCount;
+}
+
+void *IO_GetState(unsigned index, unsigned *size) {
+    *size = io->stateSize[index];
+
+    return io->state[index];
+}
+
+void IO_GetPortMaps(unsigned char *readMap, unsigned char *writeMap) {
+    memset(readMap, 0, IO_PORT_MAP_SIZE);
+    memset(writeMap, 0, IO_PORT_MAP_SIZE);
+
+    for (int i = 0; i < 256; i++) {
+        if (io->read[i] != IO_READ_DEFAULT) readMap[i >> 3] |= 1 << (i & 7);
+        if (io->write[i] != IO_WRITE_DEFAULT) writeMap[i >> 3] |= 1 << (i & 7);
+    }
+}
+
+#if CPU_PROFILE
+// Function to get a time in nanoseconds for timing handlers
+static unsigned long long IO_GetTime(void) {
+    struct timespec time;
+
+    timespec_get(&time, TIME_UTC);
+
+    return (unsigned long long)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+#endif
+
+// Function to call the read function of a port, timing it for the profiler
+static inline unsigned char IO_CallRead(unsigned char port) {
+#if CPU_PROFILE
+    unsigned long long start = IO_GetTime();
+    unsigned char value = io->read[port](io->readUser[port]);
+
+    io->profileCalls[port]++;
+    io->profileTime[port] += IO_GetTime() - start;
+
+    return value;
+#else
+    return io->read[port](io->readUser[port]);
+#endif
+}
+
+// Function to call the write function of a port, timing it for the profiler
+static inline void IO_CallWrite(unsigned char port, unsigned char value) {
+#if CPU_PROFILE
+    unsigned long long start = IO_GetTime();
+
+    io->write[port](io->writeUser[port], value);
+
+    io->profileCalls[port]++;
+    io->profileTime[port] += IO_GetTime() - start;
+#else
+    io->write[port](io->writeUser[port], value);
+#endif
+}
+
+// Function to stop a replay that no longer matches the machine, handing over to the devices
+static void IO_ReplayDiverged(void) {
+    printf("Error: Replay diverged at byte %u of the log, continuing with the devices\n", io->replayPosition);
+
+    IO_StopTrace();
+}
+
+// Function to find the next device update of the log past the reads before it, leaving it at ~0 when there are no more
+static void IO_ReplayNextUpdate(void) {
+    unsigned position = io->replayPosition;
+
+    io->nextUpdate = ~0ULL;
+    io->nextWake = 0;
+
+    while (position < io->replaySize && io->replay[position] == IO_TRACE_TAG_READ)
+        position += 3;
+
+    if (position >= io->replaySize) return;
+    if (io->replay[position] != IO_TRACE_TAG_UPDATE && io->replay[position] != IO_TRACE_TAG_WAKE) return;
+
+    io->updatePosition = position;
+    io->nextWake = io->replay[position] == IO_TRACE_TAG_WAKE;
+
+    unsigned long long delta = 0;
+
+    for (unsigned shift = 0; ++position < io->replaySize && shift < 64; shift += 7) {
+        unsigned char byte = io->replay[position];
+
+        delta |= (unsigned long long)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80)) {
+            io->nextUpdate = io->lastUpdate + delta;
+
+            return;
+        }
     }
+}
+
+int IO_StartRecording(const char *path) {
+    IO_StopTrace();
+
+    io->traceFile = fopen(path, "wb");
+
+    if (!io->traceFile) {
+        printf("Error: Failed to open %s\n", path);
+
+        return 0;
+    }
+
+    fwrite(IO_TRACE_MAGIC, 1, IO_TRACE_MAGIC_SIZE, io->traceFile);
+    fputc(IO_TRACE_VERSION, io->traceFile);
+
+    io->trace = IO_TRACE_RECORD;
+    io->lastUpdate = 0;
 
     return 1;
 }
 
-void IO_RegisterRead(unsigned char port, unsigned char (*funcptr)(void)) {
-    IO_READ_FUNPTR[port] = funcptr;
+int IO_StartReplay(const char *path) {
+    IO_StopTrace();
+
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        printf("Error: Failed to open %s\n", path);
+
+        return 0;
+    }
+
+    // Read the whole log up front, so replayed reads cost no file access
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    io->replay = size > 0 ? malloc(size) : NULL;
+
+    if (!io->replay || fread(io->replay, 1, size, file) != (size_t)size || size <= IO_TRACE_MAGIC_SIZE
+        || memcmp(io->replay, IO_TRACE_MAGIC, IO_TRACE_MAGIC_SIZE) || io->replay[IO_TRACE_MAGIC_SIZE] != IO_TRACE_VERSION) {
+        printf("Error: %s is not an I/O trace\n", path);
+
+        fclose(file);
+        free(io->replay);
+        io->replay = NULL;
+
+        return 0;
+    }
+
+    fclose(file);
+
+    io->trace = IO_TRACE_REPLAY;
+    io->replaySize = size;
+    io->replayPosition = IO_TRACE_MAGIC_SIZE + 1;
+    io->lastUpdate = 0;
+
+    IO_ReplayNextUpdate();
+
+    return 1;
+}
+
+void IO_StopTrace(void) {
+    if (io->traceFile) fclose(io->traceFile);
+
+    free(io->replay);
+
+    io->trace = IO_TRACE_NONE;
+    io->traceFile = NULL;
+    io->replay = NULL;
+}
+
+IOTrace IO_GetTraceMode(void) {
+    return io->trace;
 }
 
-void IO_RegisterWrite(unsigned char port, void (*funcptr)(unsigned char value)) {
-    IO_WRITE_FUNPTR[port] = funcptr;
+// Function to log a device update or wake record at an instruction count
+static void IO_RecordEvent(unsigned char tag, unsigned long long count) {
+    unsigned long long delta = count - io->lastUpdate;
+
+    fputc(tag, io->traceFile);
+
+    do {
+        fputc((delta & 0x7F) | (delta > 0x7F ? 0x80 : 0), io->traceFile);
+        delta >>= 7;
+    } while (delta);
+
+    io->lastUpdate = count;
+}
+
+void IO_RecordUpdate(unsigned long long count) {
+    IO_RecordEvent(IO_TRACE_TAG_UPDATE, count);
+}
+
+void IO_RecordWake(unsigned long long count) {
+    IO_RecordEvent(IO_TRACE_TAG_WAKE, count);
+}
+
+unsigned long long IO_GetNextUpdate(void) {
+    return io->nextUpdate;
+}
+
+int IO_IsNextWake(void) {
+    return io->nextWake;
+}
+
+void IO_ReplayUpdate(void) {
+    // Every read logged before the update must have happened by now
+    if (io->replayPosition != io->updatePosition) {
+        IO_ReplayDiverged();
+
+        return;
+    }
+
+    // Skip the tag and the LEB128 bytes of the update or wake
+    io->replayPosition++;
+
+    while (io->replay[io->replayPosition++] & 0x80);
+
+    io->lastUpdate = io->nextUpdate;
+
+    if (io->replayPosition == io->replaySize) {
+        IO_StopTrace();
+
+        return;
+    }
+
+    IO_ReplayNextUpdate();
+}
+
+void IO_GetProfile(unsigned char port, unsigned long long *calls, unsigned long long *time) {
+#if CPU_PROFILE
+    *calls = io->profileCalls[port];
+    *time = io->profileTime[port];
+#else
+    *calls = 0;
+    *time = 0;
+#endif
 }
 
 unsigned char IO_Read(unsigned char port) {
-    return IO_READ_FUNPTR[port]();
+    if (io->trace == IO_TRACE_NONE || IO_IS_INTERNAL(port)) return IO_CallRead(port);
+
+    if (io->trace == IO_TRACE_RECORD) {
+        unsigned char value = IO_CallRead(port);
+
+        fputc(IO_TRACE_TAG_READ, io->traceFile);
+        fputc(port, io->traceFile);
+        fputc(value, io->traceFile);
+
+        return value;
+    }
+
+    // Replays must find the same read next in the log
+    unsigned char *record = &io->replay[io->replayPosition];
+
+    if (io->replaySize - io->replayPosition < 3 || record[0] != IO_TRACE_TAG_READ || record[1] != port) {
+        IO_ReplayDiverged();
+
+        return IO_Read(port);
+    }
+
+    unsigned char value = record[2];
+
+    io->replayPosition += 3;
+
+    if (io->replayPosition == io->replaySize) IO_StopTrace();
+
+    return value;
 }
 
 void IO_Write(unsigned char port, unsigned char value) {
-    IO_WRITE_FUNPTR[port](value);
+    // Devices are stubbed out while replaying
+    if (io->trace == IO_TRACE_REPLAY && !IO_IS_INTERNAL(port)) return;
+
+    IO_CallWrite(port, value);
 }
\ No newline at end of file
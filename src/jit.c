@@ -0,0 +1,2092 @@
+#include "jit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "cpu.h"
+#include "memory.h"
+#include "utils.h"
+
+/*
+    x86 - 64 JIT compiler
+
+    Translates guest basic blocks into native code that keeps a, b, s and
+    the status flags in host registers, following the System V calling
+    convention. Blocks end at branches or before instructions that aren't
+    translated, which run through the CPU opcode table instead.
+
+    Within a block, up to four bytes around the top of the stack are held in
+    a host register, so pops following a push read them from there. Pushes
+    defer their stores while the bytes are held, and a push over popped bytes
+    not written yet replaces them, so an expression only writes the bytes left
+    in memory once it is done. Popped bytes stay visible to guest loads, so
+    held bytes are spilled before any other guest access, before instructions
+    reading or moving the stack pointer, before pushes that don't fit in the
+    register and on every block exit, which also keeps I/O and the machine
+    state seen from outside in memory. Spills an instruction needs are found
+    by translating it once without keeping the code, and are emitted ahead of
+    it, so they exit the block cleanly on writes to code. Pushes over the
+    bytes of the block itself would leave the rest of the block running stale
+    code, so the stack range pushes write between two drops of the top
+    register is tested against the block once, ahead of the first of them,
+    and the block exits there to run that instruction through the opcode
+    table if they overlap. The test also exits there when the range isn't on
+    RAM both ways, so a stack on a device, clean or shared page runs through
+    the opcode table with every push and pop reaching memory, as devices
+    would otherwise see writes at the spill and never see the pops. Pushes
+    with no such test, after a drop within the same instruction, test
+    themselves and write through.
+
+    Guest loads and stores go through the memory page table, inlining the RAM
+    case like the header accessors do. Entries that are NULL, for devices,
+    clean or shared RAM and pages holding decoded code, and shorts crossing a
+    page call a thunk into the memory module instead, so devices, the bank
+    controller and dirty tracking behave as they do under the interpreter.
+
+    Blocks are chained by patching their exit jumps to point straight at the
+    next block on first use. Translated bytes are marked in the memory code
+    map, and any write to them flushes the whole translation cache, since
+    patched jumps may point into any block. Writes to devices also end the
+    block, as they may remap memory or raise an interrupt.
+*/
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+#if JIT_SUPPORTED
+
+#include <sys/mman.h>
+
+// Size of the executable code buffer in bytes
+#define JIT_CODE_SIZE (16 * 1024 * 1024)
+
+// Maximum number of guest instructions per block
+#define JIT_BLOCK_MAX_INSTRUCTIONS 64
+
+// Worst case native code size of a block, including its exit stubs
+#define JIT_BLOCK_MAX_SIZE (JIT_BLOCK_MAX_INSTRUCTIONS * 448)
+
+// Maximum number of exit stubs per block
+#define JIT_BLOCK_MAX_EXITS (JIT_BLOCK_MAX_INSTRUCTIONS * 5 + 4)
+
+// x86 - 64 register enum
+typedef enum jit_register_e {
+    JIT_RAX,
+    JIT_RCX,
+    JIT_RDX,
+    JIT_RBX,
+    JIT_RSP,
+    JIT_RBP,
+    JIT_RSI,
+    JIT_RDI,
+    JIT_R8,
+    JIT_R9,
+    JIT_R10,
+    JIT_R11,
+    JIT_R12,
+    JIT_R13,
+    JIT_R14,
+    JIT_R15,
+} JITRegister;
+
+// Host registers holding the guest state in translated code
+#define JIT_REG_PAGES JIT_RBX
+#define JIT_REG_GUEST JIT_RDI
+#define JIT_REG_REMAINING JIT_RBP
+
+#define JIT_REG_A JIT_R12
+#define JIT_REG_B JIT_R13
+#define JIT_REG_S JIT_R14
+
+// Guest registers always hold zero - extended 16 - bit values, updated with 16 - bit ops
+
+// Status flags are held as 0 or 1, in flags register bit order
+#define JIT_REG_FLAG JIT_R8
+
+// Zero - extended bytes around the top of the stack, see JITTop
+#define JIT_REG_TOP JIT_R15
+
+// Host pointer to the page of a guest access, free outside of them
+#define JIT_REG_HOST JIT_RSI
+
+// x86 - 64 ALU opcodes, in op r/m32, r32 form
+#define JIT_OP_ADD 0x01
+#define JIT_OP_OR 0x09
+#define JIT_OP_AND 0x21
+#define JIT_OP_SUB 0x29
+#define JIT_OP_XOR 0x31
+#define JIT_OP_TEST 0x85
+#define JIT_OP_MOV 0x89
+
+// mov r/m8, r8, only for byte registers al to bl unless an operand needs a REX prefix
+#define JIT_OP_MOV_BYTE 0x88
+
+// x86 - 64 immediate ALU opcode extensions
+#define JIT_EXT_ADD 0
+#define JIT_EXT_OR 1
+#define JIT_EXT_AND 4
+#define JIT_EXT_SUB 5
+#define JIT_EXT_XOR 6
+#define JIT_EXT_CMP 7
+
+// x86 - 64 shift opcode extensions
+#define JIT_EXT_ROL 0
+#define JIT_EXT_SHL 4
+#define JIT_EXT_SHR 5
+
+// x86 - 64 condition codes
+#define JIT_CC_B 0x2
+#define JIT_CC_NB 0x3
+#define JIT_CC_A 0x7
+#define JIT_CC_Z 0x4
+#define JIT_CC_NZ 0x5
+
+// Unconditional jump, passed in place of a condition code
+#define JIT_CC_ALWAYS 0xFF
+
+// Top of stack cache state, the low byte of the top register being the lowest address held
+typedef struct {
+    // Number of bytes held, up to 2
+    int size;
+
+    // Address of the lowest byte held, relative to s
+    int offset;
+
+    // Set if the bytes held aren't written to guest memory yet
+    unsigned char pending;
+} JITTop;
+
+// Test of the bytes written by deferred pushes for overlapping the block, patched once the block is translated
+typedef struct {
+    // Displacement and limit of the test
+    unsigned char *displacement;
+    unsigned char *limit;
+
+    // Displacements of the lowest and highest byte for the test of their pages, NULL without one
+    unsigned char *lowPage;
+    unsigned char *highPage;
+
+    // Bytes written from low up to high, and s at the test, relative to s where the top register was last dropped
+    int low;
+    int high;
+    int depth;
+} JITDefer;
+
+// Block exit reason enum
+typedef enum jit_exit_e {
+    // Not enough instructions left in the batch for the next block
+    JIT_EXIT_BUDGET,
+
+    // Jump to a block that isn't linked yet
+    JIT_EXIT_LINK,
+
+    // Jump to a computed address without a translated block
+    JIT_EXIT_LOOKUP,
+
+    // Write to translated code, which already flushed the cache, or to a device
+    JIT_EXIT_WRITE,
+
+    // Pushes over the bytes of the block ahead or off RAM, the next instruction runs through the opcode table
+    JIT_EXIT_STACK,
+} JITExit;
+
+// Addressing mode enum
+typedef enum jit_mode_e {
+    JIT_MODE_I,
+    JIT_MODE_D,
+    JIT_MODE_RA,
+    JIT_MODE_RB,
+    JIT_MODE_XA,
+    JIT_MODE_XB,
+    JIT_MODE_YA,
+    JIT_MODE_YB,
+} JITMode;
+
+// ALU operation enum
+typedef enum jit_alu_e {
+    JIT_ALU_AD,
+    JIT_ALU_SU,
+    JIT_ALU_AN,
+    JIT_ALU_OR,
+    JIT_ALU_XR,
+    JIT_ALU_CP,
+    JIT_ALU_IV,
+    JIT_ALU_IC,
+    JIT_ALU_DC,
+    JIT_ALU_RL,
+    JIT_ALU_RR,
+    JIT_ALU_SL,
+    JIT_ALU_SR,
+    JIT_ALU_SA,
+} JITALU;
+
+// Guest state shared with translated code
+typedef struct {
+    unsigned long long remaining;
+
+    // Virtual clock, advanced by each block on entry
+    unsigned long long cycles;
+
+    const MemoryPageTable *pages;
+
+    // Jump displacement to patch on link exits
+    unsigned char *link;
+
+    unsigned a, b, s, i;
+
+    // Status flags, in flags register bit order
+    unsigned flag[4];
+
+    // Flags register bits not held by translated code
+    unsigned flags;
+
+    unsigned exit;
+} JITGuest;
+
+// Pending block exit stub
+typedef struct {
+    // Jump displacement to point at the stub
+    unsigned char *site;
+
+    JITExit exit;
+
+    // Instruction pointer after the exit
+    unsigned short i;
+
+    // Set if the exit resumes at the instruction after the translated one
+    unsigned char next;
+
+    // Instructions to give back to the batch
+    unsigned refund;
+
+    // Cycles of the block up to the exit
+    unsigned cycles;
+} JITStub;
+
+// JIT context struct
+struct jit_context_s {
+    // Executable code buffer, NULL while the compiler is disabled
+    unsigned char *code;
+    unsigned char *blocks;
+    unsigned char *emit;
+
+    // Entry and exit code shared by all blocks
+    void (*enter)(JITGuest *guest, const unsigned char *block);
+    unsigned char *epilogue;
+
+    // Thunks calling the memory access functions from blocks
+    unsigned char *readByte;
+    unsigned char *readShort;
+    unsigned char *writeByte;
+    unsigned char *writeShort;
+    unsigned char *writeTop;
+
+    // Translated block for each guest address
+    unsigned char *block[MEMORY_SIZE];
+
+    // Incremented on every flush, to drop stale links
+    unsigned generation;
+
+    JITGuest guest;
+
+    // Block being translated, fetched through the page table of the machine
+    const MemoryPageTable *pages;
+    unsigned short pc;
+    unsigned count;
+    unsigned cycles;
+
+    // What the top register holds at the current point of the block
+    JITTop top;
+
+    // Set when a spill is emitted, to find the instructions that need one
+    unsigned char spill;
+
+    // s relative to where the top register was last dropped, and the test covering the pushes since, -1 if none
+    int depth;
+    int test;
+
+    // Set when a push has no test covering it or the top register is dropped, to find the instructions that need a test
+    unsigned char untested;
+    unsigned char dropped;
+
+    // At most one test ahead of each instruction and one for its push
+    JITDefer defer[JIT_BLOCK_MAX_INSTRUCTIONS * 2];
+    int deferCount;
+
+    // Set while translating a call, whose write exits resume at the target
+    unsigned char call;
+    unsigned short callTarget;
+
+    JITStub stub[JIT_BLOCK_MAX_EXITS];
+    int stubCount;
+};
+
+#define JIT_GUEST(field) ((unsigned char) offsetof(JITGuest, field))
+
+#else
+
+// Hosts without JIT support only need the context to exist
+struct jit_context_s {
+    unsigned char *code;
+};
+
+#endif
+
+// JIT context bound to the calling thread
+static THREAD_LOCAL JITContext *jit = NULL;
+
+#if JIT_SUPPORTED
+
+/*
+    Code emitting functions
+*/
+
+static void JIT_EmitByte(unsigned char value) {
+    *jit->emit++ = value;
+}
+
+static void JIT_EmitLong(unsigned value) {
+    memcpy(jit->emit, &value, 4);
+    jit->emit += 4;
+}
+
+static void JIT_EmitQuad(unsigned long long value) {
+    memcpy(jit->emit, &value, 8);
+    jit->emit += 8;
+}
+
+// Function to emit a REX prefix when the operands need one
+static void JIT_EmitRex(int w, int reg, int index, int base) {
+    unsigned char rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3);
+
+    if (rex != 0x40) JIT_EmitByte(rex);
+}
+
+// Function to emit op r/m32, r32 between two registers
+static void JIT_EmitOp(unsigned char op, int dst, int src) {
+    JIT_EmitRex(0, src, 0, dst);
+    JIT_EmitByte(op);
+    JIT_EmitByte(0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+// Function to emit op r32, imm
+static void JIT_EmitOpImm(int ext, int dst, unsigned imm) {
+    JIT_EmitRex(0, 0, 0, dst);
+
+    if (imm < 0x80) {
+        JIT_EmitByte(0x83);
+        JIT_EmitByte(0xC0 | (ext << 3) | (dst & 7));
+        JIT_EmitByte(imm);
+    } else {
+        JIT_EmitByte(0x81);
+        JIT_EmitByte(0xC0 | (ext << 3) | (dst & 7));
+        JIT_EmitLong(imm);
+    }
+}
+
+// Function to emit op r16, imm, which leaves the upper half of the register alone
+static void JIT_EmitOpImm16(int ext, int dst, unsigned imm) {
+    JIT_EmitByte(0x66);
+    JIT_EmitRex(0, 0, 0, dst);
+
+    if (imm < 0x80 || imm >= 0xFF80) {
+        JIT_EmitByte(0x83);
+        JIT_EmitByte(0xC0 | (ext << 3) | (dst & 7));
+        JIT_EmitByte(imm);
+    } else {
+        JIT_EmitByte(0x81);
+        JIT_EmitByte(0xC0 | (ext << 3) | (dst & 7));
+        JIT_EmitByte(imm);
+        JIT_EmitByte(imm >> 8);
+    }
+}
+
+// Function to emit mov r32, imm32
+static void JIT_EmitMovImm(int dst, unsigned imm) {
+    JIT_EmitRex(0, 0, 0, dst);
+    JIT_EmitByte(0xB8 + (dst & 7));
+    JIT_EmitLong(imm);
+}
+
+// Function to emit a shift of r32 by a constant
+static void JIT_EmitShift(int ext, int dst, unsigned char count) {
+    JIT_EmitRex(0, 0, 0, dst);
+    JIT_EmitByte(0xC1);
+    JIT_EmitByte(0xC0 | (ext << 3) | (dst & 7));
+    JIT_EmitByte(count);
+}
+
+// Function to emit movzx r32, r8 or r16, only for byte registers al to bl
+static void JIT_EmitMovzx(unsigned char op, int dst, int src) {
+    JIT_EmitRex(0, dst, 0, src);
+    JIT_EmitByte(0x0F);
+    JIT_EmitByte(op);
+    JIT_EmitByte(0xC0 | ((dst & 7) << 3) | (src & 7));
+}
+
+#define JIT_MOVZX_BYTE 0xB6
+#define JIT_MOVZX_SHORT 0xB7
+
+// Function to emit a [base + index] memory operand
+static void JIT_EmitIndexed(int reg, int base, int index) {
+    JIT_EmitByte(0x04 | ((reg & 7) << 3));
+    JIT_EmitByte(((index & 7) << 3) | (base & 7));
+}
+
+// Function to load the page table entry for the address in a register, at offset into the page table, and test it
+static void JIT_EmitPageLookup(int address, unsigned offset) {
+    JIT_EmitOp(JIT_OP_MOV, JIT_REG_HOST, address);
+    JIT_EmitShift(JIT_EXT_SHR, JIT_REG_HOST, MEMORY_PAGE_SIZE_SHIFT);
+
+    // mov rsi, [rbx + rsi * 8 + offset]; test rsi, rsi
+    JIT_EmitByte(0x48);
+    JIT_EmitByte(0x8B);
+    JIT_EmitByte(0x84 | ((JIT_REG_HOST & 7) << 3));
+    JIT_EmitByte(0xC0 | ((JIT_REG_HOST & 7) << 3) | JIT_REG_PAGES);
+    JIT_EmitLong(offset);
+
+    JIT_EmitByte(0x48);
+    JIT_EmitOp(JIT_OP_TEST, JIT_REG_HOST, JIT_REG_HOST);
+}
+
+// Function to emit movzx eax, byte or word [host + rax]
+static void JIT_EmitHostLoad(unsigned char op) {
+    JIT_EmitByte(0x0F);
+    JIT_EmitByte(op);
+    JIT_EmitIndexed(JIT_RAX, JIT_REG_HOST, JIT_RAX);
+}
+
+// Function to emit mov [host + rcx], al, ax or eax
+static void JIT_EmitHostStore(int bits) {
+    if (bits == 16) JIT_EmitByte(0x66);
+
+    JIT_EmitByte(bits == 8 ? 0x88 : 0x89);
+    JIT_EmitIndexed(JIT_RAX, JIT_REG_HOST, JIT_RCX);
+}
+
+// Function to emit a call to code in the code buffer
+static void JIT_EmitCall(const unsigned char *target) {
+    JIT_EmitByte(0xE8);
+    JIT_EmitLong(0);
+
+    int displacement = (int) (target - jit->emit);
+
+    memcpy(jit->emit - 4, &displacement, 4);
+}
+
+// Function to emit a load or store of a guest state field
+static void JIT_EmitGuest(unsigned char op, int w, int reg, unsigned char offset) {
+    JIT_EmitRex(w, reg, 0, JIT_REG_GUEST);
+    JIT_EmitByte(op);
+    JIT_EmitByte(0x40 | ((reg & 7) << 3) | (JIT_REG_GUEST & 7));
+    JIT_EmitByte(offset);
+}
+
+#define JIT_GUEST_LOAD 0x8B
+#define JIT_GUEST_STORE 0x89
+
+// Function to emit mov dword [guest + offset], imm32
+static void JIT_EmitGuestImm(unsigned char offset, unsigned imm) {
+    JIT_EmitByte(0xC7);
+    JIT_EmitByte(0x40 | (JIT_REG_GUEST & 7));
+    JIT_EmitByte(offset);
+    JIT_EmitLong(imm);
+}
+
+// Function to emit an ALU operation of a 64 - bit guest state field and imm32
+static void JIT_EmitGuestOpImm(int ext, unsigned char offset, unsigned imm) {
+    JIT_EmitByte(0x48);
+    JIT_EmitByte(0x81);
+    JIT_EmitByte(0x40 | (ext << 3) | (JIT_REG_GUEST & 7));
+    JIT_EmitByte(offset);
+    JIT_EmitLong(imm);
+}
+
+// Function to emit a jump with a 32 - bit displacement, returning the displacement
+static unsigned char *JIT_EmitJump(unsigned char cc) {
+    if (cc == JIT_CC_ALWAYS) {
+        JIT_EmitByte(0xE9);
+    } else {
+        JIT_EmitByte(0x0F);
+        JIT_EmitByte(0x80 | cc);
+    }
+
+    unsigned char *site = jit->emit;
+
+    JIT_EmitLong(0);
+
+    return site;
+}
+
+// Function to point a jump displacement at a target
+static void JIT_PatchJump(unsigned char *site, const unsigned char *target) {
+    int displacement = (int) (target - (site + 4));
+
+    memcpy(site, &displacement, 4);
+}
+
+// Function to emit a jump with an 8 - bit displacement, returning the displacement
+static unsigned char *JIT_EmitJumpShort(unsigned char cc) {
+    JIT_EmitByte(cc == JIT_CC_ALWAYS ? 0xEB : 0x70 | cc);
+    JIT_EmitByte(0);
+
+    return jit->emit - 1;
+}
+
+// Function to point an 8 - bit jump displacement at the next emitted byte
+static void JIT_PatchJumpShort(unsigned char *site) {
+    *site = (unsigned char) (jit->emit - (site + 1));
+}
+
+/*
+    Guest operation emitting functions
+*/
+
+static unsigned char JIT_FetchByte(void) {
+    return Memory_FetchByte(jit->pages, jit->pc++);
+}
+
+static unsigned short JIT_FetchShort(void) {
+    unsigned char lo = JIT_FetchByte();
+    unsigned char hi = JIT_FetchByte();
+
+    return TO_SHORT(lo, hi);
+}
+
+// Function to add an exit stub for the jump displacement at site
+static void JIT_AddStub(unsigned char *site, JITExit exit, unsigned short i) {
+    JITStub *stub = &jit->stub[jit->stubCount++];
+
+    stub->site = site;
+    stub->exit = exit;
+    stub->i = i;
+    stub->next = 0;
+    stub->refund = jit->count;
+    stub->cycles = jit->cycles;
+}
+
+// Function to exit the block on writes to translated code or devices, after a test of the store thunk result
+static void JIT_GenWriteExit(void) {
+    JIT_AddStub(JIT_EmitJump(JIT_CC_NZ), JIT_EXIT_WRITE, jit->callTarget);
+
+    jit->stub[jit->stubCount - 1].next = !jit->call;
+}
+
+// Function to load the byte or short at index into eax, clobbering esi
+static void JIT_GenLoadAccess(int index, int bits) {
+    unsigned char *split = NULL;
+
+    JIT_EmitMovzx(JIT_MOVZX_BYTE, JIT_RAX, index);
+
+    // Shorts crossing a page, including the wrap at 0xFFFF, take two byte reads in the thunk; cmp al, 0xFF
+    if (bits == 16) {
+        JIT_EmitByte(0x3C);
+        JIT_EmitByte(0xFF);
+
+        split = JIT_EmitJumpShort(JIT_CC_Z);
+    }
+
+    JIT_EmitPageLookup(index, offsetof(MemoryPageTable, read));
+
+    unsigned char *slow = JIT_EmitJumpShort(JIT_CC_Z);
+
+    JIT_EmitHostLoad(bits == 16 ? JIT_MOVZX_SHORT : JIT_MOVZX_BYTE);
+
+    unsigned char *done = JIT_EmitJumpShort(JIT_CC_ALWAYS);
+
+    if (split) JIT_PatchJumpShort(split);
+    JIT_PatchJumpShort(slow);
+
+    JIT_EmitOp(JIT_OP_MOV, JIT_RAX, index);
+    JIT_EmitCall(bits == 16 ? jit->readShort : jit->readByte);
+
+    JIT_PatchJumpShort(done);
+}
+
+// Function to store al or ax at index, clobbering ecx and esi
+static void JIT_GenStoreAccess(int index, int bits) {
+    unsigned char *split = NULL;
+
+    JIT_EmitMovzx(JIT_MOVZX_BYTE, JIT_RCX, index);
+
+    // cmp cl, 0xFF
+    if (bits == 16) {
+        JIT_EmitByte(0x80);
+        JIT_EmitByte(0xC0 | (JIT_EXT_CMP << 3) | JIT_RCX);
+        JIT_EmitByte(0xFF);
+
+        split = JIT_EmitJumpShort(JIT_CC_Z);
+    }
+
+    JIT_EmitPageLookup(index, offsetof(MemoryPageTable, write));
+
+    unsigned char *slow = JIT_EmitJumpShort(JIT_CC_Z);
+
+    JIT_EmitHostStore(bits);
+
+    unsigned char *done = JIT_EmitJumpShort(JIT_CC_ALWAYS);
+
+    if (split) JIT_PatchJumpShort(split);
+    JIT_PatchJumpShort(slow);
+
+    JIT_EmitOp(JIT_OP_MOV, JIT_RCX, index);
+    JIT_EmitCall(bits == 16 ? jit->writeShort : jit->writeByte);
+    JIT_EmitOp(JIT_OP_TEST, JIT_RCX, JIT_RCX);
+    JIT_GenWriteExit();
+
+    JIT_PatchJumpShort(done);
+}
+
+// Helper macro to get the mask of the low bytes of a register
+#define JIT_BYTE_MASK(bytes) ((unsigned) ((1ull << ((bytes) * 8)) - 1))
+
+// Function to store the bytes held by the top register at their address, clobbering eax, ecx, edx and esi
+static void JIT_EmitTopStore(void) {
+    int size = jit->top.size;
+    unsigned char *split = NULL;
+
+    JIT_EmitOp(JIT_OP_MOV, JIT_RDX, JIT_REG_S);
+
+    if (jit->top.offset) JIT_EmitOpImm16(JIT_EXT_ADD, JIT_RDX, jit->top.offset & 0xFFFF);
+
+    JIT_EmitOp(JIT_OP_MOV, JIT_RAX, JIT_REG_TOP);
+    JIT_EmitMovzx(JIT_MOVZX_BYTE, JIT_RCX, JIT_RDX);
+
+    // Bytes crossing a page take the thunk; cmp cl, imm8; ja
+    if (size > 1) {
+        JIT_EmitByte(0x80);
+        JIT_EmitByte(0xC0 | (JIT_EXT_CMP << 3) | JIT_RCX);
+        JIT_EmitByte(0x100 - size);
+
+        split = JIT_EmitJumpShort(JIT_CC_A);
+    }
+
+    JIT_EmitPageLookup(JIT_RDX, offsetof(MemoryPageTable, write));
+
+    unsigned char *slow = JIT_EmitJumpShort(JIT_CC_Z);
+
+    if (size == 3) {
+        // mov [host + rcx], ax; shr eax, 16; mov [host + rcx + 2], al
+        JIT_EmitHostStore(16);
+        JIT_EmitShift(JIT_EXT_SHR, JIT_RAX, 16);
+
+        JIT_EmitByte(0x88);
+        JIT_EmitByte(0x44 | (JIT_RAX << 3));
+        JIT_EmitByte((JIT_RCX << 3) | (JIT_REG_HOST & 7));
+        JIT_EmitByte(2);
+    } else {
+        JIT_EmitHostStore(size * 8);
+    }
+
+    unsigned char *done = JIT_EmitJumpShort(JIT_CC_ALWAYS);
+
+    if (split) JIT_PatchJumpShort(split);
+    JIT_PatchJumpShort(slow);
+
+    JIT_EmitOp(JIT_OP_MOV, JIT_RCX, JIT_RDX);
+    JIT_EmitMovImm(JIT_RDX, size);
+    JIT_EmitCall(jit->writeTop);
+    JIT_EmitOp(JIT_OP_TEST, JIT_RCX, JIT_RCX);
+    JIT_GenWriteExit();
+
+    JIT_PatchJumpShort(done);
+}
+
+// Function to write the bytes held by the top register to guest memory if they aren't yet
+static void JIT_GenSpill(void) {
+    if (!jit->top.pending) return;
+
+    JIT_EmitTopStore();
+
+    jit->top.pending = 0;
+    jit->spill = 1;
+}
+
+// Function to spill the top register and forget it, before the stack pointer changes
+static void JIT_GenDropTop(void) {
+    JIT_GenSpill();
+
+    jit->top.size = 0;
+
+    // Every change of s other than pushes and pops comes after a drop, so pushes are counted from here on
+    jit->depth = 0;
+    jit->test = -1;
+    jit->dropped = 1;
+}
+
+// Function to spill the top register with exits resuming at an instruction that hasn't run yet
+static void JIT_GenSpillAt(unsigned short i) {
+    int stubStart = jit->stubCount;
+
+    JIT_GenSpill();
+
+    for (int k = stubStart; k < jit->stubCount; k++) {
+        jit->stub[k].i = i;
+        jit->stub[k].next = 0;
+    }
+}
+
+// Function to load the byte at index into eax
+static void JIT_GenLoadByte(int index) {
+    // Loads may read the bytes held by the top register
+    JIT_GenSpill();
+    JIT_GenLoadAccess(index, 8);
+}
+
+// Function to load the short at index into eax
+static void JIT_GenLoadShort(int index) {
+    JIT_GenSpill();
+    JIT_GenLoadAccess(index, 16);
+}
+
+// Function to store al at index, clobbering ecx
+static void JIT_GenStoreByte(int index) {
+    // Stores may overwrite the bytes held by the top register
+    JIT_GenDropTop();
+    JIT_GenStoreAccess(index, 8);
+}
+
+// Function to store ax at index, clobbering ecx
+static void JIT_GenStoreShort(int index) {
+    JIT_GenDropTop();
+    JIT_GenStoreAccess(index, 16);
+}
+
+// Function to check if any of the bytes from s up to s + size is held by the top register
+static int JIT_IsTopHeld(int size) {
+    return jit->top.size && jit->top.offset < size && jit->top.offset + jit->top.size > 0;
+}
+
+// Function to load the bytes from s into eax, from the top register when all of them are held
+static void JIT_GenTopLoad(int size) {
+    int shift = -jit->top.offset;
+
+    if (!jit->top.size || shift < 0 || shift + size > jit->top.size) {
+        // Part of the bytes may be held and not written yet
+        if (JIT_IsTopHeld(size)) JIT_GenSpill();
+
+        JIT_GenLoadAccess(JIT_REG_S, size * 8);
+        return;
+    }
+
+    JIT_EmitOp(JIT_OP_MOV, JIT_RAX, JIT_REG_TOP);
+
+    if (shift) JIT_EmitShift(JIT_EXT_SHR, JIT_RAX, shift * 8);
+    if (shift + size < jit->top.size) JIT_EmitMovzx(size == 1 ? JIT_MOVZX_BYTE : JIT_MOVZX_SHORT, JIT_RAX, JIT_RAX);
+}
+
+// Function to drop the bytes of the top register below s once written
+static void JIT_TrimTop(void) {
+    JITTop *top = &jit->top;
+
+    if (top->pending || top->offset >= 0) return;
+
+    if (top->offset + top->size <= 0) {
+        top->size = 0;
+        return;
+    }
+
+    JIT_EmitShift(JIT_EXT_SHR, JIT_REG_TOP, -top->offset * 8);
+
+    top->size += top->offset;
+    top->offset = 0;
+}
+
+// Function to emit the address of a stack byte into ecx, returning its displacement from s to patch
+static unsigned char *JIT_EmitStackAddress(void) {
+    // lea ecx, [r14 + displacement]; movzx ecx, cx
+    JIT_EmitByte(0x41);
+    JIT_EmitByte(0x8D);
+    JIT_EmitByte(0x80 | (JIT_RCX << 3) | (JIT_REG_S & 7));
+
+    unsigned char *displacement = jit->emit;
+
+    JIT_EmitLong(0);
+    JIT_EmitMovzx(JIT_MOVZX_SHORT, JIT_RCX, JIT_RCX);
+
+    return displacement;
+}
+
+// Function to emit the slow flag of the page of a stack byte into al, or ored into it, returning its displacement from s to patch
+static unsigned char *JIT_EmitStackPage(int merge) {
+    unsigned char *displacement = JIT_EmitStackAddress();
+
+    JIT_EmitShift(JIT_EXT_SHR, JIT_RCX, MEMORY_PAGE_SIZE_SHIFT);
+
+    // movzx eax, byte [rbx + rcx + slow] or or al, byte [rbx + rcx + slow]
+    if (merge) {
+        JIT_EmitByte(0x0A);
+    } else {
+        JIT_EmitByte(0x0F);
+        JIT_EmitByte(0xB6);
+    }
+
+    JIT_EmitByte(0x84 | (JIT_RAX << 3));
+    JIT_EmitByte((JIT_RCX << 3) | JIT_REG_PAGES);
+    JIT_EmitLong(offsetof(MemoryPageTable, slow));
+
+    return displacement;
+}
+
+// Function to emit the test of a range of stack bytes for overlapping the block, setting below if it does
+static void JIT_EmitDeferTest(JITDefer *defer) {
+    // cmp ecx, limit, taking the distance to the block past the range
+    defer->displacement = JIT_EmitStackAddress();
+    defer->lowPage = NULL;
+    defer->highPage = NULL;
+
+    JIT_EmitByte(0x81);
+    JIT_EmitByte(0xC0 | (JIT_EXT_CMP << 3) | JIT_RCX);
+
+    defer->limit = jit->emit;
+
+    JIT_EmitLong(0);
+}
+
+// Function to test the bytes pushes write until the top register is dropped, exiting ahead of an instruction if they overlap the block
+static void JIT_GenStackTest(unsigned short i) {
+    JITDefer *defer = &jit->defer[jit->deferCount];
+
+    jit->test = jit->deferCount++;
+
+    // The range is widened by the pushes covered
+    defer->low = jit->depth;
+    defer->high = jit->depth;
+    defer->depth = jit->depth;
+
+    JIT_EmitDeferTest(defer);
+    JIT_AddStub(JIT_EmitJump(JIT_CC_B), JIT_EXIT_STACK, i);
+
+    // The range spans two pages at most, whose slow flags are clear only for RAM both ways
+    defer->lowPage = JIT_EmitStackPage(0);
+    defer->highPage = JIT_EmitStackPage(1);
+
+    JIT_AddStub(JIT_EmitJump(JIT_CC_NZ), JIT_EXIT_STACK, i);
+}
+
+// Function to write the top register out right away if a push just deferred overlaps the block being translated
+static void JIT_GenDefer(int size) {
+    JITDefer *defer = &jit->defer[jit->deferCount++];
+
+    defer->low = jit->depth;
+    defer->high = jit->depth + size;
+    defer->depth = jit->depth;
+
+    JIT_EmitDeferTest(defer);
+
+    unsigned char *done = JIT_EmitJumpShort(JIT_CC_NB);
+
+    JIT_EmitTopStore();
+    JIT_PatchJumpShort(done);
+}
+
+// Function to push the byte or short in eax into the top register, deferring its store
+static void JIT_GenPush(int size) {
+    JITTop *top = &jit->top;
+    unsigned char movzx = size == 1 ? JIT_MOVZX_BYTE : JIT_MOVZX_SHORT;
+
+    JIT_EmitOpImm16(JIT_EXT_SUB, JIT_REG_S, size);
+    top->offset = top->size ? top->offset + size : 0;
+    jit->depth -= size;
+
+    int low = top->offset < 0 ? top->offset : 0;
+    int high = top->offset + top->size > size ? top->offset + top->size : size;
+
+    // Bytes held that don't fit in the register next to the pushed ones are written, and dropped if out of reach
+    if (top->size && (top->offset > size || top->offset + top->size < 0 || high - low > 4)) {
+        JIT_GenSpill();
+        JIT_TrimTop();
+
+        if (top->offset > size) top->size = 0;
+
+        if (top->size && top->offset + top->size > 4) {
+            JIT_EmitOpImm(JIT_EXT_AND, JIT_REG_TOP, JIT_BYTE_MASK(4 - top->offset));
+
+            top->size = 4 - top->offset;
+        }
+
+        low = 0;
+        high = top->offset + top->size > size ? top->offset + top->size : size;
+    }
+
+    if (!top->size) {
+        JIT_EmitMovzx(movzx, JIT_REG_TOP, JIT_RAX);
+    } else {
+        if (top->offset > low) JIT_EmitShift(JIT_EXT_SHL, JIT_REG_TOP, (top->offset - low) * 8);
+
+        if (!low) {
+            // mov r15b, al or mov r15w, ax replaces the low bytes
+            if (size == 2) JIT_EmitByte(0x66);
+
+            JIT_EmitOp(size == 1 ? JIT_OP_MOV_BYTE : JIT_OP_MOV, JIT_REG_TOP, JIT_RAX);
+        } else {
+            JIT_EmitOpImm(JIT_EXT_AND, JIT_REG_TOP, ~(JIT_BYTE_MASK(size) << (-low * 8)));
+            JIT_EmitMovzx(movzx, JIT_RCX, JIT_RAX);
+            JIT_EmitShift(JIT_EXT_SHL, JIT_RCX, -low * 8);
+            JIT_EmitOp(JIT_OP_OR, JIT_REG_TOP, JIT_RCX);
+        }
+    }
+
+    top->offset = low;
+    top->size = high - low;
+    top->pending = 1;
+
+    if (jit->test < 0) {
+        // Only pushes before any drop can be tested ahead of their instruction
+        if (!jit->dropped) jit->untested = 1;
+
+        JIT_GenDefer(size);
+        return;
+    }
+
+    JITDefer *defer = &jit->defer[jit->test];
+
+    if (jit->depth < defer->low) defer->low = jit->depth;
+    if (jit->depth + size > defer->high) defer->high = jit->depth + size;
+}
+
+// Function to pop a byte or short into eax
+static void JIT_GenPop(int size) {
+    JIT_GenTopLoad(size);
+    JIT_EmitOpImm16(JIT_EXT_ADD, JIT_REG_S, size);
+
+    jit->top.offset -= size;
+    jit->depth += size;
+
+    JIT_TrimTop();
+}
+
+static void JIT_GenPushByte(void) {
+    JIT_GenPush(1);
+}
+
+static void JIT_GenPushShort(void) {
+    JIT_GenPush(2);
+}
+
+static void JIT_GenPopByte(void) {
+    JIT_GenPop(1);
+}
+
+static void JIT_GenPopShort(void) {
+    JIT_GenPop(2);
+}
+
+// Function to put the effective address of an addressing mode into edx
+static void JIT_GenAddress(JITMode mode) {
+    switch (mode) {
+        case JIT_MODE_D:
+            JIT_EmitMovImm(JIT_RDX, JIT_FetchShort());
+            break;
+
+        case JIT_MODE_RA:
+            JIT_EmitOp(JIT_OP_MOV, JIT_RDX, JIT_REG_A);
+            break;
+
+        case JIT_MODE_RB:
+            JIT_EmitOp(JIT_OP_MOV, JIT_RDX, JIT_REG_B);
+            break;
+
+        case JIT_MODE_XA:
+        case JIT_MODE_YA:
+            JIT_EmitOp(JIT_OP_MOV, JIT_RDX, JIT_REG_A);
+            JIT_EmitOpImm16(JIT_EXT_ADD, JIT_RDX, JIT_FetchShort());
+            break;
+
+        case JIT_MODE_XB:
+        case JIT_MODE_YB:
+            JIT_EmitOp(JIT_OP_MOV, JIT_RDX, JIT_REG_B);
+            JIT_EmitOpImm16(JIT_EXT_ADD, JIT_RDX, JIT_FetchShort());
+            break;
+
+        default:
+            break;
+    }
+
+    // Indirect modes read the address from memory
+    if (mode == JIT_MODE_YA || mode == JIT_MODE_YB) {
+        JIT_GenLoadShort(JIT_RDX);
+        JIT_EmitOp(JIT_OP_MOV, JIT_RDX, JIT_RAX);
+    }
+}
+
+// Function to load a register from an addressing mode
+static void JIT_GenLoad(int reg, JITMode mode) {
+    if (reg == JIT_REG_S) JIT_GenDropTop();
+
+    if (mode == JIT_MODE_I) {
+        JIT_EmitMovImm(reg, JIT_FetchShort());
+        return;
+    }
+
+    JIT_GenAddress(mode);
+    JIT_GenLoadShort(JIT_RDX);
+    JIT_EmitOp(JIT_OP_MOV, reg, JIT_RAX);
+}
+
+// Function to store a register through an addressing mode
+static void JIT_GenStore(int reg, JITMode mode) {
+    JIT_GenAddress(mode);
+    JIT_EmitOp(JIT_OP_MOV, JIT_RAX, reg);
+    JIT_GenStoreShort(JIT_RDX);
+}
+
+// Function to push a byte read through an addressing mode
+static void JIT_GenPushByteFrom(JITMode mode) {
+    if (mode == JIT_MODE_I) {
+        JIT_EmitMovImm(JIT_RAX, JIT_FetchByte());
+    } else {
+        JIT_GenAddress(mode);
+        JIT_GenLoadByte(JIT_RDX);
+    }
+
+    JIT_GenPushByte();
+}
+
+// Function to push a short read through an addressing mode
+static void JIT_GenPushShortFrom(JITMode mode) {
+    if (mode == JIT_MODE_I) {
+        JIT_EmitMovImm(JIT_RAX, JIT_FetchShort());
+    } else {
+        JIT_GenAddress(mode);
+        JIT_GenLoadShort(JIT_RDX);
+    }
+
+    JIT_GenPushShort();
+}
+
+// Function to push a register
+static void JIT_GenPushRegister(int reg) {
+    JIT_EmitOp(JIT_OP_MOV, JIT_RAX, reg);
+    JIT_GenPushShort();
+}
+
+// Function to pop a byte and store it through an addressing mode
+static void JIT_GenPopByteTo(JITMode mode) {
+    JIT_GenPopByte();
+    JIT_EmitOp(JIT_OP_MOV, JIT_RCX, JIT_RAX);
+    JIT_GenAddress(mode);
+    JIT_EmitOp(JIT_OP_MOV, JIT_RAX, JIT_RCX);
+    JIT_GenStoreByte(JIT_RDX);
+}
+
+// Function to pop a short and store it through an addressing mode
+static void JIT_GenPopShortTo(JITMode mode) {
+    JIT_GenPopShort();
+    JIT_EmitOp(JIT_OP_MOV, JIT_RCX, JIT_RAX);
+    JIT_GenAddress(mode);
+    JIT_EmitOp(JIT_OP_MOV, JIT_RAX, JIT_RCX);
+    JIT_GenStoreShort(JIT_RDX);
+}
+
+// Function to set a status flag to a constant
+static void JIT_GenSetFlag(int flag, unsigned value) {
+    if (value)
+        JIT_EmitMovImm(JIT_REG_FLAG + flag, 1);
+    else
+        JIT_EmitOp(JIT_OP_XOR, JIT_REG_FLAG + flag, JIT_REG_FLAG + flag);
+}
+
+// Function to set the carry flag from the bit above a result in eax and drop it
+static void JIT_GenCarry(int bits) {
+    JIT_EmitOp(JIT_OP_MOV, JIT_REG_FLAG + 1, JIT_RAX);
+    JIT_EmitShift(JIT_EXT_SHR, JIT_REG_FLAG + 1, bits);
+    JIT_EmitMovzx(bits == 8 ? JIT_MOVZX_BYTE : JIT_MOVZX_SHORT, JIT_RAX, JIT_RAX);
+}
+
+// Function to set the zero, sign and overflow flags from a result in eax
+static void JIT_GenResultFlags(int bits) {
+    // test eax, eax; sete cl
+    JIT_EmitOp(JIT_OP_TEST, JIT_RAX, JIT_RAX);
+    JIT_EmitByte(0x0F);
+    JIT_EmitByte(0x94);
+    JIT_EmitByte(0xC0 | JIT_RCX);
+
+    JIT_EmitMovzx(JIT_MOVZX_BYTE, JIT_REG_FLAG + 0, JIT_RCX);
+
+    JIT_EmitOp(JIT_OP_MOV, JIT_REG_FLAG + 2, JIT_RAX);
+    JIT_EmitShift(JIT_EXT_SHR, JIT_REG_FLAG + 2, bits - 1);
+
+    JIT_GenSetFlag(3, 0);
+}
+
+// Function to emit a 2 - operand ALU instruction, popping the operands into ecx and eax
+static void JIT_GenBinary(JITALU alu, int bits) {
+    unsigned mask = bits == 8 ? 0xFF : 0xFFFF;
+
+    if (bits == 8) JIT_GenPopByte(); else JIT_GenPopShort();
+    JIT_EmitOp(JIT_OP_MOV, JIT_RCX, JIT_RAX);
+    if (bits == 8) JIT_GenPopByte(); else JIT_GenPopShort();
+
+    switch (alu) {
+        // Compares subtract with the carry set, and subtracts add the inverse
+        case JIT_ALU_CP:
+            JIT_GenSetFlag(1, 1);
+            // Fall through
+
+        case JIT_ALU_SU:
+            JIT_EmitOpImm(JIT_EXT_XOR, JIT_RAX, mask);
+            // Fall through
+
+        case JIT_ALU_AD:
+            JIT_EmitOp(JIT_OP_ADD, JIT_RAX, JIT_RCX);
+            JIT_EmitOp(JIT_OP_ADD, JIT_RAX, JIT_REG_FLAG + 1);
+            JIT_GenCarry(bits);
+            break;
+
+        case JIT_ALU_AN:
+            JIT_EmitOp(JIT_OP_AND, JIT_RAX, JIT_RCX);
+            JIT_GenSetFlag(1, 0);
+            break;
+
+        case JIT_ALU_OR:
+            JIT_EmitOp(JIT_OP_OR, JIT_RAX, JIT_RCX);
+            JIT_GenSetFlag(1, 0);
+            break;
+
+        case JIT_ALU_XR:
+            JIT_EmitOp(JIT_OP_XOR, JIT_RAX, JIT_RCX);
+            JIT_GenSetFlag(1, 0);
+            break;
+
+        default:
+            break;
+    }
+
+    JIT_GenResultFlags(bits);
+
+    // Compares only set the flags
+    if (alu == JIT_ALU_CP) return;
+
+    if (bits == 8) JIT_GenPushByte(); else JIT_GenPushShort();
+}
+
+// Function to emit a 1 - operand ALU instruction, popping the operand into eax
+static void JIT_GenUnary(JITALU alu, int bits) {
+    unsigned mask = bits == 8 ? 0xFF : 0xFFFF;
+
+    if (bits == 8) JIT_GenPopByte(); else JIT_GenPopShort();
+
+    switch (alu) {
+        case JIT_ALU_IV:
+            JIT_EmitOpImm(JIT_EXT_XOR, JIT_RAX, mask);
+            JIT_GenSetFlag(1, 0);
+            break;
+
+        case JIT_ALU_IC:
+            // Adds 1 with the carry cleared
+            JIT_EmitOpImm(JIT_EXT_ADD, JIT_RAX, 1);
+            JIT_GenCarry(bits);
+            break;
+
+        case JIT_ALU_DC:
+            // Subtracts 1 with the carry set, adding its inverse plus 1
+            JIT_EmitOpImm(JIT_EXT_ADD, JIT_RAX, mask);
+            JIT_GenCarry(bits);
+            break;
+
+        // Shifts rotate with the carry preset
+        case JIT_ALU_SL:
+            JIT_GenSetFlag(1, 0);
+            // Fall through
+
+        case JIT_ALU_RL:
+            JIT_EmitOp(JIT_OP_MOV, JIT_RCX, JIT_RAX);
+            JIT_EmitShift(JIT_EXT_SHL, JIT_RAX, 1);
+            JIT_EmitOp(JIT_OP_OR, JIT_RAX, JIT_REG_FLAG + 1);
+            JIT_EmitMovzx(bits == 8 ? JIT_MOVZX_BYTE : JIT_MOVZX_SHORT, JIT_RAX, JIT_RAX);
+            JIT_EmitShift(JIT_EXT_SHR, JIT_RCX, bits - 1);
+            JIT_EmitOp(JIT_OP_MOV, JIT_REG_FLAG + 1, JIT_RCX);
+            break;
+
+        case JIT_ALU_SR:
+        case JIT_ALU_SA:
+            JIT_GenSetFlag(1, alu == JIT_ALU_SA);
+            // Fall through
+
+        case JIT_ALU_RR:
+            // Both widths rotate the carry into bit 7, matching the interpreter
+            JIT_EmitOp(JIT_OP_MOV, JIT_RCX, JIT_RAX);
+            JIT_EmitShift(JIT_EXT_SHR, JIT_RAX, 1);
+            JIT_EmitOp(JIT_OP_MOV, JIT_RDX, JIT_REG_FLAG + 1);
+            JIT_EmitShift(JIT_EXT_SHL, JIT_RDX, 7);
+            JIT_EmitOp(JIT_OP_OR, JIT_RAX, JIT_RDX);
+            JIT_EmitOpImm(JIT_EXT_AND, JIT_RCX, 1);
+            JIT_EmitOp(JIT_OP_MOV, JIT_REG_FLAG + 1, JIT_RCX);
+            break;
+
+        default:
+            break;
+    }
+
+    JIT_GenResultFlags(bits);
+
+    if (bits == 8) JIT_GenPushByte(); else JIT_GenPushShort();
+}
+
+// Function to jump to the block at a constant address, linked on first use
+static void JIT_GenLink(unsigned char cc, unsigned short target) {
+    // Nothing stays held across block exits
+    JIT_GenSpill();
+
+    JIT_AddStub(JIT_EmitJump(cc), JIT_EXIT_LINK, target);
+}
+
+// Function to jump to the block at the address in eax
+static void JIT_GenDispatch(void) {
+    // Instructions ending in a dispatch get their spill ahead of them, so this never clobbers eax
+    JIT_GenSpill();
+
+    JIT_EmitGuest(JIT_GUEST_STORE, 0, JIT_RAX, JIT_GUEST(i));
+
+    // mov rcx, block; mov rcx, [rcx + rax * 8]
+    JIT_EmitByte(0x48);
+    JIT_EmitByte(0xB9);
+    JIT_EmitQuad((unsigned long long) jit->block);
+
+    JIT_EmitByte(0x48);
+    JIT_EmitByte(0x8B);
+    JIT_EmitByte(0x0C);
+    JIT_EmitByte(0xC1);
+
+    // test rcx, rcx; jz lookup; jmp rcx
+    JIT_EmitByte(0x48);
+    JIT_EmitByte(0x85);
+    JIT_EmitByte(0xC9);
+
+    JIT_EmitByte(0x74);
+    JIT_EmitByte(0x02);
+
+    JIT_EmitByte(0xFF);
+    JIT_EmitByte(0xE1);
+
+    JIT_EmitGuestImm(JIT_GUEST(exit), JIT_EXIT_LOOKUP);
+    JIT_PatchJump(JIT_EmitJump(JIT_CC_ALWAYS), jit->epilogue);
+}
+
+// Function to emit a conditional branch, returning the condition code taking it
+static unsigned char JIT_GenCondition(unsigned char index) {
+    int flag = index & 3;
+
+    JIT_EmitOp(JIT_OP_TEST, JIT_REG_FLAG + flag, JIT_REG_FLAG + flag);
+
+    // The second four conditions are negated
+    return index & 4 ? JIT_CC_Z : JIT_CC_NZ;
+}
+
+// Function to emit a call to a constant address
+static void JIT_GenCall(unsigned short target) {
+    jit->call = 1;
+    jit->callTarget = target;
+
+    JIT_EmitMovImm(JIT_RAX, jit->pc);
+    JIT_GenPushShort();
+    JIT_GenLink(JIT_CC_ALWAYS, target);
+}
+
+// Function to translate one instruction, returning 1 if it ends the block
+static int JIT_Translate(unsigned char opcode) {
+    unsigned short address;
+    unsigned char cc;
+
+    switch (opcode) {
+        // Load instructions
+        case CPU_OPCODE_LDAI: JIT_GenLoad(JIT_REG_A, JIT_MODE_I); break;
+        case CPU_OPCODE_LDBI: JIT_GenLoad(JIT_REG_B, JIT_MODE_I); break;
+        case CPU_OPCODE_LDSI: JIT_GenLoad(JIT_REG_S, JIT_MODE_I); break;
+        case CPU_OPCODE_LDAD: JIT_GenLoad(JIT_REG_A, JIT_MODE_D); break;
+        case CPU_OPCODE_LDBD: JIT_GenLoad(JIT_REG_B, JIT_MODE_D); break;
+        case CPU_OPCODE_LDSD: JIT_GenLoad(JIT_REG_S, JIT_MODE_D); break;
+        case CPU_OPCODE_LDARA: JIT_GenLoad(JIT_REG_A, JIT_MODE_RA); break;
+        case CPU_OPCODE_LDBRA: JIT_GenLoad(JIT_REG_B, JIT_MODE_RA); break;
+        case CPU_OPCODE_LDSRA: JIT_GenLoad(JIT_REG_S, JIT_MODE_RA); break;
+        case CPU_OPCODE_LDARB: JIT_GenLoad(JIT_REG_A, JIT_MODE_RB); break;
+        case CPU_OPCODE_LDBRB: JIT_GenLoad(JIT_REG_B, JIT_MODE_RB); break;
+        case CPU_OPCODE_LDSRB: JIT_GenLoad(JIT_REG_S, JIT_MODE_RB); break;
+        case CPU_OPCODE_LDAXA: JIT_GenLoad(JIT_REG_A, JIT_MODE_XA); break;
+        case CPU_OPCODE_LDBXA: JIT_GenLoad(JIT_REG_B, JIT_MODE_XA); break;
+        case CPU_OPCODE_LDSXA: JIT_GenLoad(JIT_REG_S, JIT_MODE_XA); break;
+        case CPU_OPCODE_LDAXB: JIT_GenLoad(JIT_REG_A, JIT_MODE_XB); break;
+        case CPU_OPCODE_LDBXB: JIT_GenLoad(JIT_REG_B, JIT_MODE_XB); break;
+        case CPU_OPCODE_LDSXB: JIT_GenLoad(JIT_REG_S, JIT_MODE_XB); break;
+        case CPU_OPCODE_LDAYA: JIT_GenLoad(JIT_REG_A, JIT_MODE_YA); break;
+        case CPU_OPCODE_LDBYA: JIT_GenLoad(JIT_REG_B, JIT_MODE_YA); break;
+        case CPU_OPCODE_LDSYA: JIT_GenLoad(JIT_REG_S, JIT_MODE_YA); break;
+        case CPU_OPCODE_LDAYB: JIT_GenLoad(JIT_REG_A, JIT_MODE_YB); break;
+        case CPU_OPCODE_LDBYB: JIT_GenLoad(JIT_REG_B, JIT_MODE_YB); break;
+        case CPU_OPCODE_LDSYB: JIT_GenLoad(JIT_REG_S, JIT_MODE_YB); break;
+
+        // Store instructions
+        case CPU_OPCODE_STAD: JIT_GenStore(JIT_REG_A, JIT_MODE_D); break;
+        case CPU_OPCODE_STBD: JIT_GenStore(JIT_REG_B, JIT_MODE_D); break;
+        case CPU_OPCODE_STSD: JIT_GenStore(JIT_REG_S, JIT_MODE_D); break;
+        case CPU_OPCODE_STARA: JIT_GenStore(JIT_REG_A, JIT_MODE_RA); break;
+        case CPU_OPCODE_STBRA: JIT_GenStore(JIT_REG_B, JIT_MODE_RA); break;
+        case CPU_OPCODE_STSRA: JIT_GenStore(JIT_REG_S, JIT_MODE_RA); break;
+        case CPU_OPCODE_STARB: JIT_GenStore(JIT_REG_A, JIT_MODE_RB); break;
+        case CPU_OPCODE_STBRB: JIT_GenStore(JIT_REG_B, JIT_MODE_RB); break;
+        case CPU_OPCODE_STSRB: JIT_GenStore(JIT_REG_S, JIT_MODE_RB); break;
+        case CPU_OPCODE_STAXA: JIT_GenStore(JIT_REG_A, JIT_MODE_XA); break;
+        case CPU_OPCODE_STBXA: JIT_GenStore(JIT_REG_B, JIT_MODE_XA); break;
+        case CPU_OPCODE_STSXA: JIT_GenStore(JIT_REG_S, JIT_MODE_XA); break;
+        case CPU_OPCODE_STAXB: JIT_GenStore(JIT_REG_A, JIT_MODE_XB); break;
+        case CPU_OPCODE_STBXB: JIT_GenStore(JIT_REG_B, JIT_MODE_XB); break;
+        case CPU_OPCODE_STSXB: JIT_GenStore(JIT_REG_S, JIT_MODE_XB); break;
+        case CPU_OPCODE_STAYA: JIT_GenStore(JIT_REG_A, JIT_MODE_YA); break;
+        case CPU_OPCODE_STBYA: JIT_GenStore(JIT_REG_B, JIT_MODE_YA); break;
+        case CPU_OPCODE_STSYA: JIT_GenStore(JIT_REG_S, JIT_MODE_YA); break;
+        case CPU_OPCODE_STAYB: JIT_GenStore(JIT_REG_A, JIT_MODE_YB); break;
+        case CPU_OPCODE_STBYB: JIT_GenStore(JIT_REG_B, JIT_MODE_YB); break;
+        case CPU_OPCODE_STSYB: JIT_GenStore(JIT_REG_S, JIT_MODE_YB); break;
+
+        // Move instructions
+        case CPU_OPCODE_MVAB: JIT_EmitOp(JIT_OP_MOV, JIT_REG_A, JIT_REG_B); break;
+        case CPU_OPCODE_MVAS: JIT_GenSpill(); JIT_EmitOp(JIT_OP_MOV, JIT_REG_A, JIT_REG_S); break;
+        case CPU_OPCODE_MVAI: JIT_EmitMovImm(JIT_REG_A, jit->pc); break;
+
+        case CPU_OPCODE_MVBA: JIT_EmitOp(JIT_OP_MOV, JIT_REG_B, JIT_REG_A); break;
+        case CPU_OPCODE_MVBS: JIT_GenSpill(); JIT_EmitOp(JIT_OP_MOV, JIT_REG_B, JIT_REG_S); break;
+        case CPU_OPCODE_MVBI: JIT_EmitMovImm(JIT_REG_B, jit->pc); break;
+
+        case CPU_OPCODE_MVSA: JIT_GenDropTop(); JIT_EmitOp(JIT_OP_MOV, JIT_REG_S, JIT_REG_A); break;
+        case CPU_OPCODE_MVSB: JIT_GenDropTop(); JIT_EmitOp(JIT_OP_MOV, JIT_REG_S, JIT_REG_B); break;
+        case CPU_OPCODE_MVSI: JIT_GenDropTop(); JIT_EmitMovImm(JIT_REG_S, jit->pc); break;
+
+        case CPU_OPCODE_MVIA: JIT_EmitOp(JIT_OP_MOV, JIT_RAX, JIT_REG_A); JIT_GenDispatch(); return 1;
+        case CPU_OPCODE_MVIB: JIT_EmitOp(JIT_OP_MOV, JIT_RAX, JIT_REG_B); JIT_GenDispatch(); return 1;
+        case CPU_OPCODE_MVIS: JIT_EmitOp(JIT_OP_MOV, JIT_RAX, JIT_REG_S); JIT_GenDispatch(); return 1;
+
+        // Push instructions
+        case CPU_OPCODE_PUBI: JIT_GenPushByteFrom(JIT_MODE_I); break;
+        case CPU_OPCODE_PUBD: JIT_GenPushByteFrom(JIT_MODE_D); break;
+        case CPU_OPCODE_PUBRA: JIT_GenPushByteFrom(JIT_MODE_RA); break;
+        case CPU_OPCODE_PUBRB: JIT_GenPushByteFrom(JIT_MODE_RB); break;
+        case CPU_OPCODE_PUBXA: JIT_GenPushByteFrom(JIT_MODE_XA); break;
+        case CPU_OPCODE_PUBXB: JIT_GenPushByteFrom(JIT_MODE_XB); break;
+        case CPU_OPCODE_PUBYA: JIT_GenPushByteFrom(JIT_MODE_YA); break;
+        case CPU_OPCODE_PUBYB: JIT_GenPushByteFrom(JIT_MODE_YB); break;
+
+        case CPU_OPCODE_PUSI: JIT_GenPushShortFrom(JIT_MODE_I); break;
+        case CPU_OPCODE_PUSD: JIT_GenPushShortFrom(JIT_MODE_D); break;
+        case CPU_OPCODE_PUSRA: JIT_GenPushShortFrom(JIT_MODE_RA); break;
+        case CPU_OPCODE_PUSRB: JIT_GenPushShortFrom(JIT_MODE_RB); break;
+        case CPU_OPCODE_PUSXA: JIT_GenPushShortFrom(JIT_MODE_XA); break;
+        case CPU_OPCODE_PUSXB: JIT_GenPushShortFrom(JIT_MODE_XB); break;
+        case CPU_OPCODE_PUSYA: JIT_GenPushShortFrom(JIT_MODE_YA); break;
+        case CPU_OPCODE_PUSYB: JIT_GenPushShortFrom(JIT_MODE_YB); break;
+
+        case CPU_OPCODE_PUA: JIT_GenPushRegister(JIT_REG_A); break;
+        case CPU_OPCODE_PUB: JIT_GenPushRegister(JIT_REG_B); break;
+        case CPU_OPCODE_PUS: JIT_GenSpill(); JIT_GenPushRegister(JIT_REG_S); break;
+        case CPU_OPCODE_PUI: JIT_EmitMovImm(JIT_RAX, jit->pc); JIT_GenPushShort(); break;
+
+        // Pop instructions
+        case CPU_OPCODE_POBD: JIT_GenPopByteTo(JIT_MODE_D); break;
+        case CPU_OPCODE_POBRA: JIT_GenPopByteTo(JIT_MODE_RA); break;
+        case CPU_OPCODE_POBRB: JIT_GenPopByteTo(JIT_MODE_RB); break;
+        case CPU_OPCODE_POBXA: JIT_GenPopByteTo(JIT_MODE_XA); break;
+        case CPU_OPCODE_POBXB: JIT_GenPopByteTo(JIT_MODE_XB); break;
+        case CPU_OPCODE_POBYA: JIT_GenPopByteTo(JIT_MODE_YA); break;
+        case CPU_OPCODE_POBYB: JIT_GenPopByteTo(JIT_MODE_YB); break;
+
+        case CPU_OPCODE_POSD: JIT_GenPopShortTo(JIT_MODE_D); break;
+        case CPU_OPCODE_POSRA: JIT_GenPopShortTo(JIT_MODE_RA); break;
+        case CPU_OPCODE_POSRB: JIT_GenPopShortTo(JIT_MODE_RB); break;
+        case CPU_OPCODE_POSXA: JIT_GenPopShortTo(JIT_MODE_XA); break;
+        case CPU_OPCODE_POSXB: JIT_GenPopShortTo(JIT_MODE_XB); break;
+        case CPU_OPCODE_POSYA: JIT_GenPopShortTo(JIT_MODE_YA); break;
+        case CPU_OPCODE_POSYB: JIT_GenPopShortTo(JIT_MODE_YB); break;
+
+        case CPU_OPCODE_POA: JIT_GenPopShort(); JIT_EmitOp(JIT_OP_MOV, JIT_REG_A, JIT_RAX); break;
+        case CPU_OPCODE_POB: JIT_GenPopShort(); JIT_EmitOp(JIT_OP_MOV, JIT_REG_B, JIT_RAX); break;
+        case CPU_OPCODE_POS: JIT_GenPopShort(); JIT_GenDropTop(); JIT_EmitOp(JIT_OP_MOV, JIT_REG_S, JIT_RAX); break;
+        case CPU_OPCODE_POI: JIT_GenPopShort(); JIT_GenDispatch(); return 1;
+
+        // Stack instructions
+        case CPU_OPCODE_DTS: JIT_GenTopLoad(1); JIT_GenPushByte(); break;
+
+        case CPU_OPCODE_STS:
+            // Pops the short and pushes it back with rol ax, 8 swapping the two bytes
+            JIT_GenPopShort();
+
+            JIT_EmitByte(0x66);
+            JIT_EmitShift(JIT_EXT_ROL, JIT_RAX, 8);
+
+            JIT_GenPushShort();
+            break;
+
+        // Indexing register instructions
+        case CPU_OPCODE_IRA: JIT_EmitOpImm16(JIT_EXT_ADD, JIT_REG_A, 1); break;
+        case CPU_OPCODE_IRB: JIT_EmitOpImm16(JIT_EXT_ADD, JIT_REG_B, 1); break;
+        case CPU_OPCODE_IRS: JIT_GenDropTop(); JIT_EmitOpImm16(JIT_EXT_ADD, JIT_REG_S, 1); break;
+
+        case CPU_OPCODE_DRA: JIT_EmitOpImm16(JIT_EXT_SUB, JIT_REG_A, 1); break;
+        case CPU_OPCODE_DRB: JIT_EmitOpImm16(JIT_EXT_SUB, JIT_REG_B, 1); break;
+        case CPU_OPCODE_DRS: JIT_GenDropTop(); JIT_EmitOpImm16(JIT_EXT_SUB, JIT_REG_S, 1); break;
+
+        // 8 - bit ALU instructions
+        case CPU_OPCODE_ADB: JIT_GenBinary(JIT_ALU_AD, 8); break;
+        case CPU_OPCODE_SUB: JIT_GenBinary(JIT_ALU_SU, 8); break;
+        case CPU_OPCODE_ANB: JIT_GenBinary(JIT_ALU_AN, 8); break;
+        case CPU_OPCODE_ORB: JIT_GenBinary(JIT_ALU_OR, 8); break;
+        case CPU_OPCODE_XRB: JIT_GenBinary(JIT_ALU_XR, 8); break;
+        case CPU_OPCODE_CPB: JIT_GenBinary(JIT_ALU_CP, 8); break;
+        case CPU_OPCODE_IVB: JIT_GenUnary(JIT_ALU_IV, 8); break;
+        case CPU_OPCODE_ICB: JIT_GenUnary(JIT_ALU_IC, 8); break;
+        case CPU_OPCODE_DCB: JIT_GenUnary(JIT_ALU_DC, 8); break;
+        case CPU_OPCODE_RLB: JIT_GenUnary(JIT_ALU_RL, 8); break;
+        case CPU_OPCODE_RRB: JIT_GenUnary(JIT_ALU_RR, 8); break;
+        case CPU_OPCODE_SLB: JIT_GenUnary(JIT_ALU_SL, 8); break;
+        case CPU_OPCODE_SRB: JIT_GenUnary(JIT_ALU_SR, 8); break;
+        case CPU_OPCODE_SAB: JIT_GenUnary(JIT_ALU_SA, 8); break;
+
+        // 16 - bit ALU instructions
+        case CPU_OPCODE_ADS: JIT_GenBinary(JIT_ALU_AD, 16); break;
+        case CPU_OPCODE_SUS: JIT_GenBinary(JIT_ALU_SU, 16); break;
+        case CPU_OPCODE_ANS: JIT_GenBinary(JIT_ALU_AN, 16); break;
+        case CPU_OPCODE_ORS: JIT_GenBinary(JIT_ALU_OR, 16); break;
+        case CPU_OPCODE_XRS: JIT_GenBinary(JIT_ALU_XR, 16); break;
+        case CPU_OPCODE_CPS: JIT_GenBinary(JIT_ALU_CP, 16); break;
+        case CPU_OPCODE_IVS: JIT_GenUnary(JIT_ALU_IV, 16); break;
+        case CPU_OPCODE_ICS: JIT_GenUnary(JIT_ALU_IC, 16); break;
+        case CPU_OPCODE_DCS: JIT_GenUnary(JIT_ALU_DC, 16); break;
+        case CPU_OPCODE_RLS: JIT_GenUnary(JIT_ALU_RL, 16); break;
+        case CPU_OPCODE_RRS: JIT_GenUnary(JIT_ALU_RR, 16); break;
+        case CPU_OPCODE_SLS: JIT_GenUnary(JIT_ALU_SL, 16); break;
+        case CPU_OPCODE_SRS: JIT_GenUnary(JIT_ALU_SR, 16); break;
+        case CPU_OPCODE_SAS: JIT_GenUnary(JIT_ALU_SA, 16); break;
+
+        // Status flag instructions
+        case CPU_OPCODE_SFZ: JIT_GenSetFlag(0, 1); break;
+        case CPU_OPCODE_SFC: JIT_GenSetFlag(1, 1); break;
+        case CPU_OPCODE_SFS: JIT_GenSetFlag(2, 1); break;
+        case CPU_OPCODE_SFV: JIT_GenSetFlag(3, 1); break;
+
+        case CPU_OPCODE_CFZ: JIT_GenSetFlag(0, 0); break;
+        case CPU_OPCODE_CFC: JIT_GenSetFlag(1, 0); break;
+        case CPU_OPCODE_CFS: JIT_GenSetFlag(2, 0); break;
+        case CPU_OPCODE_CFV: JIT_GenSetFlag(3, 0); break;
+
+        // Branching instructions
+        case CPU_OPCODE_JM: JIT_GenLink(JIT_CC_ALWAYS, JIT_FetchShort()); return 1;
+        case CPU_OPCODE_CA: address = JIT_FetchShort(); JIT_GenCall(address); return 1;
+        case CPU_OPCODE_RT: JIT_GenPopShort(); JIT_GenDispatch(); return 1;
+
+        case CPU_OPCODE_SIA: JIT_GenCall(0x0000); return 1;
+        case CPU_OPCODE_SIB: JIT_GenCall(0x0008); return 1;
+        case CPU_OPCODE_SIC: JIT_GenCall(0x0010); return 1;
+        case CPU_OPCODE_SID: JIT_GenCall(0x0018); return 1;
+        case CPU_OPCODE_SIE: JIT_GenCall(0x0020); return 1;
+        case CPU_OPCODE_SIF: JIT_GenCall(0x0028); return 1;
+        case CPU_OPCODE_SIG: JIT_GenCall(0x0030); return 1;
+        case CPU_OPCODE_SIH: JIT_GenCall(0x0038); return 1;
+
+        // Conditional branching instructions
+        case CPU_OPCODE_JMZ:
+        case CPU_OPCODE_JMC:
+        case CPU_OPCODE_JMS:
+        case CPU_OPCODE_JMV:
+        case CPU_OPCODE_JMNZ:
+        case CPU_OPCODE_JMNC:
+        case CPU_OPCODE_JMNS:
+        case CPU_OPCODE_JMNV:
+            address = JIT_FetchShort();
+            cc = JIT_GenCondition(opcode - CPU_OPCODE_JMZ);
+
+            JIT_GenLink(cc, address);
+            JIT_GenLink(JIT_CC_ALWAYS, jit->pc);
+
+            return 1;
+
+        case CPU_OPCODE_CAZ:
+        case CPU_OPCODE_CAC:
+        case CPU_OPCODE_CAS:
+        case CPU_OPCODE_CAV:
+        case CPU_OPCODE_CANZ:
+        case CPU_OPCODE_CANC:
+        case CPU_OPCODE_CANS:
+        case CPU_OPCODE_CANV:
+            address = JIT_FetchShort();
+            cc = JIT_GenCondition(opcode - CPU_OPCODE_CAZ);
+
+            // Skip the call when the condition fails
+            JIT_GenLink(cc ^ 1, jit->pc);
+            JIT_GenCall(address);
+
+            return 1;
+
+        case CPU_OPCODE_RTZ:
+        case CPU_OPCODE_RTC:
+        case CPU_OPCODE_RTS:
+        case CPU_OPCODE_RTV:
+        case CPU_OPCODE_RTNZ:
+        case CPU_OPCODE_RTNC:
+        case CPU_OPCODE_RTNS:
+        case CPU_OPCODE_RTNV:
+            cc = JIT_GenCondition(opcode - CPU_OPCODE_RTZ);
+
+            JIT_GenLink(cc ^ 1, jit->pc);
+            JIT_GenPopShort();
+            JIT_GenDispatch();
+
+            return 1;
+
+        // Miscellaneous instructions
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+// Function to find if an instruction needs the top register spilled or its pushes tested ahead of it, translating it without keeping the code
+static void JIT_Probe(unsigned char opcode) {
+    jit->spill = 0;
+    jit->untested = 0;
+
+    if (!jit->top.pending && jit->test >= 0) return;
+
+    unsigned char *emit = jit->emit;
+    unsigned short pc = jit->pc;
+    int stubCount = jit->stubCount;
+    int deferCount = jit->deferCount;
+    JITTop top = jit->top;
+    int depth = jit->depth;
+    int test = jit->test;
+
+    // A covering test is only widened, by the same pushes the kept translation makes
+    jit->dropped = 0;
+    jit->pc++;
+
+    JIT_Translate(opcode);
+
+    jit->emit = emit;
+    jit->pc = pc;
+    jit->stubCount = stubCount;
+    jit->deferCount = deferCount;
+    jit->top = top;
+    jit->depth = depth;
+    jit->test = test;
+    jit->call = 0;
+    jit->callTarget = 0;
+}
+
+// Function to check if an instruction is translated
+static int JIT_IsTranslated(unsigned char opcode) {
+    switch (opcode) {
+        // Flag register, halt and I/O instructions run through the opcode table
+        case CPU_OPCODE_PUF:
+        case CPU_OPCODE_POF:
+        case CPU_OPCODE_EI:
+        case CPU_OPCODE_DI:
+        case CPU_OPCODE_HT:
+        case CPU_OPCODE_IPB:
+        case CPU_OPCODE_OPB:
+        case CPU_OPCODE_IPS:
+        case CPU_OPCODE_OPS:
+            return 0;
+
+        default:
+            return 1;
+    }
+}
+
+/*
+    Translation cache functions
+*/
+
+// Function to drop every translated block
+static void JIT_Flush(void) {
+    memset(jit->block, 0, sizeof(jit->block));
+
+    for (int page = 0; page < MEMORY_PAGE_COUNT; page++)
+        Memory_ClearCodePage(page);
+
+    jit->emit = jit->blocks;
+    jit->generation++;
+}
+
+// Function called on writes to translated code from outside a block
+static void JIT_CodeWrite(unsigned short address) {
+    JIT_Flush();
+}
+
+// Function to emit the exit stubs of the block being translated
+static void JIT_EmitStubs(void) {
+    for (int i = 0; i < jit->stubCount; i++) {
+        JITStub *stub = &jit->stub[i];
+
+        JIT_PatchJump(stub->site, jit->emit);
+
+        JIT_EmitGuestImm(JIT_GUEST(i), stub->i);
+
+        switch (stub->exit) {
+            case JIT_EXIT_LINK:
+                // Record the jump to patch once the target is translated
+                JIT_EmitByte(0x48);
+                JIT_EmitByte(0xB8);
+                JIT_EmitQuad((unsigned long long) stub->site);
+
+                JIT_EmitGuest(JIT_GUEST_STORE, 1, JIT_RAX, JIT_GUEST(link));
+                break;
+
+            case JIT_EXIT_WRITE:
+            case JIT_EXIT_STACK:
+                // Give back the instructions after the writing one, or from the tested one on; add rbp, imm32
+                JIT_EmitByte(0x48);
+                JIT_EmitByte(0x81);
+                JIT_EmitByte(0xC5);
+                JIT_EmitLong(jit->count - stub->refund);
+
+                // Take their cycles back off the clock
+                JIT_EmitGuestOpImm(5, JIT_GUEST(cycles), jit->cycles - stub->cycles);
+                break;
+
+            default:
+                break;
+        }
+
+        JIT_EmitGuestImm(JIT_GUEST(exit), stub->exit);
+        JIT_PatchJump(JIT_EmitJump(JIT_CC_ALWAYS), jit->epilogue);
+    }
+}
+
+// Function to translate the block at an address, returning NULL if its first instruction isn't translated
+static unsigned char *JIT_Compile(unsigned short address) {
+    if (!JIT_IsTranslated(Memory_FetchByte(jit->pages, address))) return NULL;
+
+    if (jit->code + JIT_CODE_SIZE - jit->emit < JIT_BLOCK_MAX_SIZE) JIT_Flush();
+
+    unsigned char *block = jit->emit;
+
+    jit->pc = address;
+    jit->count = 0;
+    jit->cycles = 0;
+    jit->stubCount = 0;
+
+    jit->deferCount = 0;
+
+    // Blocks can be entered from anywhere, so nothing is held on entry
+    jit->top.size = 0;
+    jit->top.pending = 0;
+
+    jit->depth = 0;
+    jit->test = -1;
+
+    // Exit before the block if the batch can't fit it; cmp rbp, imm32; jb; sub rbp, imm32
+    JIT_EmitByte(0x48);
+    JIT_EmitByte(0x81);
+    JIT_EmitByte(0xFD);
+
+    unsigned char *countCompare = jit->emit;
+
+    JIT_EmitLong(0);
+    JIT_AddStub(JIT_EmitJump(JIT_CC_B), JIT_EXIT_BUDGET, address);
+
+    JIT_EmitByte(0x48);
+    JIT_EmitByte(0x81);
+    JIT_EmitByte(0xED);
+
+    unsigned char *countSubtract = jit->emit;
+
+    JIT_EmitLong(0);
+
+    // Advance the clock by the cycles of the whole block; add qword [guest + cycles], imm32
+    JIT_EmitGuestOpImm(0, JIT_GUEST(cycles), 0);
+
+    unsigned char *cyclesAdd = jit->emit - 4;
+
+    // Translate instructions until a branch or an untranslated instruction
+    for (;;) {
+        unsigned short start = jit->pc;
+        unsigned char opcode = Memory_FetchByte(jit->pages, start);
+
+        jit->call = 0;
+        jit->callTarget = 0;
+
+        JIT_Probe(opcode);
+
+        // Nothing may be held on the exit of the test either
+        if (jit->spill || jit->untested) JIT_GenSpillAt(start);
+        if (jit->untested) JIT_GenStackTest(start);
+
+        int stubStart = jit->stubCount;
+
+        JIT_FetchByte();
+
+        jit->count++;
+        jit->cycles += CPU_GetCycleCost(opcode);
+
+        int end = JIT_Translate(opcode);
+
+        // Operands are fetched during translation, so the next instruction is only known now
+        for (int i = stubStart; i < jit->stubCount; i++)
+            if (jit->stub[i].next) jit->stub[i].i = jit->pc;
+
+        Memory_SetCode(start, (unsigned short) (jit->pc - start));
+
+        if (end) break;
+
+        if (jit->count == JIT_BLOCK_MAX_INSTRUCTIONS || !JIT_IsTranslated(Memory_FetchByte(jit->pages, jit->pc))) {
+            JIT_GenSpillAt(jit->pc);
+            JIT_GenLink(JIT_CC_ALWAYS, jit->pc);
+            break;
+        }
+    }
+
+    // Tests take the distance from the block start past the range against the sizes of both, wrapping like addresses do
+    for (int i = 0; i < jit->deferCount; i++) {
+        JITDefer *defer = &jit->defer[i];
+        int size = defer->high - defer->low;
+        int displacement = defer->high - 1 - defer->depth - address;
+        unsigned limit = size ? (unsigned short) (jit->pc - address) + size - 1 : 0;
+
+        memcpy(defer->displacement, &displacement, 4);
+        memcpy(defer->limit, &limit, 4);
+
+        if (!defer->lowPage) continue;
+
+        int low = defer->low - defer->depth;
+        int high = defer->high - 1 - defer->depth;
+
+        memcpy(defer->lowPage, &low, 4);
+        memcpy(defer->highPage, &high, 4);
+    }
+
+    memcpy(countCompare, &jit->count, 4);
+    memcpy(countSubtract, &jit->count, 4);
+    memcpy(cyclesAdd, &jit->cycles, 4);
+
+    JIT_EmitStubs();
+
+    jit->block[address] = block;
+
+    return block;
+}
+
+/*
+    Memory access functions, called from blocks through thunks when the page table has no entry for an access
+*/
+
+static unsigned JIT_ReadByte(unsigned address) {
+    return Memory_ReadByte(jit->pages, address);
+}
+
+static unsigned JIT_ReadShort(unsigned address) {
+    return Memory_ReadShort(jit->pages, address);
+}
+
+// Function to write a byte, returning 1 if the block has to exit
+static unsigned JIT_WriteByte(unsigned address, unsigned value) {
+    // The cache is flushed right away, the block only returns through its exit stub
+    if (Memory_StoreByte(jit->pages, address, value)) {
+        Memory_NotifyCodeWrite(address);
+
+        return 1;
+    }
+
+    // A device may have remapped memory or raised an interrupt, which the interpreter would see before the next instruction
+    return Memory_HasDevice(address >> MEMORY_PAGE_SIZE_SHIFT);
+}
+
+static unsigned JIT_WriteShort(unsigned address, unsigned value) {
+    unsigned exit = JIT_WriteByte(address, value & 0xFF);
+
+    return JIT_WriteByte((unsigned short) (address + 1), value >> 8) | exit;
+}
+
+// Function to write the bytes held by the top register, whose count the thunk leaves in edx
+static unsigned JIT_WriteTop(unsigned address, unsigned value, unsigned size) {
+    unsigned exit = 0;
+
+    for (unsigned i = 0; i < size; i++) exit |= JIT_WriteByte((unsigned short) (address + i), (value >> (i * 8)) & 0xFF);
+
+    return exit;
+}
+
+// Function to emit a thunk calling a memory access function with the System V calling convention
+// Loads take the address in eax and return the byte or short in eax, stores take the address in ecx and the value in eax and return the exit flag in ecx
+// The third argument of a function is passed through in edx
+static unsigned char *JIT_EmitThunk(void *function, int store) {
+    // The guest state registers the function may clobber, an even number to keep the stack aligned after the call into the thunk
+    static const int LOAD_SAVED[] = { JIT_RCX, JIT_RDX, JIT_RSI, JIT_RDI, JIT_R8, JIT_R9, JIT_R10, JIT_R11 };
+    static const int STORE_SAVED[] = { JIT_RAX, JIT_RDX, JIT_RSI, JIT_RDI, JIT_R8, JIT_R9, JIT_R10, JIT_R11 };
+
+    const int *saved = store ? STORE_SAVED : LOAD_SAVED;
+    unsigned char *thunk = jit->emit;
+
+    for (int i = 0; i < 8; i++) {
+        JIT_EmitRex(0, 0, 0, saved[i]);
+        JIT_EmitByte(0x50 + (saved[i] & 7));
+    }
+
+    if (store) {
+        JIT_EmitOp(JIT_OP_MOV, JIT_RDI, JIT_RCX);
+        JIT_EmitOp(JIT_OP_MOV, JIT_RSI, JIT_RAX);
+    } else {
+        JIT_EmitOp(JIT_OP_MOV, JIT_RDI, JIT_RAX);
+    }
+
+    // mov rax, function; call rax
+    JIT_EmitByte(0x48);
+    JIT_EmitByte(0xB8);
+    JIT_EmitQuad((unsigned long long) function);
+
+    JIT_EmitByte(0xFF);
+    JIT_EmitByte(0xD0);
+
+    if (store) JIT_EmitOp(JIT_OP_MOV, JIT_RCX, JIT_RAX);
+
+    for (int i = 7; i >= 0; i--) {
+        JIT_EmitRex(0, 0, 0, saved[i]);
+        JIT_EmitByte(0x58 + (saved[i] & 7));
+    }
+
+    // ret
+    JIT_EmitByte(0xC3);
+
+    return thunk;
+}
+
+// Function to emit the code entering and leaving translated blocks
+static void JIT_EmitTrampoline(void) {
+    static const int SAVED[] = { JIT_RBX, JIT_RBP, JIT_R12, JIT_R13, JIT_R14, JIT_R15 };
+
+    jit->enter = (void (*)(JITGuest *, const unsigned char *)) jit->emit;
+
+    // Save the callee - saved registers
+    for (int i = 0; i < 6; i++) {
+        JIT_EmitRex(0, 0, 0, SAVED[i]);
+        JIT_EmitByte(0x50 + (SAVED[i] & 7));
+    }
+
+    JIT_EmitGuest(JIT_GUEST_LOAD, 1, JIT_REG_PAGES, JIT_GUEST(pages));
+    JIT_EmitGuest(JIT_GUEST_LOAD, 1, JIT_REG_REMAINING, JIT_GUEST(remaining));
+
+    JIT_EmitGuest(JIT_GUEST_LOAD, 0, JIT_REG_A, JIT_GUEST(a));
+    JIT_EmitGuest(JIT_GUEST_LOAD, 0, JIT_REG_B, JIT_GUEST(b));
+    JIT_EmitGuest(JIT_GUEST_LOAD, 0, JIT_REG_S, JIT_GUEST(s));
+
+    for (int flag = 0; flag < 4; flag++)
+        JIT_EmitGuest(JIT_GUEST_LOAD, 0, JIT_REG_FLAG + flag, JIT_GUEST(flag) + 4 * flag);
+
+    // jmp rsi
+    JIT_EmitByte(0xFF);
+    JIT_EmitByte(0xE0 | JIT_RSI);
+
+    // Store the guest state back and restore the callee - saved registers
+    jit->epilogue = jit->emit;
+
+    JIT_EmitGuest(JIT_GUEST_STORE, 1, JIT_REG_REMAINING, JIT_GUEST(remaining));
+
+    JIT_EmitGuest(JIT_GUEST_STORE, 0, JIT_REG_A, JIT_GUEST(a));
+    JIT_EmitGuest(JIT_GUEST_STORE, 0, JIT_REG_B, JIT_GUEST(b));
+    JIT_EmitGuest(JIT_GUEST_STORE, 0, JIT_REG_S, JIT_GUEST(s));
+
+    for (int flag = 0; flag < 4; flag++)
+        JIT_EmitGuest(JIT_GUEST_STORE, 0, JIT_REG_FLAG + flag, JIT_GUEST(flag) + 4 * flag);
+
+    for (int i = 5; i >= 0; i--) {
+        JIT_EmitRex(0, 0, 0, SAVED[i]);
+        JIT_EmitByte(0x58 + (SAVED[i] & 7));
+    }
+
+    // ret
+    JIT_EmitByte(0xC3);
+
+    jit->readByte = JIT_EmitThunk(JIT_ReadByte, 0);
+    jit->readShort = JIT_EmitThunk(JIT_ReadShort, 0);
+    jit->writeByte = JIT_EmitThunk(JIT_WriteByte, 1);
+    jit->writeShort = JIT_EmitThunk(JIT_WriteShort, 1);
+    jit->writeTop = JIT_EmitThunk(JIT_WriteTop, 1);
+
+    jit->blocks = jit->emit;
+}
+
+/*
+    Guest state functions
+*/
+
+static void JIT_LoadState(void) {
+    CPUState state;
+
+    CPU_GetState(&state);
+
+    jit->guest.a = state.a;
+    jit->guest.b = state.b;
+    jit->guest.s = state.s;
+    jit->guest.i = state.i;
+
+    jit->guest.cycles = state.cycles;
+
+    jit->guest.flag[0] = !!(state.f & CPU_FLAG_Z);
+    jit->guest.flag[1] = !!(state.f & CPU_FLAG_C);
+    jit->guest.flag[2] = !!(state.f & CPU_FLAG_S);
+    jit->guest.flag[3] = !!(state.f & CPU_FLAG_V);
+
+    jit->guest.flags = state.f & ~(CPU_FLAG_Z | CPU_FLAG_C | CPU_FLAG_S | CPU_FLAG_V);
+}
+
+static void JIT_StoreState(void) {
+    CPUState state;
+
+    state.a = jit->guest.a;
+    state.b = jit->guest.b;
+    state.s = jit->guest.s;
+    state.i = jit->guest.i;
+
+    state.cycles = jit->guest.cycles;
+
+    state.f = jit->guest.flags;
+
+    if (jit->guest.flag[0]) state.f |= CPU_FLAG_Z;
+    if (jit->guest.flag[1]) state.f |= CPU_FLAG_C;
+    if (jit->guest.flag[2]) state.f |= CPU_FLAG_S;
+    if (jit->guest.flag[3]) state.f |= CPU_FLAG_V;
+
+    CPU_SetState(&state);
+}
+
+// Function to run one instruction through the opcode table, returning 0 if the CPU halted, would accept an interrupt or was stopped
+static int JIT_Interpret(void) {
+    JIT_StoreState();
+    CPU_Execute();
+    JIT_LoadState();
+
+    jit->guest.remaining--;
+
+    return !(jit->guest.flags & CPU_FLAG_H) && !CPU_IsInterruptReady() && !CPU_IsStopped();
+}
+
+#endif
+
+JITContext *JIT_CreateContext(void) {
+    JITContext *context = calloc(1, sizeof(JITContext));
+
+    if (!context) printf("Error: Failed to allocate JIT context\n");
+
+    return context;
+}
+
+void JIT_DestroyContext(JITContext *context) {
+    if (!context) return;
+
+#if JIT_SUPPORTED
+    if (context->code) munmap(context->code, JIT_CODE_SIZE);
+#endif
+
+    if (jit == context) jit = NULL;
+
+    free(context);
+}
+
+void JIT_BindContext(JITContext *context) {
+    jit = context;
+}
+
+int JIT_Init(void) {
+#if JIT_SUPPORTED
+    jit->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (jit->code == MAP_FAILED) {
+        printf("Error: Failed to map JIT code memory\n");
+
+        jit->code = NULL;
+
+        return 0;
+    }
+
+    jit->emit = jit->code;
+    jit->pages = Memory_GetPageTable();
+
+    jit->guest.pages = Memory_GetPageTable();
+
+    JIT_EmitTrampoline();
+    JIT_Flush();
+
+    // Writes to translated code from outside a block flush the cache
+    Memory_RegisterCodeWrite(JIT_CodeWrite);
+
+    return 1;
+#else
+    printf("Error: JIT compiler is only supported on x86 - 64 Linux\n");
+
+    return 0;
+#endif
+}
+
+void JIT_Quit(void) {
+#if JIT_SUPPORTED
+    if (jit->code) munmap(jit->code, JIT_CODE_SIZE);
+
+    jit->code = NULL;
+#endif
+}
+
+int JIT_IsEnabled(void) {
+    return jit && jit->code;
+}
+
+unsigned JIT_Run(unsigned count) {
+#if JIT_SUPPORTED
+    JIT_LoadState();
+
+    if (jit->guest.flags & CPU_FLAG_H) return 0;
+
+    jit->guest.remaining = count;
+
+    // Only interpreted instructions can let an interrupt through, and CPU_Run accepts it, or start a device that stops the run
+    while (jit->guest.remaining && !(jit->guest.flags & CPU_FLAG_H) && !CPU_IsInterruptReady() && !CPU_IsStopped()) {
+        unsigned char *block = jit->block[jit->guest.i];
+
+        if (!block) block = JIT_Compile(jit->guest.i);
+
+        if (!block) {
+            JIT_Interpret();
+            continue;
+        }
+
+        jit->enter(&jit->guest, block);
+
+        switch (jit->guest.exit) {
+            case JIT_EXIT_BUDGET:
+                // Finish the batch one instruction at a time
+                while (jit->guest.remaining && JIT_Interpret());
+
+                break;
+
+            case JIT_EXIT_LINK: {
+                unsigned generation = jit->generation;
+                unsigned char *target = jit->block[jit->guest.i];
+
+                if (!target) target = JIT_Compile(jit->guest.i);
+
+                // Chain the exit straight to the target unless translating it flushed the cache
+                if (target && generation == jit->generation) JIT_PatchJump(jit->guest.link, target);
+
+                break;
+            }
+
+            case JIT_EXIT_STACK:
+                // The rest of the block after the instruction is translated anew, with a test of its own
+                JIT_Interpret();
+
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    JIT_StoreState();
+
+    return count - jit->guest.remaining;
+#else
+    return 0;
+#endif
+}
\ No newline at end of file
@@ -2,37 +2,116 @@
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "cpu.h"
 #include "display.h"
-#include "disk.h"
-#include "memory.h"
-#include "io.h"
+#include "vm.h"
+
+// Number of instructions executed between device updates
+#define MAIN_BATCH_SIZE 10000
+
+// Frame time in milliseconds
+#define MAIN_FRAME_TIME 16
+
+// Number of instructions to execute per frame, 0 to go by the virtual clock
+static unsigned INSTRUCTIONS_PER_FRAME = 0;
+
+// Number of virtual clock cycles per frame, 0 to fill the frame time; 100 MHz by default
+static unsigned long long CYCLES_PER_FRAME = 1600000;
+
+// Virtual clock cycle the current frame ends at
+static unsigned long long FRAME_CYCLES = 0;
+
+// Physical memory in KiB for the bank controller, 0 to run without it
+static unsigned MEMORY_KIB = 0;
+
+// Run the CPU through the JIT compiler flag
+static int USE_JIT = 0;
+
+// I/O log to record to or replay from, NULL for neither
+static const char *RECORD_PATH = NULL;
+static const char *REPLAY_PATH = NULL;
+
+// File to write the profile to, NULL for none
+static const char *PROFILE_PATH = NULL;
+
+// Set by SIGUSR1 to write the profile and carry on
+static volatile sig_atomic_t PROFILE_REQUESTED = 0;
+
+// The machine shown in the window and its display
+static VM *MACHINE = NULL;
+static DisplayContext *DISPLAY = NULL;
+
+// Signal handler function
+static void Main_Signal(int number) {
+    PROFILE_REQUESTED = 1;
+}
 
 SDL_AppResult SDL_AppInit(void **appState, int argc, char **argv) {
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            INSTRUCTIONS_PER_FRAME = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            CYCLES_PER_FRAME = strtoull(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            RECORD_PATH = argv[++i];
+        } else if (!strcmp(argv[i], "-R") && i + 1 < argc) {
+            REPLAY_PATH = argv[++i];
+        } else if (!strcmp(argv[i], "-P") && i + 1 < argc) {
+            PROFILE_PATH = argv[++i];
+        } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            MEMORY_KIB = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-j")) {
+            USE_JIT = 1;
+        } else {
+            printf("Usage: %s [-i instructions_per_frame | -c cycles_per_frame] [-r record.log | -R replay.log] [-P profile.csv] [-m memory_kib] [-j]\n", argv[0]);
+
+            return SDL_APP_FAILURE;
+        }
+    }
+
     // Initialize SDL3
     if (!SDL_Init(SDL_INIT_VIDEO)) return SDL_APP_FAILURE;
 
-    // Initialize the CPU
-    printf("Initializing CPU...\n");
-    if (!CPU_Init()) return SDL_APP_FAILURE;
-
-    // Initialize the memory
-    if (!Memory_Init()) return SDL_APP_FAILURE;
+    // Create the machine, which initializes the CPU, memory, I/O module and disk
+    printf("Initializing machine...\n");
+    MACHINE = VM_Create();
+    if (!MACHINE) return SDL_APP_FAILURE;
 
-    // Initialize I/O module
-    printf("Initializing I/O module...\n");
-    if (!IO_Init()) return SDL_APP_FAILURE;
+    // Add the bank controller
+    if (MEMORY_KIB) {
+        printf("Initializing bank controller...\n");
+        if (!VM_EnableBanks(MACHINE, MEMORY_KIB * 1024)) return SDL_APP_FAILURE;
+    }
 
-    // Initialize the disk
-    printf("Initializing disk...\n");
-    if (!Disk_Init()) return SDL_APP_FAILURE;
+    // Initialize the JIT compiler, falling back to the interpreter if it fails
+    if (USE_JIT) {
+        printf("Initializing JIT compiler...\n");
+        if (!VM_EnableJIT(MACHINE)) printf("Falling back to the interpreter\n");
+    }
 
-    // Initialize the display
+    // Initialize the display, which attaches its ports to the bound machine
     printf("Initializing display...\n");
+    DISPLAY = Display_CreateContext();
+    if (!DISPLAY) return SDL_APP_FAILURE;
+
+    Display_BindContext(DISPLAY);
     if (!Display_Init()) return SDL_APP_FAILURE;
-    
+
+    // Record or replay the devices from here on
+    if (RECORD_PATH && !VM_StartRecording(MACHINE, RECORD_PATH)) return SDL_APP_FAILURE;
+    if (REPLAY_PATH && !VM_StartReplay(MACHINE, REPLAY_PATH)) return SDL_APP_FAILURE;
+
+    // Write the profile on SIGUSR1 where there is one, SDL handles Ctrl - C itself
+#ifdef SIGUSR1
+    signal(SIGUSR1, Main_Signal);
+#endif
+
     printf("Entering main loop...\n");
 
     return SDL_APP_CONTINUE;
@@ -44,6 +123,14 @@ SDL_AppResult SDL_AppEvent(void *appState, SDL_Event *event) {
             return SDL_APP_SUCCESS;
         
         case SDL_EVENT_KEY_DOWN:
+            // Input wakes a halted machine
+            VM_Wake(MACHINE);
+            break;
+
+        case SDL_EVENT_WINDOW_EXPOSED:
+        case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+            // The window lost what was presented before, or must present it at another size
+            Display_Invalidate();
             break;
     
         case SDL_EVENT_KEY_UP:
@@ -65,11 +152,60 @@ SDL_AppResult SDL_AppEvent(void *appState, SDL_Event *event) {
 }
 
 SDL_AppResult SDL_AppIterate(void *appState) {
-    // Update modules
-    Disk_Update();
+    Uint64 frameEnd = SDL_GetTicks() + MAIN_FRAME_TIME;
+    unsigned executed = 0;
+    CPUState state;
+
+    if (PROFILE_REQUESTED && PROFILE_PATH) {
+        VM_Bind(MACHINE);
+        CPU_WriteProfile(PROFILE_PATH);
+    }
+
+    PROFILE_REQUESTED = 0;
+
+    // Running past a frame end shortens the next frame, but frames cut short by a halt or a slow host aren't made up
+    VM_GetState(MACHINE, &state);
+
+    if (state.cycles < FRAME_CYCLES) FRAME_CYCLES = state.cycles;
+
+    FRAME_CYCLES += CYCLES_PER_FRAME;
+
+    // Run the CPU in batches, updating devices in between
+    while (!VM_IsHalted(MACHINE)) {
+        unsigned batch = MAIN_BATCH_SIZE;
+
+        if (INSTRUCTIONS_PER_FRAME) {
+            if (executed >= INSTRUCTIONS_PER_FRAME) break;
+
+            batch = SDL_min(batch, INSTRUCTIONS_PER_FRAME - executed);
+        } else if (CYCLES_PER_FRAME) {
+            VM_GetState(MACHINE, &state);
+
+            if (state.cycles >= FRAME_CYCLES) break;
+
+            // Every instruction costs at least a cycle, so no more instructions run than the frame has cycles left
+            batch = SDL_min(batch, FRAME_CYCLES - state.cycles);
+        }
+
+        executed += VM_Run(MACHINE, batch);
+
+        if (SDL_GetTicks() >= frameEnd) break;
+    }
 
     Display_Draw();
 
+    // Nothing but input can wake an idle machine, so sleep until an event arrives instead of drawing the same frame
+    if (VM_IsHalted(MACHINE)) {
+        SDL_WaitEvent(NULL);
+
+        return SDL_APP_CONTINUE;
+    }
+
+    // Wait out the rest of the frame
+    Uint64 now = SDL_GetTicks();
+
+    if (now < frameEnd) SDL_Delay(frameEnd - now);
+
     return SDL_APP_CONTINUE;
 }
 
@@ -81,7 +217,20 @@ void SDL_AppQuit(void *appState, SDL_AppResult result) {
     else
         printf("Quit successfully!\n");
 
-    Display_Quit();
-    Disk_Quit();
+    if (MACHINE) {
+        VM_Bind(MACHINE);
+        CPU_PrintFusionReport();
+
+        if (CPU_PROFILE || PROFILE_PATH) CPU_PrintProfileReport();
+        if (PROFILE_PATH) CPU_WriteProfile(PROFILE_PATH);
+    }
+
+    VM_Destroy(MACHINE);
+
+    if (DISPLAY) {
+        Display_Quit();
+        Display_DestroyContext(DISPLAY);
+    }
+
     SDL_Quit();
 }
\ No newline at end of file
@@ -1,31 +1,353 @@
 #include "memory.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "utils.h"
 
-// Memory size constants
-#define MEMORY_SIZE 65536
-#define MEMORY_SIZE_MASK (MEMORY_SIZE - 1)
+// Default code write function
+static void MEMORY_CODE_WRITE_DEFAULT(unsigned short address) { return; }
+
+// Memory - mapped device struct, one per page
+typedef struct memory_device_s {
+    unsigned char (*read)(void *user, unsigned short address);
+    void (*write)(void *user, unsigned short address, unsigned char value);
+    void *user;
+} MemoryDevice;
+
+// Memory context struct
+struct memory_context_s {
+    // Memory array
+    unsigned char data[MEMORY_SIZE];
+
+    // Code map, set for bytes holding decoded code
+    unsigned char code[MEMORY_SIZE];
+
+    // Set for pages with any byte marked in the code map
+    unsigned char codePage[MEMORY_PAGE_COUNT];
+
+    // Set for pages backed by the same RAM as another page
+    unsigned char shared[MEMORY_PAGE_COUNT];
+
+    // Dirty flag of each page of the memory array, set when written since the last clear
+    unsigned char dirty[MEMORY_PAGE_COUNT];
+
+    // Dirty flag of the RAM behind each page
+    unsigned char *dirtyFlag[MEMORY_PAGE_COUNT];
+
+    // Device mapped to each page, with NULL functions where there is none
+    MemoryDevice device[MEMORY_PAGE_COUNT];
+
+    MemoryPageTable pages;
+
+    // Function called on writes to decoded code
+    void (*codeWrite)(unsigned short address);
+};
+
+// Memory context bound to the calling thread
+static THREAD_LOCAL MemoryContext *memory = NULL;
+
+MemoryContext *Memory_CreateContext(void) {
+    MemoryContext *context = calloc(1, sizeof(MemoryContext));
+
+    if (!context) {
+        printf("Error: Failed to allocate memory context\n");
+
+        return NULL;
+    }
+
+    context->codeWrite = MEMORY_CODE_WRITE_DEFAULT;
 
-// Memory array
-static unsigned char MEMORY[MEMORY_SIZE];
+    context->pages.code = context->code;
+
+    for (int page = 0; page < MEMORY_PAGE_COUNT; page++) {
+        context->pages.read[page] = &context->data[page << MEMORY_PAGE_SIZE_SHIFT];
+        context->pages.write[page] = &context->data[page << MEMORY_PAGE_SIZE_SHIFT];
+        context->pages.ram[page] = &context->data[page << MEMORY_PAGE_SIZE_SHIFT];
+
+        // Memory starts out dirty, as it was never checkpointed
+        context->dirty[page] = 1;
+        context->dirtyFlag[page] = &context->dirty[page];
+    }
+
+    return context;
+}
+
+void Memory_DestroyContext(MemoryContext *context) {
+    if (memory == context) memory = NULL;
+
+    free(context);
+}
+
+void Memory_BindContext(MemoryContext *context) {
+    memory = context;
+}
 
 int Memory_Init(void) {
     return 1;
 }
 
+// Function to point the page table entries of a page at its RAM, where no device, decoded code or shared RAM is in the way
+static void Memory_UpdatePage(unsigned char page) {
+    unsigned char *data = memory->pages.ram[page];
+    MemoryDevice *device = &memory->device[page];
+
+    memory->pages.read[page] = device->read ? NULL : data;
+    int clean = !*memory->dirtyFlag[page];
+
+    memory->pages.write[page] = device->write || memory->codePage[page] || memory->shared[page] || clean ? NULL : data;
+    memory->pages.slow[page] = device->read || device->write || memory->shared[page] || clean;
+}
+
+// Function to set the dirty flag of the RAM behind a page, letting writes to it take the fast path again
+static void Memory_SetDirty(unsigned char page) {
+    *memory->dirtyFlag[page] = 1;
+    Memory_UpdatePage(page);
+}
+
+// Function to replace a page of the memory array, invalidating decoded code wherever it is mapped if it changes
+static void Memory_LoadPage(unsigned page, const unsigned char *data) {
+    unsigned char *ram = &memory->data[page << MEMORY_PAGE_SIZE_SHIFT];
+
+    // Pages that are unchanged keep their decoded code
+    if (!memcmp(ram, data, MEMORY_PAGE_SIZE)) return;
+
+    memcpy(ram, data, MEMORY_PAGE_SIZE);
+
+    memory->dirty[page] = 1;
+
+    for (unsigned other = 0; other < MEMORY_PAGE_COUNT; other++) {
+        if (memory->pages.ram[other] != ram) continue;
+
+        Memory_UpdatePage(other);
+        Memory_InvalidatePage(other);
+    }
+}
+
+void Memory_LoadData(const unsigned char *data) {
+    for (unsigned page = 0; page < MEMORY_PAGE_COUNT; page++)
+        Memory_LoadPage(page, &data[page << MEMORY_PAGE_SIZE_SHIFT]);
+}
+
+void Memory_GetDirtyMap(unsigned char *map) {
+    memset(map, 0, MEMORY_DIRTY_MAP_SIZE);
+
+    for (unsigned page = 0; page < MEMORY_PAGE_COUNT; page++)
+        if (memory->dirty[page]) map[page >> 3] |= 1 << (page & 7);
+}
+
+void Memory_ClearDirtyMap(void) {
+    memset(memory->dirty, 0, MEMORY_PAGE_COUNT);
+
+    Memory_UpdateDirty();
+}
+
+void Memory_UpdateDirty(void) {
+    for (unsigned page = 0; page < MEMORY_PAGE_COUNT; page++) Memory_UpdatePage(page);
+}
+
+unsigned Memory_GetDeltaSize(void) {
+    unsigned size = MEMORY_DIRTY_MAP_SIZE;
+
+    for (unsigned page = 0; page < MEMORY_PAGE_COUNT; page++)
+        if (memory->dirty[page]) size += MEMORY_PAGE_SIZE;
+
+    return size;
+}
+
+void Memory_SaveDelta(unsigned char *buffer) {
+    Memory_GetDirtyMap(buffer);
+    buffer += MEMORY_DIRTY_MAP_SIZE;
+
+    for (unsigned page = 0; page < MEMORY_PAGE_COUNT; page++) {
+        if (!memory->dirty[page]) continue;
+
+        memcpy(buffer, &memory->data[page << MEMORY_PAGE_SIZE_SHIFT], MEMORY_PAGE_SIZE);
+        buffer += MEMORY_PAGE_SIZE;
+    }
+}
+
+int Memory_CheckDelta(const unsigned char *buffer, unsigned size, unsigned *length) {
+    if (size < MEMORY_DIRTY_MAP_SIZE) return 0;
+
+    *length = MEMORY_DIRTY_MAP_SIZE;
+
+    for (unsigned page = 0; page < MEMORY_PAGE_COUNT; page++)
+        if (buffer[page >> 3] & (1 << (page & 7))) *length += MEMORY_PAGE_SIZE;
+
+    return *length <= size;
+}
+
+unsigned Memory_LoadDelta(const unsigned char *buffer) {
+    const unsigned char *map = buffer;
+    const unsigned char *data = buffer + MEMORY_DIRTY_MAP_SIZE;
+
+    for (unsigned page = 0; page < MEMORY_PAGE_COUNT; page++) {
+        if (!(map[page >> 3] & (1 << (page & 7)))) continue;
+
+        Memory_LoadPage(page, data);
+        data += MEMORY_PAGE_SIZE;
+    }
+
+    return data - buffer;
+}
+
+unsigned char *Memory_GetData(void) {
+    return memory->data;
+}
+
+// Function to report a write to decoded code on the other pages sharing the RAM of a page, returning 1 if there was any
+static int Memory_WriteShared(unsigned short address) {
+    unsigned char page = address >> MEMORY_PAGE_SIZE_SHIFT;
+    unsigned char *ram = memory->pages.ram[page];
+    int written = 0;
+
+    for (int other = 0; other < MEMORY_PAGE_COUNT; other++) {
+        if (other == page || memory->pages.ram[other] != ram) continue;
+
+        unsigned short alias = (other << MEMORY_PAGE_SIZE_SHIFT) | (address & MEMORY_PAGE_SIZE_MASK);
+
+        if (memory->code[alias]) {
+            memory->codeWrite(alias);
+            written = 1;
+        }
+    }
+
+    return written;
+}
+
+const MemoryPageTable *Memory_GetPageTable(void) {
+    return &memory->pages;
+}
+
+unsigned char Memory_ReadSlow(unsigned short address) {
+    MemoryDevice *device = &memory->device[address >> MEMORY_PAGE_SIZE_SHIFT];
+
+    if (device->read) return device->read(device->user, address);
+
+    return Memory_FetchByte(&memory->pages, address);
+}
+
+int Memory_WriteSlow(unsigned short address, unsigned char value) {
+    MemoryDevice *device = &memory->device[address >> MEMORY_PAGE_SIZE_SHIFT];
+
+    if (device->write) {
+        device->write(device->user, address, value);
+
+        return 0;
+    }
+
+    memory->pages.ram[address >> MEMORY_PAGE_SIZE_SHIFT][address & MEMORY_PAGE_SIZE_MASK] = value;
+
+    Memory_SetDirty(address >> MEMORY_PAGE_SIZE_SHIFT);
+
+    // Decoded code on the other pages is invalidated here, the caller only knows about the address it wrote
+    int written = memory->shared[address >> MEMORY_PAGE_SIZE_SHIFT] && Memory_WriteShared(address);
+
+    return written | memory->code[address];
+}
+
+void Memory_NotifyCodeWrite(unsigned short address) {
+    memory->codeWrite(address);
+}
+
+void Memory_SetRAMByte(unsigned short address, unsigned char value) {
+    memory->pages.ram[address >> MEMORY_PAGE_SIZE_SHIFT][address & MEMORY_PAGE_SIZE_MASK] = value;
+
+    Memory_SetDirty(address >> MEMORY_PAGE_SIZE_SHIFT);
+
+    if (memory->shared[address >> MEMORY_PAGE_SIZE_SHIFT]) Memory_WriteShared(address);
+
+    if (memory->code[address]) memory->codeWrite(address);
+}
+
+void Memory_MapRAM(unsigned char page, unsigned char *data, unsigned char *dirty, int shared) {
+    if (!data) data = &memory->data[page << MEMORY_PAGE_SIZE_SHIFT];
+    if (!dirty) dirty = &memory->dirty[(data - memory->data) >> MEMORY_PAGE_SIZE_SHIFT];
+
+    int changed = memory->pages.ram[page] != data;
+
+    memory->pages.ram[page] = data;
+    memory->dirtyFlag[page] = dirty;
+    memory->shared[page] = shared;
+
+    Memory_UpdatePage(page);
+
+    // Decoded code came from the old RAM
+    if (changed) Memory_InvalidatePage(page);
+}
+
+void Memory_InvalidatePage(unsigned char page) {
+    if (!memory->codePage[page]) return;
+
+    // Code write functions invalidate the whole page around the address
+    for (unsigned i = page << MEMORY_PAGE_SIZE_SHIFT; i < (page + 1u) << MEMORY_PAGE_SIZE_SHIFT; i++) {
+        if (memory->code[i]) {
+            memory->codeWrite(i);
+            break;
+        }
+    }
+}
+
+void Memory_MapDevice(unsigned char page, unsigned char (*read)(void *user, unsigned short address), void (*write)(void *user, unsigned short address, unsigned char value), void *user) {
+    memory->device[page].read = read;
+    memory->device[page].write = write;
+    memory->device[page].user = user;
+
+    Memory_UpdatePage(page);
+}
+
+void Memory_UnmapDevice(unsigned char page) {
+    Memory_MapDevice(page, NULL, NULL, NULL);
+}
+
+int Memory_HasDevice(unsigned char page) {
+    return memory->device[page].read || memory->device[page].write;
+}
+
 unsigned char Memory_GetByte(unsigned short address) {
-    return MEMORY[address & MEMORY_SIZE_MASK];
+    return Memory_ReadByte(&memory->pages, address);
 }
 
 void Memory_SetByte(unsigned short address, unsigned char value) {
-    MEMORY[address & MEMORY_SIZE_MASK] = value;
+    // Writes to decoded code notify the CPU from the slow path
+    Memory_WriteByte(&memory->pages, address, value);
 }
 
 unsigned short Memory_GetShort(unsigned short address) {
-    return TO_SHORT(Memory_GetByte(address), Memory_GetByte(address + 1));
+    return Memory_ReadShort(&memory->pages, address);
 }
 
 void Memory_SetShort(unsigned short address, unsigned short value) {
-    Memory_SetByte(address, SHORT_LO(value));
-    Memory_SetByte(address + 1, SHORT_HI(value));
+    Memory_WriteShort(&memory->pages, address, value);
+}
+
+void Memory_SetCode(unsigned short address, unsigned char length) {
+    for (unsigned char i = 0; i < length; i++) {
+        unsigned short byte = address + i;
+
+        memory->code[byte] = 1;
+
+        // Writes to the page take the slow path, which checks the code map
+        if (!memory->codePage[byte >> MEMORY_PAGE_SIZE_SHIFT]) {
+            memory->codePage[byte >> MEMORY_PAGE_SIZE_SHIFT] = 1;
+            Memory_UpdatePage(byte >> MEMORY_PAGE_SIZE_SHIFT);
+        }
+    }
+}
+
+void Memory_ClearCodePage(unsigned char page) {
+    memset(&memory->code[page << MEMORY_PAGE_SIZE_SHIFT], 0, MEMORY_PAGE_SIZE);
+
+    memory->codePage[page] = 0;
+    Memory_UpdatePage(page);
+}
+
+const unsigned char *Memory_GetCodeMap(void) {
+    return memory->code;
+}
+
+void Memory_RegisterCodeWrite(void (*funcptr)(unsigned short address)) {
+    memory->codeWrite = funcptr;
 }
\ No newline at end of file
@@ -0,0 +1,649 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "memory.h"
+
+/*
+    Ahead - of - time translator
+
+    Reads a guest image and writes it out as C for the AOT runtime, see
+    aot.h. Code is found by following control flow from the entry points:
+    the reset and restart vectors that fall inside the image, its load
+    address and any given with -e. Jump, call and conditional branch
+    targets start new basic blocks. Jumps through registers or the stack
+    (MVIA, MVIB, MVIS, POI and the returns) end a block without a known
+    target, so code only reached that way needs an -e entry point or runs
+    through the interpreter.
+
+    Each block becomes one function, ending at a branch, before a flag
+    register, halt or I/O instruction, which the interpreter runs, or
+    before the start of another block. The output only needs aot.h, and is
+    linked with the machine objects:
+
+        stackvm-aot -a 0x0100 -o program.c program.bin
+        VM_EnableAOT(vm, &AOT_IMAGE);
+*/
+
+// Maximum number of guest instructions per block, which keeps blocks under 256 bytes
+#define TRANSLATOR_BLOCK_MAX_INSTRUCTIONS 64
+
+// Maximum number of entry points given with -e
+#define TRANSLATOR_MAX_ENTRIES 256
+
+// Operand enum
+typedef enum translator_operand_e {
+    TRANSLATOR_OPERAND_NONE,
+    TRANSLATOR_OPERAND_BYTE,
+    TRANSLATOR_OPERAND_SHORT,
+    TRANSLATOR_OPERAND_D,
+    TRANSLATOR_OPERAND_RA,
+    TRANSLATOR_OPERAND_RB,
+    TRANSLATOR_OPERAND_XA,
+    TRANSLATOR_OPERAND_XB,
+    TRANSLATOR_OPERAND_YA,
+    TRANSLATOR_OPERAND_YB,
+} TranslatorOperand;
+
+// Decoded instruction struct
+typedef struct translator_instruction_s {
+    unsigned address;
+    unsigned char opcode;
+    unsigned char length;
+    TranslatorOperand operand;
+
+    // Immediate byte or short, or the address part of the operand
+    unsigned short value;
+
+    // Address of the next instruction
+    unsigned short next;
+} TranslatorInstruction;
+
+// Operands of the memory addressing modes, in opcode order
+static const TranslatorOperand TRANSLATOR_MODES[7] = {
+    TRANSLATOR_OPERAND_D,
+    TRANSLATOR_OPERAND_RA,
+    TRANSLATOR_OPERAND_RB,
+    TRANSLATOR_OPERAND_XA,
+    TRANSLATOR_OPERAND_XB,
+    TRANSLATOR_OPERAND_YA,
+    TRANSLATOR_OPERAND_YB,
+};
+
+// Register names, in load and store opcode order
+static const char *TRANSLATOR_REGISTER[3] = { "a", "b", "s" };
+
+// Branch conditions, in conditional branch opcode order
+static const char *TRANSLATOR_CONDITION[8] = {
+    "g->zf", "g->cf", "g->sf", "g->vf", "!g->zf", "!g->cf", "!g->sf", "!g->vf",
+};
+
+// Address the image is loaded at
+static unsigned short LOAD_ADDRESS = 0;
+
+// Image bytes and their length, cut off at the end of memory
+static unsigned char IMAGE[MEMORY_SIZE];
+static unsigned IMAGE_LENGTH = 0;
+
+// Entry points given with -e
+static unsigned short ENTRIES[TRANSLATOR_MAX_ENTRIES];
+static int ENTRY_COUNT = 0;
+
+// Set for addresses an instruction was decoded at, and for the ones a block starts at
+static unsigned char DECODED[MEMORY_SIZE];
+static unsigned char LEADER[MEMORY_SIZE];
+
+// Addresses still to follow
+static unsigned short PENDING[MEMORY_SIZE];
+static unsigned PENDING_COUNT = 0;
+
+// Blocks found, by start address
+static unsigned short BLOCKS[MEMORY_SIZE];
+static unsigned BLOCK_COUNT = 0;
+
+// Function to get the operand of an opcode
+static TranslatorOperand Translator_GetOperand(unsigned char opcode) {
+    if (opcode <= CPU_OPCODE_LDSI) return TRANSLATOR_OPERAND_SHORT;
+    if (opcode <= CPU_OPCODE_LDSYB) return TRANSLATOR_MODES[opcode / 3 - 1];
+    if (opcode <= CPU_OPCODE_STSYB) return TRANSLATOR_MODES[(opcode - CPU_OPCODE_STAD) / 3];
+
+    if (opcode == CPU_OPCODE_PUBI) return TRANSLATOR_OPERAND_BYTE;
+    if (opcode == CPU_OPCODE_PUSI) return TRANSLATOR_OPERAND_SHORT;
+
+    if (opcode >= CPU_OPCODE_PUBD && opcode <= CPU_OPCODE_PUBYB) return TRANSLATOR_MODES[opcode - CPU_OPCODE_PUBD];
+    if (opcode >= CPU_OPCODE_PUSD && opcode <= CPU_OPCODE_PUSYB) return TRANSLATOR_MODES[opcode - CPU_OPCODE_PUSD];
+    if (opcode >= CPU_OPCODE_POBD && opcode <= CPU_OPCODE_POBYB) return TRANSLATOR_MODES[opcode - CPU_OPCODE_POBD];
+    if (opcode >= CPU_OPCODE_POSD && opcode <= CPU_OPCODE_POSYB) return TRANSLATOR_MODES[opcode - CPU_OPCODE_POSD];
+
+    if (opcode == CPU_OPCODE_JM || opcode == CPU_OPCODE_CA) return TRANSLATOR_OPERAND_SHORT;
+    if (opcode >= CPU_OPCODE_JMZ && opcode <= CPU_OPCODE_CANV) return TRANSLATOR_OPERAND_SHORT;
+    if (opcode >= CPU_OPCODE_IPB && opcode <= CPU_OPCODE_OPS) return TRANSLATOR_OPERAND_BYTE;
+
+    return TRANSLATOR_OPERAND_NONE;
+}
+
+// Function to decode the instruction at an address, failing if it doesn't fit in the image
+static int Translator_Decode(unsigned address, TranslatorInstruction *instruction) {
+    if (address < LOAD_ADDRESS || address >= LOAD_ADDRESS + IMAGE_LENGTH) return 0;
+
+    const unsigned char *data = IMAGE + (address - LOAD_ADDRESS);
+
+    instruction->address = address;
+    instruction->opcode = data[0];
+    instruction->operand = Translator_GetOperand(data[0]);
+    instruction->value = 0;
+
+    switch (instruction->operand) {
+        case TRANSLATOR_OPERAND_NONE:
+        case TRANSLATOR_OPERAND_RA:
+        case TRANSLATOR_OPERAND_RB:
+            instruction->length = 1;
+            break;
+
+        case TRANSLATOR_OPERAND_BYTE:
+            instruction->length = 2;
+            break;
+
+        default:
+            instruction->length = 3;
+            break;
+    }
+
+    if (address + instruction->length > LOAD_ADDRESS + IMAGE_LENGTH) return 0;
+
+    if (instruction->length == 2) instruction->value = data[1];
+    if (instruction->length == 3) instruction->value = data[1] | (data[2] << 8);
+
+    instruction->next = address + instruction->length;
+
+    return 1;
+}
+
+// Function to check if an opcode runs through the interpreter, as the JIT compiler leaves the same ones
+static int Translator_IsInterpreted(unsigned char opcode) {
+    switch (opcode) {
+        case CPU_OPCODE_PUF:
+        case CPU_OPCODE_POF:
+        case CPU_OPCODE_EI:
+        case CPU_OPCODE_DI:
+        case CPU_OPCODE_HT:
+        case CPU_OPCODE_IPB:
+        case CPU_OPCODE_OPB:
+        case CPU_OPCODE_IPS:
+        case CPU_OPCODE_OPS:
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+// Function to check if an opcode ends a block, as every change of i does
+static int Translator_IsBranch(unsigned char opcode) {
+    if (opcode >= CPU_OPCODE_MVIA && opcode <= CPU_OPCODE_MVIS) return 1;
+    if (opcode == CPU_OPCODE_POI) return 1;
+
+    return opcode >= CPU_OPCODE_JM && opcode <= CPU_OPCODE_RTNV;
+}
+
+// Function to check if a branch may carry on at the next instruction, counting calls that return there
+static int Translator_FallsThrough(unsigned char opcode) {
+    return opcode == CPU_OPCODE_CA || (opcode >= CPU_OPCODE_SIA && opcode <= CPU_OPCODE_RTNV);
+}
+
+// Function to check if an opcode may write memory
+static int Translator_IsWrite(unsigned char opcode) {
+    if (opcode >= CPU_OPCODE_STAD && opcode <= CPU_OPCODE_STSYB) return 1;
+    if (opcode >= CPU_OPCODE_PUBI && opcode <= CPU_OPCODE_PUF) return 1;
+    if (opcode >= CPU_OPCODE_POBD && opcode <= CPU_OPCODE_POSYB) return 1;
+    if (opcode == CPU_OPCODE_DTS || opcode == CPU_OPCODE_STS) return 1;
+
+    // ALU instructions push their result, except the compares
+    if (opcode == CPU_OPCODE_CPB || opcode == CPU_OPCODE_CPS) return 0;
+
+    return opcode >= CPU_OPCODE_ADB && opcode <= CPU_OPCODE_SAS;
+}
+
+// Function to mark an address as starting a block and follow the code from it
+static void Translator_AddLeader(unsigned address) {
+    address &= MEMORY_SIZE_MASK;
+
+    if (LEADER[address]) return;
+
+    LEADER[address] = 1;
+    PENDING[PENDING_COUNT++] = address;
+}
+
+// Function to follow control flow from every pending address
+static void Translator_Explore(void) {
+    while (PENDING_COUNT) {
+        unsigned address = PENDING[--PENDING_COUNT];
+        TranslatorInstruction instruction;
+
+        while (!DECODED[address] && Translator_Decode(address, &instruction)) {
+            unsigned char opcode = instruction.opcode;
+
+            DECODED[address] = 1;
+
+            if (opcode == CPU_OPCODE_JM || opcode == CPU_OPCODE_CA || (opcode >= CPU_OPCODE_JMZ && opcode <= CPU_OPCODE_CANV))
+                Translator_AddLeader(instruction.value);
+
+            if (opcode >= CPU_OPCODE_SIA && opcode <= CPU_OPCODE_SIH)
+                Translator_AddLeader((opcode - CPU_OPCODE_SIA) << 3);
+
+            // Branches end the block, and so do interpreted instructions, the next block starting after them
+            if (Translator_IsBranch(opcode) || Translator_IsInterpreted(opcode)) {
+                if (!Translator_IsBranch(opcode) || Translator_FallsThrough(opcode))
+                    Translator_AddLeader(instruction.next);
+
+                break;
+            }
+
+            address = instruction.next;
+        }
+    }
+}
+
+// Function to write the memory address of an instruction operand as a C expression
+static void Translator_WriteAddress(FILE *file, const TranslatorInstruction *instruction) {
+    switch (instruction->operand) {
+        case TRANSLATOR_OPERAND_D: fprintf(file, "0x%04X", instruction->value); break;
+        case TRANSLATOR_OPERAND_RA: fprintf(file, "g->a"); break;
+        case TRANSLATOR_OPERAND_RB: fprintf(file, "g->b"); break;
+        case TRANSLATOR_OPERAND_XA: fprintf(file, "(unsigned short) (g->a + 0x%04X)", instruction->value); break;
+        case TRANSLATOR_OPERAND_XB: fprintf(file, "(unsigned short) (g->b + 0x%04X)", instruction->value); break;
+        case TRANSLATOR_OPERAND_YA: fprintf(file, "AOT_GetShort(g, g->a + 0x%04X)", instruction->value); break;
+        case TRANSLATOR_OPERAND_YB: fprintf(file, "AOT_GetShort(g, g->b + 0x%04X)", instruction->value); break;
+        default: break;
+    }
+}
+
+// Function to write the value an instruction pushes as a C expression
+static void Translator_WriteSource(FILE *file, const TranslatorInstruction *instruction, int shortValue) {
+    if (instruction->operand == TRANSLATOR_OPERAND_BYTE) {
+        fprintf(file, "0x%02X", instruction->value);
+    } else if (instruction->operand == TRANSLATOR_OPERAND_SHORT) {
+        fprintf(file, "0x%04X", instruction->value);
+    } else {
+        fprintf(file, shortValue ? "AOT_GetShort(g, " : "AOT_GetByte(g, ");
+        Translator_WriteAddress(file, instruction);
+        fprintf(file, ")");
+    }
+}
+
+// Function to write an 8 or 16 - bit ALU instruction, which pops its operands and pushes the result
+static void Translator_WriteALU(FILE *file, unsigned char opcode) {
+    int shortValue = opcode >= CPU_OPCODE_ADS;
+    int operation = opcode - (shortValue ? CPU_OPCODE_ADS : CPU_OPCODE_ADB);
+
+    const char *type = shortValue ? "unsigned short" : "unsigned char";
+    const char *size = shortValue ? "Short" : "Byte";
+    const char *suffix = shortValue ? "S" : "B";
+    const char *mask = shortValue ? "0xFFFE" : "0xFE";
+
+    fprintf(file, "    {\n");
+    fprintf(file, "        %s x = AOT_Pop%s(g);\n", type, size);
+
+    // Binary operations pop a second operand
+    if (operation <= CPU_OPCODE_CPB - CPU_OPCODE_ADB) fprintf(file, "        %s y = AOT_Pop%s(g);\n", type, size);
+
+    switch (operation + CPU_OPCODE_ADB) {
+        case CPU_OPCODE_ADB: fprintf(file, "        AOT_Push%s(g, AOT_AD%s(g, x, y));\n", size, suffix); break;
+        case CPU_OPCODE_SUB: fprintf(file, "        AOT_Push%s(g, AOT_AD%s(g, x, (%s) ~y));\n", size, suffix, type); break;
+        case CPU_OPCODE_ANB: fprintf(file, "        AOT_Push%s(g, AOT_Result%s(g, x & y));\n", size, size); break;
+        case CPU_OPCODE_ORB: fprintf(file, "        AOT_Push%s(g, AOT_Result%s(g, x | y));\n", size, size); break;
+        case CPU_OPCODE_XRB: fprintf(file, "        AOT_Push%s(g, AOT_Result%s(g, x ^ y));\n", size, size); break;
+
+        case CPU_OPCODE_CPB:
+            fprintf(file, "        g->cf = 1;\n");
+            fprintf(file, "        AOT_AD%s(g, x, (%s) ~y);\n", suffix, type);
+            break;
+
+        case CPU_OPCODE_IVB: fprintf(file, "        AOT_Push%s(g, AOT_Result%s(g, (%s) ~x));\n", size, size, type); break;
+
+        case CPU_OPCODE_ICB:
+            fprintf(file, "        g->cf = 0;\n");
+            fprintf(file, "        AOT_Push%s(g, AOT_AD%s(g, x, 1));\n", size, suffix);
+            break;
+
+        case CPU_OPCODE_DCB:
+            fprintf(file, "        g->cf = 1;\n");
+            fprintf(file, "        AOT_Push%s(g, AOT_AD%s(g, x, %s));\n", size, suffix, mask);
+            break;
+
+        case CPU_OPCODE_RLB: fprintf(file, "        AOT_Push%s(g, AOT_RL%s(g, x));\n", size, suffix); break;
+        case CPU_OPCODE_RRB: fprintf(file, "        AOT_Push%s(g, AOT_RR%s(g, x));\n", size, suffix); break;
+
+        case CPU_OPCODE_SLB:
+            fprintf(file, "        g->cf = 0;\n");
+            fprintf(file, "        AOT_Push%s(g, AOT_RL%s(g, x));\n", size, suffix);
+            break;
+
+        case CPU_OPCODE_SRB:
+        case CPU_OPCODE_SAB:
+            fprintf(file, "        g->cf = %d;\n", operation + CPU_OPCODE_ADB == CPU_OPCODE_SAB);
+            fprintf(file, "        AOT_Push%s(g, AOT_RR%s(g, x));\n", size, suffix);
+            break;
+    }
+
+    fprintf(file, "    }\n");
+}
+
+// Function to write one instruction as C, returning 1 if it ends the block
+static int Translator_WriteInstruction(FILE *file, const TranslatorInstruction *instruction) {
+    unsigned char opcode = instruction->opcode;
+    const char *name = CPU_GetName(opcode);
+
+    // Undefined opcodes run as NO
+    fprintf(file, "    // %04X: %s", instruction->address, name ? name : "NO");
+
+    if (instruction->length == 2) fprintf(file, " 0x%02X", instruction->value);
+    if (instruction->length == 3) fprintf(file, " 0x%04X", instruction->value);
+
+    fprintf(file, "\n");
+
+    if (opcode <= CPU_OPCODE_LDSYB) {
+        const char *reg = TRANSLATOR_REGISTER[opcode % 3];
+
+        if (instruction->operand == TRANSLATOR_OPERAND_SHORT) {
+            fprintf(file, "    g->%s = 0x%04X;\n", reg, instruction->value);
+        } else {
+            fprintf(file, "    g->%s = AOT_GetShort(g, ", reg);
+            Translator_WriteAddress(file, instruction);
+            fprintf(file, ");\n");
+        }
+
+        return 0;
+    }
+
+    if (opcode <= CPU_OPCODE_STSYB) {
+        fprintf(file, "    AOT_SetShort(g, ");
+        Translator_WriteAddress(file, instruction);
+        fprintf(file, ", g->%s);\n", TRANSLATOR_REGISTER[(opcode - CPU_OPCODE_STAD) % 3]);
+
+        return 0;
+    }
+
+    if (opcode >= CPU_OPCODE_PUBI && opcode <= CPU_OPCODE_PUBYB) {
+        fprintf(file, "    AOT_PushByte(g, ");
+        Translator_WriteSource(file, instruction, 0);
+        fprintf(file, ");\n");
+
+        return 0;
+    }
+
+    if (opcode >= CPU_OPCODE_PUSI && opcode <= CPU_OPCODE_PUSYB) {
+        fprintf(file, "    AOT_PushShort(g, ");
+        Translator_WriteSource(file, instruction, 1);
+        fprintf(file, ");\n");
+
+        return 0;
+    }
+
+    if (opcode >= CPU_OPCODE_POBD && opcode <= CPU_OPCODE_POSYB) {
+        int shortValue = opcode >= CPU_OPCODE_POSD;
+
+        fprintf(file, "    AOT_Set%s(g, ", shortValue ? "Short" : "Byte");
+        Translator_WriteAddress(file, instruction);
+        fprintf(file, ", AOT_Pop%s(g));\n", shortValue ? "Short" : "Byte");
+
+        return 0;
+    }
+
+    if (opcode >= CPU_OPCODE_ADB && opcode <= CPU_OPCODE_SAS) {
+        Translator_WriteALU(file, opcode);
+
+        return 0;
+    }
+
+    if (opcode >= CPU_OPCODE_SFZ && opcode <= CPU_OPCODE_CFV) {
+        static const char *flags[4] = { "zf", "cf", "sf", "vf" };
+
+        fprintf(file, "    g->%s = %d;\n", flags[(opcode - CPU_OPCODE_SFZ) % 4], opcode <= CPU_OPCODE_SFV);
+
+        return 0;
+    }
+
+    if (opcode >= CPU_OPCODE_JMZ && opcode <= CPU_OPCODE_JMNV) {
+        fprintf(file, "    g->i = %s ? 0x%04X : 0x%04X;\n", TRANSLATOR_CONDITION[opcode - CPU_OPCODE_JMZ], instruction->value, instruction->next);
+
+        return 1;
+    }
+
+    if (opcode >= CPU_OPCODE_CAZ && opcode <= CPU_OPCODE_CANV) {
+        fprintf(file, "    if (%s) {\n", TRANSLATOR_CONDITION[opcode - CPU_OPCODE_CAZ]);
+        fprintf(file, "        AOT_PushShort(g, 0x%04X);\n", instruction->next);
+        fprintf(file, "        g->i = 0x%04X;\n", instruction->value);
+        fprintf(file, "    } else {\n");
+        fprintf(file, "        g->i = 0x%04X;\n", instruction->next);
+        fprintf(file, "    }\n");
+
+        return 1;
+    }
+
+    if (opcode >= CPU_OPCODE_RTZ && opcode <= CPU_OPCODE_RTNV) {
+        fprintf(file, "    g->i = %s ? AOT_PopShort(g) : 0x%04X;\n", TRANSLATOR_CONDITION[opcode - CPU_OPCODE_RTZ], instruction->next);
+
+        return 1;
+    }
+
+    if (opcode >= CPU_OPCODE_SIA && opcode <= CPU_OPCODE_SIH) {
+        fprintf(file, "    AOT_PushShort(g, 0x%04X);\n", instruction->next);
+        fprintf(file, "    g->i = 0x%04X;\n", (opcode - CPU_OPCODE_SIA) << 3);
+
+        return 1;
+    }
+
+    switch (opcode) {
+        case CPU_OPCODE_MVAB: fprintf(file, "    g->a = g->b;\n"); return 0;
+        case CPU_OPCODE_MVAS: fprintf(file, "    g->a = g->s;\n"); return 0;
+        case CPU_OPCODE_MVAI: fprintf(file, "    g->a = 0x%04X;\n", instruction->next); return 0;
+        case CPU_OPCODE_MVBA: fprintf(file, "    g->b = g->a;\n"); return 0;
+        case CPU_OPCODE_MVBS: fprintf(file, "    g->b = g->s;\n"); return 0;
+        case CPU_OPCODE_MVBI: fprintf(file, "    g->b = 0x%04X;\n", instruction->next); return 0;
+        case CPU_OPCODE_MVSA: fprintf(file, "    g->s = g->a;\n"); return 0;
+        case CPU_OPCODE_MVSB: fprintf(file, "    g->s = g->b;\n"); return 0;
+        case CPU_OPCODE_MVSI: fprintf(file, "    g->s = 0x%04X;\n", instruction->next); return 0;
+        case CPU_OPCODE_MVIA: fprintf(file, "    g->i = g->a;\n"); return 1;
+        case CPU_OPCODE_MVIB: fprintf(file, "    g->i = g->b;\n"); return 1;
+        case CPU_OPCODE_MVIS: fprintf(file, "    g->i = g->s;\n"); return 1;
+
+        case CPU_OPCODE_PUA: fprintf(file, "    AOT_PushShort(g, g->a);\n"); return 0;
+        case CPU_OPCODE_PUB: fprintf(file, "    AOT_PushShort(g, g->b);\n"); return 0;
+        case CPU_OPCODE_PUS: fprintf(file, "    AOT_PushShort(g, g->s);\n"); return 0;
+        case CPU_OPCODE_PUI: fprintf(file, "    AOT_PushShort(g, 0x%04X);\n", instruction->next); return 0;
+
+        case CPU_OPCODE_POA: fprintf(file, "    g->a = AOT_PopShort(g);\n"); return 0;
+        case CPU_OPCODE_POB: fprintf(file, "    g->b = AOT_PopShort(g);\n"); return 0;
+        case CPU_OPCODE_POS: fprintf(file, "    g->s = AOT_PopShort(g);\n"); return 0;
+        case CPU_OPCODE_POI: fprintf(file, "    g->i = AOT_PopShort(g);\n"); return 1;
+
+        case CPU_OPCODE_DTS: fprintf(file, "    AOT_PushByte(g, AOT_GetByte(g, g->s));\n"); return 0;
+        case CPU_OPCODE_STS: fprintf(file, "    AOT_STS(g);\n"); return 0;
+
+        case CPU_OPCODE_IRA: fprintf(file, "    g->a++;\n"); return 0;
+        case CPU_OPCODE_IRB: fprintf(file, "    g->b++;\n"); return 0;
+        case CPU_OPCODE_IRS: fprintf(file, "    g->s++;\n"); return 0;
+        case CPU_OPCODE_DRA: fprintf(file, "    g->a--;\n"); return 0;
+        case CPU_OPCODE_DRB: fprintf(file, "    g->b--;\n"); return 0;
+        case CPU_OPCODE_DRS: fprintf(file, "    g->s--;\n"); return 0;
+
+        case CPU_OPCODE_JM: fprintf(file, "    g->i = 0x%04X;\n", instruction->value); return 1;
+
+        case CPU_OPCODE_CA:
+            fprintf(file, "    AOT_PushShort(g, 0x%04X);\n", instruction->next);
+            fprintf(file, "    g->i = 0x%04X;\n", instruction->value);
+            return 1;
+
+        case CPU_OPCODE_RT: fprintf(file, "    g->i = AOT_PopShort(g);\n"); return 1;
+
+        default:
+            // NO and the unused opcodes do nothing
+            return 0;
+    }
+}
+
+// Function to write the block starting at an address, returning its table entry fields through the pointers
+static void Translator_WriteBlock(FILE *file, unsigned address, unsigned *length, unsigned *count, unsigned *cycles) {
+    TranslatorInstruction instructions[TRANSLATOR_BLOCK_MAX_INSTRUCTIONS];
+    int instructionCount = 0;
+    int ended = 0;
+
+    // Gather the instructions up to a branch, an interpreted instruction or another block
+    unsigned pc = address;
+
+    while (instructionCount < TRANSLATOR_BLOCK_MAX_INSTRUCTIONS) {
+        TranslatorInstruction *instruction = &instructions[instructionCount];
+
+        if (!Translator_Decode(pc, instruction) || Translator_IsInterpreted(instruction->opcode)) break;
+
+        instructionCount++;
+        pc += instruction->length;
+
+        if (Translator_IsBranch(instruction->opcode)) {
+            ended = 1;
+            break;
+        }
+
+        if (pc >= MEMORY_SIZE || LEADER[pc]) break;
+    }
+
+    // A block cut off at the size limit carries on in the next one
+    if (!ended && pc < MEMORY_SIZE && instructionCount == TRANSLATOR_BLOCK_MAX_INSTRUCTIONS) LEADER[pc] = 1;
+
+    unsigned cyclesAfter[TRANSLATOR_BLOCK_MAX_INSTRUCTIONS + 1];
+
+    cyclesAfter[instructionCount] = 0;
+
+    for (int i = instructionCount - 1; i >= 0; i--)
+        cyclesAfter[i] = cyclesAfter[i + 1] + CPU_GetCycleCost(instructions[i].opcode);
+
+    fprintf(file, "static void AOT_Block_%04X(AOTGuest *guest) {\n", address);
+    fprintf(file, "    AOTGuest copy = *guest, *g = &copy;\n\n");
+
+    for (int i = 0; i < instructionCount; i++) {
+        if (i) fprintf(file, "\n");
+
+        Translator_WriteInstruction(file, &instructions[i]);
+
+        // Leave after writes to translated code, which may be the rest of this block
+        if (i + 1 < instructionCount && Translator_IsWrite(instructions[i].opcode))
+            fprintf(file, "    AOT_CHECK(guest, g, 0x%04X, %d, %u);\n", instructions[i].next, instructionCount - i - 1, cyclesAfter[i + 1]);
+    }
+
+    if (!ended) fprintf(file, "\n    g->i = 0x%04X;\n", pc & MEMORY_SIZE_MASK);
+
+    fprintf(file, "\n    *guest = copy;\n}\n\n");
+
+    *length = pc - address;
+    *count = instructionCount;
+    *cycles = cyclesAfter[0];
+}
+
+// Function to write the translated image as C
+static int Translator_Write(const char *path, const char *imagePath, const char *symbol) {
+    FILE *file = path ? fopen(path, "w") : stdout;
+
+    if (!file) {
+        printf("Error: Failed to open %s\n", path);
+
+        return 0;
+    }
+
+    fprintf(file, "// Translated by stackvm-aot from %s, loaded at 0x%04X\n\n", imagePath, LOAD_ADDRESS);
+    fprintf(file, "#include \"aot.h\"\n\n");
+
+    // The image bytes, which memory must still hold for a block to run
+    fprintf(file, "static const unsigned char AOT_DATA[%u] = {", IMAGE_LENGTH);
+
+    for (unsigned i = 0; i < IMAGE_LENGTH; i++)
+        fprintf(file, "%s0x%02X,", i % 16 ? " " : "\n    ", IMAGE[i]);
+
+    fprintf(file, "\n};\n\n");
+
+    static unsigned lengths[MEMORY_SIZE], counts[MEMORY_SIZE], cycles[MEMORY_SIZE];
+
+    // Blocks are written in address order, which the runtime relies on
+    for (unsigned address = 0; address < MEMORY_SIZE; address++) {
+        TranslatorInstruction instruction;
+
+        if (!LEADER[address] || !Translator_Decode(address, &instruction) || Translator_IsInterpreted(instruction.opcode)) continue;
+
+        Translator_WriteBlock(file, address, &lengths[BLOCK_COUNT], &counts[BLOCK_COUNT], &cycles[BLOCK_COUNT]);
+
+        BLOCKS[BLOCK_COUNT++] = address;
+    }
+
+    if (BLOCK_COUNT) {
+        fprintf(file, "static const AOTBlock AOT_BLOCKS[%u] = {\n", BLOCK_COUNT);
+
+        for (unsigned i = 0; i < BLOCK_COUNT; i++)
+            fprintf(file, "    { 0x%04X, %u, %u, %u, AOT_Block_%04X },\n", BLOCKS[i], lengths[i], counts[i], cycles[i], BLOCKS[i]);
+
+        fprintf(file, "};\n\n");
+    }
+
+    fprintf(file, "const AOTImage %s = { 0x%04X, %u, AOT_DATA, %u, %s };\n", symbol, LOAD_ADDRESS, IMAGE_LENGTH, BLOCK_COUNT, BLOCK_COUNT ? "AOT_BLOCKS" : "NULL");
+
+    if (file != stdout) fclose(file);
+
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    const char *imagePath = NULL;
+    const char *outputPath = NULL;
+    const char *symbol = "AOT_IMAGE";
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            LOAD_ADDRESS = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-e") && i + 1 < argc && ENTRY_COUNT < TRANSLATOR_MAX_ENTRIES) {
+            ENTRIES[ENTRY_COUNT++] = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            symbol = argv[++i];
+        } else if (argv[i][0] != '-' && !imagePath) {
+            imagePath = argv[i];
+        } else {
+            printf("Usage: %s [-a load_address] [-e entry_address ...] [-o output.c] [-s symbol] image\n", argv[0]);
+
+            return 1;
+        }
+    }
+
+    if (!imagePath) {
+        printf("Usage: %s [-a load_address] [-e entry_address ...] [-o output.c] [-s symbol] image\n", argv[0]);
+
+        return 1;
+    }
+
+    FILE *file = fopen(imagePath, "rb");
+
+    if (!file) {
+        printf("Error: Failed to open image %s\n", imagePath);
+
+        return 1;
+    }
+
+    // Only the part of the image before the end of memory is translated, the rest runs through the interpreter
+    IMAGE_LENGTH = fread(IMAGE, 1, MEMORY_SIZE - LOAD_ADDRESS, file);
+
+    fclose(file);
+
+    // Follow the code from the reset and restart vectors, the load address and the given entry points
+    for (unsigned vector = 0; vector <= CPU_OPCODE_SIH - CPU_OPCODE_SIA; vector++)
+        Translator_AddLeader(vector << 3);
+
+    Translator_AddLeader(LOAD_ADDRESS);
+
+    for (int i = 0; i < ENTRY_COUNT; i++)
+        Translator_AddLeader(ENTRIES[i]);
+
+    Translator_Explore();
+
+    return !Translator_Write(outputPath, imagePath, symbol);
+}
\ No newline at end of file
@@ -0,0 +1,797 @@
+#include "vm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "aot.h"
+#include "bank.h"
+#include "disk.h"
+#include "interrupt.h"
+#include "io.h"
+#include "jit.h"
+#include "memory.h"
+#include "utils.h"
+
+// Virtual machine struct, one context per module
+struct vm_s {
+    CPUContext *cpu;
+    MemoryContext *memory;
+    IOContext *io;
+    DiskContext *disk;
+    InterruptContext *interrupt;
+    BankContext *bank;
+    JITContext *jit;
+    AOTContext *aot;
+
+    // Number of instructions executed, the clock of recorded device updates
+    unsigned long long executed;
+
+    // Virtual clock cycle the devices were last updated at
+    unsigned long long deviceCycles;
+};
+
+// Number of virtual clock cycles per device update, the disk transferring one byte per update
+#define VM_DEVICE_CYCLES 256
+
+// Initial value and prime of the 64 - bit FNV-1a hash
+#define VM_HASH_BASIS 0xCBF29CE484222325ULL
+#define VM_HASH_PRIME 0x100000001B3ULL
+
+/*
+    Snapshot format, all fields in machine byte order
+
+    header      magic, version and total size
+    cpu         a, b, s, i and f registers, then the virtual clock
+    memory      MEMORY_SIZE bytes
+    banks       Bank_GetStateSize bytes, controller registers and extended memory
+    disk        Disk_GetStateSize bytes, image and controller registers
+    ports       read and write port maps, IO_PORT_MAP_SIZE bytes each
+    devices     block count, then each block size and its bytes
+
+    Delta snapshots hold what changed since the last snapshot was saved or
+    loaded, which is the checkpoint they apply to
+
+    header      delta magic, version and total size, then the full snapshot size of the machine
+    cpu         as above
+    memory      dirty page map, then each dirty page
+    banks       Bank_GetDeltaSize bytes, controller registers, dirty page map of extended memory and each dirty page
+    disk        dirty sector map, each dirty sector, then the controller registers
+    ports       as above
+    devices     as above
+*/
+
+// Snapshot magics and format version
+#define VM_SNAPSHOT_MAGIC 0x534D5653
+#define VM_SNAPSHOT_DELTA_MAGIC 0x444D5653
+#define VM_SNAPSHOT_VERSION 3
+
+// Snapshot header struct
+typedef struct vm_snapshot_header_s {
+    unsigned magic;
+    unsigned version;
+    unsigned size;
+} VMSnapshotHeader;
+
+// Machine bound to the calling thread
+static THREAD_LOCAL VM *VM_BOUND = NULL;
+
+VM *VM_Create(void) {
+    VM *vm = calloc(1, sizeof(VM));
+
+    if (!vm) {
+        printf("Error: Failed to allocate VM\n");
+
+        return NULL;
+    }
+
+    vm->cpu = CPU_CreateContext();
+    vm->memory = Memory_CreateContext();
+    vm->io = IO_CreateContext();
+    vm->disk = Disk_CreateContext();
+    vm->interrupt = Interrupt_CreateContext();
+    vm->bank = Bank_CreateContext();
+    vm->jit = JIT_CreateContext();
+    vm->aot = AOT_CreateContext();
+
+    if (!vm->cpu || !vm->memory || !vm->io || !vm->disk || !vm->interrupt || !vm->bank || !vm->jit || !vm->aot) {
+        VM_Destroy(vm);
+
+        return NULL;
+    }
+
+    VM_Bind(vm);
+
+    // Initialize the modules in the same order as the frontend always has
+    if (!CPU_Init() || !Memory_Init() || !IO_Init() || !Interrupt_Init() || !Disk_Init()) {
+        VM_Destroy(vm);
+
+        return NULL;
+    }
+
+    return vm;
+}
+
+void VM_Destroy(VM *vm) {
+    if (!vm) return;
+
+    // Quit the disk while its context is still around
+    if (vm->disk) {
+        VM_Bind(vm);
+        Disk_Quit();
+    }
+
+    CPU_DestroyContext(vm->cpu);
+    Memory_DestroyContext(vm->memory);
+    IO_DestroyContext(vm->io);
+    Disk_DestroyContext(vm->disk);
+    Interrupt_DestroyContext(vm->interrupt);
+    Bank_DestroyContext(vm->bank);
+    JIT_DestroyContext(vm->jit);
+    AOT_DestroyContext(vm->aot);
+
+    if (VM_BOUND == vm) VM_BOUND = NULL;
+
+    free(vm);
+}
+
+void VM_Bind(VM *vm) {
+    if (VM_BOUND == vm) return;
+
+    VM_BOUND = vm;
+
+    CPU_BindContext(vm->cpu);
+    Memory_BindContext(vm->memory);
+    IO_BindContext(vm->io);
+    Disk_BindContext(vm->disk);
+    Interrupt_BindContext(vm->interrupt);
+    Bank_BindContext(vm->bank);
+    JIT_BindContext(vm->jit);
+    AOT_BindContext(vm->aot);
+}
+
+int VM_EnableJIT(VM *vm) {
+    VM_Bind(vm);
+
+    if (JIT_IsEnabled()) return 1;
+
+    // Profile builds step every instruction through the opcode table, which translated code would skip
+    if (CPU_PROFILE) {
+        printf("Error: The JIT compiler is compiled out of profile builds\n");
+
+        return 0;
+    }
+
+    if (AOT_IsEnabled()) {
+        printf("Error: The JIT compiler can't run alongside translated code\n");
+
+        return 0;
+    }
+
+    return JIT_Init();
+}
+
+int VM_EnableBanks(VM *vm, unsigned size) {
+    VM_Bind(vm);
+
+    if (Bank_IsEnabled()) return 1;
+
+    return Bank_Init(size);
+}
+
+int VM_EnableAOT(VM *vm, const AOTImage *image) {
+    VM_Bind(vm);
+
+    if (CPU_PROFILE) {
+        printf("Error: Translated code is compiled out of profile builds\n");
+
+        return 0;
+    }
+
+    if (JIT_IsEnabled()) {
+        printf("Error: Translated code can't run alongside the JIT compiler\n");
+
+        return 0;
+    }
+
+    return AOT_Init(image);
+}
+
+int VM_LoadImage(VM *vm, const char *path, unsigned short address) {
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        printf("Error: Failed to open image %s\n", path);
+
+        return 0;
+    }
+
+    VM_Bind(vm);
+
+    // Images wrap around the end of memory, and at most a full memory is read
+    int c;
+    unsigned length = 0;
+
+    while ((c = fgetc(file)) != EOF && length < MEMORY_SIZE) {
+        Memory_SetByte(address + length, c);
+        length++;
+    }
+
+    fclose(file);
+
+    return 1;
+}
+
+// Function to update the devices once for every device period the virtual clock passed since the last update, returning 0 if none was due
+static int VM_UpdateDevices(VM *vm) {
+    CPUState state;
+
+    CPU_GetState(&state);
+
+    int busy = Disk_IsBusy();
+    unsigned long long updates = state.cycles / VM_DEVICE_CYCLES - vm->deviceCycles / VM_DEVICE_CYCLES;
+
+    // An idle disk doesn't change on updates, so the rest can be skipped
+    if (!busy) updates = 0;
+
+    for (unsigned long long i = 0; i < updates && Disk_IsBusy(); i++) Disk_Update();
+
+    // A halted CPU waits out the rest of the transfer, the clock skipping straight from one update to the next
+    if (state.f & CPU_FLAG_H && Disk_IsBusy()) {
+        while (Disk_IsBusy()) {
+            state.cycles = (state.cycles / VM_DEVICE_CYCLES + 1) * VM_DEVICE_CYCLES;
+            Disk_Update();
+        }
+
+        CPU_SetState(&state);
+
+        updates = 1;
+    }
+
+    vm->deviceCycles = state.cycles;
+
+    // Finishing a transfer wakes a halted CPU only through an interrupt it will accept, otherwise it stays halted
+    if (busy && !Disk_IsBusy() && CPU_IsInterruptReady()) CPU_Wake();
+
+    return updates != 0;
+}
+
+// Function to get how many of count instructions can run before the devices are due an update
+// Every instruction costs at least one cycle and at most CPU_GetMaxCycleCost, so a busy device is updated right after the instruction that reaches its next period, however the run is sliced
+static unsigned VM_GetDeviceBudget(VM *vm, unsigned count) {
+    if (!Disk_IsBusy()) return count;
+
+    CPUState state;
+
+    CPU_GetState(&state);
+
+    unsigned left = VM_DEVICE_CYCLES - state.cycles % VM_DEVICE_CYCLES;
+    unsigned budget = left / CPU_GetMaxCycleCost();
+
+    if (!budget) budget = 1;
+
+    return budget < count ? budget : count;
+}
+
+// Function to run the CPU for up to count instructions, counting them
+static unsigned VM_RunCPU(VM *vm, unsigned count) {
+    int idle = !Disk_IsBusy();
+    unsigned executed = CPU_Run(count);
+
+    vm->executed += executed;
+
+    // Starting a transfer stops the run right after the instruction that did, and the transfer's periods count from there
+    if (idle && Disk_IsBusy()) {
+        CPUState state;
+
+        CPU_GetState(&state);
+        vm->deviceCycles = state.cycles;
+    }
+
+    return executed;
+}
+
+// Function to replay the wakes logged at the current instruction count, input that arrived between runs
+static void VM_ReplayWakes(VM *vm) {
+    while (IO_GetTraceMode() == IO_TRACE_REPLAY && IO_IsNextWake() && IO_GetNextUpdate() == vm->executed) {
+        CPU_Wake();
+        IO_ReplayUpdate();
+    }
+}
+
+unsigned VM_Run(VM *vm, unsigned count) {
+    VM_Bind(vm);
+
+    // Replayed device updates happen at their logged instruction count, however the caller slices the run
+    if (IO_GetTraceMode() == IO_TRACE_REPLAY) {
+        unsigned long long next = IO_GetNextUpdate();
+
+        if (next - vm->executed < count) count = next - vm->executed;
+
+        unsigned executed = VM_RunCPU(vm, count);
+
+        if (vm->executed == next) {
+            if (!IO_IsNextWake()) {
+                VM_UpdateDevices(vm);
+                IO_ReplayUpdate();
+            }
+
+            VM_ReplayWakes(vm);
+        }
+
+        return executed;
+    }
+
+    unsigned executed = 0;
+
+    // Starting a transfer stops CPU_Run, and a busy device is then run up to each of its periods in turn
+    do {
+        executed += VM_RunCPU(vm, VM_GetDeviceBudget(vm, count - executed));
+
+        if (VM_UpdateDevices(vm) && IO_GetTraceMode() == IO_TRACE_RECORD) IO_RecordUpdate(vm->executed);
+    } while (executed < count && !CPU_IsHalted());
+
+    return executed;
+}
+
+int VM_IsHalted(VM *vm) {
+    VM_Bind(vm);
+
+    return CPU_IsHalted() && !Disk_IsBusy();
+}
+
+void VM_Wake(VM *vm) {
+    VM_Bind(vm);
+
+    // Replays wake the CPU where the log says, ignoring input of their own
+    if (IO_GetTraceMode() == IO_TRACE_REPLAY) return;
+
+    if (IO_GetTraceMode() == IO_TRACE_RECORD) IO_RecordWake(vm->executed);
+
+    CPU_Wake();
+}
+
+void VM_GetState(VM *vm, CPUState *state) {
+    VM_Bind(vm);
+    CPU_GetState(state);
+}
+
+void VM_SetState(VM *vm, const CPUState *state) {
+    VM_Bind(vm);
+    CPU_SetState(state);
+
+    // Setting the clock doesn't count as time passing for the devices
+    vm->deviceCycles = state->cycles;
+}
+
+void VM_ReadMemory(VM *vm, unsigned short address, void *buffer, unsigned length) {
+    unsigned char *bytes = buffer;
+
+    VM_Bind(vm);
+
+    // Reads see the RAM under device pages, so dumping memory has no side effects
+    const MemoryPageTable *pages = Memory_GetPageTable();
+
+    for (unsigned i = 0; i < length; i++)
+        bytes[i] = Memory_FetchByte(pages, address + i);
+}
+
+void VM_WriteMemory(VM *vm, unsigned short address, const void *buffer, unsigned length) {
+    const unsigned char *bytes = buffer;
+
+    VM_Bind(vm);
+
+    // Writes land in RAM like reads, and still invalidate decoded and translated code
+    for (unsigned i = 0; i < length; i++)
+        Memory_SetRAMByte(address + i, bytes[i]);
+}
+
+unsigned VM_GetDiskSize(VM *vm) {
+    VM_Bind(vm);
+
+    return Disk_GetSize();
+}
+
+void VM_ReadDisk(VM *vm, unsigned address, void *buffer, unsigned length) {
+    VM_Bind(vm);
+
+    unsigned size = Disk_GetSize();
+
+    if (address >= size) return;
+    if (length > size - address) length = size - address;
+
+    memcpy(buffer, Disk_GetData() + address, length);
+}
+
+unsigned long long VM_HashMemory(VM *vm) {
+    VM_Bind(vm);
+
+    // Hashed like VM_ReadMemory reads, through the banks switched in and past device pages
+    const MemoryPageTable *pages = Memory_GetPageTable();
+    unsigned long long hash = VM_HASH_BASIS;
+
+    for (unsigned address = 0; address < MEMORY_SIZE; address++)
+        hash = (hash ^ Memory_FetchByte(pages, address)) * VM_HASH_PRIME;
+
+    return hash;
+}
+
+unsigned long long VM_HashDisk(VM *vm) {
+    VM_Bind(vm);
+
+    const unsigned char *data = Disk_GetData();
+    unsigned size = Disk_GetSize();
+    unsigned long long hash = VM_HASH_BASIS;
+
+    for (unsigned i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * VM_HASH_PRIME;
+
+    return hash;
+}
+
+unsigned long long VM_GetTime(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (unsigned long long)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+int VM_StartRecording(VM *vm, const char *path) {
+    VM_Bind(vm);
+
+    // Update counts in the log start from the beginning of the recording
+    vm->executed = 0;
+
+    return IO_StartRecording(path);
+}
+
+int VM_StartReplay(VM *vm, const char *path) {
+    VM_Bind(vm);
+
+    vm->executed = 0;
+
+    if (!IO_StartReplay(path)) return 0;
+
+    // Input may have woken the machine before it first ran
+    VM_ReplayWakes(vm);
+
+    return 1;
+}
+
+void VM_StopTrace(VM *vm) {
+    VM_Bind(vm);
+    IO_StopTrace();
+}
+
+// Function to get the size of the port maps and device state blocks
+static unsigned VM_GetDevicesSize(void) {
+    unsigned size = IO_PORT_MAP_SIZE * 2 + sizeof(unsigned);
+
+    for (unsigned i = 0; i < IO_GetStateCount(); i++) {
+        unsigned blockSize;
+
+        IO_GetState(i, &blockSize);
+        size += sizeof(unsigned) + blockSize;
+    }
+
+    return size;
+}
+
+// Function to save the port maps and device state blocks
+static void VM_SaveDevices(unsigned char *bytes) {
+    IO_GetPortMaps(bytes, bytes + IO_PORT_MAP_SIZE);
+    bytes += IO_PORT_MAP_SIZE * 2;
+
+    unsigned count = IO_GetStateCount();
+
+    memcpy(bytes, &count, sizeof(count));
+    bytes += sizeof(count);
+
+    for (unsigned i = 0; i < count; i++) {
+        unsigned blockSize;
+        void *block = IO_GetState(i, &blockSize);
+
+        memcpy(bytes, &blockSize, sizeof(blockSize));
+        memcpy(bytes + sizeof(blockSize), block, blockSize);
+        bytes += sizeof(blockSize) + blockSize;
+    }
+}
+
+// Function to check that saved port maps and device state blocks match the machine
+static int VM_CheckDevices(const unsigned char *bytes) {
+    // Port functions can't be saved, so the machine must have the same devices bound
+    unsigned char readMap[IO_PORT_MAP_SIZE], writeMap[IO_PORT_MAP_SIZE];
+
+    IO_GetPortMaps(readMap, writeMap);
+
+    if (memcmp(bytes, readMap, IO_PORT_MAP_SIZE) || memcmp(bytes + IO_PORT_MAP_SIZE, writeMap, IO_PORT_MAP_SIZE)) {
+        printf("Error: Snapshot was taken with other devices attached\n");
+
+        return 0;
+    }
+
+    // Device state blocks must line up one for one as well
+    const unsigned char *blocks = bytes + IO_PORT_MAP_SIZE * 2;
+    unsigned count;
+
+    memcpy(&count, blocks, sizeof(count));
+    blocks += sizeof(count);
+
+    if (count != IO_GetStateCount()) {
+        printf("Error: Snapshot was taken with other devices attached\n");
+
+        return 0;
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        unsigned blockSize, savedSize;
+
+        IO_GetState(i, &blockSize);
+        memcpy(&savedSize, blocks, sizeof(savedSize));
+
+        if (savedSize != blockSize) {
+            printf("Error: Snapshot was taken with other devices attached\n");
+
+            return 0;
+        }
+
+        blocks += sizeof(savedSize) + savedSize;
+    }
+
+    return 1;
+}
+
+// Function to restore the device state blocks, after VM_CheckDevices passed
+static void VM_LoadDevices(const unsigned char *bytes) {
+    unsigned count = IO_GetStateCount();
+
+    bytes += IO_PORT_MAP_SIZE * 2 + sizeof(count);
+
+    for (unsigned i = 0; i < count; i++) {
+        unsigned blockSize;
+        void *block = IO_GetState(i, &blockSize);
+
+        memcpy(block, bytes + sizeof(blockSize), blockSize);
+        bytes += sizeof(blockSize) + blockSize;
+    }
+
+    // The CPU interrupt request follows the restored controller
+    Interrupt_Update();
+}
+
+// Function to make the current state the checkpoint the next delta snapshot holds the changes since
+static void VM_Checkpoint(void) {
+    Memory_ClearDirtyMap();
+    Bank_ClearDirtyMap();
+    Disk_ClearDirtyMap();
+}
+
+unsigned VM_GetSnapshotSize(VM *vm) {
+    VM_Bind(vm);
+
+    return sizeof(VMSnapshotHeader) + sizeof(CPUState) + MEMORY_SIZE + Bank_GetStateSize() + Disk_GetStateSize() + VM_GetDevicesSize();
+}
+
+unsigned VM_SaveSnapshot(VM *vm, void *buffer, unsigned size) {
+    VMSnapshotHeader header = { VM_SNAPSHOT_MAGIC, VM_SNAPSHOT_VERSION, VM_GetSnapshotSize(vm) };
+    unsigned char *bytes = buffer;
+    CPUState state;
+
+    VM_Bind(vm);
+
+    if (size < header.size) {
+        printf("Error: Snapshot buffer too small\n");
+
+        return 0;
+    }
+
+    memcpy(bytes, &header, sizeof(header));
+    bytes += sizeof(header);
+
+    CPU_GetState(&state);
+    memcpy(bytes, &state, sizeof(state));
+    bytes += sizeof(state);
+
+    memcpy(bytes, Memory_GetData(), MEMORY_SIZE);
+    bytes += MEMORY_SIZE;
+
+    Bank_SaveState(bytes);
+    bytes += Bank_GetStateSize();
+
+    Disk_SaveState(bytes);
+    bytes += Disk_GetStateSize();
+
+    VM_SaveDevices(bytes);
+
+    VM_Checkpoint();
+
+    return header.size;
+}
+
+int VM_LoadSnapshot(VM *vm, const void *buffer, unsigned size) {
+    const unsigned char *bytes = buffer;
+    VMSnapshotHeader header;
+    CPUState state;
+
+    VM_Bind(vm);
+
+    if (size < sizeof(header)) {
+        printf("Error: Snapshot is truncated\n");
+
+        return 0;
+    }
+
+    memcpy(&header, bytes, sizeof(header));
+
+    if (header.magic != VM_SNAPSHOT_MAGIC || header.version != VM_SNAPSHOT_VERSION) {
+        printf("Error: Snapshot format is not supported\n");
+
+        return 0;
+    }
+
+    // A matching size rules out different memory, disk and device layouts before anything is touched
+    if (header.size != size || header.size != VM_GetSnapshotSize(vm)) {
+        printf("Error: Snapshot does not match the machine\n");
+
+        return 0;
+    }
+
+    if (!VM_CheckDevices(bytes + size - VM_GetDevicesSize())) return 0;
+
+    if (!Bank_CheckState(bytes + sizeof(header) + sizeof(CPUState) + MEMORY_SIZE)) {
+        printf("Error: Snapshot is corrupt\n");
+
+        return 0;
+    }
+
+    bytes += sizeof(header);
+
+    memcpy(&state, bytes, sizeof(state));
+    CPU_SetState(&state);
+    vm->deviceCycles = state.cycles;
+    bytes += sizeof(state);
+
+    Memory_LoadData(bytes);
+    bytes += MEMORY_SIZE;
+
+    Bank_LoadState(bytes);
+    bytes += Bank_GetStateSize();
+
+    Disk_LoadState(bytes);
+    bytes += Disk_GetStateSize();
+
+    VM_LoadDevices(bytes);
+
+    VM_Checkpoint();
+
+    return 1;
+}
+
+unsigned VM_GetDeltaSnapshotSize(VM *vm) {
+    VM_Bind(vm);
+
+    return sizeof(VMSnapshotHeader) + sizeof(unsigned) + sizeof(CPUState) + Memory_GetDeltaSize() + Bank_GetDeltaSize() + Disk_GetDeltaSize() + VM_GetDevicesSize();
+}
+
+unsigned VM_SaveDeltaSnapshot(VM *vm, void *buffer, unsigned size) {
+    VMSnapshotHeader header = { VM_SNAPSHOT_DELTA_MAGIC, VM_SNAPSHOT_VERSION, VM_GetDeltaSnapshotSize(vm) };
+    unsigned machineSize = VM_GetSnapshotSize(vm);
+    unsigned char *bytes = buffer;
+    CPUState state;
+
+    if (size < header.size) {
+        printf("Error: Snapshot buffer too small\n");
+
+        return 0;
+    }
+
+    memcpy(bytes, &header, sizeof(header));
+    memcpy(bytes + sizeof(header), &machineSize, sizeof(machineSize));
+    bytes += sizeof(header) + sizeof(machineSize);
+
+    CPU_GetState(&state);
+    memcpy(bytes, &state, sizeof(state));
+    bytes += sizeof(state);
+
+    Memory_SaveDelta(bytes);
+    bytes += Memory_GetDeltaSize();
+
+    Bank_SaveDelta(bytes);
+    bytes += Bank_GetDeltaSize();
+
+    Disk_SaveDelta(bytes);
+    bytes += Disk_GetDeltaSize();
+
+    VM_SaveDevices(bytes);
+
+    VM_Checkpoint();
+
+    return header.size;
+}
+
+int VM_LoadDeltaSnapshot(VM *vm, const void *buffer, unsigned size) {
+    const unsigned char *bytes = buffer;
+    VMSnapshotHeader header;
+    unsigned machineSize;
+    CPUState state;
+
+    VM_Bind(vm);
+
+    if (size < sizeof(header) + sizeof(machineSize)) {
+        printf("Error: Snapshot is truncated\n");
+
+        return 0;
+    }
+
+    memcpy(&header, bytes, sizeof(header));
+    memcpy(&machineSize, bytes + sizeof(header), sizeof(machineSize));
+
+    if (header.magic != VM_SNAPSHOT_DELTA_MAGIC || header.version != VM_SNAPSHOT_VERSION) {
+        printf("Error: Snapshot format is not supported\n");
+
+        return 0;
+    }
+
+    // The size of a delta depends on what changed, so the machine is matched by its full snapshot size instead
+    unsigned fixedSize = sizeof(header) + sizeof(machineSize) + sizeof(CPUState) + VM_GetDevicesSize();
+
+    if (header.size != size || machineSize != VM_GetSnapshotSize(vm) || size < fixedSize) {
+        printf("Error: Snapshot does not match the machine\n");
+
+        return 0;
+    }
+
+    if (!VM_CheckDevices(bytes + size - VM_GetDevicesSize())) return 0;
+
+    bytes += sizeof(header) + sizeof(machineSize);
+
+    // The dirty maps have to account for every byte between the CPU state and the devices before anything is applied
+    const unsigned char *delta = bytes + sizeof(CPUState);
+    unsigned left = size - fixedSize;
+    unsigned memoryLength, bankLength, diskLength;
+
+    if (!Memory_CheckDelta(delta, left, &memoryLength) ||
+        !Bank_CheckDelta(delta + memoryLength, left - memoryLength, &bankLength) ||
+        !Disk_CheckDelta(delta + memoryLength + bankLength, left - memoryLength - bankLength, &diskLength) ||
+        memoryLength + bankLength + diskLength != left) {
+        printf("Error: Snapshot is corrupt\n");
+
+        return 0;
+    }
+
+    memcpy(&state, bytes, sizeof(state));
+    CPU_SetState(&state);
+    vm->deviceCycles = state.cycles;
+    bytes += sizeof(state);
+
+    bytes += Memory_LoadDelta(bytes);
+    bytes += Bank_LoadDelta(bytes);
+    bytes += Disk_LoadDelta(bytes);
+
+    VM_LoadDevices(bytes);
+
+    VM_Checkpoint();
+
+    return 1;
+}
+
+void VM_AttachDevice(VM *vm, unsigned char port, unsigned char (*read)(void *user), void (*write)(void *user, unsigned char value), void *user) {
+    VM_Bind(vm);
+
+    if (read) IO_RegisterRead(port, read, user);
+    if (write) IO_RegisterWrite(port, write, user);
+}
+
+void VM_MapDevice(VM *vm, unsigned char page, unsigned char (*read)(void *user, unsigned short address), void (*write)(void *user, unsigned short address, unsigned char value), void *user) {
+    VM_Bind(vm);
+
+    Memory_MapDevice(page, read, write, user);
+}
+
+void VM_UnmapDevice(VM *vm, unsigned char page) {
+    VM_Bind(vm);
+
+    Memory_UnmapDevice(page);
+}
\ No newline at end of file
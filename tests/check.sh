@@ -0,0 +1,182 @@
+#!/bin/sh
+
+# Differential check
+#
+# Runs the images written by tests/images.c under the opcode table, switch and
+# threaded code interpreters, the JIT compiler and translated code, and fails
+# if the final registers, virtual clock or memory hash of any of them differ.
+# Every image also has to end the same when run one instruction at a time
+# and in large batches, and the fused instruction image the same under every
+# instruction budget up to its end.
+# Every image runs both on the plain machine and with the bank controller.
+# Every image is also recorded and replayed under the interpreter and the JIT
+# compiler, comparing the display image's final frames too, and snapshotted
+# and restored through a delta snapshot by tests/snapshots.c. The device image
+# is recorded and replayed with a device attached from outside the machine
+# by tests/replay.c. The mapped device image runs with a device mapped over a
+# page and attached to a port by tests/devices.c, under every dispatch method
+# and the JIT compiler, which have to call the devices the same way.
+# Each vectorized pixel conversion kernel the host supports is compared with
+# the scalar one by tests/kernels.c.
+# Run through "make check", which passes the source lists below.
+#
+#     HEADLESS_SRC - sources of the headless frontend
+#     LIB_SRC      - sources of the machine, for the translator and the
+#                    snapshot, replay and device checks
+
+CC=${CC:-gcc}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+FLAGS="-O2 -DCPU_PROFILE=0 -DDISPLAY_HEADLESS -I./include"
+
+# Build the image writer, the checks, the translator and a frontend for every dispatch method
+$CC ./tests/images.c -o "$WORK/images" -I./include || exit 1
+$CC ./tests/kernels.c ./src/blit.c -o "$WORK/kernels" -O2 -I./include || exit 1
+$CC ./tests/snapshots.c $LIB_SRC -o "$WORK/snapshots" $FLAGS -DCPU_DISPATCH=2 || exit 1
+$CC ./tests/replay.c $LIB_SRC -o "$WORK/replay" $FLAGS -DCPU_DISPATCH=2 || exit 1
+$CC ./src/translator.c $LIB_SRC -o "$WORK/aot" -O2 -I./include || exit 1
+
+for dispatch in 0 1 2; do
+    $CC $HEADLESS_SRC -o "$WORK/headless$dispatch" $FLAGS -DCPU_DISPATCH=$dispatch || exit 1
+    $CC ./tests/devices.c $LIB_SRC -o "$WORK/devices$dispatch" $FLAGS -DCPU_DISPATCH=$dispatch || exit 1
+done
+
+"$WORK/images" "$WORK" || exit 1
+
+FAILED=0
+
+for image in "$WORK"/*.bin; do
+    name=$(basename "$image" .bin)
+
+    # Translated code is linked into its own frontend, one per image
+    "$WORK/aot" -o "$WORK/$name.c" "$image" > /dev/null || exit 1
+    $CC $HEADLESS_SRC "$WORK/$name.c" -o "$WORK/$name-aot" $FLAGS -DCPU_DISPATCH=2 -DHEADLESS_AOT || exit 1
+
+    for memory in "" "-m 256"; do
+        run="$name${memory:+ $memory}"
+
+        "$WORK/headless0" $memory "$image" > "$WORK/$name.table"
+        "$WORK/headless1" $memory "$image" > "$WORK/$name.switch"
+        "$WORK/headless2" $memory "$image" > "$WORK/$name.threaded"
+        "$WORK/headless2" $memory -j "$image" > "$WORK/$name.jit"
+        "$WORK/$name-aot" $memory -t "$image" > "$WORK/$name.aot"
+
+        for method in switch threaded jit aot; do
+            if ! cmp -s "$WORK/$name.table" "$WORK/$name.$method"; then
+                echo "$run: $method differs from the opcode table"
+                diff "$WORK/$name.table" "$WORK/$name.$method"
+                FAILED=1
+            fi
+        done
+
+        # Devices follow the virtual clock, so slicing the run differently must not change it
+        for batch in 1 100000; do
+            "$WORK/headless2" $memory -s $batch "$image" > "$WORK/$name.batch"
+
+            if ! cmp -s "$WORK/$name.table" "$WORK/$name.batch"; then
+                echo "$run: batches of $batch differ from the opcode table"
+                diff "$WORK/$name.table" "$WORK/$name.batch"
+                FAILED=1
+            fi
+        done
+
+        echo "$run: $(tail -n 2 "$WORK/$name.table" | tr '\n' ' ')"
+
+        # Recording must not change the run, and replaying has to end where the recording did
+        for jit in "" "-j"; do
+            "$WORK/headless2" $memory $jit -r "$WORK/$name.log" "$image" > "$WORK/$name.record"
+            "$WORK/headless2" $memory $jit -R "$WORK/$name.log" "$image" > "$WORK/$name.replay"
+
+            for trace in record replay; do
+                if ! cmp -s "$WORK/$name.table" "$WORK/$name.$trace"; then
+                    echo "$run${jit:+ $jit}: $trace differs from the opcode table"
+                    diff "$WORK/$name.table" "$WORK/$name.$trace"
+                    FAILED=1
+                fi
+            done
+        done
+    done
+done
+
+# Budgets ending in every instruction of the fused image have to stop each method at the same place
+count=$("$WORK/headless0" "$WORK/fuse.bin" | sed -n 's/^Executed \([0-9]*\) .*/\1/p')
+budget=1
+
+while [ "$budget" -le "$count" ]; do
+    "$WORK/headless0" -n $budget "$WORK/fuse.bin" > "$WORK/fuse.table"
+    "$WORK/headless1" -n $budget "$WORK/fuse.bin" > "$WORK/fuse.switch"
+    "$WORK/headless2" -n $budget "$WORK/fuse.bin" > "$WORK/fuse.threaded"
+    "$WORK/headless2" -n $budget -j "$WORK/fuse.bin" > "$WORK/fuse.jit"
+    "$WORK/fuse-aot" -n $budget -t "$WORK/fuse.bin" > "$WORK/fuse.aot"
+
+    for method in switch threaded jit aot; do
+        if ! cmp -s "$WORK/fuse.table" "$WORK/fuse.$method"; then
+            echo "fuse -n $budget: $method differs from the opcode table"
+            diff "$WORK/fuse.table" "$WORK/fuse.$method"
+            FAILED=1
+        fi
+    done
+
+    budget=$((budget + 1))
+done
+
+echo "fuse: budgets 1 to $count"
+
+# Snapshots restored through a delta have to carry on as the machine they were taken from
+for memory in "" "-m 256"; do
+    for jit in "" "-j"; do
+        echo "snapshots${memory:+ $memory}${jit:+ $jit}:"
+
+        "$WORK/snapshots" $memory $jit "$WORK"/*.bin || FAILED=1
+    done
+done
+
+# Replays answer a device outside the machine from the log, and hand back to it when they diverge or the log ends
+for memory in "" "-m 256"; do
+    for jit in "" "-j"; do
+        echo "replay${memory:+ $memory}${jit:+ $jit}:"
+
+        "$WORK/replay" $memory $jit "$WORK/device.bin" || FAILED=1
+    done
+done
+
+# Devices mapped over the stack or raising a line have to see the same accesses, with the line taken at the same point
+"$WORK/devices0" "$WORK/mapped.bin" > "$WORK/mapped.table" || FAILED=1
+"$WORK/devices1" "$WORK/mapped.bin" > "$WORK/mapped.switch" || FAILED=1
+"$WORK/devices2" "$WORK/mapped.bin" > "$WORK/mapped.threaded" || FAILED=1
+"$WORK/devices2" -j "$WORK/mapped.bin" > "$WORK/mapped.jit" || FAILED=1
+
+for method in switch threaded jit; do
+    if ! cmp -s "$WORK/mapped.table" "$WORK/mapped.$method"; then
+        echo "mapped devices: $method differs from the opcode table"
+        diff "$WORK/mapped.table" "$WORK/mapped.$method"
+        FAILED=1
+    fi
+done
+
+echo "mapped devices: $(tail -n 1 "$WORK/mapped.table")"
+
+# Replays run the display instead of stubbing it out, so mode and cursor changes reach the final frame
+for memory in "" "-m 256"; do
+    run="display replay${memory:+ $memory}"
+
+    "$WORK/headless2" $memory -r "$WORK/display.log" -o "$WORK/display.record.ppm" "$WORK/display.bin" > "$WORK/display.record"
+    "$WORK/headless2" $memory -R "$WORK/display.log" -o "$WORK/display.replay.ppm" "$WORK/display.bin" > "$WORK/display.replay"
+
+    if ! cmp -s "$WORK/display.record" "$WORK/display.replay"; then
+        echo "$run: replay differs from the recording"
+        diff "$WORK/display.record" "$WORK/display.replay"
+        FAILED=1
+    elif ! cmp -s "$WORK/display.record.ppm" "$WORK/display.replay.ppm"; then
+        echo "$run: replayed frame differs from the recording"
+        FAILED=1
+    else
+        echo "$run: frames match"
+    fi
+done
+
+"$WORK/kernels" || FAILED=1
+
+exit $FAILED
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "interrupt.h"
+#include "vm.h"
+
+#include "machine.h"
+
+/*
+    Mapped device check
+
+    Maps a device over the page of the image given on the command line whose
+    reads come back changed from what was written, and whose first byte
+    raises a line when written, and attaches a port whose reads raise
+    another, then runs the image to the halt and prints its registers,
+    virtual clock, memory hash and how often each device was called. Run
+    through tests/check.sh under every dispatch method and the JIT compiler
+    with -j, which compares what they print.
+*/
+
+// Page of the mapped device and port of the attached one, see tests/images.c
+#define DEVICES_PAGE 0x80
+#define DEVICES_PORT 0x70
+
+// Lines raised by a write to the first byte of the page and by a read of the port
+#define DEVICES_LINE_WRITE 2
+#define DEVICES_LINE_READ 3
+
+// Device struct, the page behind the mapping and how often each device was called
+typedef struct {
+    unsigned char page[256];
+    unsigned reads;
+    unsigned writes;
+    unsigned portReads;
+} Devices;
+
+// Mapped device read function, every byte changed from what was written
+static unsigned char Devices_Read(void *user, unsigned short address) {
+    Devices *devices = user;
+
+    devices->reads++;
+
+    return devices->page[address & 0xFF] ^ 0x5A;
+}
+
+// Mapped device write function
+static void Devices_Write(void *user, unsigned short address, unsigned char value) {
+    Devices *devices = user;
+
+    devices->writes++;
+    devices->page[address & 0xFF] = value;
+
+    if (!(address & 0xFF)) Interrupt_Raise(1 << DEVICES_LINE_WRITE);
+}
+
+// Attached device read function
+static unsigned char Devices_PortRead(void *user) {
+    Devices *devices = user;
+
+    Interrupt_Raise(1 << DEVICES_LINE_READ);
+
+    return devices->portReads++;
+}
+
+int main(int argc, char **argv) {
+    int useJIT = argc == 3 && !strcmp(argv[1], "-j");
+    Devices devices = {0};
+    CPUState state;
+
+    if (argc != 2 + useJIT) {
+        printf("Usage: %s [-j] image\n", argv[0]);
+
+        return 1;
+    }
+
+    VM *machine = VM_Create();
+
+    if (!machine) return 1;
+
+    if ((useJIT && !VM_EnableJIT(machine)) || !VM_LoadImage(machine, argv[argc - 1], 0)) {
+        VM_Destroy(machine);
+
+        return 1;
+    }
+
+    VM_MapDevice(machine, DEVICES_PAGE, Devices_Read, Devices_Write, &devices);
+    VM_AttachDevice(machine, DEVICES_PORT, Devices_PortRead, NULL, &devices);
+
+    unsigned long long executed = Machine_Run(machine, MACHINE_MAX_INSTRUCTIONS);
+
+    VM_GetState(machine, &state);
+
+    printf("Executed %llu instructions in %llu cycles, %s\n", executed, state.cycles, VM_IsHalted(machine) ? "halted" : "still running");
+    printf("A=%04X B=%04X S=%04X I=%04X F=%02X memory %016llX\n", state.a, state.b, state.s, state.i, state.f, VM_HashMemory(machine));
+    printf("Device read %u times, written %u times, port read %u times\n", devices.reads, devices.writes, devices.portReads);
+
+    VM_Destroy(machine);
+
+    return 0;
+}
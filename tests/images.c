@@ -0,0 +1,901 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "bank.h"
+#include "cpu.h"
+#include "disk.h"
+#include "display.h"
+#include "interrupt.h"
+#include "utils.h"
+
+/*
+    Differential check images
+
+    Writes small guest programs that each execution method has to agree on,
+    into the directory given as the only argument. Each one runs from address
+    0 until it halts, and targets a case where the JIT compiler and translated
+    code take shortcuts the interpreter doesn't:
+
+        alias.bin   - guest loads and stores to the bytes at the top of the
+                      stack, and instructions that read or move the stack
+                      pointer, right after pushes
+        smc.bin     - stores and pushes into instructions of the running block,
+                      both ahead of and behind the current instruction
+        wrap.bin    - pushes, pops, loads and stores wrapping at 0xFFFF, and
+                      shorts split across pages
+        bank.bin    - code written to and run from banks switched in and out
+                      of a window, and overwritten through another window
+                      sharing the bank, for machines with the bank controller
+        display.bin - display mode and cursor changes read back through the
+                      ports, ending in a pixel mode over a pattern, for
+                      frames to compare between a recording and its replay
+        poll.bin    - disk transfers polled through the status port, counting
+                      the polls, so the result shows where device updates
+                      land on the virtual clock however the run is sliced
+        disk.bin    - disk writes and reads completing through the line 1
+                      interrupt, waited out with HT or counted in a loop,
+                      ending halted on a transfer with interrupts disabled
+        irq.bin     - lines raised through the controller port and the disk,
+                      masked, acknowledged and prioritized, let through by
+                      EI, POF and port writes, with one handler nesting
+                      another, logging the order the handlers ran in
+        device.bin  - values read from a port no device of the machine uses,
+                      echoed to the next one, with odd values reading one
+                      more, for tests/replay.c to attach a device to
+        mapped.bin  - fused instructions with the stack on a device page, and
+                      a port read, a store and a push raising a line, for
+                      tests/devices.c to map the devices of
+        fuse.bin    - every fused instruction sequence in a loop, then each
+                      one with the stack over its own code, which isn't RAM
+                      both ways, so it runs unfused and pushes overwrite the
+                      later parts
+*/
+
+// Ports of the device tests/replay.c attaches, read and written by the device image
+#define IMAGES_DEVICE_INPUT 0x60
+#define IMAGES_DEVICE_OUTPUT 0x61
+
+// Port whose read raises line 3, and page whose first byte raises line 2 when written, mapped by tests/devices.c
+#define IMAGES_DEVICE_RAISE 0x70
+#define IMAGES_DEVICE_PAGE 0x80
+
+// Image being assembled, and the address of the next byte
+static unsigned char IMAGE[0x10000];
+static unsigned short HERE = 0;
+
+// Helper functions to assemble bytes, shorts and instructions with a short operand
+static void Images_Byte(unsigned char value) { IMAGE[HERE++] = value; }
+static void Images_Short(unsigned short value) { Images_Byte(value & 0xFF); Images_Byte(value >> 8); }
+static void Images_Op(unsigned char opcode, unsigned short operand) { Images_Byte(opcode); Images_Short(operand); }
+
+// Function to point the operand of an instruction assembled earlier at the next byte
+static void Images_Patch(unsigned short address) {
+    IMAGE[address + 1] = HERE & 0xFF;
+    IMAGE[address + 2] = HERE >> 8;
+}
+
+// Function to write the assembled image out, starting at address 0
+static int Images_Write(const char *directory, const char *name) {
+    char path[1024];
+
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+    FILE *file = fopen(path, "wb");
+
+    if (!file) {
+        printf("Error: Failed to open %s\n", path);
+
+        return 0;
+    }
+
+    fwrite(IMAGE, 1, HERE, file);
+    fclose(file);
+
+    memset(IMAGE, 0, sizeof(IMAGE));
+    HERE = 0;
+
+    return 1;
+}
+
+// Function to assemble the stack aliasing image
+static void Images_Alias(void) {
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_LDAI, 0x0000);
+    Images_Op(CPU_OPCODE_LDBI, 0x0000);
+
+    unsigned short loop = HERE;
+
+    // Load a pushed short back, and store over one before popping it
+    Images_Op(CPU_OPCODE_PUSI, 0x1234);
+    Images_Op(CPU_OPCODE_LDBD, 0x2FFE);
+    Images_Op(CPU_OPCODE_PUSI, 0x5678);
+    Images_Op(CPU_OPCODE_STAD, 0x2FFC);
+    Images_Byte(CPU_OPCODE_ADS);
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_Byte(CPU_OPCODE_XRS);
+
+    // Byte pushes, duplicated and combined
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0x5A);
+    Images_Byte(CPU_OPCODE_DTS);
+    Images_Byte(CPU_OPCODE_ADB);
+    Images_Op(CPU_OPCODE_POBD, 0x2000);
+    Images_Op(CPU_OPCODE_POSD, 0x2002);
+
+    // Swapped and register - addressed stores into the top of the stack
+    Images_Op(CPU_OPCODE_PUSI, 0xBEEF);
+    Images_Byte(CPU_OPCODE_STS);
+    Images_Op(CPU_OPCODE_POSD, 0x2004);
+    Images_Op(CPU_OPCODE_PUSI, 0xCAFE);
+    Images_Byte(CPU_OPCODE_MVBS);
+    Images_Byte(CPU_OPCODE_STARB);
+    Images_Op(CPU_OPCODE_POSD, 0x2006);
+
+    // Instructions reading and replacing the stack pointer after pushes
+    Images_Byte(CPU_OPCODE_PUS);
+    Images_Op(CPU_OPCODE_PUSI, 0x9999);
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Byte(CPU_OPCODE_MVAS);
+    Images_Op(CPU_OPCODE_STAD, 0x2008);
+    Images_Byte(CPU_OPCODE_POA);
+    Images_Byte(CPU_OPCODE_IRS);
+    Images_Byte(CPU_OPCODE_IRS);
+    Images_Byte(CPU_OPCODE_POS);
+    Images_Op(CPU_OPCODE_PUSI, 0x4242);
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_PUSD, 0x2FFE);
+    Images_Op(CPU_OPCODE_POSD, 0x200A);
+
+    Images_Byte(CPU_OPCODE_IRA);
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Op(CPU_OPCODE_PUSI, 300);
+    Images_Byte(CPU_OPCODE_CPS);
+    Images_Op(CPU_OPCODE_JMNZ, loop);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the self - modifying code image
+static void Images_SMC(void) {
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_LDAI, 0x0000);
+
+    // The loop counts in the operand of its own first instruction
+    unsigned short loop = HERE;
+
+    Images_Op(CPU_OPCODE_LDBI, 0x0000);
+    Images_Byte(CPU_OPCODE_IRB);
+    Images_Op(CPU_OPCODE_STBD, loop + 1);
+
+    // Patch an instruction further on in the block, turning it from NO into IRA
+    unsigned short patch = HERE + 5;
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(CPU_OPCODE_IRA);
+    Images_Op(CPU_OPCODE_POBD, patch);
+    Images_Byte(CPU_OPCODE_NO);
+
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_Op(CPU_OPCODE_PUSI, 500);
+    Images_Byte(CPU_OPCODE_CPS);
+    Images_Op(CPU_OPCODE_JMNZ, loop);
+
+    // Push into the operand of the next instruction
+    unsigned short target = HERE + 6;
+
+    Images_Op(CPU_OPCODE_LDSI, target + 3);
+    Images_Op(CPU_OPCODE_PUSI, 0x7777);
+    Images_Op(CPU_OPCODE_LDAI, 0x0000);
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_STAD, 0x2000);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the address wrapping image
+static void Images_Wrap(void) {
+    Images_Op(CPU_OPCODE_JM, 0x0010);
+
+    HERE = 0x0010;
+
+    // Pushes and pops wrapping the stack pointer, over the jump at address 0
+    Images_Op(CPU_OPCODE_LDSI, 0x0001);
+    Images_Op(CPU_OPCODE_PUSI, 0xA1B2);
+    Images_Op(CPU_OPCODE_PUSI, 0xC3D4);
+    Images_Byte(CPU_OPCODE_POA);
+    Images_Byte(CPU_OPCODE_POB);
+    Images_Op(CPU_OPCODE_STAD, 0x2000);
+    Images_Op(CPU_OPCODE_STBD, 0x2002);
+
+    // Loads and stores of shorts at 0xFFFF and across a page boundary
+    Images_Op(CPU_OPCODE_LDAI, 0xABCD);
+    Images_Op(CPU_OPCODE_STAD, 0xFFFF);
+    Images_Op(CPU_OPCODE_LDBD, 0xFFFF);
+    Images_Op(CPU_OPCODE_STBD, 0x20FF);
+    Images_Op(CPU_OPCODE_LDAD, 0x20FF);
+    Images_Op(CPU_OPCODE_STAD, 0x2004);
+
+    // Indexed and indirect addresses wrapping past 0xFFFF
+    Images_Op(CPU_OPCODE_LDAI, 0xFFF0);
+    Images_Op(CPU_OPCODE_LDBI, 0x5AA5);
+    Images_Op(CPU_OPCODE_STBXA, 0x0110);
+    Images_Op(CPU_OPCODE_LDBXA, 0x000F);
+    Images_Op(CPU_OPCODE_STBD, 0x2006);
+    Images_Op(CPU_OPCODE_LDAI, 0xFFFE);
+    Images_Op(CPU_OPCODE_LDBYA, 0x0001);
+    Images_Op(CPU_OPCODE_STBD, 0x2008);
+    Images_Byte(CPU_OPCODE_STARA);
+
+    // Byte pushes wrapping the stack pointer, then a short store of it
+    Images_Op(CPU_OPCODE_LDSI, 0x0000);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0x5A);
+    Images_Byte(CPU_OPCODE_DTS);
+    Images_Byte(CPU_OPCODE_ADB);
+    Images_Op(CPU_OPCODE_POBD, 0x200A);
+    Images_Op(CPU_OPCODE_LDSI, 0xFFFF);
+    Images_Byte(CPU_OPCODE_POA);
+    Images_Op(CPU_OPCODE_STSD, 0xFFFF);
+    Images_Op(CPU_OPCODE_STAD, 0x200C);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the code switching the selected window to a bank
+static void Images_Switch(unsigned char window, unsigned char number) {
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(window);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(BANK_PORT_WINDOW);
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(number);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(BANK_PORT_BANK_LO);
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(BANK_PORT_BANK_HI);
+}
+
+// Function to assemble the code writing a subroutine loading b with a constant at an address
+static void Images_Subroutine(unsigned short address, unsigned char value) {
+    Images_Op(CPU_OPCODE_LDAI, TO_SHORT(CPU_OPCODE_LDBI, value));
+    Images_Op(CPU_OPCODE_STAD, address);
+    Images_Op(CPU_OPCODE_LDAI, TO_SHORT(value, CPU_OPCODE_RT));
+    Images_Op(CPU_OPCODE_STAD, address + 2);
+}
+
+// Function to assemble the code calling the subroutine in window 1 and storing b at an address
+static void Images_Call(unsigned short address) {
+    Images_Op(CPU_OPCODE_CA, 0x4000);
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_Op(CPU_OPCODE_POSD, address);
+}
+
+// Function to assemble the bank switching image, for 16 KiB windows and at least 6 banks
+static void Images_Bank(void) {
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+
+    unsigned short loop = HERE;
+
+    // Two banks in window 1 with different code at the same address
+    Images_Switch(1, 4);
+    Images_Subroutine(0x4000, 0x11);
+    Images_Call(0x2000);
+
+    Images_Switch(1, 5);
+    Images_Subroutine(0x4000, 0x22);
+    Images_Call(0x2002);
+
+    Images_Switch(1, 4);
+    Images_Call(0x2004);
+
+    // Window 2 sharing the bank of window 1, written over the code in it
+    Images_Switch(2, 4);
+    Images_Subroutine(0x8000, 0x33);
+    Images_Call(0x2006);
+    Images_Switch(2, 2);
+
+    Images_Op(CPU_OPCODE_LDAD, 0x2010);
+    Images_Byte(CPU_OPCODE_IRA);
+    Images_Op(CPU_OPCODE_STAD, 0x2010);
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Op(CPU_OPCODE_PUSI, 50);
+    Images_Byte(CPU_OPCODE_CPS);
+    Images_Op(CPU_OPCODE_JMNZ, loop);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the code sending a display command with a data value
+static void Images_Display(unsigned char command, unsigned short data) {
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(data & 0xFF);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(DISPLAY_PORT_DATA_LO);
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(data >> 8);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(DISPLAY_PORT_DATA_HI);
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(command);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(DISPLAY_PORT_COMMAND);
+}
+
+// Function to assemble the code reading a display register back and storing it at an address
+static void Images_DisplayRead(unsigned char command, unsigned short address) {
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(command);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(DISPLAY_PORT_COMMAND);
+
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(DISPLAY_PORT_DATA_LO);
+    Images_Op(CPU_OPCODE_POBD, address);
+}
+
+// Function to assemble the display mode switching image
+static void Images_DisplayModes(void) {
+    Images_Op(CPU_OPCODE_LDSI, 0x8000);
+
+    // Cursor changes in a text mode, and the index they work out to
+    Images_Display(DISPLAY_COMMAND_SET_MODE, DISPLAY_MODE_TEXT_80_60_16);
+    Images_Display(DISPLAY_COMMAND_SET_CURSOR_POS, TO_SHORT(7, 3));
+    Images_DisplayRead(DISPLAY_COMMAND_GET_CURSOR_INDEX, 0x7F00);
+    Images_Display(DISPLAY_COMMAND_SET_CURSOR_TYPE, 0x03);
+    Images_DisplayRead(DISPLAY_COMMAND_GET_CURSOR_TYPE, 0x7F01);
+
+    // A pixel mode over a pattern of its own addresses, drawn in the final frame
+    Images_Display(DISPLAY_COMMAND_SET_MODE, DISPLAY_MODE_PIXEL_320_200_16);
+    Images_DisplayRead(DISPLAY_COMMAND_GET_MODE, 0x7F02);
+
+    Images_Op(CPU_OPCODE_LDAI, 0x1000);
+
+    unsigned short loop = HERE;
+
+    Images_Byte(CPU_OPCODE_STARA);
+    Images_Byte(CPU_OPCODE_IRA);
+    Images_Byte(CPU_OPCODE_IRA);
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Op(CPU_OPCODE_PUSI, 0x7D00);
+    Images_Byte(CPU_OPCODE_CPS);
+    Images_Op(CPU_OPCODE_JMNZ, loop);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the code sending a disk command with a data value
+static void Images_Disk(unsigned char command, unsigned short data) {
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(data & 0xFF);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(DISK_PORT_DATA_LO);
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(data >> 8);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(DISK_PORT_DATA_HI);
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(command);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(DISK_PORT_COMMAND);
+}
+
+// Function to assemble the code starting a disk transfer of sectors between a start sector and a memory address
+static void Images_DiskTransfer(unsigned char command, unsigned char sector, unsigned short address, unsigned char count) {
+    Images_Disk(DISK_COMMAND_SET_START_SECTOR, sector);
+    Images_Disk(DISK_COMMAND_SET_MEMORY_ADDRESS, address);
+    Images_Disk(DISK_COMMAND_SET_SECTOR_COUNT, count);
+    Images_Disk(command, 0);
+}
+
+// Function to assemble the code polling the disk status until it is ready, counting each poll with an instruction
+static void Images_DiskPoll(unsigned char counter) {
+    unsigned short poll = HERE;
+
+    Images_Byte(counter);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(DISK_PORT_STATUS);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0x02);
+    Images_Byte(CPU_OPCODE_ANB);
+    Images_Op(CPU_OPCODE_POBD, 0x2F00);
+    Images_Op(CPU_OPCODE_JMZ, poll);
+}
+
+// Function to assemble the disk polling image
+static void Images_Poll(void) {
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_LDAI, 0x0000);
+    Images_Op(CPU_OPCODE_LDBI, 0x0000);
+
+    // Write the code out to the disk, then read it back elsewhere, polling both transfers
+    Images_DiskTransfer(DISK_COMMAND_WRITE_SECTORS, 3, 0x0000, 1);
+    Images_DiskPoll(CPU_OPCODE_IRA);
+    Images_Op(CPU_OPCODE_STAD, 0x2000);
+
+    Images_DiskTransfer(DISK_COMMAND_READ_SECTORS, 3, 0x4000, 2);
+    Images_DiskPoll(CPU_OPCODE_IRB);
+    Images_Op(CPU_OPCODE_STBD, 0x2002);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the disk interrupt image
+static void Images_DiskInterrupt(void) {
+    Images_Op(CPU_OPCODE_JM, 0x0080);
+
+    // The line 1 handler counts completions, enabling interrupts again before it returns
+    HERE = INTERRUPT_LINE_DISK << 3;
+
+    Images_Op(CPU_OPCODE_JM, 0x0040);
+
+    HERE = 0x0040;
+
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Op(CPU_OPCODE_LDAD, 0x2010);
+    Images_Byte(CPU_OPCODE_IRA);
+    Images_Op(CPU_OPCODE_STAD, 0x2010);
+    Images_Byte(CPU_OPCODE_POA);
+    Images_Byte(CPU_OPCODE_EI);
+    Images_Byte(CPU_OPCODE_RT);
+
+    HERE = 0x0080;
+
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Disk(DISK_COMMAND_ENABLE_INTERRUPTS, 0);
+    Images_Byte(CPU_OPCODE_EI);
+
+    // Write the code out and read it back elsewhere, halting until each transfer completes
+    Images_DiskTransfer(DISK_COMMAND_WRITE_SECTORS, 5, 0x0000, 2);
+    Images_Byte(CPU_OPCODE_HT);
+
+    Images_DiskTransfer(DISK_COMMAND_READ_SECTORS, 5, 0x5000, 2);
+    Images_Byte(CPU_OPCODE_HT);
+
+    // Count in a loop until the handler has seen the next transfer complete
+    Images_DiskTransfer(DISK_COMMAND_WRITE_SECTORS, 9, 0x5000, 1);
+    Images_Op(CPU_OPCODE_LDBI, 0x0000);
+
+    unsigned short loop = HERE;
+
+    Images_Byte(CPU_OPCODE_IRB);
+    Images_Op(CPU_OPCODE_LDAD, 0x2010);
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Op(CPU_OPCODE_PUSI, 3);
+    Images_Byte(CPU_OPCODE_CPS);
+    Images_Op(CPU_OPCODE_JMNZ, loop);
+    Images_Op(CPU_OPCODE_STBD, 0x2012);
+
+    // With interrupts disabled the completion doesn't wake the CPU, which stays halted once the transfer is done
+    Images_Byte(CPU_OPCODE_DI);
+    Images_DiskTransfer(DISK_COMMAND_READ_SECTORS, 9, 0x6000, 1);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the code writing a value to an interrupt controller port
+static void Images_Interrupt(unsigned char port, unsigned char value) {
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(value);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(port);
+}
+
+// Function to assemble the code appending a to the interrupt log
+static void Images_InterruptLog(void) {
+    Images_Op(CPU_OPCODE_LDBD, 0x20F0);
+    Images_Byte(CPU_OPCODE_STARB);
+    Images_Byte(CPU_OPCODE_IRB);
+    Images_Byte(CPU_OPCODE_IRB);
+    Images_Op(CPU_OPCODE_STBD, 0x20F0);
+}
+
+// Function to assemble the interrupt controller image
+static void Images_InterruptController(void) {
+    Images_Op(CPU_OPCODE_JM, 0x0080);
+
+    // Every vector but line 0 loads its line number and logs it in the common handler
+    for (unsigned line = 1; line < INTERRUPT_LINE_COUNT; line++) {
+        HERE = line << 3;
+
+        Images_Byte(CPU_OPCODE_PUA);
+        Images_Op(CPU_OPCODE_LDAI, line);
+        Images_Op(CPU_OPCODE_JM, 0x0040);
+    }
+
+    HERE = 0x0040;
+
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_InterruptLog();
+
+    // The line 3 handler enables interrupts and raises line 6, which runs nested before it logs its end
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Op(CPU_OPCODE_PUSI, 3);
+    Images_Byte(CPU_OPCODE_CPS);
+
+    unsigned short skip = HERE;
+
+    Images_Op(CPU_OPCODE_JMNZ, 0x0000);
+
+    Images_Byte(CPU_OPCODE_EI);
+    Images_Interrupt(INTERRUPT_PORT_RAISE, 1 << 6);
+    Images_Byte(CPU_OPCODE_DI);
+    Images_Op(CPU_OPCODE_LDAI, 0x0033);
+    Images_InterruptLog();
+    Images_Patch(skip);
+
+    Images_Byte(CPU_OPCODE_POB);
+    Images_Byte(CPU_OPCODE_POA);
+    Images_Byte(CPU_OPCODE_EI);
+    Images_Byte(CPU_OPCODE_RT);
+
+    HERE = 0x0080;
+
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_LDAI, 0x2100);
+    Images_Op(CPU_OPCODE_STAD, 0x20F0);
+
+    // Lines raised together run by priority, with a masked one held back until it is unmasked
+    Images_Interrupt(INTERRUPT_PORT_PRIORITY, 0x25);
+    Images_Interrupt(INTERRUPT_PORT_PRIORITY, 0x47);
+    Images_Interrupt(INTERRUPT_PORT_PRIORITY, 0x61);
+    Images_Interrupt(INTERRUPT_PORT_MASK, 1 << 6);
+    Images_Interrupt(INTERRUPT_PORT_RAISE, (1 << 2) | (1 << 4) | (1 << 6));
+    Images_Byte(CPU_OPCODE_EI);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(INTERRUPT_PORT_PENDING);
+    Images_Op(CPU_OPCODE_POBD, 0x2000);
+    Images_Interrupt(INTERRUPT_PORT_MASK, 0);
+
+    // Lines of the same priority run lowest first
+    Images_Interrupt(INTERRUPT_PORT_RAISE, (1 << 5) | (1 << 7));
+
+    // An acknowledged line never runs
+    Images_Byte(CPU_OPCODE_DI);
+    Images_Interrupt(INTERRUPT_PORT_RAISE, 1 << 7);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(INTERRUPT_PORT_PENDING);
+    Images_Op(CPU_OPCODE_POBD, 0x2001);
+    Images_Interrupt(INTERRUPT_PORT_PENDING, 1 << 7);
+    Images_Byte(CPU_OPCODE_EI);
+
+    // A handler nesting another
+    Images_Interrupt(INTERRUPT_PORT_RAISE, 1 << 3);
+
+    // Popping the flags lets a pending line through
+    Images_Byte(CPU_OPCODE_DI);
+    Images_Interrupt(INTERRUPT_PORT_RAISE, 1 << 5);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(CPU_FLAG_I);
+    Images_Byte(CPU_OPCODE_POF);
+
+    // A short port write unmasking a line and raising another
+    Images_Interrupt(INTERRUPT_PORT_MASK, 1 << 2);
+    Images_Interrupt(INTERRUPT_PORT_RAISE, 1 << 2);
+    Images_Op(CPU_OPCODE_PUSI, TO_SHORT(0, 1 << 7));
+    Images_Byte(CPU_OPCODE_OPS);
+    Images_Byte(INTERRUPT_PORT_MASK);
+
+    // A disk completion held back by the mask while polling the pending lines, then one waited out with HT
+    Images_Disk(DISK_COMMAND_ENABLE_INTERRUPTS, 0);
+    Images_Interrupt(INTERRUPT_PORT_MASK, 1 << INTERRUPT_LINE_DISK);
+    Images_DiskTransfer(DISK_COMMAND_READ_SECTORS, 0, 0x5000, 1);
+    Images_Op(CPU_OPCODE_LDBI, 0x0000);
+
+    unsigned short poll = HERE;
+
+    Images_Byte(CPU_OPCODE_IRB);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(INTERRUPT_PORT_PENDING);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(1 << INTERRUPT_LINE_DISK);
+    Images_Byte(CPU_OPCODE_ANB);
+    Images_Op(CPU_OPCODE_POBD, 0x2F00);
+    Images_Op(CPU_OPCODE_JMZ, poll);
+    Images_Op(CPU_OPCODE_STBD, 0x2002);
+    Images_Interrupt(INTERRUPT_PORT_MASK, 0);
+
+    Images_DiskTransfer(DISK_COMMAND_READ_SECTORS, 0, 0x5100, 1);
+    Images_Byte(CPU_OPCODE_HT);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the external device image
+static void Images_Device(void) {
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_LDBI, 0x0000);
+
+    unsigned short loop = HERE;
+
+    // Echo each value read back to the device, and add it to a sum
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(IMAGES_DEVICE_INPUT);
+    Images_Op(CPU_OPCODE_POBD, 0x2000);
+    Images_Op(CPU_OPCODE_PUBD, 0x2000);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(IMAGES_DEVICE_OUTPUT);
+    Images_Op(CPU_OPCODE_PUSD, 0x2002);
+    Images_Op(CPU_OPCODE_PUSD, 0x2000);
+    Images_Byte(CPU_OPCODE_ADS);
+    Images_Op(CPU_OPCODE_POSD, 0x2002);
+
+    // Odd values read one more, so how many reads there are depends on what they return
+    Images_Op(CPU_OPCODE_PUBD, 0x2000);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0x01);
+    Images_Byte(CPU_OPCODE_ANB);
+    Images_Op(CPU_OPCODE_POBD, 0x2F00);
+
+    unsigned short even = HERE;
+
+    Images_Op(CPU_OPCODE_JMZ, 0x0000);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(IMAGES_DEVICE_INPUT);
+    Images_Op(CPU_OPCODE_POBD, 0x2004);
+    Images_Op(CPU_OPCODE_LDAD, 0x2006);
+    Images_Byte(CPU_OPCODE_IRA);
+    Images_Op(CPU_OPCODE_STAD, 0x2006);
+    Images_Patch(even);
+
+    Images_Byte(CPU_OPCODE_IRB);
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_Op(CPU_OPCODE_PUSI, 64);
+    Images_Byte(CPU_OPCODE_CPS);
+    Images_Op(CPU_OPCODE_JMNZ, loop);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the code counting eight instructions in b
+static void Images_Count(void) {
+    for (int count = 0; count < 8; count++) Images_Byte(CPU_OPCODE_IRB);
+}
+
+// Function to assemble the mapped device image
+static void Images_MappedDevice(void) {
+    Images_Op(CPU_OPCODE_JM, 0x0080);
+
+    // Both lines log the count they interrupted
+    HERE = 2 << 3;
+    Images_Op(CPU_OPCODE_JM, 0x0040);
+    HERE = 3 << 3;
+    Images_Op(CPU_OPCODE_JM, 0x0040);
+
+    HERE = 0x0040;
+
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Op(CPU_OPCODE_LDAD, 0x20F0);
+    Images_Byte(CPU_OPCODE_STBRA);
+    Images_Byte(CPU_OPCODE_IRA);
+    Images_Byte(CPU_OPCODE_IRA);
+    Images_Op(CPU_OPCODE_STAD, 0x20F0);
+    Images_Byte(CPU_OPCODE_POA);
+    Images_Byte(CPU_OPCODE_EI);
+    Images_Byte(CPU_OPCODE_RT);
+
+    HERE = 0x0080;
+
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_LDAI, 0x2100);
+    Images_Op(CPU_OPCODE_STAD, 0x20F0);
+
+    // Fused sequences with the stack on the device page, which changes every byte read back
+    Images_Op(CPU_OPCODE_LDSI, TO_SHORT(0x80, IMAGES_DEVICE_PAGE));
+    Images_Op(CPU_OPCODE_PUSI, 0x1234);
+    Images_Op(CPU_OPCODE_PUSI, 0x0001);
+    Images_Byte(CPU_OPCODE_ADS);
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_Byte(CPU_OPCODE_ADS);
+    Images_Byte(CPU_OPCODE_POA);
+    Images_Byte(CPU_OPCODE_POB);
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0x42);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0x42);
+    Images_Byte(CPU_OPCODE_CPB);
+    Images_Op(CPU_OPCODE_JMZ, HERE + 3);
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0xFF);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(INTERRUPT_PORT_MASK);
+    Images_Byte(CPU_OPCODE_ANB);
+    Images_Op(CPU_OPCODE_JMNZ, HERE + 3);
+    Images_Op(CPU_OPCODE_POBD, 0x2000);
+    Images_Op(CPU_OPCODE_STAD, 0x2002);
+    Images_Op(CPU_OPCODE_STBD, 0x2004);
+
+    // A port read, a fused port read, a store and a push raising a line, each taken right after the instruction
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_LDBI, 0x0000);
+
+    Images_Byte(CPU_OPCODE_EI);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(IMAGES_DEVICE_RAISE);
+    Images_Count();
+    Images_Byte(CPU_OPCODE_DI);
+    Images_Op(CPU_OPCODE_POBD, 0x2010);
+
+    Images_Byte(CPU_OPCODE_EI);
+    Images_Byte(CPU_OPCODE_IPS);
+    Images_Byte(IMAGES_DEVICE_RAISE);
+    Images_Count();
+    Images_Byte(CPU_OPCODE_DI);
+    Images_Op(CPU_OPCODE_POSD, 0x2012);
+
+    Images_Byte(CPU_OPCODE_EI);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0xFF);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(IMAGES_DEVICE_RAISE);
+    Images_Byte(CPU_OPCODE_ANB);
+    Images_Op(CPU_OPCODE_JMZ, HERE + 3);
+    Images_Count();
+    Images_Byte(CPU_OPCODE_DI);
+    Images_Op(CPU_OPCODE_POBD, 0x2014);
+
+    Images_Byte(CPU_OPCODE_EI);
+    Images_Op(CPU_OPCODE_STAD, TO_SHORT(0x00, IMAGES_DEVICE_PAGE));
+    Images_Count();
+
+    Images_Op(CPU_OPCODE_LDSI, TO_SHORT(0x02, IMAGES_DEVICE_PAGE));
+    Images_Op(CPU_OPCODE_PUSI, 0x5678);
+    Images_Count();
+    Images_Byte(CPU_OPCODE_DI);
+
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+// Function to assemble the fused instruction image
+static void Images_Fusion(void) {
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_LDAI, 0x0000);
+    Images_Op(CPU_OPCODE_LDBI, 0x0001);
+    Images_Op(CPU_OPCODE_PUSI, 0x0000);
+
+    unsigned short loop = HERE;
+
+    // Every fused sequence, with the parity of the count read back through the mask port
+    Images_Op(CPU_OPCODE_PUSI, 0x0101);
+    Images_Byte(CPU_OPCODE_ADS);
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_Byte(CPU_OPCODE_ADS);
+    Images_Byte(CPU_OPCODE_POA);
+    Images_Byte(CPU_OPCODE_IRB);
+    Images_Op(CPU_OPCODE_STBD, 0x2010);
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_Byte(CPU_OPCODE_OPB);
+    Images_Byte(INTERRUPT_PORT_MASK);
+    Images_Op(CPU_OPCODE_POBD, 0x2011);
+
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0x01);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(INTERRUPT_PORT_MASK);
+    Images_Byte(CPU_OPCODE_ANB);
+
+    unsigned short even = HERE;
+
+    Images_Op(CPU_OPCODE_JMZ, 0x0000);
+    Images_Op(CPU_OPCODE_POBD, 0x2012);
+
+    unsigned short join = HERE;
+
+    Images_Op(CPU_OPCODE_JM, 0x0000);
+    Images_Patch(even);
+    Images_Op(CPU_OPCODE_POBD, 0x2013);
+    Images_Patch(join);
+
+    Images_Op(CPU_OPCODE_PUBD, 0x2010);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0x05);
+    Images_Byte(CPU_OPCODE_CPB);
+    Images_Op(CPU_OPCODE_JMNZ, loop);
+
+    Images_Op(CPU_OPCODE_PUBD, 0x2010);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(0x05);
+    Images_Byte(CPU_OPCODE_CPB);
+    Images_Op(CPU_OPCODE_JMZ, HERE + 3);
+    Images_Op(CPU_OPCODE_POSD, 0x2014);
+
+    // Pushes over the later parts of the fused instruction, turning them into NO
+    Images_Op(CPU_OPCODE_LDSI, HERE + 8);
+    Images_Op(CPU_OPCODE_PUSI, TO_SHORT(CPU_OPCODE_NO, CPU_OPCODE_NO));
+    Images_Byte(CPU_OPCODE_ADS);
+    Images_Byte(CPU_OPCODE_IRA);
+
+    Images_Op(CPU_OPCODE_LDSI, HERE + 6);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(CPU_OPCODE_NO);
+    Images_Byte(CPU_OPCODE_CPB);
+    Images_Op(CPU_OPCODE_JMZ, HERE + 3);
+
+    Images_Op(CPU_OPCODE_LDSI, HERE + 6);
+    Images_Byte(CPU_OPCODE_PUBI);
+    Images_Byte(CPU_OPCODE_NO);
+    Images_Byte(CPU_OPCODE_CPB);
+    Images_Op(CPU_OPCODE_JMNZ, HERE + 3);
+
+    Images_Op(CPU_OPCODE_LDAI, TO_SHORT(CPU_OPCODE_NO, CPU_OPCODE_NO));
+    Images_Op(CPU_OPCODE_LDSI, HERE + 6);
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_Byte(CPU_OPCODE_ADS);
+    Images_Byte(CPU_OPCODE_POA);
+
+    Images_Interrupt(INTERRUPT_PORT_MASK, CPU_OPCODE_NO);
+    Images_Op(CPU_OPCODE_LDSI, HERE + 6);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(INTERRUPT_PORT_MASK);
+    Images_Byte(CPU_OPCODE_ANB);
+    Images_Op(CPU_OPCODE_JMNZ, HERE + 3);
+
+    // Pushes into the code jumped over, splitting fused instructions after a later part
+    Images_Op(CPU_OPCODE_LDSI, HERE + 8);
+    Images_Op(CPU_OPCODE_JM, HERE + 5);
+    Images_Short(0x0000);
+    Images_Byte(CPU_OPCODE_PUA);
+    Images_Byte(CPU_OPCODE_PUB);
+    Images_Byte(CPU_OPCODE_ADS);
+    Images_Byte(CPU_OPCODE_POA);
+
+    Images_Op(CPU_OPCODE_LDSI, HERE + 7);
+    Images_Op(CPU_OPCODE_JM, HERE + 4);
+    Images_Byte(0x00);
+    Images_Byte(CPU_OPCODE_IPB);
+    Images_Byte(INTERRUPT_PORT_MASK);
+    Images_Byte(CPU_OPCODE_ANB);
+    Images_Op(CPU_OPCODE_JMZ, HERE + 3);
+
+    Images_Op(CPU_OPCODE_LDSI, 0x3000);
+    Images_Op(CPU_OPCODE_STAD, 0x2016);
+    Images_Op(CPU_OPCODE_STBD, 0x2018);
+    Images_Byte(CPU_OPCODE_HT);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        printf("Usage: %s directory\n", argv[0]);
+
+        return 1;
+    }
+
+    Images_Alias();
+    if (!Images_Write(argv[1], "alias.bin")) return 1;
+
+    Images_SMC();
+    if (!Images_Write(argv[1], "smc.bin")) return 1;
+
+    Images_Wrap();
+    if (!Images_Write(argv[1], "wrap.bin")) return 1;
+
+    Images_Bank();
+    if (!Images_Write(argv[1], "bank.bin")) return 1;
+
+    Images_DisplayModes();
+    if (!Images_Write(argv[1], "display.bin")) return 1;
+
+    Images_Poll();
+    if (!Images_Write(argv[1], "poll.bin")) return 1;
+
+    Images_DiskInterrupt();
+    if (!Images_Write(argv[1], "disk.bin")) return 1;
+
+    Images_InterruptController();
+    if (!Images_Write(argv[1], "irq.bin")) return 1;
+
+    Images_Device();
+    if (!Images_Write(argv[1], "device.bin")) return 1;
+
+    Images_MappedDevice();
+    if (!Images_Write(argv[1], "mapped.bin")) return 1;
+
+    Images_Fusion();
+    if (!Images_Write(argv[1], "fuse.bin")) return 1;
+
+    return 0;
+}
\ No newline at end of file
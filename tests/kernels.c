@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "blit.h"
+
+/*
+    Conversion kernel check
+
+    Forces each vectorized conversion kernel the host supports and compares
+    what it writes against the scalar kernel, over every row length up to a
+    few whole vectors past the widest mode, from unaligned source bytes into
+    unaligned pixels. Guard pixels past the end of each row catch kernels
+    writing beyond it. Kernels the host lacks are skipped.
+*/
+
+// Longest row checked in bytes, past the 160 bytes of a 320 pixel 16 color row
+#define KERNELS_MAX_COUNT 224
+
+// Number of unaligned starting points checked, covering a whole AVX2 vector
+#define KERNELS_MAX_OFFSET 32
+
+// Pixels past the end of each row that must stay untouched
+#define KERNELS_GUARD 64
+
+// Value the pixels are filled with before each conversion
+#define KERNELS_FILL 0xDEADBEEF
+
+// Names of the kernels, in kernel enum order
+static const char *KERNEL_NAMES[] = { "scalar", "sse2", "ssse3", "avx2" };
+
+// Source bytes, and the pixels written by the scalar kernel and the kernel being checked
+static unsigned char BYTES[KERNELS_MAX_OFFSET + KERNELS_MAX_COUNT];
+static unsigned EXPECTED[KERNELS_MAX_OFFSET + KERNELS_MAX_COUNT * 8 + KERNELS_GUARD];
+static unsigned ACTUAL[KERNELS_MAX_OFFSET + KERNELS_MAX_COUNT * 8 + KERNELS_GUARD];
+
+// Palette with every byte of every color distinct
+static unsigned PALETTE[16];
+
+// Function to convert one row with a kernel into pixels from an offset on, either monochrome or 16 color
+static void Kernels_Convert(BlitKernel kernel, unsigned *pixels, unsigned offset, const unsigned char *bytes, unsigned count, int mono) {
+    Blit_SetKernel(kernel);
+
+    for (unsigned i = 0; i < sizeof(EXPECTED) / sizeof(unsigned); i++) pixels[i] = KERNELS_FILL;
+
+    if (mono)
+        Blit_ExpandMono(pixels + offset, bytes, count, 0x00C0FFEE);
+    else
+        Blit_Expand16(pixels + offset, bytes, count, PALETTE);
+}
+
+// Function to check one kernel against the scalar one, returning 0 on the first row that differs
+static int Kernels_Check(BlitKernel kernel) {
+    for (int mono = 0; mono <= 1; mono++) {
+        for (unsigned offset = 0; offset < KERNELS_MAX_OFFSET; offset++) {
+            for (unsigned count = 0; count <= KERNELS_MAX_COUNT; count++) {
+                const unsigned char *bytes = BYTES + offset;
+
+                // The pixels start unaligned independently of the bytes
+                unsigned shift = (offset + count) % KERNELS_MAX_OFFSET;
+
+                Kernels_Convert(BLIT_KERNEL_SCALAR, EXPECTED, shift, bytes, count, mono);
+                Kernels_Convert(kernel, ACTUAL, shift, bytes, count, mono);
+
+                if (memcmp(EXPECTED, ACTUAL, sizeof(EXPECTED))) {
+                    printf("%s: %s row of %u bytes from offset %u differs from the scalar kernel\n", KERNEL_NAMES[kernel], mono ? "monochrome" : "16 color", count, offset);
+
+                    return 0;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+int main(void) {
+    unsigned seed = 1;
+
+    // Every byte value appears, and the rest is pseudo - random
+    for (unsigned i = 0; i < sizeof(BYTES); i++) {
+        seed = seed * 1103515245 + 12345;
+        BYTES[i] = i < 256 ? i : seed >> 16;
+    }
+
+    for (int i = 0; i < 16; i++) PALETTE[i] = 0x01010101 * i + 0x00102030;
+
+    int failed = 0;
+
+    for (int kernel = BLIT_KERNEL_SSE2; kernel <= BLIT_KERNEL_AVX2; kernel++) {
+        if (!Blit_SetKernel(kernel)) {
+            printf("%s: not supported by the host, skipped\n", KERNEL_NAMES[kernel]);
+            continue;
+        }
+
+        if (Kernels_Check(kernel))
+            printf("%s: matches the scalar kernel\n", KERNEL_NAMES[kernel]);
+        else
+            failed = 1;
+    }
+
+    return failed;
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#ifndef __TESTS_MACHINE_H__
+#define __TESTS_MACHINE_H__
+
+#include <stdio.h>
+
+#include "cpu.h"
+#include "vm.h"
+
+/*
+    Machine fixture
+
+    Runs a machine to its halt in batches, and takes and compares the state
+    of machines run different ways, registers, virtual clock, memory and
+    disk alike. Shared by the snapshot, replay and device checks, which
+    include it into their own single file program.
+*/
+
+// Number of instructions executed between halt checks
+#define MACHINE_BATCH_SIZE 10000
+
+// Instructions after which an image that hasn't halted fails a check
+#define MACHINE_MAX_INSTRUCTIONS 100000000ull
+
+// Machine state compared between runs
+typedef struct {
+    CPUState cpu;
+    unsigned long long memoryHash;
+    unsigned long long diskHash;
+} MachineState;
+
+// Function to run a machine until it halts or has executed count instructions, returning how many it did
+static unsigned long long Machine_Run(VM *machine, unsigned long long count) {
+    unsigned long long executed = 0;
+
+    while (!VM_IsHalted(machine) && executed < count) {
+        unsigned batch = count - executed < MACHINE_BATCH_SIZE ? count - executed : MACHINE_BATCH_SIZE;
+
+        executed += VM_Run(machine, batch);
+    }
+
+    return executed;
+}
+
+// Function to get the registers of a machine and hash its memory and disk
+static void Machine_GetState(VM *machine, MachineState *state) {
+    VM_GetState(machine, &state->cpu);
+
+    state->memoryHash = VM_HashMemory(machine);
+    state->diskHash = VM_HashDisk(machine);
+}
+
+// Function to check two machine states are the same, printing both if not
+static int Machine_Compare(const char *name, const char *what, const MachineState *expected, const MachineState *actual) {
+    const CPUState *a = &expected->cpu;
+    const CPUState *b = &actual->cpu;
+
+    if (a->a == b->a && a->b == b->b && a->s == b->s && a->i == b->i && a->f == b->f && a->cycles == b->cycles &&
+        expected->memoryHash == actual->memoryHash && expected->diskHash == actual->diskHash) return 1;
+
+    printf("%s: %s differs\n", name, what);
+    printf("    expected A=%04X B=%04X S=%04X I=%04X F=%02X cycles %llu memory %016llX disk %016llX\n", a->a, a->b, a->s, a->i, a->f, a->cycles, expected->memoryHash, expected->diskHash);
+    printf("    actual   A=%04X B=%04X S=%04X I=%04X F=%02X cycles %llu memory %016llX disk %016llX\n", b->a, b->b, b->s, b->i, b->f, b->cycles, actual->memoryHash, actual->diskHash);
+
+    return 0;
+}
+
+#endif
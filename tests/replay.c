@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "memory.h"
+#include "vm.h"
+
+#include "machine.h"
+
+/*
+    Record and replay check
+
+    Attaches a device the machine knows nothing about to the ports the
+    image given on the command line reads and writes, and records a run of
+    it, the device answering from one sequence. Replaying the log with a
+    device answering from another has to end where the recording did,
+    without calling the device. Two replays then hand over to the device
+    halfway: one where the guest's reads are patched to another port, so
+    they no longer match the log, and one of a log recorded only up to
+    there. Both have to end like a run without a trace whose device
+    switches to the other sequence at the same point, registers, virtual
+    clock, memory and disk alike. Machines run through the JIT compiler
+    with -j, and with the bank controller with -m.
+*/
+
+// Ports of the device, read and written by the image, and the port its reads are patched to
+#define REPLAY_PORT_INPUT 0x60
+#define REPLAY_PORT_OUTPUT 0x61
+#define REPLAY_PORT_OTHER 0x62
+
+// Seeds of the sequences the device answers from
+#define REPLAY_SEED_RECORD 0x11
+#define REPLAY_SEED_REPLAY 0x5A
+
+// Physical memory in KiB for the bank controller, 0 to run without it
+static unsigned MEMORY_KIB = 0;
+
+// Run the CPU through the JIT compiler flag
+static int USE_JIT = 0;
+
+// Device struct, answering reads from a sequence and counting what it is called with
+typedef struct {
+    unsigned char seed;
+    unsigned reads;
+    unsigned writes;
+} ReplayDevice;
+
+// Device read function, the next value of its sequence
+static unsigned char Replay_DeviceRead(void *user) {
+    ReplayDevice *device = user;
+    unsigned index = device->reads++;
+
+    return (unsigned char)(index * 0x3B + device->seed) ^ (index >> 2);
+}
+
+// Device write function
+static void Replay_DeviceWrite(void *user, unsigned char value) {
+    ReplayDevice *device = user;
+
+    device->writes++;
+}
+
+// Function to start a device over on another sequence
+static void Replay_Switch(ReplayDevice *device, unsigned char seed) {
+    device->seed = seed;
+    device->reads = 0;
+    device->writes = 0;
+}
+
+// Function to create a machine with the devices asked for and the image loaded, attaching the device to its ports
+static VM *Replay_Create(const char *path, ReplayDevice *device) {
+    VM *machine = VM_Create();
+
+    if (!machine) return NULL;
+
+    if ((MEMORY_KIB && !VM_EnableBanks(machine, MEMORY_KIB * 1024)) || (USE_JIT && !VM_EnableJIT(machine)) || !VM_LoadImage(machine, path, 0)) {
+        VM_Destroy(machine);
+
+        return NULL;
+    }
+
+    VM_AttachDevice(machine, REPLAY_PORT_INPUT, Replay_DeviceRead, NULL, device);
+    VM_AttachDevice(machine, REPLAY_PORT_OUTPUT, NULL, Replay_DeviceWrite, device);
+    VM_AttachDevice(machine, REPLAY_PORT_OTHER, Replay_DeviceRead, NULL, device);
+
+    return machine;
+}
+
+// Function to point every read of the input port in memory at the other port
+static void Replay_PatchReads(VM *machine) {
+    unsigned char memory[MEMORY_SIZE];
+
+    VM_ReadMemory(machine, 0, memory, MEMORY_SIZE);
+
+    for (unsigned address = 0; address < MEMORY_SIZE - 1; address++) {
+        if (memory[address] == CPU_OPCODE_IPB && memory[address + 1] == REPLAY_PORT_INPUT) {
+            unsigned char port = REPLAY_PORT_OTHER;
+
+            VM_WriteMemory(machine, address + 1, &port, 1);
+        }
+    }
+}
+
+// Function to check the device of a replay was called as often as the one of the run it is compared with
+static int Replay_CompareDevice(const char *name, const char *what, const ReplayDevice *expected, const ReplayDevice *actual) {
+    if (expected->reads == actual->reads) return 1;
+
+    printf("%s: %s read the device %u times instead of %u\n", name, what, actual->reads, expected->reads);
+
+    return 0;
+}
+
+// Function to run a machine to the halt, optionally recording, replaying or patching its reads halfway, returning how many instructions it executed or 0 if a step fails
+static unsigned long long Replay_Trace(const char *name, VM *machine, ReplayDevice *device, const char *record, const char *replay, unsigned long long half, int patch, MachineState *state) {
+    unsigned long long executed = 0;
+
+    if ((record && !VM_StartRecording(machine, record)) || (replay && !VM_StartReplay(machine, replay))) return 0;
+
+    // Recordings stop halfway when asked to, and runs without a trace switch their device over there
+    if (half) {
+        executed = Machine_Run(machine, half);
+
+        if (record) VM_StopTrace(machine);
+        if (!record && !replay) Replay_Switch(device, REPLAY_SEED_REPLAY);
+        if (patch) Replay_PatchReads(machine);
+    }
+
+    executed += Machine_Run(machine, MACHINE_MAX_INSTRUCTIONS);
+
+    if (!VM_IsHalted(machine)) {
+        printf("%s: didn't halt within %llu instructions\n", name, MACHINE_MAX_INSTRUCTIONS);
+
+        return 0;
+    }
+
+    Machine_GetState(machine, state);
+
+    return executed;
+}
+
+// Function to run the image on a machine of its own with a device answering from seed, see Replay_Trace
+static unsigned long long Replay_Machine(const char *path, const char *name, ReplayDevice *device, unsigned char seed, const char *record, const char *replay, unsigned long long half, int patch, MachineState *state) {
+    Replay_Switch(device, seed);
+
+    VM *machine = Replay_Create(path, device);
+
+    if (!machine) {
+        printf("%s: failed to create the machine\n", name);
+
+        return 0;
+    }
+
+    unsigned long long executed = Replay_Trace(name, machine, device, record, replay, half, patch, state);
+
+    VM_Destroy(machine);
+
+    return executed;
+}
+
+// Function to check one image, returning 0 if it fails
+static int Replay_Check(const char *path) {
+    const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    char log[1024];
+    ReplayDevice expected, actual;
+    MachineState recording, reference, state;
+
+    snprintf(log, sizeof(log), "%s.replay", path);
+
+    // The recording sets what the replays have to end at, and where they hand over to the device
+    unsigned long long total = Replay_Machine(path, name, &expected, REPLAY_SEED_RECORD, log, NULL, 0, 0, &recording);
+
+    if (!total) return 0;
+
+    unsigned long long half = total / 2;
+
+    // Replaying the whole log ends where the recording did, without calling the device
+    if (!Replay_Machine(path, name, &actual, REPLAY_SEED_REPLAY, NULL, log, 0, 0, &state)) return 0;
+    if (!Machine_Compare(name, "replay", &recording, &state)) return 0;
+
+    if (actual.reads || actual.writes) {
+        printf("%s: replay called the device %u times\n", name, actual.reads + actual.writes);
+
+        return 0;
+    }
+
+    // A replay whose reads stop matching the log hands over to the device at the first one that doesn't
+    if (!Replay_Machine(path, name, &expected, REPLAY_SEED_RECORD, NULL, NULL, half, 1, &reference)) return 0;
+    if (!Replay_Machine(path, name, &actual, REPLAY_SEED_REPLAY, NULL, log, half, 1, &state)) return 0;
+    if (!Machine_Compare(name, "diverged replay", &reference, &state)) return 0;
+    if (!Replay_CompareDevice(name, "diverged replay", &expected, &actual)) return 0;
+
+    // A replay of a log recorded up to halfway hands over to the device where the log ends
+    if (!Replay_Machine(path, name, &expected, REPLAY_SEED_RECORD, log, NULL, half, 0, &state)) return 0;
+    if (!Machine_Compare(name, "recording stopped halfway", &recording, &state)) return 0;
+
+    if (!Replay_Machine(path, name, &expected, REPLAY_SEED_RECORD, NULL, NULL, half, 0, &reference)) return 0;
+    if (!Replay_Machine(path, name, &actual, REPLAY_SEED_REPLAY, NULL, log, 0, 0, &state)) return 0;
+    if (!Machine_Compare(name, "replay of the log's first half", &reference, &state)) return 0;
+    if (!Replay_CompareDevice(name, "replay of the log's first half", &expected, &actual)) return 0;
+
+    printf("%s: replays of %llu instructions and %u reads, handing over at %llu, match\n", name, total, expected.reads, half);
+
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int failed = 0;
+    int i = 1;
+
+    // Parse command line arguments, the images following the options
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            MEMORY_KIB = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-j")) {
+            USE_JIT = 1;
+        } else {
+            break;
+        }
+    }
+
+    if (i == argc || argv[i][0] == '-') {
+        printf("Usage: %s [-m memory_kib] [-j] image...\n", argv[0]);
+
+        return 1;
+    }
+
+    for (; i < argc; i++)
+        if (!Replay_Check(argv[i])) failed = 1;
+
+    return failed;
+}
@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "vm.h"
+
+#include "machine.h"
+
+/*
+    Snapshot round trip check
+
+    Runs each image given on the command line to its halt on a reference
+    machine, and again on a machine that saves a snapshot a third of the
+    way through and a delta snapshot at two thirds, then runs on to the
+    halt. A third machine restored from the snapshot and then the delta
+    has to match the second at the delta, and reach the same halt as the
+    reference, registers, virtual clock, memory and disk alike. A copy of
+    the delta with every page marked dirty has to be turned down, and so
+    does a copy of the snapshot with an unsupported bank window size.
+    Machines run through the JIT compiler with -j, and with the bank
+    controller with -m.
+*/
+
+// Offset of the memory dirty map in a delta snapshot, past the header, the full snapshot size and the CPU state
+#define SNAPSHOTS_DELTA_MAP_OFFSET (4 * sizeof(unsigned) + sizeof(CPUState))
+
+// Offset of the window size register in a snapshot of a machine with the bank controller, past the header, CPU state, memory and bank numbers
+#define SNAPSHOTS_BANK_SHIFT_OFFSET (3 * sizeof(unsigned) + sizeof(CPUState) + MEMORY_SIZE + 16 * sizeof(unsigned short) + 1)
+
+// Physical memory in KiB for the bank controller, 0 to run without it
+static unsigned MEMORY_KIB = 0;
+
+// Run the CPU through the JIT compiler flag
+static int USE_JIT = 0;
+
+// Function to create a machine with the devices asked for, loading an image if one is given
+static VM *Snapshots_Create(const char *path) {
+    VM *machine = VM_Create();
+
+    if (!machine) return NULL;
+
+    if ((MEMORY_KIB && !VM_EnableBanks(machine, MEMORY_KIB * 1024)) || (USE_JIT && !VM_EnableJIT(machine)) || (path && !VM_LoadImage(machine, path, 0))) {
+        VM_Destroy(machine);
+
+        return NULL;
+    }
+
+    return machine;
+}
+
+// Function to run the round trip on one image's machines, allocating the snapshots for the caller to free, returning 0 if any state differs or a step fails
+static int Snapshots_RoundTrip(const char *name, VM *reference, VM *source, VM *restored, unsigned char **snapshot, unsigned char **delta) {
+    MachineState halt, middle, actual;
+
+    // The reference run sets where the snapshots are taken and what the halt looks like
+    unsigned long long total = Machine_Run(reference, MACHINE_MAX_INSTRUCTIONS);
+
+    if (!VM_IsHalted(reference)) {
+        printf("%s: didn't halt within %llu instructions\n", name, MACHINE_MAX_INSTRUCTIONS);
+
+        return 0;
+    }
+
+    Machine_GetState(reference, &halt);
+
+    // Snapshot a third of the way in, and save what changed up to two thirds as a delta
+    Machine_Run(source, total / 3);
+
+    unsigned snapshotSize = VM_GetSnapshotSize(source);
+
+    *snapshot = malloc(snapshotSize);
+
+    if (!*snapshot || !VM_SaveSnapshot(source, *snapshot, snapshotSize)) {
+        printf("%s: failed to save the snapshot\n", name);
+
+        return 0;
+    }
+
+    // A snapshot whose bank controller registers select an unsupported window size has to be turned down as well
+    if (MEMORY_KIB) {
+        unsigned char *corrupt = malloc(snapshotSize);
+
+        if (!corrupt) return 0;
+
+        memcpy(corrupt, *snapshot, snapshotSize);
+        corrupt[SNAPSHOTS_BANK_SHIFT_OFFSET] = 13;
+
+        int loaded = VM_LoadSnapshot(restored, corrupt, snapshotSize);
+
+        free(corrupt);
+
+        if (loaded) {
+            printf("%s: a snapshot with a corrupt bank window size was loaded\n", name);
+
+            return 0;
+        }
+    }
+
+    Machine_Run(source, total * 2 / 3 - total / 3);
+
+    unsigned deltaSize = VM_GetDeltaSnapshotSize(source);
+
+    *delta = malloc(deltaSize);
+
+    if (!*delta || !VM_SaveDeltaSnapshot(source, *delta, deltaSize)) {
+        printf("%s: failed to save the delta snapshot\n", name);
+
+        return 0;
+    }
+
+    Machine_GetState(source, &middle);
+
+    // A delta whose memory dirty map claims more pages than it holds has to be turned down before it is applied
+    unsigned char *corrupt = malloc(deltaSize);
+
+    if (!corrupt) return 0;
+
+    memcpy(corrupt, *delta, deltaSize);
+    memset(corrupt + SNAPSHOTS_DELTA_MAP_OFFSET, 0xFF, MEMORY_DIRTY_MAP_SIZE);
+
+    int loaded = VM_LoadDeltaSnapshot(restored, corrupt, deltaSize);
+
+    free(corrupt);
+
+    if (loaded) {
+        printf("%s: a delta with a corrupt dirty map was applied\n", name);
+
+        return 0;
+    }
+
+    // Restore a fresh machine from both and compare it with the source at the delta
+    if (!VM_LoadSnapshot(restored, *snapshot, snapshotSize) || !VM_LoadDeltaSnapshot(restored, *delta, deltaSize)) {
+        printf("%s: failed to restore the snapshots\n", name);
+
+        return 0;
+    }
+
+    Machine_GetState(restored, &actual);
+
+    if (!Machine_Compare(name, "restored machine at the delta", &middle, &actual)) return 0;
+
+    // Taking the snapshots must not change the run, and the restored machine has to carry on the same way
+    Machine_Run(source, MACHINE_MAX_INSTRUCTIONS);
+    Machine_GetState(source, &actual);
+
+    if (!Machine_Compare(name, "snapshotted machine at the halt", &halt, &actual)) return 0;
+
+    Machine_Run(restored, MACHINE_MAX_INSTRUCTIONS);
+    Machine_GetState(restored, &actual);
+
+    if (!Machine_Compare(name, "restored machine at the halt", &halt, &actual)) return 0;
+
+    printf("%s: snapshot and delta at %llu and %llu of %llu instructions round trip\n", name, total / 3, total * 2 / 3, total);
+
+    return 1;
+}
+
+// Function to check one image, returning 0 if it fails
+static int Snapshots_Check(const char *path) {
+    const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    VM *reference = Snapshots_Create(path);
+    VM *source = Snapshots_Create(path);
+    VM *restored = Snapshots_Create(NULL);
+    unsigned char *snapshot = NULL;
+    unsigned char *delta = NULL;
+    int result = 0;
+
+    if (reference && source && restored)
+        result = Snapshots_RoundTrip(name, reference, source, restored, &snapshot, &delta);
+    else
+        printf("%s: failed to create the machines\n", name);
+
+    free(snapshot);
+    free(delta);
+
+    VM_Destroy(reference);
+    VM_Destroy(source);
+    VM_Destroy(restored);
+
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int failed = 0;
+    int i = 1;
+
+    // Parse command line arguments, the images following the options
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            MEMORY_KIB = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-j")) {
+            USE_JIT = 1;
+        } else {
+            break;
+        }
+    }
+
+    if (i == argc || argv[i][0] == '-') {
+        printf("Usage: %s [-m memory_kib] [-j] image...\n", argv[0]);
+
+        return 1;
+    }
+
+    for (; i < argc; i++)
+        if (!Snapshots_Check(argv[i])) failed = 1;
+
+    return failed;
+}
\ No newline at end of file